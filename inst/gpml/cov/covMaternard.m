@@ -43,7 +43,8 @@ if dg                                                               % vector kxx
   K = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    K = sq_dist(diag(sqrt(d)./ell)*x');
+    K = sq_dist_cache(x,d./ell.^2);          % reuse distances if cached
+    if isempty(K), K = sq_dist(diag(sqrt(d)./ell)*x'); end
   else                                                   % cross covariances Kxz
     K = sq_dist(diag(sqrt(d)./ell)*x',diag(sqrt(d)./ell)*z');
   end
@@ -57,7 +58,8 @@ else                                                               % derivatives
       Ki = zeros(size(x,1),1);
     else
       if xeqz
-        Ki = sq_dist(sqrt(d)/ell(i)*x(:,i)');
+        Ki = sq_dist_cache(x,d/ell(i)^2,i);
+        if isempty(Ki), Ki = sq_dist(sqrt(d)/ell(i)*x(:,i)'); end
       else
         Ki = sq_dist(sqrt(d)/ell(i)*x(:,i)',sqrt(d)/ell(i)*z(:,i)');
       end
@@ -37,7 +37,8 @@ if dg                                                               % vector kxx
   K = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    K = sq_dist(sqrt(d)/ell*x');
+    K = sq_dist_cache(x,d/ell^2);            % reuse distances if cached
+    if isempty(K), K = sq_dist(sqrt(d)/ell*x'); end
   else                                                   % cross covariances Kxz
     K = sq_dist(sqrt(d)/ell*x',sqrt(d)/ell*z');
   end
@@ -34,7 +34,8 @@ if dg                                                               % vector kxx
   D2 = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    D2 = sq_dist(diag(1./ell)*x');
+    D2 = sq_dist_cache(x,1./ell.^2);         % reuse distances if cached
+    if isempty(D2), D2 = sq_dist(diag(1./ell)*x'); end
   else                                                   % cross covariances Kxz
     D2 = sq_dist(diag(1./ell)*x',diag(1./ell)*z');
   end
@@ -48,7 +49,9 @@ else                                                               % derivatives
       K = D2*0;
     else
       if xeqz
-        K = sf2*(1+0.5*D2/alpha).^(-alpha-1).*sq_dist(x(:,i)'/ell(i));
+        Ki = sq_dist_cache(x,1/ell(i)^2,i);
+        if isempty(Ki), Ki = sq_dist(x(:,i)'/ell(i)); end
+        K = sf2*(1+0.5*D2/alpha).^(-alpha-1).*Ki;
       else
         K = sf2*(1+0.5*D2/alpha).^(-alpha-1).*sq_dist(x(:,i)'/ell(i),z(:,i)'/ell(i));
       end
@@ -30,7 +30,8 @@ if dg                                                               % vector kxx
   D2 = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    D2 = sq_dist(x'/ell);
+    D2 = sq_dist_cache(x,1/ell^2);           % reuse distances if cached
+    if isempty(D2), D2 = sq_dist(x'/ell); end
   else                                                   % cross covariances Kxz
     D2 = sq_dist(x'/ell,z'/ell);
   end
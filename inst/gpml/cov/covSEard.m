@@ -32,7 +32,8 @@ if dg                                                               % vector kxx
   K = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    K = sq_dist(diag(1./ell)*x');
+    K = sq_dist_cache(x,1./ell.^2);          % reuse distances if cached
+    if isempty(K), K = sq_dist(diag(1./ell)*x'); end
   else                                                   % cross covariances Kxz
     K = sq_dist(diag(1./ell)*x',diag(1./ell)*z');
   end
@@ -45,7 +46,9 @@ if nargin>3                                                        % derivatives
       K = K*0;
     else
       if xeqz
-        K = K.*sq_dist(x(:,i)'/ell(i));
+        Ki = sq_dist_cache(x,1/ell(i)^2,i);
+        if isempty(Ki), Ki = sq_dist(x(:,i)'/ell(i)); end
+        K = K.*Ki;
       else
         K = K.*sq_dist(x(:,i)'/ell(i),z(:,i)'/ell(i));
       end
@@ -29,7 +29,8 @@ if dg                                                               % vector kxx
   K = zeros(size(x,1),1);
 else
   if xeqz                                                 % symmetric matrix Kxx
-    K = sq_dist(x'/ell);
+    K = sq_dist_cache(x,1/ell^2);            % reuse distances if cached
+    if isempty(K), K = sq_dist(x'/ell); end
   else                                                   % cross covariances Kxz
     K = sq_dist(x'/ell,z'/ell);
   end
@@ -0,0 +1,107 @@
+function [post nlZ dnlZ] = infEPparallel(varargin)
+
+% Parallel Expectation Propagation approximation to the posterior Gaussian
+% Process. Unlike infEP, which updates the sites one at a time with rank-1
+% updates of the posterior, all sites are updated at once from the same
+% posterior (so the likelihood is called once per sweep, vectorised over the
+% sites), a damped step is taken towards the new site parameters, and the
+% posterior is refactorized once per sweep. At convergence, the result is
+% the same fixed point as infEP's.
+%
+% Usage: inf = {@infEPparallel} or inf = {@infEPparallel, opt}, where
+% opt = [damping tol max_sweep] gives the fraction of the full site update
+% taken each sweep (default 0.5), the change in nlZ below which EP stops
+% (default 1e-4), and the maximal number of sweeps (default 50).
+%
+% See also INFEP.M, INFMETHODS.M.
+
+persistent last_ttau last_tnu              % keep tilde parameters between calls
+opt = [];                                          % optional leading options
+if nargin == 7, opt = varargin{1}; varargin = varargin(2:end); end
+[hyp, mean, cov, lik, x, y] = deal(varargin{:});
+damp = 0.5; tol = 1e-4; max_sweep = 50; min_sweep = 2;        % default options
+if numel(opt) > 0, damp = opt(1); end
+if numel(opt) > 1, tol = opt(2); end
+if numel(opt) > 2, max_sweep = opt(3); end
+
+inf = 'infEP';                            % call likelihoods as infEP does
+n = size(x,1);
+if isnumeric(cov),  K = cov;                    % use provided covariance matrix
+else K = feval(cov{:},  hyp.cov,  x); end       % evaluate the covariance matrix
+if isnumeric(mean), m = mean;                         % use provided mean vector
+else m = feval(mean{:}, hyp.mean, x); end             % evaluate the mean vector
+
+% marginal likelihood for ttau = tnu = zeros(n,1); equals n*log(2) for likCum*
+nlZ0 = -sum(feval(lik{:}, hyp.lik, y, m, diag(K), inf));
+if any(size(last_ttau) ~= [n 1])      % find starting point for tilde parameters
+  ttau = zeros(n,1); tnu  = zeros(n,1);        % init to zero if no better guess
+else
+  ttau = last_ttau; tnu  = last_tnu;   % try the tilde values from previous call
+end
+[v,L,alpha,nlZ,tau_n,nu_n,dlZ,d2lZ] = ...
+                           epComputeParams(K, y, ttau, tnu, lik, hyp, m, inf);
+if nlZ > nlZ0                                             % if zero is better ..
+  ttau = zeros(n,1); tnu  = zeros(n,1);         % .. then init with zero instead
+  [v,L,alpha,nlZ,tau_n,nu_n,dlZ,d2lZ] = ...
+                           epComputeParams(K, y, ttau, tnu, lik, hyp, m, inf);
+end
+
+nlZ_old = Inf; sweep = 0;               % converged, max. sweeps or min. sweeps?
+while (abs(nlZ-nlZ_old) > tol && sweep < max_sweep) || sweep<min_sweep
+  nlZ_old = nlZ; sweep = sweep+1;
+  ttau_new = -d2lZ./(1+d2lZ./tau_n);        % new tilde params for all sites ..
+  ttau_new = max(ttau_new,0);                 % enforce positivity of ttau
+  tnu_new = (dlZ - nu_n./tau_n.*d2lZ)./(1+d2lZ./tau_n);  % .. from the moments
+  id = tau_n > 0;                 % sites with improper cavities are left alone
+  ttau(id) = (1-damp)*ttau(id) + damp*ttau_new(id);   % damped step towards ..
+  tnu(id)  = (1-damp)*tnu(id)  + damp*tnu_new(id);    % .. the new parameters
+  [v,L,alpha,nlZ,tau_n,nu_n,dlZ,d2lZ] = ...
+                           epComputeParams(K, y, ttau, tnu, lik, hyp, m, inf);
+end
+
+if sweep == max_sweep && abs(nlZ-nlZ_old) > tol
+  error('maximum number of sweeps exceeded in function infEPparallel')
+end
+
+last_ttau = ttau; last_tnu = tnu;                       % remember for next call
+post.alpha = alpha; post.sW = sqrt(ttau); post.L = L;  % return posterior params
+
+if nargout>2                                           % do we want derivatives?
+  dnlZ = hyp;                                   % allocate space for derivatives
+  sW = sqrt(ttau);
+  F = alpha*alpha'-repmat(sW,1,n).*solve_chol(L,diag(sW));   % covariance hypers
+  for i=1:length(hyp.cov)
+    dK = feval(cov{:}, hyp.cov, x, [], i);
+    dnlZ.cov(i) = -sum(sum(F.*dK))/2;
+  end
+  for i = 1:numel(hyp.lik)                                   % likelihood hypers
+    dlik = feval(lik{:}, hyp.lik, y, nu_n./tau_n, 1./tau_n, inf, i);
+    dnlZ.lik(i) = -sum(dlik);
+  end
+  for i = 1:numel(hyp.mean)                                       % mean hypers
+    dm = feval(mean{:}, hyp.mean, x, i);
+    dnlZ.mean(i) = -dlZ'*dm;
+  end
+end
+
+% function to compute the posterior variances v (the diagonal of Sigma), L,
+% alpha, the negative log marginal likelihood, nlZ, and the cavity parameters
+% and moments from the current site parameters, ttau and tnu. Only diag(Sigma)
+% is needed, so Sigma itself is never formed.
+function [v,L,alpha,nlZ,tau_n,nu_n,dlZ,d2lZ] = ...
+                                 epComputeParams(K,y,ttau,tnu,lik,hyp,m,inf)
+  n = length(y);                                      % number of training cases
+  sW = sqrt(ttau);                                            % compute v and mu
+  L = chol(eye(n)+sW*sW'.*K);                            % L'*L=B=eye(n)+sW*K*sW
+  V = L'\(repmat(sW,1,n).*K);
+  v = diag(K) - sum(V.*V,1)';
+  alpha = tnu-sW.*solve_chol(L,sW.*(K*tnu+m));
+  mu = K*alpha+m;
+
+  tau_n = 1./v-ttau;                       % compute the log marginal likelihood
+  nu_n  = mu./v-tnu;                              % vectors of cavity parameters
+  [lZ,dlZ,d2lZ] = feval(lik{:}, hyp.lik, y, nu_n./tau_n, 1./tau_n, inf);
+  p = tnu-m.*ttau; q = nu_n-m.*tau_n;                        % auxiliary vectors
+  Vp = V*p;                                 % p'*Sigma*p = p'*K*p - p'*V'*V*p
+  nlZ = sum(log(diag(L))) - sum(lZ) - (p'*K*p - Vp'*Vp)/2 + (v'*p.^2)/2 ...
+      - q'*((ttau./tau_n.*q-2*p).*v)/2 - sum(log(1+ttau./tau_n))/2;
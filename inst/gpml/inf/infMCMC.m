@@ -13,7 +13,11 @@ function [post nlZ dnlZ] = infMCMC(hyp, mean, cov, lik, x, y, par)
 %   - par.Nskip     num of steps out of which one sample kept
 %   - par.Nburnin   num of burn in samples (corresponds to Nskip*Nburning steps)
 %   - par.Nais      num of AIS runs to remove finite temperature bias
-% Default values are 'sampler=hmc', Nsample=200, Nskip=40, Nburnin=10, Nais=3.
+%   - par.init      initial state alpha of the chain (n by 1), to continue
+%                   a previous run from its last sample
+%   - par.stepsize  initial HMC leapfrog stepsize, e.g. post.stepsize_HMC
+% Default values are 'sampler=hmc', Nsample=200, Nskip=40, Nburnin=10, Nais=3,
+% init=zeros(n,1), stepsize=1e-2.
 %
 % The Hybrid Monte Carlo Sampler (HMC) is implemented as described in the
 % technical report: Probabilistic Inference using MCMC Methods by Radford Neal,
@@ -53,6 +57,8 @@ if isfield(par,'Nsample'),  N  =par.Nsample;  else N   = 200;   end
 if isfield(par,'Nskip'),    Ns =par.Nskip;    else Ns  =  40;   end
 if isfield(par,'Nburnin'),  Nb =par.Nburnin;  else Nb  =  10;   end
 if isfield(par,'Nais'),     R  =par.Nais;     else R   =   3;   end
+if isfield(par,'init'),     a0 =par.init;     else a0  =  [];   end
+if isfield(par,'stepsize'), ep0=par.stepsize; else ep0 = 1e-2;  end
 
 K = feval(cov{:}, hyp.cov, x);                  % evaluate the covariance matrix
 m = feval(mean{:}, hyp.mean, x);                      % evaluate the mean vector
@@ -60,11 +66,12 @@ n = size(K,1);
 [cK,fail] = chol(K);                    % try an ordinary Cholesky decomposition
 if fail, sr2 = 1e-8*sum(diag(K))/n; cK = chol(K+sr2*eye(n)); end    % regularise
 T = (N+Nb)*Ns;                                         % overall number of steps
-[alpha,Na] = sample(K,cK,m,y,lik,hyp.lik, N,Nb,Ns, alg);  % sample w/o annealing
+[alpha,Na,ep] = sample(K,cK,m,y,lik,hyp.lik, N,Nb,Ns, alg, a0,ep0); % no anneal
 post.alpha = alpha; al = sum(alpha,2)/N;
 post.L  = -(cK\(cK'\eye(n)) + al*al' - alpha*alpha'/N);    % inv(K) - cov(alpha)
 post.sW = [];
-post.acceptance_rate_MCMC = Na/T;                  % additional output parameter
+post.acceptance_rate_MCMC = Na/T;                 % additional output parameters
+if strcmpi(alg,'hmc'), post.stepsize_HMC = ep; end
 if nargout>1                                      % annealed importance sampling
   % discrete time t from 1 to T and temperature tau from tau(1)=0 to tau(T)=1
   taus = [zeros(1,Nb),linspace(0,1,N)].^4; % annealing schedule, effort at start
@@ -74,7 +81,7 @@ if nargout>1                                      % annealed importance sampling
   % ln Z(t)/Z(t-1) = ( tau(t)-tau(t-1) ) * loglik(f_t)
   lZ = zeros(R,1); dtaus = diff(taus(Nb+(1:N)));        % we have: sum(dtaus)==1
   for r=1:R
-    [A,Na] = sample(K,cK,m,y,lik,hyp.lik, N,Nb,Ns, alg, taus);             % AIS
+    [A,Na] = sample(K,cK,m,y,lik,hyp.lik, N,Nb,Ns, alg, [],1e-2, taus);   % AIS
     for t=2:N                              % evaluate the likelihood sample-wise
       lp = feval(lik{:},hyp.lik,y,K*A(:,t)+m,[],'infLaplace');
       lZ(r) = lZ(r)+dtaus(t-1)*sum(lp);
@@ -88,21 +95,22 @@ if nargout>1                                      % annealed importance sampling
 end
 
 %% choose between HMC and ESS depending on the alg string
-function [alpha,Na] = sample(K,cK,m,y,lik,hyp, N,Nb,Ns, alg, varargin)
+function [alpha,Na,ep] = sample(K,cK,m,y,lik,hyp, N,Nb,Ns, alg,a0,ep0, varargin)
+  if isempty(a0), a0 = zeros(size(m)); end      % start at alpha=0, i.e. f=m
   if strcmpi(alg,'hmc')
-    [alpha,Na] = sample_hmc(K, m,y,lik,hyp, N,Nb,Ns, varargin{:});
+    [alpha,Na,ep] = sample_hmc(K, m,y,lik,hyp, N,Nb,Ns, a0,ep0, varargin{:});
   else
-    [alpha,Na] = sample_ess(cK,m,y,lik,hyp, N,Nb,Ns, varargin{:});
+    [alpha,Na] = sample_ess(cK,m,y,lik,hyp, N,Nb,Ns, a0, varargin{:}); ep = [];
   end
 
 %% sample using elliptical slices
-function [alpha,T] = sample_ess(cK,m,y,lik,hyp, N,Nb,Ns, taus)
-  if nargin>=9, tau = taus(1); else tau = 1; end       % default is no annealing
+function [alpha,T] = sample_ess(cK,m,y,lik,hyp, N,Nb,Ns, a0, taus)
+  if nargin>=10, tau = taus(1); else tau = 1; end      % default is no annealing
   T = (N+Nb)*Ns;                                       % overall number of steps
   F = zeros(size(m,1),N);
   for t=1:T
-    if nargin>=9, tau = taus(1+floor((t-1)/Ns)); end   % parameter from schedule
-    if t==1, f=0*m; l=sum(feval(lik{:},hyp,y,f+m)); end  % init sample f & lik l
+    if nargin>=10, tau = taus(1+floor((t-1)/Ns)); end  % parameter from schedule
+    if t==1, f=cK'*(cK*a0); l=sum(feval(lik{:},hyp,y,f+m)); end   % init f & l
     r = cK'*randn(size(m));                          % random sample from N(0,K)
     [f,l] = sample_ess_step(f,l,r,m,y,lik,hyp,tau);
     if mod(t,Ns)==0                                   % keep one state out of Ns
@@ -127,11 +135,11 @@ function [f,l] = sample_ess_step(f,l,r,m,y,lik,hyp,tau)
   f = fp;                                                               % accept
 
 %% sample using Hamiltonian dynamics as proposal algorithm
-function [alpha,Na] = sample_hmc(K,m,y,lik,hyp, N,Nb,Ns, taus)
+function [alpha,Na,ep] = sample_hmc(K,m,y,lik,hyp, N,Nb,Ns, a0,ep0, taus)
   % use adaptive stepsize rule to enforce a specific acceptance rate 
   epmin = 1e-6; % minimum leapfrog stepsize
   epmax = 9e-1; % maximum leapfrog stepsize
-  ep    = 1e-2; % initial leapfrog stepsize
+  ep    = ep0;  % initial leapfrog stepsize
   acc_t = 0.9;  % target acceptance rate
   acc   = 0;    % current acceptance rate
   epinc = 1.02; % increase factor of stepsize if acceptance rate is below target
@@ -142,12 +150,12 @@ function [alpha,Na] = sample_hmc(K,m,y,lik,hyp, N,Nb,Ns, taus)
   n = size(K,1);
   T = (N+Nb)*Ns;                                       % overall number of steps
   alpha = zeros(n,N);                                            % sample points
-  al = zeros(n,1);                                            % current position
-  if nargin>=9, tau = taus(1); else tau = 1; end       % default is no annealing
+  al = a0;                                                    % current position
+  if nargin>=11, tau = taus(1); else tau = 1; end      % default is no annealing
   [gold,eold] = E(al,K,m,y,lik,hyp,tau);              % initial energy, gradient
   Na = 0;                                            % number of accepted points
   for t=1:T
-    if nargin>=9, tau = taus(1+floor((t-1)/Ns)); end   % parameter from schedule
+    if nargin>=11, tau = taus(1+floor((t-1)/Ns)); end  % parameter from schedule
     p = randn(n,1);                                    % random initial momentum
     q = al;
     g = gold;
@@ -182,7 +190,7 @@ function [alpha,Na] = sample_hmc(K,m,y,lik,hyp, N,Nb,Ns, taus)
   if Na/T<acc_t*0.9 || 1.07*acc_t<Na/T  % Acceptance rate in the right ballpark?
     fprintf('The acceptance rate %1.2f%% is not within',100*Na/T)
     fprintf(' [%1.1f, %1.1f]%%\n', 100*acc_t*0.9, 100*acc_t*1.07)
-    if nargin<9
+    if nargin<11
       warning('Bad (HMC) acceptance rate')
     else
       warning('Bad (AIS) acceptance rate')
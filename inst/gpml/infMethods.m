@@ -4,6 +4,7 @@
 %   infExact         Exact inference (only possible with Gaussian likelihood)
 %   infLaplace       Laplace's Approximation
 %   infEP            Expectation Propagation
+%   infEPparallel    Expectation Propagation, all sites updated at once
 %   infVB            Variational Bayes Approximation
 %   infKL            Kullback-Leibler optimal Approximation
 %
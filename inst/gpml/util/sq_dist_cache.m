@@ -0,0 +1,58 @@
+% sq_dist_cache - pairwise squared distances of a set of inputs, kept between
+% calls. While hyperparameters are optimized, the covariance function is
+% evaluated over and over on the same training inputs, and only the scaling of
+% the distances changes; this keeps sq_dist(x') (for isotropic covariances) or
+% the per-dimension squared differences sq_dist(x(:,d)') (for ARD covariances)
+% of the inputs last seen, and scales them instead of recomputing them. The
+% cache holds one set of inputs at a time, recognised by their contents, and
+% is only used while a memory limit is set; otherwise, or when the distances
+% would not fit in the limit, the result is empty and the caller should fall
+% back to sq_dist.
+%
+% Usage: C = sq_dist_cache(x, w)       C = sq_dist(diag(sqrt(w))*x') for a
+%                                      scalar or D by 1 vector of weights w
+%    or: C = sq_dist_cache(x, w, i)    C = w*sq_dist(x(:,i)') for a scalar w
+%    or: sq_dist_cache('limit', bytes) set the memory limit (0, the default,
+%                                      disables the cache) and empty it
+%    or: sq_dist_cache('clear')        empty the cache
+%
+% Where x is of size nxD and C is of size nxn.
+%
+% See also SQ_DIST.M.
+
+function C = sq_dist_cache(x, w, i)
+
+persistent limit X T per_dim               % memory limit and cached distances
+if isempty(limit), limit = 0; per_dim = false; end
+C = [];
+if ischar(x)                                                  % cache control
+  switch x
+    case 'limit', limit = w; X = []; T = [];
+    case 'clear', X = []; T = [];
+    otherwise, error('Unknown sq_dist_cache command.')
+  end
+  return
+end
+
+[n,D] = size(x);
+need_dim = D>1 && (numel(w)>1 || nargin>2);      % per-dimension distances
+if need_dim, bytes = 8*n*n*D; else bytes = 8*n*n; end
+if bytes>limit, return, end
+if ~isequal(X,x) || need_dim~=per_dim
+  X = []; T = [];                              % release before recomputing
+  if need_dim
+    T = zeros(n,n,D);
+    for d = 1:D, T(:,:,d) = bsxfun(@minus,x(:,d),x(:,d)').^2; end
+  else
+    T = sq_dist(x');
+  end
+  X = x; per_dim = need_dim;
+end
+
+if nargin>2                                       % one dimension's distances
+  if per_dim, C = w*T(:,:,i); else C = w*T; end
+elseif per_dim                                    % weighted over dimensions
+  C = reshape(reshape(T,n*n,D)*w(:),n,n);
+else
+  C = w*T;
+end
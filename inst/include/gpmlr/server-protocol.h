@@ -0,0 +1,185 @@
+#ifndef GPMLR_SERVER_PROTOCOL_H
+#define GPMLR_SERVER_PROTOCOL_H
+
+// The wire format spoken by gpmlr's prediction server (see gp_serve() in R),
+// and a small blocking client for it. This header only needs POSIX, so
+// services can include it directly; see inst/server/gpmlr-client.cpp.
+//
+// Every message is a fixed header followed by a payload. All integers are
+// uint32_t and all numbers are doubles, in the host's byte order (the server
+// only listens on a Unix domain socket, so both ends share a machine).
+//
+// Request:  server_request_header, then name_length bytes of model name,
+//           then n_rows * n_cols doubles: the test inputs, one per row,
+//           stored row by row.
+// Response: server_response_header, then
+//           - for predictions, n_rows * 4 doubles: the columns YMU, YS2,
+//             FMU, and FS2, one after the other;
+//           - for statistics, n_rows * n_cols doubles, column by column;
+//           - for errors, n_rows bytes of error message (n_cols is 0).
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const uint32_t SERVER_MAGIC = 0x524d5047; // "GPMR"
+const uint32_t SERVER_VERSION = 1;
+
+enum server_request_type {
+    REQUEST_PREDICT = 1,  // predict at the given inputs
+    REQUEST_STATS = 2,    // report the latency histogram
+    REQUEST_SHUTDOWN = 3  // stop the server after replying
+};
+
+enum server_status { STATUS_OK = 0, STATUS_ERROR = 1 };
+
+struct server_request_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;
+    uint32_t name_length;
+    uint32_t n_rows;
+    uint32_t n_cols;
+};
+
+struct server_response_header {
+    uint32_t magic;
+    uint32_t status;
+    uint32_t n_rows;
+    uint32_t n_cols;
+};
+
+// Requests larger than this are refused, so a bad client can't make the
+// server allocate without bound
+const uint64_t SERVER_MAX_PAYLOAD = 1ULL << 31;
+
+
+// ------------------------ Blocking socket helpers --------------------------
+inline bool write_all(int fd, const void* buffer, size_t n) {
+    const char* p = static_cast<const char*>(buffer);
+    while ( n > 0 ) {
+        ssize_t written = send(fd, p, n, MSG_NOSIGNAL);
+        if ( written < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( written <= 0 ) {
+            return false;
+        }
+        p += written;
+        n -= written;
+    }
+    return true;
+}
+
+inline bool read_all(int fd, void* buffer, size_t n) {
+    char* p = static_cast<char*>(buffer);
+    while ( n > 0 ) {
+        ssize_t got = recv(fd, p, n, 0);
+        if ( got < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( got <= 0 ) {
+            return false;
+        }
+        p += got;
+        n -= got;
+    }
+    return true;
+}
+
+// Connects to the server listening at path; returns -1 on failure
+inline int server_connect(const std::string& path) {
+    sockaddr_un address;
+    if ( path.size() >= sizeof(address.sun_path) ) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( fd < 0 ) {
+        return -1;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path.c_str());
+    if ( connect(fd, reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) != 0 ) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// ------------------------------- Client ------------------------------------
+// Sends one request over an open connection and waits for the reply.
+// On success, result holds the response payload and n_rows/n_cols its shape;
+// on failure, error says why.
+inline bool server_exchange(int fd, uint32_t type, const std::string& model,
+                            const double* x, uint32_t n_rows, uint32_t n_cols,
+                            std::vector<double>& result,
+                            uint32_t& result_rows, uint32_t& result_cols,
+                            std::string& error) {
+    server_request_header request;
+    request.magic = SERVER_MAGIC;
+    request.version = SERVER_VERSION;
+    request.type = type;
+    request.name_length = static_cast<uint32_t>(model.size());
+    request.n_rows = n_rows;
+    request.n_cols = n_cols;
+    size_t n_values = static_cast<size_t>(n_rows) * n_cols;
+    if ( !write_all(fd, &request, sizeof(request))
+         || !write_all(fd, model.data(), model.size())
+         || (n_values > 0 && !write_all(fd, x, n_values * sizeof(double))) ) {
+        error = "Failed to send request.";
+        return false;
+    }
+    server_response_header response;
+    if ( !read_all(fd, &response, sizeof(response))
+         || response.magic != SERVER_MAGIC ) {
+        error = "Failed to read response.";
+        return false;
+    }
+    if ( response.status != STATUS_OK ) {
+        std::string message(response.n_rows, '\0');
+        if ( response.n_rows > 0 && !read_all(fd, &message[0],
+                                              response.n_rows) ) {
+            message = "Failed to read error message.";
+        }
+        error = message;
+        return false;
+    }
+    result_rows = response.n_rows;
+    result_cols = response.n_cols;
+    result.resize(static_cast<size_t>(result_rows) * result_cols);
+    if ( !result.empty() && !read_all(fd, &result[0],
+                                      result.size() * sizeof(double)) ) {
+        error = "Failed to read response.";
+        return false;
+    }
+    return true;
+}
+
+// Convenience wrapper: connect, ask for predictions, and disconnect.
+// x holds n_rows test inputs of n_cols dimensions, row by row; on success
+// result holds the YMU, YS2, FMU, and FS2 columns (n_rows each).
+inline bool server_predict(const std::string& path, const std::string& model,
+                           const double* x, uint32_t n_rows, uint32_t n_cols,
+                           std::vector<double>& result, std::string& error) {
+    int fd = server_connect(path);
+    if ( fd < 0 ) {
+        error = "Could not connect to " + path + ".";
+        return false;
+    }
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    bool ok = server_exchange(fd, REQUEST_PREDICT, model, x, n_rows, n_cols,
+                              result, rows, cols, error);
+    close(fd);
+    return ok;
+}
+
+#endif
@@ -0,0 +1,71 @@
+// A small command line client for gpmlr's prediction server (gp_serve()).
+// Build it against the header installed with the package, e.g.
+//
+//   INCLUDE=$(Rscript -e 'cat(system.file("include", package = "gpmlr"))')
+//   g++ -I"$INCLUDE" gpmlr-client.cpp -o gpmlr-client
+//
+// Usage:
+//   gpmlr-client SOCKET MODEL D < inputs   # predict; reads rows of D numbers
+//   gpmlr-client SOCKET --stats            # print the latency histogram
+//   gpmlr-client SOCKET --shutdown         # stop the server
+//
+// Predictions are printed one row per input as: ymu ys2 fmu fs2
+
+#include <gpmlr/server-protocol.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if ( argc < 3 ) {
+        std::cerr << "usage: gpmlr-client SOCKET MODEL D < inputs\n"
+                  << "       gpmlr-client SOCKET --stats|--shutdown\n";
+        return 2;
+    }
+    std::string path = argv[1];
+    std::string what = argv[2];
+    std::vector<double> result;
+    uint32_t rows = 0;
+    uint32_t cols = 0;
+    std::string error;
+    int fd = server_connect(path);
+    if ( fd < 0 ) {
+        std::cerr << "Could not connect to " << path << "\n";
+        return 1;
+    }
+    bool ok = false;
+    if ( what == "--stats" || what == "--shutdown" ) {
+        uint32_t type = what == "--stats" ? REQUEST_STATS : REQUEST_SHUTDOWN;
+        ok = server_exchange(fd, type, "", 0, 0, 0, result, rows, cols, error);
+        for ( uint32_t i = 0; ok && i < rows; ++i ) {
+            if ( result[rows + i] > 0 ) {
+                std::printf("< %12.0f us: %.0f\n", result[i], result[rows + i]);
+            }
+        }
+    }
+    else if ( argc == 4 ) {
+        uint32_t d = static_cast<uint32_t>(std::atoi(argv[3]));
+        std::vector<double> x;
+        double value;
+        while ( std::cin >> value ) {
+            x.push_back(value);
+        }
+        uint32_t n = d > 0 ? static_cast<uint32_t>(x.size() / d) : 0;
+        ok = server_exchange(fd, REQUEST_PREDICT, what, x.empty() ? 0 : &x[0],
+                             n, d, result, rows, cols, error);
+        for ( uint32_t i = 0; ok && i < rows; ++i ) {
+            std::printf("%.10g %.10g %.10g %.10g\n", result[i],
+                        result[rows + i], result[2 * rows + i],
+                        result[3 * rows + i]);
+        }
+    }
+    else {
+        error = "Missing the number of input dimensions.";
+    }
+    close(fd);
+    if ( !ok ) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,26 @@
 
 using namespace Rcpp;
 
+// gp_compact
+Rcpp::List gp_compact(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericVector xs, Rcpp::NumericVector ys, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_compact(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_compact(hyp, mean, cov, lik, x, y, xs, ys, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // octave_is_embedded
 bool octave_is_embedded();
 RcppExport SEXP _gpmlr_octave_is_embedded() {
@@ -48,8 +68,107 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// gp_ep
+Rcpp::List gp_ep(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericVector options, bool derivatives);
+RcppExport SEXP _gpmlr_gp_ep(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP optionsSEXP, SEXP derivativesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type options(optionsSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_ep(hyp, mean, cov, lik, x, y, options, derivatives));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_exact
+SEXP gp_exact(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_exact(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_exact(hyp, mean, cov, lik, x, y, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_additive_model
+bool gp_additive_model(Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x);
+RcppExport SEXP _gpmlr_gp_additive_model(SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_additive_model(mean, cov, lik, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_inducing
+Rcpp::NumericMatrix gp_inducing(Rcpp::NumericVector x, int m, std::string method, Rcpp::List cov, Rcpp::NumericVector hyp_cov, double seed, int threads);
+RcppExport SEXP _gpmlr_gp_inducing(SEXP xSEXP, SEXP mSEXP, SEXP methodSEXP, SEXP covSEXP, SEXP hyp_covSEXP, SEXP seedSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type m(mSEXP);
+    Rcpp::traits::input_parameter< std::string >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type hyp_cov(hyp_covSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_inducing(x, m, method, cov, hyp_cov, seed, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_fitc
+SEXP gp_fitc(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_fitc(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_fitc(hyp, mean, cov, lik, x, y, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_fitc_model
+bool gp_fitc_model(Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x);
+RcppExport SEXP _gpmlr_gp_fitc_model(SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_fitc_model(mean, cov, lik, x));
+    return rcpp_result_gen;
+END_RCPP
+}
 // gpml1
-Rcpp::List gpml1(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, Rcpp::NumericVector x, Rcpp::NumericVector y);
+Rcpp::List gpml1(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, SEXP x, Rcpp::NumericVector y);
 RcppExport SEXP _gpmlr_gpml1(SEXP hyperparametersSEXP, SEXP inffuncSEXP, SEXP meanfuncSEXP, SEXP covfuncSEXP, SEXP likfuncSEXP, SEXP xSEXP, SEXP ySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
@@ -59,14 +178,14 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Rcpp::List >::type meanfunc(meanfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type covfunc(covfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type likfunc(likfuncSEXP);
-    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
     rcpp_result_gen = Rcpp::wrap(gpml1(hyperparameters, inffunc, meanfunc, covfunc, likfunc, x, y));
     return rcpp_result_gen;
 END_RCPP
 }
 // gpml2
-Rcpp::List gpml2(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, Rcpp::NumericVector training_x, Rcpp::NumericVector training_y, Rcpp::NumericVector testing_x);
+Rcpp::List gpml2(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, SEXP training_x, Rcpp::NumericVector training_y, SEXP testing_x);
 RcppExport SEXP _gpmlr_gpml2(SEXP hyperparametersSEXP, SEXP inffuncSEXP, SEXP meanfuncSEXP, SEXP covfuncSEXP, SEXP likfuncSEXP, SEXP training_xSEXP, SEXP training_ySEXP, SEXP testing_xSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
@@ -76,15 +195,15 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Rcpp::List >::type meanfunc(meanfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type covfunc(covfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type likfunc(likfuncSEXP);
-    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type training_x(training_xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type training_x(training_xSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type training_y(training_ySEXP);
-    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type testing_x(testing_xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type testing_x(testing_xSEXP);
     rcpp_result_gen = Rcpp::wrap(gpml2(hyperparameters, inffunc, meanfunc, covfunc, likfunc, training_x, training_y, testing_x));
     return rcpp_result_gen;
 END_RCPP
 }
 // gpml3
-Rcpp::List gpml3(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, Rcpp::NumericVector training_x, Rcpp::NumericVector training_y, Rcpp::NumericVector testing_x, Rcpp::NumericVector testing_y);
+Rcpp::List gpml3(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, SEXP training_x, Rcpp::NumericVector training_y, SEXP testing_x, Rcpp::NumericVector testing_y);
 RcppExport SEXP _gpmlr_gpml3(SEXP hyperparametersSEXP, SEXP inffuncSEXP, SEXP meanfuncSEXP, SEXP covfuncSEXP, SEXP likfuncSEXP, SEXP training_xSEXP, SEXP training_ySEXP, SEXP testing_xSEXP, SEXP testing_ySEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
@@ -94,14 +213,221 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Rcpp::List >::type meanfunc(meanfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type covfunc(covfuncSEXP);
     Rcpp::traits::input_parameter< Rcpp::List >::type likfunc(likfuncSEXP);
-    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type training_x(training_xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type training_x(training_xSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type training_y(training_ySEXP);
-    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type testing_x(testing_xSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type testing_x(testing_xSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type testing_y(testing_ySEXP);
     rcpp_result_gen = Rcpp::wrap(gpml3(hyperparameters, inffunc, meanfunc, covfunc, likfunc, training_x, training_y, testing_x, testing_y));
     return rcpp_result_gen;
 END_RCPP
 }
+// gpml4
+Rcpp::List gpml4(Rcpp::List hyperparameters, Rcpp::List inffunc, Rcpp::List meanfunc, Rcpp::List covfunc, Rcpp::List likfunc, SEXP training_x, Rcpp::List post, SEXP testing_x, Rcpp::NumericVector testing_y);
+RcppExport SEXP _gpmlr_gpml4(SEXP hyperparametersSEXP, SEXP inffuncSEXP, SEXP meanfuncSEXP, SEXP covfuncSEXP, SEXP likfuncSEXP, SEXP training_xSEXP, SEXP postSEXP, SEXP testing_xSEXP, SEXP testing_ySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyperparameters(hyperparametersSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type inffunc(inffuncSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type meanfunc(meanfuncSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type covfunc(covfuncSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type likfunc(likfuncSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type training_x(training_xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type post(postSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type testing_x(testing_xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type testing_y(testing_ySEXP);
+    rcpp_result_gen = Rcpp::wrap(gpml4(hyperparameters, inffunc, meanfunc, covfunc, likfunc, training_x, post, testing_x, testing_y));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_grid
+Rcpp::List gp_grid(Rcpp::List axes, Rcpp::List cov, Rcpp::List hyp, Rcpp::List mean, Rcpp::NumericVector y, Rcpp::NumericMatrix xs, Rcpp::NumericVector options, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_grid(SEXP axesSEXP, SEXP covSEXP, SEXP hypSEXP, SEXP meanSEXP, SEXP ySEXP, SEXP xsSEXP, SEXP optionsSEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type axes(axesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type options(optionsSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_grid(axes, cov, hyp, mean, y, xs, options, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_iterative
+Rcpp::List gp_iterative(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericVector xs, Rcpp::NumericVector ys, Rcpp::NumericVector options, double seed, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_iterative(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP optionsSEXP, SEXP seedSEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type options(optionsSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_iterative(hyp, mean, cov, lik, x, y, xs, ys, options, seed, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_laplace
+Rcpp::List gp_laplace(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, bool derivatives);
+RcppExport SEXP _gpmlr_gp_laplace(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP derivativesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_laplace(hyp, mean, cov, lik, x, y, derivatives));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_mcmc_chain
+Rcpp::List gp_mcmc_chain(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, std::string sampler, int n_sample, int n_skip, int n_burnin, Rcpp::NumericVector init, double stepsize, double seed);
+RcppExport SEXP _gpmlr_gp_mcmc_chain(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP samplerSEXP, SEXP n_sampleSEXP, SEXP n_skipSEXP, SEXP n_burninSEXP, SEXP initSEXP, SEXP stepsizeSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< std::string >::type sampler(samplerSEXP);
+    Rcpp::traits::input_parameter< int >::type n_sample(n_sampleSEXP);
+    Rcpp::traits::input_parameter< int >::type n_skip(n_skipSEXP);
+    Rcpp::traits::input_parameter< int >::type n_burnin(n_burninSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type init(initSEXP);
+    Rcpp::traits::input_parameter< double >::type stepsize(stepsizeSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_mcmc_chain(hyp, mean, cov, lik, x, y, sampler, n_sample, n_skip, n_burnin, init, stepsize, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_mcmc_post
+Rcpp::List gp_mcmc_post(Rcpp::List hyp, Rcpp::List cov, Rcpp::NumericVector x, Rcpp::NumericMatrix alpha);
+RcppExport SEXP _gpmlr_gp_mcmc_post(SEXP hypSEXP, SEXP covSEXP, SEXP xSEXP, SEXP alphaSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type alpha(alphaSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_mcmc_post(hyp, cov, x, alpha));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_hash
+std::string gp_hash(Rcpp::List objects);
+RcppExport SEXP _gpmlr_gp_hash(SEXP objectsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type objects(objectsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_hash(objects));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_minibatch_nlz
+Rcpp::NumericMatrix gp_minibatch_nlz(Rcpp::List hyp, Rcpp::List inf, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericMatrix x, Rcpp::NumericVector y, Rcpp::List batches, int threads);
+RcppExport SEXP _gpmlr_gp_minibatch_nlz(SEXP hypSEXP, SEXP infSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP batchesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type inf(infSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type batches(batchesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_minibatch_nlz(hyp, inf, mean, cov, lik, x, y, batches, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_save
+void gp_save(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector alpha, Rcpp::NumericVector sW, Rcpp::NumericMatrix L, std::string spec, std::string path);
+RcppExport SEXP _gpmlr_gp_save(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP alphaSEXP, SEXP sWSEXP, SEXP LSEXP, SEXP specSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type sW(sWSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type L(LSEXP);
+    Rcpp::traits::input_parameter< std::string >::type spec(specSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    gp_save(hyp, mean, cov, lik, x, alpha, sW, L, spec, path);
+    return R_NilValue;
+END_RCPP
+}
+// gp_load
+Rcpp::List gp_load(std::string path);
+RcppExport SEXP _gpmlr_gp_load(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_load(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_predict
+Rcpp::List gp_predict(SEXP pointer, Rcpp::NumericMatrix xs, int threads);
+RcppExport SEXP _gpmlr_gp_predict(SEXP pointerSEXP, SEXP xsSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type pointer(pointerSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_predict(pointer, xs, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_nlz_grid
+Rcpp::NumericMatrix gp_nlz_grid(Rcpp::List hyp, Rcpp::List inf, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericMatrix hyp_grid, bool gradient, int threads);
+RcppExport SEXP _gpmlr_gp_nlz_grid(SEXP hypSEXP, SEXP infSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP hyp_gridSEXP, SEXP gradientSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type inf(infSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type hyp_grid(hyp_gridSEXP);
+    Rcpp::traits::input_parameter< bool >::type gradient(gradientSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_nlz_grid(hyp, inf, mean, cov, lik, x, y, hyp_grid, gradient, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // print_path
 void print_path();
 RcppExport SEXP _gpmlr_print_path() {
@@ -131,9 +457,32 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
-// set_hyperparameters
-Rcpp::List set_hyperparameters(Rcpp::List hyp, Rcpp::List inf, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, int n_evals);
-RcppExport SEXP _gpmlr_set_hyperparameters(SEXP hypSEXP, SEXP infSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP n_evalsSEXP) {
+// gp_predict_cov
+SEXP gp_predict_cov(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericMatrix x, Rcpp::NumericVector alpha, Rcpp::NumericVector sW, Rcpp::NumericMatrix L, Rcpp::NumericMatrix xs, int band, Rcpp::IntegerVector block, std::string path, int threads);
+RcppExport SEXP _gpmlr_gp_predict_cov(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP alphaSEXP, SEXP sWSEXP, SEXP LSEXP, SEXP xsSEXP, SEXP bandSEXP, SEXP blockSEXP, SEXP pathSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type sW(sWSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type L(LSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< int >::type band(bandSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type block(blockSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_predict_cov(hyp, mean, cov, lik, x, alpha, sW, L, xs, band, block, path, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_predict_post
+SEXP gp_predict_post(Rcpp::List hyp, Rcpp::List inf, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::Nullable<Rcpp::List> post, Rcpp::NumericVector xs, Rcpp::NumericVector ys, int threads);
+RcppExport SEXP _gpmlr_gp_predict_post(SEXP hypSEXP, SEXP infSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP postSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -144,24 +493,258 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
     Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::List> >::type post(postSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_predict_post(hyp, inf, mean, cov, lik, x, y, post, xs, ys, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_sample
+SEXP gp_sample(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericMatrix x, Rcpp::NumericVector alpha, Rcpp::NumericVector sW, Rcpp::NumericMatrix L, Rcpp::NumericMatrix xs, int n_draws, int n_features, double seed, std::string path, int threads);
+RcppExport SEXP _gpmlr_gp_sample(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP alphaSEXP, SEXP sWSEXP, SEXP LSEXP, SEXP xsSEXP, SEXP n_drawsSEXP, SEXP n_featuresSEXP, SEXP seedSEXP, SEXP pathSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type alpha(alphaSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type sW(sWSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type L(LSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< int >::type n_draws(n_drawsSEXP);
+    Rcpp::traits::input_parameter< int >::type n_features(n_featuresSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_sample(hyp, mean, cov, lik, x, alpha, sW, L, xs, n_draws, n_features, seed, path, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_serve
+Rcpp::List gp_serve(Rcpp::List models, std::string path, int max_batch, double max_wait);
+RcppExport SEXP _gpmlr_gp_serve(SEXP modelsSEXP, SEXP pathSEXP, SEXP max_batchSEXP, SEXP max_waitSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type models(modelsSEXP);
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type max_batch(max_batchSEXP);
+    Rcpp::traits::input_parameter< double >::type max_wait(max_waitSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_serve(models, path, max_batch, max_wait));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_server_request
+Rcpp::NumericMatrix gp_server_request(std::string path, int type, std::string model, Rcpp::NumericMatrix xs);
+RcppExport SEXP _gpmlr_gp_server_request(SEXP pathSEXP, SEXP typeSEXP, SEXP modelSEXP, SEXP xsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< int >::type type(typeSEXP);
+    Rcpp::traits::input_parameter< std::string >::type model(modelSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type xs(xsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_server_request(path, type, model, xs));
+    return rcpp_result_gen;
+END_RCPP
+}
+// set_hyperparameters
+Rcpp::List set_hyperparameters(Rcpp::List hyp, Rcpp::List inf, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, SEXP x, Rcpp::NumericVector y, int n_evals, double cache_bytes);
+RcppExport SEXP _gpmlr_set_hyperparameters(SEXP hypSEXP, SEXP infSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP n_evalsSEXP, SEXP cache_bytesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type inf(infSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
     Rcpp::traits::input_parameter< int >::type n_evals(n_evalsSEXP);
-    rcpp_result_gen = Rcpp::wrap(set_hyperparameters(hyp, inf, mean, cov, lik, x, y, n_evals));
+    Rcpp::traits::input_parameter< double >::type cache_bytes(cache_bytesSEXP);
+    rcpp_result_gen = Rcpp::wrap(set_hyperparameters(hyp, inf, mean, cov, lik, x, y, n_evals, cache_bytes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_state_space
+Rcpp::List gp_state_space(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericVector xs, Rcpp::NumericVector ys, bool derivatives, bool posterior);
+RcppExport SEXP _gpmlr_gp_state_space(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP derivativesSEXP, SEXP posteriorSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< bool >::type posterior(posteriorSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_state_space(hyp, mean, cov, lik, x, y, xs, ys, derivatives, posterior));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_set_threads
+void gp_set_threads(int total, int blas);
+RcppExport SEXP _gpmlr_gp_set_threads(SEXP totalSEXP, SEXP blasSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< int >::type total(totalSEXP);
+    Rcpp::traits::input_parameter< int >::type blas(blasSEXP);
+    gp_set_threads(total, blas);
+    return R_NilValue;
+END_RCPP
+}
+// gp_threads_info
+Rcpp::List gp_threads_info();
+RcppExport SEXP _gpmlr_gp_threads_info() {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    rcpp_result_gen = Rcpp::wrap(gp_threads_info());
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_toeplitz_grid
+bool gp_toeplitz_grid(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x);
+RcppExport SEXP _gpmlr_gp_toeplitz_grid(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_toeplitz_grid(hyp, mean, cov, lik, x));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_toeplitz
+Rcpp::List gp_toeplitz(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::NumericVector xs, Rcpp::NumericVector ys, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_toeplitz(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_toeplitz(hyp, mean, cov, lik, x, y, xs, ys, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_vecchia_index
+Rcpp::List gp_vecchia_index(Rcpp::NumericVector x, int m, int threads);
+RcppExport SEXP _gpmlr_gp_vecchia_index(SEXP xSEXP, SEXP mSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< int >::type m(mSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_vecchia_index(x, m, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_vecchia
+Rcpp::List gp_vecchia(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, Rcpp::IntegerMatrix neighbours, bool derivatives, int threads);
+RcppExport SEXP _gpmlr_gp_vecchia(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP neighboursSEXP, SEXP derivativesSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type neighbours(neighboursSEXP);
+    Rcpp::traits::input_parameter< bool >::type derivatives(derivativesSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_vecchia(hyp, mean, cov, lik, x, y, neighbours, derivatives, threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// gp_vecchia_predict
+Rcpp::List gp_vecchia_predict(Rcpp::List hyp, Rcpp::List mean, Rcpp::List cov, Rcpp::List lik, Rcpp::NumericVector x, Rcpp::NumericVector y, int m, Rcpp::NumericVector xs, Rcpp::NumericVector ys, int threads);
+RcppExport SEXP _gpmlr_gp_vecchia_predict(SEXP hypSEXP, SEXP meanSEXP, SEXP covSEXP, SEXP likSEXP, SEXP xSEXP, SEXP ySEXP, SEXP mSEXP, SEXP xsSEXP, SEXP ysSEXP, SEXP threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type hyp(hypSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type mean(meanSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type cov(covSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type lik(likSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type x(xSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type y(ySEXP);
+    Rcpp::traits::input_parameter< int >::type m(mSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type xs(xsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type ys(ysSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(gp_vecchia_predict(hyp, mean, cov, lik, x, y, m, xs, ys, threads));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
+    {"_gpmlr_gp_compact", (DL_FUNC) &_gpmlr_gp_compact, 10},
     {"_gpmlr_octave_is_embedded", (DL_FUNC) &_gpmlr_octave_is_embedded, 0},
     {"_gpmlr_octave_has_ever_been_embedded", (DL_FUNC) &_gpmlr_octave_has_ever_been_embedded, 0},
     {"_gpmlr_embed_octave", (DL_FUNC) &_gpmlr_embed_octave, 2},
     {"_gpmlr_exit_octave", (DL_FUNC) &_gpmlr_exit_octave, 1},
+    {"_gpmlr_gp_ep", (DL_FUNC) &_gpmlr_gp_ep, 8},
+    {"_gpmlr_gp_exact", (DL_FUNC) &_gpmlr_gp_exact, 8},
+    {"_gpmlr_gp_additive_model", (DL_FUNC) &_gpmlr_gp_additive_model, 4},
+    {"_gpmlr_gp_inducing", (DL_FUNC) &_gpmlr_gp_inducing, 7},
+    {"_gpmlr_gp_fitc", (DL_FUNC) &_gpmlr_gp_fitc, 8},
+    {"_gpmlr_gp_fitc_model", (DL_FUNC) &_gpmlr_gp_fitc_model, 4},
     {"_gpmlr_gpml1", (DL_FUNC) &_gpmlr_gpml1, 7},
     {"_gpmlr_gpml2", (DL_FUNC) &_gpmlr_gpml2, 8},
     {"_gpmlr_gpml3", (DL_FUNC) &_gpmlr_gpml3, 9},
+    {"_gpmlr_gpml4", (DL_FUNC) &_gpmlr_gpml4, 9},
+    {"_gpmlr_gp_grid", (DL_FUNC) &_gpmlr_gp_grid, 9},
+    {"_gpmlr_gp_iterative", (DL_FUNC) &_gpmlr_gp_iterative, 12},
+    {"_gpmlr_gp_laplace", (DL_FUNC) &_gpmlr_gp_laplace, 7},
+    {"_gpmlr_gp_mcmc_chain", (DL_FUNC) &_gpmlr_gp_mcmc_chain, 13},
+    {"_gpmlr_gp_mcmc_post", (DL_FUNC) &_gpmlr_gp_mcmc_post, 4},
+    {"_gpmlr_gp_hash", (DL_FUNC) &_gpmlr_gp_hash, 1},
+    {"_gpmlr_gp_minibatch_nlz", (DL_FUNC) &_gpmlr_gp_minibatch_nlz, 9},
+    {"_gpmlr_gp_save", (DL_FUNC) &_gpmlr_gp_save, 10},
+    {"_gpmlr_gp_load", (DL_FUNC) &_gpmlr_gp_load, 1},
+    {"_gpmlr_gp_predict", (DL_FUNC) &_gpmlr_gp_predict, 3},
+    {"_gpmlr_gp_nlz_grid", (DL_FUNC) &_gpmlr_gp_nlz_grid, 10},
     {"_gpmlr_print_path", (DL_FUNC) &_gpmlr_print_path, 0},
     {"_gpmlr_add_to_path", (DL_FUNC) &_gpmlr_add_to_path, 1},
     {"_gpmlr_set_wd", (DL_FUNC) &_gpmlr_set_wd, 1},
-    {"_gpmlr_set_hyperparameters", (DL_FUNC) &_gpmlr_set_hyperparameters, 8},
+    {"_gpmlr_gp_predict_cov", (DL_FUNC) &_gpmlr_gp_predict_cov, 13},
+    {"_gpmlr_gp_predict_post", (DL_FUNC) &_gpmlr_gp_predict_post, 11},
+    {"_gpmlr_gp_sample", (DL_FUNC) &_gpmlr_gp_sample, 14},
+    {"_gpmlr_gp_serve", (DL_FUNC) &_gpmlr_gp_serve, 4},
+    {"_gpmlr_gp_server_request", (DL_FUNC) &_gpmlr_gp_server_request, 4},
+    {"_gpmlr_set_hyperparameters", (DL_FUNC) &_gpmlr_set_hyperparameters, 9},
+    {"_gpmlr_gp_state_space", (DL_FUNC) &_gpmlr_gp_state_space, 10},
+    {"_gpmlr_gp_set_threads", (DL_FUNC) &_gpmlr_gp_set_threads, 2},
+    {"_gpmlr_gp_threads_info", (DL_FUNC) &_gpmlr_gp_threads_info, 0},
+    {"_gpmlr_gp_toeplitz_grid", (DL_FUNC) &_gpmlr_gp_toeplitz_grid, 5},
+    {"_gpmlr_gp_toeplitz", (DL_FUNC) &_gpmlr_gp_toeplitz, 10},
+    {"_gpmlr_gp_vecchia_index", (DL_FUNC) &_gpmlr_gp_vecchia_index, 3},
+    {"_gpmlr_gp_vecchia", (DL_FUNC) &_gpmlr_gp_vecchia, 9},
+    {"_gpmlr_gp_vecchia_predict", (DL_FUNC) &_gpmlr_gp_vecchia_predict, 10},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,227 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s sparse exact inference for compactly supported covariances
+// (approx = "compact"): infExact() for likGauss with covPPiso or covPPard,
+// where K is built sparse in compiled code (see native-compact.cpp) and
+// factored by Octave's sparse chol(), i.e. CHOLMOD with a fill-reducing
+// ordering. Nothing n x n is ever dense.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// Copies Octave's factor into compiled code's layout
+static void octave_to_sparse(const SparseMatrix& x, sparse_matrix& result) {
+    result.rows = x.rows();
+    result.cols = x.cols();
+    long nnz = x.cidx(result.cols);
+    result.start.resize(static_cast<long>(result.cols) + 1);
+    for ( int j = 0; j <= result.cols; ++j ) {
+        result.start[j] = x.cidx(j);
+    }
+    result.row.resize(nnz);
+    result.value.resize(nnz);
+    for ( long k = 0; k < nnz; ++k ) {
+        result.row[k] = x.ridx(k);
+        result.value[k] = x.data(k);
+    }
+}
+
+// [[Rcpp::export(.gp_compact)]]
+Rcpp::List gp_compact(Rcpp::List hyp,
+                      Rcpp::List mean,
+                      Rcpp::List cov,
+                      Rcpp::List lik,
+                      Rcpp::NumericVector x,
+                      Rcpp::NumericVector y,
+                      Rcpp::NumericVector xs,
+                      Rcpp::NumericVector ys,
+                      bool derivatives,
+                      int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int ns = xs.size() / dim;
+    if ( xs.size() != static_cast<R_xlen_t>(ns) * dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    native_model model;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    std::vector<int> offsets;
+    if ( !parse_native_model(inf, mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets)
+         || model.cov.type != COV_PP ) {
+        Rcpp::stop("Sparse inference needs likGauss, meanZero or meanConst, "
+                   "and covPPiso or covPPard.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    const double* cov_hyp = &h[n_mean];
+    double m = n_mean > 0 ? h[0] : 0.0;
+    double sn2 = std::exp(2.0 * h[n_mean + n_cov]);
+    // A = K / sn2 + I as in infExact(), or K + sn2 I for very small sn2,
+    // with both triangles stored
+    sparse_matrix K;
+    compact_cov(model.cov, cov_hyp, x.begin(), n, x.begin(), n, threads, K);
+    double sl = sn2 < 1e-6 ? 1.0 : sn2;
+    long nnz = K.start[n];
+    SparseMatrix A(n, n, nnz);
+    for ( int j = 0; j <= n; ++j ) {
+        A.xcidx(j) = K.start[j];
+    }
+    for ( int j = 0; j < n; ++j ) {
+        for ( long p = K.start[j]; p < K.start[j + 1]; ++p ) {
+            A.xridx(p) = K.row[p];
+            A.xdata(p) = K.row[p] == j ? K.value[p] / sl + sn2 / sl
+                                       : K.value[p] / sl;
+        }
+    }
+    octave_value_list in;
+    in(0) = octave_value(A);
+    in(1) = octave_value("vector");
+    octave_value_list factor = OCT("chol", in, 3);
+    A = SparseMatrix();
+    if ( factor(1).double_value() != 0.0 ) {
+        Rcpp::stop("The covariance matrix is not positive definite.\n");
+    }
+    SparseMatrix R_octave = factor(0).sparse_matrix_value();
+    Matrix perm_octave = factor(2).matrix_value();
+    sparse_matrix R;
+    octave_to_sparse(R_octave, R);
+    std::vector<int> perm(n);
+    for ( int k = 0; k < n; ++k ) {
+        perm[k] = static_cast<int>(perm_octave(k)) - 1;
+    }
+    // alpha = inv(K + sn2 I) (y - m), through A(perm, perm) = R'R
+    std::vector<double> b(n);
+    for ( int k = 0; k < n; ++k ) {
+        b[k] = y[perm[k]] - m;
+    }
+    sparse_solve_upper_transposed(R, &b[0]);
+    sparse_solve_upper(R, &b[0]);
+    Rcpp::NumericMatrix alpha(n, 1);
+    for ( int k = 0; k < n; ++k ) {
+        alpha[perm[k]] = b[k] / sl;
+    }
+    // POST: L is the sparse factor, in the permuted order POST$perm gives
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), 1.0 / std::sqrt(sn2));
+    Rcpp::IntegerVector perm_r(n);
+    for ( int k = 0; k < n; ++k ) {
+        perm_r[k] = perm[k] + 1;
+    }
+    Rcpp::List post = Rcpp::List::create(
+        Rcpp::_["alpha"] = alpha,
+        Rcpp::_["sW"] = sW,
+        Rcpp::_["L"] = octsparse_to_rcppsparse(R_octave),
+        Rcpp::_["perm"] = perm_r);
+    if ( ns == 0 ) {
+        Rcpp::NumericMatrix nlz(1, 1);
+        double fit = 0.0;
+        double log_det = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            fit += (y[i] - m) * alpha[i];
+            log_det += std::log(R.value[R.start[i + 1] - 1]);
+        }
+        nlz[0] = fit / 2.0 + log_det + n * (LOG_2PI + std::log(sl)) / 2.0;
+        if ( !derivatives ) {
+            return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                      Rcpp::_["POST"] = post);
+        }
+        // Q = inv(K + sn2 I) - alpha alpha' is only needed on K's pattern,
+        // where inv(A) is known from its selected inverse Z
+        std::vector<double> Z;
+        sparse_chol_selected_inverse(R, Z);
+        std::vector<int> position(n);
+        for ( int k = 0; k < n; ++k ) {
+            position[perm[k]] = k;
+        }
+        double trace = 0.0;
+        for ( int k = 0; k < n; ++k ) {
+            trace += Z[R.start[k + 1] - 1];
+        }
+        for ( int j = 0; j < n; ++j ) {
+            int pj = position[j];
+            for ( long p = K.start[j]; p < K.start[j + 1]; ++p ) {
+                int pi = position[K.row[p]];
+                double z = sparse_find(R, Z, std::min(pi, pj),
+                                       std::max(pi, pj));
+                K.value[p] = z / sl - alpha[K.row[p]] * alpha[j];
+            }
+        }
+        Rcpp::NumericMatrix d_mean(n_mean, 1);
+        Rcpp::NumericMatrix d_cov(n_cov, 1);
+        Rcpp::NumericMatrix d_lik(1, 1);
+        compact_cov_gradient(model.cov, cov_hyp, x.begin(), n, K,
+                             d_cov.begin(), threads);
+        double alpha_sum = 0.0;
+        double alpha_squares = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            alpha_sum += alpha[i];
+            alpha_squares += alpha[i] * alpha[i];
+        }
+        if ( n_mean > 0 ) {
+            d_mean[0] = -alpha_sum;
+        }
+        d_lik[0] = sn2 * (trace / sl - alpha_squares);
+        Rcpp::List dnlz = Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                             Rcpp::_["cov"] = d_cov,
+                                             Rcpp::_["lik"] = d_lik);
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["DNLZ"] = dnlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    // Predictions: the cross covariances are sparse too
+    sparse_matrix Ks;
+    compact_cov(model.cov, cov_hyp, x.begin(), n, xs.begin(), ns, threads,
+                Ks);
+    std::vector<double> reduction(ns);
+    compact_quadratic_forms(R, perm, Ks, &reduction[0], threads);
+    double sf2 = std::exp(2.0 * cov_hyp[model.cov.ard ? dim : 1]);
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    Rcpp::NumericMatrix ys2(ns, 1);
+    for ( int s = 0; s < ns; ++s ) {
+        double mu = m;
+        for ( long p = Ks.start[s]; p < Ks.start[s + 1]; ++p ) {
+            mu += Ks.value[p] * alpha[Ks.row[p]];
+        }
+        fmu[s] = mu;
+        fs2[s] = std::max(sf2 - reduction[s] / sl, 0.0);
+        ys2[s] = fs2[s] + sn2;
+    }
+    Rcpp::NumericMatrix ymu = Rcpp::clone(fmu);
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2,
+                                  Rcpp::_["POST"] = post);
+    }
+    // likGauss' log predictive probabilities
+    Rcpp::NumericMatrix lp(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        double r = ys[i] - ymu[i];
+        lp[i] = -r * r / (2.0 * ys2[i]) - 0.5 * (LOG_2PI + std::log(ys2[i]));
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp,
+                              Rcpp::_["POST"] = post);
+}
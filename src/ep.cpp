@@ -0,0 +1,129 @@
+#include "gpmlr.h"
+
+// gp()'s compiled parallel EP (infEPparallel) for likErf and likLogistic.
+// As for the Laplace approximation, the covariance matrix, mean vector, and
+// their derivatives come from GPML's (Octave) functions; the sweeps, with
+// their moment matching spread over threads, are native.
+
+// Like infEP(), start from the last site parameters found when they are
+// better than starting from zero
+static std::vector<double> last_ttau;
+static std::vector<double> last_tnu;
+
+// [[Rcpp::export(.gp_ep)]]
+Rcpp::List gp_ep(Rcpp::List hyp,
+                 Rcpp::List mean,
+                 Rcpp::List cov,
+                 Rcpp::List lik,
+                 Rcpp::NumericVector x,
+                 Rcpp::NumericVector y,
+                 Rcpp::NumericVector options,
+                 bool derivatives) {
+    // Make sure Octave is embedded
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    std::string lik_name = spec_name(lik);
+    native_lik_type lik_type;
+    if ( lik_name == "likErf" ) {
+        lik_type = LIK_ERF;
+    } else if ( lik_name == "likLogistic" ) {
+        lik_type = LIK_LOGISTIC;
+    } else {
+        Rcpp::stop("The compiled parallel EP needs likErf or likLogistic.\n");
+    }
+    // options are infEPparallel()'s opt: [damping tol max_sweep]
+    ep_options ep;
+    if ( options.size() > 0 ) {
+        ep.damping = options[0];
+    }
+    if ( options.size() > 1 ) {
+        ep.tolerance = options[1];
+    }
+    if ( options.size() > 2 ) {
+        ep.max_sweeps = static_cast<int>(options[2]);
+    }
+    if ( !(ep.damping > 0.0 && ep.damping <= 1.0) ) {
+        Rcpp::stop("The damping must be in (0, 1].\n");
+    }
+    // K = feval(cov{:}, hyp.cov, x) and m = feval(mean{:}, hyp.mean, x)
+    Rcpp::NumericVector hyp_cov = hyp["cov"];
+    Rcpp::NumericVector hyp_mean = hyp["mean"];
+    octave_value octave_x = octave_value(rcppmat_to_octmat(x));
+    octave_value_list cov_in;
+    cov_in(0) = octave_value(rcppmat_to_octmat(hyp_cov));
+    cov_in(1) = octave_x;
+    Matrix K = feval_spec(cov, cov_in).matrix_value();
+    octave_value_list mean_in;
+    mean_in(0) = octave_value(rcppmat_to_octmat(hyp_mean));
+    mean_in(1) = octave_x;
+    Matrix m = feval_spec(mean, mean_in).matrix_value();
+    int n = K.rows();
+    if ( K.cols() != n || m.numel() != n || y.size() != n ) {
+        Rcpp::stop("The training inputs and outcomes do not match.\n");
+    }
+    ep_state state;
+    if ( !native_ep(lik_type, K.data(), m.data(), y.begin(), n, ep,
+                    last_ttau, last_tnu, state) ) {
+        Rcpp::stop("EP's factorization failed.\n");
+    }
+    if ( !state.converged ) {
+        Rcpp::stop("EP did not converge in the maximum number of sweeps.\n");
+    }
+    last_ttau = state.ttau;
+    last_tnu = state.tnu;
+    Rcpp::NumericMatrix alpha(n, 1);
+    Rcpp::NumericMatrix sW(n, 1);
+    std::copy(state.alpha.begin(), state.alpha.end(), alpha.begin());
+    std::copy(state.sW.begin(), state.sW.end(), sW.begin());
+    Rcpp::NumericMatrix L(n, n);
+    std::copy(state.L.begin(), state.L.end(), L.begin());
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    Rcpp::NumericMatrix nlz(1, 1);
+    nlz[0] = state.nlz;
+    if ( !derivatives ) {
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    // dnlz, in the order of hyp's fields; likErf and likLogistic have no
+    // hyperparameters
+    std::vector<double> F(static_cast<long>(n) * n);
+    ep_gradient_matrix(state, &F[0]);
+    Rcpp::CharacterVector fields = hyp.names();
+    Rcpp::List dnlz(fields.size());
+    dnlz.names() = fields;
+    for ( int k = 0; k < fields.size(); ++k ) {
+        std::string field = Rcpp::as<std::string>(fields[k]);
+        int n_field = Rcpp::as<Rcpp::NumericVector>(hyp[k]).size();
+        if ( field == "lik" || n_field == 0 ) {
+            dnlz[k] = Rcpp::NumericMatrix(0, 0);
+            continue;
+        }
+        Rcpp::NumericMatrix d(n_field, 1);
+        for ( int i = 0; i < n_field; ++i ) {
+            octave_value_list in;
+            if ( field == "cov" ) {
+                // dK = feval(cov{:}, hyp.cov, x, [], i)
+                in(0) = cov_in(0);
+                in(1) = octave_x;
+                in(2) = octave_value(Matrix());
+                in(3) = octave_value(i + 1);
+                Matrix dK = feval_spec(cov, in).matrix_value();
+                d[i] = ep_cov_gradient(state, &F[0], dK.data());
+            } else if ( field == "mean" ) {
+                // dm = feval(mean{:}, hyp.mean, x, i)
+                in(0) = mean_in(0);
+                in(1) = octave_x;
+                in(2) = octave_value(i + 1);
+                Matrix dm = feval_spec(mean, in).matrix_value();
+                d[i] = ep_mean_gradient(state, dm.data());
+            }
+        }
+        dnlz[k] = d;
+    }
+    return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                              Rcpp::_["DNLZ"] = dnlz,
+                              Rcpp::_["POST"] = post);
+}
@@ -0,0 +1,153 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s training mode for infExact() with likGauss, for models native_model
+// or additive_model can describe (see native-exact.cpp). infExact() forms
+// one n x n derivative matrix per hyperparameter, i.e. D + 1 of them for ARD
+// kernels (and covADD.m recomputes its elementary symmetric polynomials for
+// each one), where the compiled gradient takes every trace from one
+// threaded pass over the data.
+
+// [[Rcpp::export(.gp_exact)]]
+SEXP gp_exact(Rcpp::List hyp,
+              Rcpp::List mean,
+              Rcpp::List cov,
+              Rcpp::List lik,
+              Rcpp::NumericVector x,
+              Rcpp::NumericVector y,
+              bool derivatives,
+              int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    native_model model;
+    additive_model additive;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    std::vector<int> offsets;
+    std::vector<double> h;
+    int n_mean = 0;
+    int n_cov = 0;
+    bool ok = false;
+    exact_workspace work;
+    double value = 0.0;
+    std::vector<double> grad;
+    if ( parse_native_model(inf, mean, cov, lik, dim, model)
+         && native_hyp_offsets(hyp, model, offsets) ) {
+        std::vector<double> flat_hyp;
+        for ( int i = 0; i < hyp.size(); ++i ) {
+            Rcpp::NumericVector element = hyp[i];
+            flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+        }
+        h.resize(offsets.size());
+        for ( size_t k = 0; k < offsets.size(); ++k ) {
+            h[k] = flat_hyp[offsets[k]];
+        }
+        n_mean = model.n_mean();
+        n_cov = model.cov.n_hyp();
+        grad.resize(h.size());
+        // One evaluation only, so per-dimension distances aren't worth
+        // keeping
+        distance_cache cache;
+        build_distance_cache(model.cov, x.begin(), n, 0.0, cache);
+        ok = native_exact_nlz(model, cache, x.begin(), y.begin(), n, &h[0],
+                              &value, derivatives ? &grad[0] : 0, work,
+                              threads);
+    }
+    else if ( parse_additive_model(inf, mean, cov, lik, dim, additive) ) {
+        // covADD (see native-additive.cpp); hyp, as native_additive_nlz()
+        // orders it
+        if ( !hyp.containsElementNamed("mean")
+             || !hyp.containsElementNamed("cov")
+             || !hyp.containsElementNamed("lik") ) {
+            return R_NilValue;
+        }
+        Rcpp::NumericVector hyp_mean = hyp["mean"];
+        Rcpp::NumericVector hyp_cov = hyp["cov"];
+        Rcpp::NumericVector hyp_lik = hyp["lik"];
+        n_mean = additive.n_mean();
+        n_cov = additive.cov.n_hyp();
+        if ( hyp_mean.size() != n_mean || hyp_cov.size() != n_cov
+             || hyp_lik.size() != 1 ) {
+            return R_NilValue;
+        }
+        h.assign(hyp_mean.begin(), hyp_mean.end());
+        h.insert(h.end(), hyp_cov.begin(), hyp_cov.end());
+        h.push_back(hyp_lik[0]);
+        grad.resize(h.size());
+        ok = native_additive_nlz(additive, x.begin(), y.begin(), n, &h[0],
+                                 &value, derivatives ? &grad[0] : 0, work,
+                                 threads);
+    }
+    else {
+        return R_NilValue;
+    }
+    if ( !ok ) {
+        Rcpp::stop("The covariance matrix is not positive definite.\n");
+    }
+    // POST as infExact() gives it: L is chol(K/sn2 + I), or for very small
+    // sn2, -inv(K + sn2 I)
+    double sn2 = std::exp(2.0 * h[n_mean + n_cov]);
+    Rcpp::NumericMatrix alpha(n, 1);
+    std::copy(work.alpha.begin(), work.alpha.end(), alpha.begin());
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), 1.0 / std::sqrt(sn2));
+    Rcpp::NumericMatrix L(n, n);
+    if ( sn2 < 1e-6 ) {
+        chol_inverse(&work.K[0], n, L.begin());
+        for ( R_xlen_t k = 0; k < L.size(); ++k ) {
+            L[k] = -L[k];
+        }
+    } else {
+        std::copy(work.K.begin(), work.K.end(), L.begin());
+    }
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    Rcpp::NumericMatrix nlz(1, 1);
+    nlz[0] = value;
+    if ( !derivatives ) {
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    // dnlz, in the order of hyp's fields
+    Rcpp::CharacterVector fields = hyp.names();
+    Rcpp::List dnlz(fields.size());
+    dnlz.names() = fields;
+    int start[3] = { 0, n_mean, n_mean + n_cov };
+    for ( int k = 0; k < fields.size(); ++k ) {
+        std::string field = Rcpp::as<std::string>(fields[k]);
+        int n_field = Rf_length(hyp[k]);
+        int first = field == "mean" ? start[0]
+                  : field == "cov" ? start[1]
+                  : field == "lik" ? start[2] : -1;
+        if ( first < 0 || n_field == 0 ) {
+            dnlz[k] = Rcpp::NumericMatrix(0, 0);
+            continue;
+        }
+        Rcpp::NumericMatrix d(n_field, 1);
+        for ( int i = 0; i < n_field; ++i ) {
+            d[i] = grad[first + i];
+        }
+        dnlz[k] = d;
+    }
+    return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                              Rcpp::_["DNLZ"] = dnlz,
+                              Rcpp::_["POST"] = post);
+}
+
+// Whether gp_exact() handles the model as an additive one, from the
+// specification alone
+// [[Rcpp::export(.gp_additive_model)]]
+bool gp_additive_model(Rcpp::List mean,
+                       Rcpp::List cov,
+                       Rcpp::List lik,
+                       Rcpp::NumericVector x) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    additive_model additive;
+    return parse_additive_model(Rcpp::List::create("infExact"), mean, cov,
+                                lik, dim, additive);
+}
@@ -0,0 +1,169 @@
+#include "gpmlr.h"
+
+// gp()'s FITC approximation (approx = "fitc"): choosing the inducing inputs,
+// and infFITC() for models native_model can describe, with the covariance
+// wrapped as GPML's covFITC, i.e. list("covFITC", cov, xu). Unlike the
+// Laplace and EP engines, nothing here needs Octave, as infFITC() would need
+// the n x m cross covariances in memory.
+
+// Candidates the greedy selector considers at most
+static const int GREEDY_MAX_CANDIDATES = 20000;
+
+// [[Rcpp::export(.gp_inducing)]]
+Rcpp::NumericMatrix gp_inducing(Rcpp::NumericVector x,
+                                int m,
+                                std::string method,
+                                Rcpp::List cov,
+                                Rcpp::NumericVector hyp_cov,
+                                double seed,
+                                int threads) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    int n = x.size() / dim;
+    if ( m < 1 || m > n ) {
+        Rcpp::stop("The number of inducing inputs must be in [1, n].\n");
+    }
+    Rcpp::NumericMatrix xu(m, dim);
+    unsigned s = static_cast<unsigned>(seed);
+    if ( method == "kmeans" ) {
+        select_inducing_kmeans(x.begin(), n, dim, m, s, threads, xu.begin());
+    } else if ( method == "greedy" ) {
+        native_cov native;
+        if ( !parse_native_cov(cov, dim, native) ) {
+            Rcpp::stop("Greedy selection needs a covariance function the "
+                       "compiled code supports.\n");
+        }
+        if ( hyp_cov.size() != native.n_hyp() ) {
+            Rcpp::stop("Wrong number of covariance hyperparameters.\n");
+        }
+        select_inducing_greedy(native, hyp_cov.begin(), x.begin(), n, m,
+                               GREEDY_MAX_CANDIDATES, s, xu.begin());
+    } else {
+        Rcpp::stop("The inducing input method must be kmeans or greedy.\n");
+    }
+    return xu;
+}
+
+// Returns NULL when the model needs GPML's infFITC() instead
+// [[Rcpp::export(.gp_fitc)]]
+SEXP gp_fitc(Rcpp::List hyp,
+             Rcpp::List mean,
+             Rcpp::List cov,
+             Rcpp::List lik,
+             Rcpp::NumericVector x,
+             Rcpp::NumericVector y,
+             bool derivatives,
+             int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    // cov is list("covFITC", cov, xu), and hyp.xu takes priority over xu
+    // as in GPML
+    if ( spec_name(cov) != "covFITC" || cov.size() != 3 ) {
+        return R_NilValue;
+    }
+    Rcpp::RObject inner = cov[1];
+    if ( inner.sexp_type() != VECSXP ) {
+        return R_NilValue;
+    }
+    native_model model;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    if ( !parse_native_model(inf, mean, Rcpp::as<Rcpp::List>(inner), lik,
+                             dim, model) ) {
+        return R_NilValue;
+    }
+    std::vector<int> offsets;
+    if ( !native_hyp_offsets(hyp, model, offsets) ) {
+        return R_NilValue;
+    }
+    Rcpp::NumericVector xu = cov[2];
+    if ( hyp.containsElementNamed("xu") ) {
+        xu = hyp["xu"];
+    }
+    int m = xu.size() / dim;
+    if ( xu.size() != static_cast<R_xlen_t>(m) * dim || m < 1 ) {
+        Rcpp::stop("The inducing inputs must have as many columns as x.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    fitc_result result;
+    if ( !native_fitc(model, &h[0], x.begin(), y.begin(), n, xu.begin(), m,
+                      derivatives, threads, result) ) {
+        Rcpp::stop("FITC's factorization failed.\n");
+    }
+    Rcpp::NumericMatrix alpha(m, 1);
+    std::copy(result.alpha.begin(), result.alpha.end(), alpha.begin());
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), result.sW);
+    Rcpp::NumericMatrix L(m, m);
+    std::copy(result.L.begin(), result.L.end(), L.begin());
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    Rcpp::NumericMatrix nlz(1, 1);
+    nlz[0] = result.nlz;
+    if ( !derivatives ) {
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    // dnlz, in the order of hyp's fields, with dnlz.xu as infFITC() gives it
+    Rcpp::CharacterVector fields = hyp.names();
+    Rcpp::List dnlz(fields.size());
+    dnlz.names() = fields;
+    int start[3] = { 0, model.n_mean(), model.n_mean() + model.cov.n_hyp() };
+    for ( int k = 0; k < fields.size(); ++k ) {
+        std::string field = Rcpp::as<std::string>(fields[k]);
+        int n_field = Rf_length(hyp[k]);
+        if ( field == "xu" ) {
+            Rcpp::NumericMatrix d(m, dim);
+            std::copy(result.dxu.begin(), result.dxu.end(), d.begin());
+            dnlz[k] = d;
+            continue;
+        }
+        int first = field == "mean" ? start[0]
+                  : field == "cov" ? start[1]
+                  : field == "lik" ? start[2] : -1;
+        if ( first < 0 || n_field == 0 ) {
+            dnlz[k] = Rcpp::NumericMatrix(0, 0);
+            continue;
+        }
+        Rcpp::NumericMatrix d(n_field, 1);
+        for ( int i = 0; i < n_field; ++i ) {
+            d[i] = result.dnlz[first + i];
+        }
+        dnlz[k] = d;
+    }
+    return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                              Rcpp::_["DNLZ"] = dnlz,
+                              Rcpp::_["POST"] = post);
+}
+
+// Whether gp_fitc() handles the model, from the specification alone
+// [[Rcpp::export(.gp_fitc_model)]]
+bool gp_fitc_model(Rcpp::List mean,
+                   Rcpp::List cov,
+                   Rcpp::List lik,
+                   Rcpp::NumericVector x) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( spec_name(cov) != "covFITC" || cov.size() != 3 ) {
+        return false;
+    }
+    Rcpp::RObject inner = cov[1];
+    if ( inner.sexp_type() != VECSXP ) {
+        return false;
+    }
+    native_model model;
+    return parse_native_model(Rcpp::List::create("infExact"), mean,
+                              Rcpp::as<Rcpp::List>(inner), lik, dim, model);
+}
@@ -1,5 +1,18 @@
 #include "gpmlr.h"
 
+// feval(spec{:}, args{:})
+octave_value feval_spec(const Rcpp::List& spec, const octave_value_list& args) {
+    Cell spec_cell = list_to_cell(spec);
+    octave_value_list in;
+    for ( int i = 1; i < spec_cell.numel(); ++i ) {
+        in(i - 1) = spec_cell(i);
+    }
+    for ( int i = 0; i < args.length(); ++i ) {
+        in(spec_cell.numel() - 1 + i) = args(i);
+    }
+    return OCT(spec_name(spec), in, 1)(0);
+}
+
 // First usage: training.
 // [[Rcpp::export(.gpml1)]]
 Rcpp::List gpml1(Rcpp::List hyperparameters,
@@ -7,7 +20,7 @@ Rcpp::List gpml1(Rcpp::List hyperparameters,
                  Rcpp::List meanfunc,
                  Rcpp::List covfunc,
                  Rcpp::List likfunc,
-                 Rcpp::NumericVector x,
+                 SEXP x,
                  Rcpp::NumericVector y) {
     // Make sure Octave is embedded
     if ( !octave_is_embedded() ) {
@@ -19,7 +32,7 @@ Rcpp::List gpml1(Rcpp::List hyperparameters,
     Cell mean_func = list_to_cell(meanfunc);
     Cell lik_func = list_to_cell(likfunc);
     Cell cov_func = list_to_cell(covfunc);
-    Matrix octave_x = rcppmat_to_octmat(x);
+    octave_value octave_x = rcpp_to_octval(x);
     Matrix octave_y = rcppmat_to_octmat(y);
     // Create the list of arguments going into the Octave function
     octave_value_list in;
@@ -28,7 +41,7 @@ Rcpp::List gpml1(Rcpp::List hyperparameters,
     in(2) = octave_value(mean_func);
     in(3) = octave_value(cov_func);
     in(4) = octave_value(lik_func);
-    in(5) = octave_value(octave_x);
+    in(5) = octave_x;
     in(6) = octave_value(octave_y);
     // Call GPML's Octave function gp()
     octave_value_list octave_result = OCT("gp", in, 2);
@@ -54,9 +67,9 @@ Rcpp::List gpml2(Rcpp::List hyperparameters,
                  Rcpp::List meanfunc,
                  Rcpp::List covfunc,
                  Rcpp::List likfunc,
-                 Rcpp::NumericVector training_x,
+                 SEXP training_x,
                  Rcpp::NumericVector training_y,
-                 Rcpp::NumericVector testing_x) {
+                 SEXP testing_x) {
     // Make sure Octave is embedded
     if ( !octave_is_embedded() ) {
         Rcpp::stop("You must call embed_octave() before this function.\n");
@@ -67,9 +80,9 @@ Rcpp::List gpml2(Rcpp::List hyperparameters,
     Cell mean_func = list_to_cell(meanfunc);
     Cell lik_func = list_to_cell(likfunc);
     Cell cov_func = list_to_cell(covfunc);
-    Matrix octave_training_x = rcppmat_to_octmat(training_x);
+    octave_value octave_training_x = rcpp_to_octval(training_x);
     Matrix octave_training_y = rcppmat_to_octmat(training_y);
-    Matrix octave_testing_x = rcppmat_to_octmat(testing_x);
+    octave_value octave_testing_x = rcpp_to_octval(testing_x);
     // Create the list of arguments going into the Octave function
     octave_value_list in;
     in(0) = octave_value(octave_hyperparameters);
@@ -77,9 +90,9 @@ Rcpp::List gpml2(Rcpp::List hyperparameters,
     in(2) = octave_value(mean_func);
     in(3) = octave_value(cov_func);
     in(4) = octave_value(lik_func);
-    in(5) = octave_value(octave_training_x);
+    in(5) = octave_training_x;
     in(6) = octave_value(octave_training_y);
-    in(7) = octave_value(octave_testing_x);
+    in(7) = octave_testing_x;
     // Call GPML's Octave function gp()
     octave_value_list octave_result = OCT("gp", in, 1);
     // Convert the elements of the resulting octave_value_list
@@ -110,9 +123,9 @@ Rcpp::List gpml3(Rcpp::List hyperparameters,
                  Rcpp::List meanfunc,
                  Rcpp::List covfunc,
                  Rcpp::List likfunc,
-                 Rcpp::NumericVector training_x,
+                 SEXP training_x,
                  Rcpp::NumericVector training_y,
-                 Rcpp::NumericVector testing_x,
+                 SEXP testing_x,
                  Rcpp::NumericVector testing_y) {
     // Make sure Octave is embedded
     if ( !octave_is_embedded() ) {
@@ -124,9 +137,9 @@ Rcpp::List gpml3(Rcpp::List hyperparameters,
     Cell mean_func = list_to_cell(meanfunc);
     Cell lik_func = list_to_cell(likfunc);
     Cell cov_func = list_to_cell(covfunc);
-    Matrix octave_training_x = rcppmat_to_octmat(training_x);
+    octave_value octave_training_x = rcpp_to_octval(training_x);
     Matrix octave_training_y = rcppmat_to_octmat(training_y);
-    Matrix octave_testing_x = rcppmat_to_octmat(testing_x);
+    octave_value octave_testing_x = rcpp_to_octval(testing_x);
     Matrix octave_testing_y = rcppmat_to_octmat(testing_y);
     // Create the list of arguments going into the Octave function
     octave_value_list in;
@@ -135,9 +148,9 @@ Rcpp::List gpml3(Rcpp::List hyperparameters,
     in(2) = octave_value(mean_func);
     in(3) = octave_value(cov_func);
     in(4) = octave_value(lik_func);
-    in(5) = octave_value(octave_training_x);
+    in(5) = octave_training_x;
     in(6) = octave_value(octave_training_y);
-    in(7) = octave_value(octave_testing_x);
+    in(7) = octave_testing_x;
     in(8) = octave_value(octave_testing_y);
     // Call GPML's Octave function gp()
     octave_value_list octave_result = OCT("gp", in, 1);
@@ -164,3 +177,58 @@ Rcpp::List gpml3(Rcpp::List hyperparameters,
                               Rcpp::_["POST"] = post);
 }
 
+
+// Fourth usage: prediction from a previously computed posterior, which gp()
+// accepts in place of the training outcomes; the LP element is included
+// only if testing_y is not empty.
+// [[Rcpp::export(.gpml4)]]
+Rcpp::List gpml4(Rcpp::List hyperparameters,
+                 Rcpp::List inffunc,
+                 Rcpp::List meanfunc,
+                 Rcpp::List covfunc,
+                 Rcpp::List likfunc,
+                 SEXP training_x,
+                 Rcpp::List post,
+                 SEXP testing_x,
+                 Rcpp::NumericVector testing_y) {
+    // Make sure Octave is embedded
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    // Create the list of arguments going into the Octave function
+    octave_value_list in;
+    in(0) = octave_value(list_to_map(hyperparameters));
+    in(1) = octave_value(list_to_cell(inffunc));
+    in(2) = octave_value(list_to_cell(meanfunc));
+    in(3) = octave_value(list_to_cell(covfunc));
+    in(4) = octave_value(list_to_cell(likfunc));
+    in(5) = rcpp_to_octval(training_x);
+    in(6) = octave_value(list_to_map(post));
+    in(7) = rcpp_to_octval(testing_x);
+    bool with_lp = testing_y.size() > 0;
+    if ( with_lp ) {
+        in(8) = octave_value(rcppmat_to_octmat(testing_y));
+    }
+    // Call GPML's Octave function gp()
+    octave_value_list octave_result = OCT("gp", in, 1);
+    // Convert the elements of the resulting octave_value_list
+    // into objects that R will understand
+    ColumnVector YMU = octave_result(0).column_vector_value();
+    Rcpp::NumericVector ymu = octmat_to_rcppmat(YMU);
+    ColumnVector YS2 = octave_result(1).column_vector_value();
+    Rcpp::NumericVector ys2 = octmat_to_rcppmat(YS2);
+    ColumnVector FMU = octave_result(2).column_vector_value();
+    Rcpp::NumericVector fmu = octmat_to_rcppmat(FMU);
+    ColumnVector FS2 = octave_result(3).column_vector_value();
+    Rcpp::NumericVector fs2 = octmat_to_rcppmat(FS2);
+    Rcpp::List result = Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                           Rcpp::_["YS2"] = ys2,
+                                           Rcpp::_["FMU"] = fmu,
+                                           Rcpp::_["FS2"] = fs2);
+    if ( with_lp ) {
+        ColumnVector LP = octave_result(4).column_vector_value();
+        result["LP"] = octmat_to_rcppmat(LP);
+    }
+    result["POST"] = post;
+    return result;
+}
@@ -6,6 +6,7 @@
 #include <octave/ov-struct.h> // For octave_map
 #include <octave/parse.h> // To call M files
 #include "define-version.h"
+#include "native.h" // Octave-free inference paths
 
 
 // ----------------------- Octave embedding ----------------------------------
@@ -38,6 +39,11 @@ bool exit_octave(bool verbose = true);
 #endif
 
 
+// Calls a GPML function given as a specification list (e.g. a covariance
+// function list("covMaterniso", 3)) on args, like feval(cov{:}, args{:}):
+octave_value feval_spec(const Rcpp::List& spec, const octave_value_list& args);
+
+
 // ------------- Viewing and manipulating Octave's load path -----------------
 // Prints the Octave load path:
 void print_path();
@@ -48,9 +54,45 @@ void add_to_path(Rcpp::StringVector x);
 // ------------ Converting data between Octave and Rcpp types ----------------
 Rcpp::NumericVector octmat_to_rcppmat(const Matrix& x);
 Matrix rcppmat_to_octmat(const Rcpp::NumericVector& x);
+// Sparse matrices are the Matrix package's dgCMatrix objects in R:
+bool is_dgcmatrix(SEXP x);
+SparseMatrix rcppsparse_to_octsparse(const Rcpp::S4& x);
+Rcpp::RObject octsparse_to_rcppsparse(const SparseMatrix& x);
+// Single values of any type the conversions above (or map_to_list()) know:
+octave_value rcpp_to_octval(SEXP x);
+SEXP octval_to_rcpp(const octave_value& x);
 octave_map list_to_map(const Rcpp::List& x);
 Rcpp::List map_to_list(const octave_scalar_map& x);
 Cell list_to_cell(const Rcpp::List& x);
 
+
+// ---------------- Matching specifications to native code -------------------
+// The function name at the head of a specification list (or "" if none):
+std::string spec_name(const Rcpp::List& x);
+// Whether (and how) a GPML specification can be handled natively:
+bool parse_native_cov(const Rcpp::List& cov, int dim, native_cov& result);
+bool parse_native_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                        const Rcpp::List& cov, const Rcpp::List& lik,
+                        int dim, native_model& result);
+bool parse_native_predictor(const Rcpp::List& mean, const Rcpp::List& cov,
+                            const Rcpp::List& lik, int dim,
+                            native_model& result);
+bool parse_quadrature_lik(const Rcpp::List& lik, quadrature_lik& result);
+bool parse_state_space_cov(const Rcpp::List& cov, state_space_cov& result);
+bool parse_state_space_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                             const Rcpp::List& cov, const Rcpp::List& lik,
+                             state_space_model& result);
+bool parse_additive_cov(const Rcpp::List& cov, int dim,
+                        additive_cov& result);
+bool parse_additive_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                          const Rcpp::List& cov, const Rcpp::List& lik,
+                          int dim, additive_model& result);
+// Where each native hyperparameter sits in unlist(hyp):
+bool native_hyp_offsets(const Rcpp::List& hyp, const native_model& model,
+                        std::vector<int>& offsets);
+// GPML's gp() treats POST's L as a Cholesky factor if it is upper
+// triangular with a positive diagonal (and as -inv(K + inv(W)) otherwise):
+bool is_cholesky_factor(const Rcpp::NumericMatrix& L);
+
 #endif
 
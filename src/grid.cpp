@@ -0,0 +1,133 @@
+#include "gpmlr.h"
+
+// gp_grid(): GPML's infGrid() with covGrid() for likGauss, in compiled code
+// (see native-grid.cpp). The axes come in as they are, so the grid's N x D
+// inputs are never formed, let alone converted for Octave.
+
+// [[Rcpp::export(.gp_grid)]]
+Rcpp::List gp_grid(Rcpp::List axes,
+                   Rcpp::List cov,
+                   Rcpp::List hyp,
+                   Rcpp::List mean,
+                   Rcpp::NumericVector y,
+                   Rcpp::NumericMatrix xs,
+                   Rcpp::NumericVector options,
+                   bool derivatives,
+                   int threads) {
+    int p = axes.size();
+    if ( p == 0 || cov.size() != p ) {
+        Rcpp::stop("There must be one covariance function per axis.\n");
+    }
+    // The axes and their covariance functions
+    std::vector<grid_axis> grid(p);
+    int n_hyp_cov = 0;
+    int D = 0;
+    long N = 1;
+    for ( int j = 0; j < p; ++j ) {
+        Rcpp::NumericVector x = axes[j];
+        int dim = x.hasAttribute("dim")
+                ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol() : 1;
+        if ( !parse_native_cov(Rcpp::as<Rcpp::List>(cov[j]), dim,
+                               grid[j].cov) ) {
+            Rcpp::stop("Each axis needs a covariance function the compiled "
+                       "code supports.\n");
+        }
+        grid[j].n = x.size() / dim;
+        grid[j].x = x.begin();
+        n_hyp_cov += grid[j].cov.n_hyp();
+        D += dim;
+        N *= grid[j].n;
+    }
+    if ( y.size() != N ) {
+        Rcpp::stop("y must have one value per grid point.\n");
+    }
+    if ( xs.nrow() > 0 && xs.ncol() != D ) {
+        Rcpp::stop("xs must have one column per input dimension.\n");
+    }
+    std::string mean_name = spec_name(mean);
+    native_mean_type mean_type;
+    if ( mean_name == "meanZero" && mean.size() == 1 ) {
+        mean_type = MEAN_ZERO;
+    } else if ( mean_name == "meanConst" && mean.size() == 1 ) {
+        mean_type = MEAN_CONST;
+    } else {
+        Rcpp::stop("The mean function must be meanZero or meanConst.\n");
+    }
+    // hyp, as native_grid() orders it
+    Rcpp::NumericVector hyp_mean = hyp["mean"];
+    Rcpp::NumericVector hyp_cov = hyp["cov"];
+    Rcpp::NumericVector hyp_lik = hyp["lik"];
+    int n_mean = mean_type == MEAN_CONST ? 1 : 0;
+    if ( hyp_mean.size() != n_mean || hyp_cov.size() != n_hyp_cov
+         || hyp_lik.size() != 1 ) {
+        Rcpp::stop("The hyperparameters do not match the model.\n");
+    }
+    std::vector<double> h(hyp_mean.begin(), hyp_mean.end());
+    h.insert(h.end(), hyp_cov.begin(), hyp_cov.end());
+    h.push_back(hyp_lik[0]);
+    // Missing values mark the grid points that were not observed
+    std::vector<long> observed;
+    std::vector<double> y_observed;
+    for ( long i = 0; i < N; ++i ) {
+        if ( !Rcpp::NumericVector::is_na(y[i]) ) {
+            observed.push_back(i);
+            y_observed.push_back(y[i]);
+        }
+    }
+    if ( observed.empty() ) {
+        Rcpp::stop("y has no observed values.\n");
+    }
+    grid_options grid_opt;
+    grid_opt.cg_tol = options[0];
+    grid_opt.cg_maxit = static_cast<int>(options[1]);
+    grid_opt.n_threads = threads;
+    grid_state state;
+    if ( !native_grid(grid, mean_type, &h[0], &y_observed[0], observed,
+                      derivatives, grid_opt, state) ) {
+        Rcpp::stop("Conjugate gradients did not converge.\n");
+    }
+    // Parts that were not asked for are NULL; gp_grid() drops them
+    Rcpp::NumericMatrix nlz(1, 1);
+    nlz[0] = state.nlz;
+    Rcpp::RObject dnlz = R_NilValue;
+    if ( derivatives ) {
+        Rcpp::NumericMatrix d_mean(n_mean, 1);
+        Rcpp::NumericMatrix d_cov(n_hyp_cov, 1);
+        Rcpp::NumericMatrix d_lik(1, 1);
+        std::copy(state.dnlz.begin(), state.dnlz.begin() + n_mean,
+                  d_mean.begin());
+        std::copy(state.dnlz.begin() + n_mean,
+                  state.dnlz.begin() + n_mean + n_hyp_cov, d_cov.begin());
+        d_lik[0] = state.dnlz[n_mean + n_hyp_cov];
+        dnlz = Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                  Rcpp::_["cov"] = d_cov,
+                                  Rcpp::_["lik"] = d_lik);
+    }
+    Rcpp::RObject ymu = R_NilValue;
+    Rcpp::RObject ys2 = R_NilValue;
+    Rcpp::RObject fmu = R_NilValue;
+    Rcpp::RObject fs2 = R_NilValue;
+    int ns = xs.nrow();
+    if ( ns > 0 ) {
+        Rcpp::NumericMatrix mu(ns, 1);
+        Rcpp::NumericMatrix s2(ns, 1);
+        if ( !native_grid_predict(grid, mean_type, &h[0], state, xs.begin(),
+                                  ns, grid_opt, mu.begin(), s2.begin()) ) {
+            Rcpp::stop("Conjugate gradients did not converge.\n");
+        }
+        Rcpp::NumericMatrix y_s2(ns, 1);
+        for ( int i = 0; i < ns; ++i ) {
+            y_s2[i] = s2[i] + state.sn2;
+        }
+        ymu = Rcpp::clone(mu);
+        ys2 = y_s2;
+        fmu = mu;
+        fs2 = s2;
+    }
+    return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                              Rcpp::_["DNLZ"] = dnlz,
+                              Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2);
+}
@@ -0,0 +1,133 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s iterative exact inference (approx = "iterative"): infExact() for
+// likGauss by conjugate gradients and stochastic Lanczos quadrature (see
+// native-iterative.cpp). Neither training nor prediction goes through
+// Octave, as GPML would form the n x n covariance matrix for both.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// [[Rcpp::export(.gp_iterative)]]
+Rcpp::List gp_iterative(Rcpp::List hyp,
+                        Rcpp::List mean,
+                        Rcpp::List cov,
+                        Rcpp::List lik,
+                        Rcpp::NumericVector x,
+                        Rcpp::NumericVector y,
+                        Rcpp::NumericVector xs,
+                        Rcpp::NumericVector ys,
+                        Rcpp::NumericVector options,
+                        double seed,
+                        bool derivatives,
+                        int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int ns = xs.size() / dim;
+    if ( xs.size() != static_cast<R_xlen_t>(ns) * dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    native_model model;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    std::vector<int> offsets;
+    if ( !parse_native_model(inf, mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets) ) {
+        Rcpp::stop("Iterative inference needs likGauss, meanZero or "
+                   "meanConst, and a covariance function the compiled code "
+                   "supports.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    // options is c(tolerance, max_iterations, probes, rank)
+    iterative_options opt;
+    opt.tolerance = options[0];
+    opt.max_iterations = static_cast<int>(options[1]);
+    opt.probes = static_cast<int>(options[2]);
+    opt.rank = static_cast<int>(options[3]);
+    opt.seed = static_cast<unsigned>(seed);
+    opt.n_threads = threads;
+    iterative_result result;
+    if ( !native_iterative(model, &h[0], x.begin(), y.begin(), n,
+                           derivatives && ns == 0, opt, result) ) {
+        Rcpp::stop("Conjugate gradients did not converge.\n");
+    }
+    // POST: K is never formed, so there is no L to give
+    double sn2 = std::exp(2.0 * h[model.n_mean() + model.cov.n_hyp()]);
+    Rcpp::NumericMatrix alpha(n, 1);
+    std::copy(result.alpha.begin(), result.alpha.end(), alpha.begin());
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), 1.0 / std::sqrt(sn2));
+    Rcpp::NumericMatrix L(0, 0);
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    if ( ns == 0 ) {
+        Rcpp::NumericMatrix nlz(1, 1);
+        nlz[0] = result.nlz;
+        if ( !derivatives ) {
+            return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                      Rcpp::_["POST"] = post);
+        }
+        int n_mean = model.n_mean();
+        int n_cov = model.cov.n_hyp();
+        Rcpp::NumericMatrix d_mean(n_mean, 1);
+        Rcpp::NumericMatrix d_cov(n_cov, 1);
+        Rcpp::NumericMatrix d_lik(1, 1);
+        std::copy(result.dnlz.begin(), result.dnlz.begin() + n_mean,
+                  d_mean.begin());
+        std::copy(result.dnlz.begin() + n_mean,
+                  result.dnlz.begin() + n_mean + n_cov, d_cov.begin());
+        d_lik[0] = result.dnlz[n_mean + n_cov];
+        Rcpp::List dnlz = Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                             Rcpp::_["cov"] = d_cov,
+                                             Rcpp::_["lik"] = d_lik);
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["DNLZ"] = dnlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    if ( !native_iterative_predict(model, &h[0], x.begin(), n,
+                                   &result.alpha[0], xs.begin(), ns, opt,
+                                   fmu.begin(), fs2.begin()) ) {
+        Rcpp::stop("Conjugate gradients did not converge.\n");
+    }
+    Rcpp::NumericMatrix ys2(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        ys2[i] = fs2[i] + sn2;
+    }
+    Rcpp::NumericMatrix ymu = Rcpp::clone(fmu);
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2,
+                                  Rcpp::_["POST"] = post);
+    }
+    // likGauss' log predictive probabilities
+    Rcpp::NumericMatrix lp(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        double r = ys[i] - ymu[i];
+        lp[i] = -r * r / (2.0 * ys2[i]) - 0.5 * (LOG_2PI + std::log(ys2[i]));
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp,
+                              Rcpp::_["POST"] = post);
+}
@@ -0,0 +1,121 @@
+#include "gpmlr.h"
+
+// The Octave side of gp_mcmc(). Each worker process runs one chain by
+// calling GPML's infMCMC() repeatedly, a batch of samples at a time, each
+// call continuing from the last state (and HMC stepsize) of the previous one.
+
+// [[Rcpp::export(.gp_mcmc_chain)]]
+Rcpp::List gp_mcmc_chain(Rcpp::List hyp,
+                         Rcpp::List mean,
+                         Rcpp::List cov,
+                         Rcpp::List lik,
+                         Rcpp::NumericVector x,
+                         Rcpp::NumericVector y,
+                         std::string sampler,
+                         int n_sample,
+                         int n_skip,
+                         int n_burnin,
+                         Rcpp::NumericVector init,
+                         double stepsize,
+                         double seed) {
+    // Make sure Octave is embedded
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    // Seed Octave's generators (infMCMC() draws with both rand and randn);
+    // a negative seed leaves them where the previous batch left them
+    if ( seed >= 0 ) {
+        octave_value_list state;
+        state(0) = octave_value("state");
+        state(1) = octave_value(seed);
+        OCT("rand", state);
+        OCT("randn", state);
+    }
+    octave_scalar_map par;
+    par.assign("sampler", octave_value(sampler));
+    par.assign("Nsample", octave_value(n_sample));
+    par.assign("Nskip", octave_value(n_skip));
+    par.assign("Nburnin", octave_value(n_burnin));
+    par.assign("stepsize", octave_value(stepsize));
+    if ( init.size() > 0 ) {
+        par.assign("init", octave_value(rcppmat_to_octmat(init)));
+    }
+    octave_value_list in;
+    in(0) = octave_value(list_to_map(hyp));
+    in(1) = octave_value(list_to_cell(mean));
+    in(2) = octave_value(list_to_cell(cov));
+    in(3) = octave_value(list_to_cell(lik));
+    in(4) = octave_value(rcppmat_to_octmat(x));
+    in(5) = octave_value(rcppmat_to_octmat(y));
+    in(6) = octave_value(par);
+    octave_value_list octave_result = OCT("infMCMC", in, 1);
+    octave_scalar_map post = octave_result(0).scalar_map_value();
+    Matrix alpha = post.getfield("alpha").matrix_value();
+    double acceptance = post.getfield("acceptance_rate_MCMC").double_value();
+    // ESS has no stepsize to carry over
+    if ( post.isfield("stepsize_HMC") ) {
+        stepsize = post.getfield("stepsize_HMC").double_value();
+    }
+    return Rcpp::List::create(Rcpp::_["alpha"] = octmat_to_rcppmat(alpha),
+                              Rcpp::_["acceptance"] = acceptance,
+                              Rcpp::_["stepsize"] = stepsize);
+}
+
+// Combines samples of alpha as infMCMC() does into a posterior for gp():
+// L = -(inv(K) + mean(alpha) * mean(alpha)' - alpha * alpha' / N)
+// [[Rcpp::export(.gp_mcmc_post)]]
+Rcpp::List gp_mcmc_post(Rcpp::List hyp,
+                        Rcpp::List cov,
+                        Rcpp::NumericVector x,
+                        Rcpp::NumericMatrix alpha) {
+    // Make sure Octave is embedded
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    // K = feval(cov{:}, hyp.cov, x)
+    Rcpp::NumericVector hyp_cov = hyp["cov"];
+    octave_value_list in;
+    in(0) = octave_value(rcppmat_to_octmat(hyp_cov));
+    in(1) = octave_value(rcppmat_to_octmat(x));
+    Matrix K = feval_spec(cov, in).matrix_value();
+    int n = K.rows();
+    int N = alpha.ncol();
+    if ( alpha.nrow() != n ) {
+        Rcpp::stop("The samples do not match the training inputs.\n");
+    }
+    // Regularize as infMCMC() does if K is not positive definite
+    std::vector<double> R(K.data(), K.data() + static_cast<long>(n) * n);
+    if ( !chol_upper(&R[0], n) ) {
+        double trace = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            trace += K(i, i);
+        }
+        std::copy(K.data(), K.data() + static_cast<long>(n) * n, R.begin());
+        for ( int i = 0; i < n; ++i ) {
+            R[static_cast<long>(i) * n + i] += 1e-8 * trace / n;
+        }
+        if ( !chol_upper(&R[0], n) ) {
+            Rcpp::stop("The covariance matrix is not positive definite.\n");
+        }
+    }
+    Rcpp::NumericMatrix L(n, n);
+    chol_inverse(&R[0], n, L.begin());
+    std::vector<double> al(n, 0.0);
+    for ( int s = 0; s < N; ++s ) {
+        for ( int i = 0; i < n; ++i ) {
+            al[i] += alpha(i, s) / N;
+        }
+    }
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i < n; ++i ) {
+            double cross = 0.0;
+            for ( int s = 0; s < N; ++s ) {
+                cross += alpha(i, s) * alpha(j, s);
+            }
+            L(i, j) = -(L(i, j) + al[i] * al[j] - cross / N);
+        }
+    }
+    return Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                              Rcpp::_["sW"] = Rcpp::NumericMatrix(0, 0),
+                              Rcpp::_["L"] = L);
+}
@@ -0,0 +1,132 @@
+#include "gpmlr.h"
+#include <cstring>
+#include <cstdio>
+#include <stdint.h>
+
+// Content hashes for gp_memo()'s keys (see R/gp_memo.R). Objects are hashed
+// by walking them rather than by serializing them, so no copy of x is made
+// and the hash doesn't depend on R's serialization format or version. Two
+// independent 64-bit lanes give a 128-bit key, which makes collisions
+// between cached results negligible.
+
+namespace {
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// MurmurHash3's finalizer
+inline uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+struct hasher {
+    uint64_t a, b, length;
+    hasher() : a(0x9e3779b97f4a7c15ULL), b(0x6a09e667f3bcc909ULL),
+               length(0) {}
+    void word(uint64_t w) {
+        a = rotl(a ^ (w * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+        b = rotl(b ^ (w * 0x4cf5ad432745937fULL), 27) * 0x87c37b91114253d5ULL;
+        ++length;
+    }
+    // Whole words at a time, with the tail zero padded
+    void bytes(const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        size_t i = 0;
+        for ( ; i + 8 <= n; i += 8 ) {
+            uint64_t w;
+            std::memcpy(&w, p + i, 8);
+            word(w);
+        }
+        if ( i < n ) {
+            uint64_t w = 0;
+            std::memcpy(&w, p + i, n - i);
+            word(w);
+        }
+    }
+    void digest(char* out) {
+        uint64_t h1 = fmix(a ^ length);
+        uint64_t h2 = fmix(b + h1);
+        h1 = fmix(h1 + h2);
+        std::snprintf(out, 33, "%016llx%016llx",
+                      static_cast<unsigned long long>(h1),
+                      static_cast<unsigned long long>(h2));
+    }
+};
+
+void hash_sexp(SEXP x, hasher& h) {
+    R_xlen_t n = Rf_xlength(x);
+    int type = TYPEOF(x);
+    // Integers are hashed as the doubles they stand for, so that x = 1:10
+    // and x = as.numeric(1:10) share a key
+    h.word(type == INTSXP ? REALSXP : type);
+    h.word(static_cast<uint64_t>(n));
+    switch ( type ) {
+    case NILSXP:
+        break;
+    case REALSXP:
+        h.bytes(REAL(x), n * sizeof(double));
+        break;
+    case INTSXP:
+        for ( R_xlen_t i = 0; i < n; ++i ) {
+            int v = INTEGER(x)[i];
+            double d = v == NA_INTEGER ? NA_REAL : static_cast<double>(v);
+            h.bytes(&d, sizeof(double));
+        }
+        break;
+    case LGLSXP:
+        h.bytes(LOGICAL(x), n * sizeof(int));
+        break;
+    case STRSXP:
+        for ( R_xlen_t i = 0; i < n; ++i ) {
+            SEXP s = STRING_ELT(x, i);
+            if ( s == NA_STRING ) {
+                h.word(~0ULL);
+                continue;
+            }
+            size_t length = std::strlen(CHAR(s));
+            h.word(length);
+            h.bytes(CHAR(s), length);
+        }
+        break;
+    case VECSXP:
+        for ( R_xlen_t i = 0; i < n; ++i ) {
+            hash_sexp(VECTOR_ELT(x, i), h);
+        }
+        break;
+    case S4SXP:
+        // e.g. the Matrix package's dgCMatrix, whose slots are attributes
+        for ( SEXP a = ATTRIB(x); a != R_NilValue; a = CDR(a) ) {
+            const char* slot = CHAR(PRINTNAME(TAG(a)));
+            size_t length = std::strlen(slot);
+            h.word(length);
+            h.bytes(slot, length);
+            hash_sexp(CAR(a), h);
+        }
+        return;
+    default:
+        Rcpp::stop("Only numeric, logical, and character vectors, lists, "
+                   "and sparse matrices can be memoized.\n");
+    }
+    // Names tell hyp's fields apart, and dimensions x's shape
+    if ( type != NILSXP ) {
+        hash_sexp(Rf_getAttrib(x, R_NamesSymbol), h);
+        hash_sexp(Rf_getAttrib(x, R_DimSymbol), h);
+    }
+}
+
+}
+
+// [[Rcpp::export(.gp_hash)]]
+std::string gp_hash(Rcpp::List objects) {
+    hasher h;
+    hash_sexp(objects, h);
+    char out[33];
+    h.digest(out);
+    return std::string(out);
+}
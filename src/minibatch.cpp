@@ -0,0 +1,128 @@
+#include "gpmlr.h"
+
+// The negative log marginal likelihood and its gradient on each of several
+// minibatches of the training data, at one set of hyperparameters, for
+// set_hyperparameters()' stochastic methods. Models native_model can
+// describe are evaluated in compiled code with the minibatches spread
+// across threads; anything else goes through GPML's gp(), one minibatch at
+// a time.
+
+// [[Rcpp::export(.gp_minibatch_nlz)]]
+Rcpp::NumericMatrix gp_minibatch_nlz(Rcpp::List hyp,
+                                     Rcpp::List inf,
+                                     Rcpp::List mean,
+                                     Rcpp::List cov,
+                                     Rcpp::List lik,
+                                     Rcpp::NumericMatrix x,
+                                     Rcpp::NumericVector y,
+                                     Rcpp::List batches,
+                                     int threads) {
+    int n = y.size();
+    int dim = x.ncol();
+    if ( x.nrow() != n ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int n_batches = batches.size();
+    // Zero-based indices of each minibatch's points
+    std::vector< std::vector<int> > index(n_batches);
+    for ( int b = 0; b < n_batches; ++b ) {
+        Rcpp::IntegerVector rows = batches[b];
+        for ( int k = 0; k < rows.size(); ++k ) {
+            if ( rows[k] < 1 || rows[k] > n ) {
+                Rcpp::stop("Minibatch indices must be between 1 and the "
+                           "number of training points.\n");
+            }
+            index[b].push_back(rows[k] - 1);
+        }
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    int n_hyp = static_cast<int>(flat_hyp.size());
+    Rcpp::NumericMatrix result(n_batches, n_hyp + 1);
+    // Try the native path first
+    native_model model;
+    std::vector<int> offsets;
+    if ( parse_native_model(inf, mean, cov, lik, dim, model)
+         && native_hyp_offsets(hyp, model, offsets)
+         && static_cast<int>(offsets.size()) == n_hyp ) {
+        std::vector<double> h(n_hyp);
+        for ( int k = 0; k < n_hyp; ++k ) {
+            h[k] = flat_hyp[offsets[k]];
+        }
+        int n_threads = resolve_threads(threads);
+        std::vector<exact_workspace> work(n_threads);
+        // Rcpp objects must not be touched from worker threads,
+        // so we work on plain buffers and copy back at the end
+        std::vector<double> out(static_cast<long>(n_batches) * (n_hyp + 1));
+        const double* x_ptr = x.begin();
+        const double* y_ptr = y.begin();
+        parallel_for(n_batches, n_threads, [&](int b, int t) {
+            int m = static_cast<int>(index[b].size());
+            std::vector<double> xb(static_cast<long>(m) * dim);
+            std::vector<double> yb(m);
+            for ( int k = 0; k < m; ++k ) {
+                int i = index[b][k];
+                yb[k] = y_ptr[i];
+                for ( int d = 0; d < dim; ++d ) {
+                    xb[static_cast<long>(d) * m + k]
+                        = x_ptr[static_cast<long>(d) * n + i];
+                }
+            }
+            distance_cache cache;
+            build_distance_cache(model.cov, &xb[0], m, 0.0, cache);
+            std::vector<double> g(n_hyp);
+            double nlz = 0.0;
+            bool ok = m > 0
+                && native_exact_nlz(model, cache, &xb[0], &yb[0], m, &h[0],
+                                    &nlz, &g[0], work[t]);
+            out[b] = ok ? nlz : R_NaN;
+            for ( int k = 0; k < n_hyp; ++k ) {
+                long column = offsets[k] + 1;
+                out[column * n_batches + b] = ok ? g[k] : R_NaN;
+            }
+        });
+        std::copy(out.begin(), out.end(), result.begin());
+        return result;
+    }
+    // Otherwise go through Octave
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    octave_value_list in;
+    in(0) = octave_value(list_to_map(hyp));
+    in(1) = octave_value(list_to_cell(inf));
+    in(2) = octave_value(list_to_cell(mean));
+    in(3) = octave_value(list_to_cell(cov));
+    in(4) = octave_value(list_to_cell(lik));
+    Rcpp::CharacterVector fields = hyp.names();
+    for ( int b = 0; b < n_batches; ++b ) {
+        Rcpp::checkUserInterrupt();
+        int m = static_cast<int>(index[b].size());
+        Matrix xb(m, dim);
+        Matrix yb(m, 1);
+        for ( int k = 0; k < m; ++k ) {
+            yb(k, 0) = y[index[b][k]];
+            for ( int d = 0; d < dim; ++d ) {
+                xb(k, d) = x(index[b][k], d);
+            }
+        }
+        in(5) = octave_value(xb);
+        in(6) = octave_value(yb);
+        octave_value_list octave_result = OCT("gp", in, 2);
+        result(b, 0) = octave_result(0).double_value();
+        octave_scalar_map DNLZ = octave_result(1).scalar_map_value();
+        int column = 1;
+        for ( int f = 0; f < fields.size(); ++f ) {
+            std::string field = Rcpp::as<std::string>(fields(f));
+            Matrix d = DNLZ.getfield(field).matrix_value();
+            int length = Rf_length(hyp[f]);
+            for ( int k = 0; k < length; ++k ) {
+                result(b, column++) = k < d.numel() ? d(k) : R_NaN;
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,194 @@
+#include "model-file.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t align_section(uint64_t offset) {
+    uint64_t a = MODEL_FILE_ALIGNMENT;
+    return (offset + a - 1) / a * a;
+}
+
+// Whether count elements of element bytes each, starting at offset, lie in
+// a file of size bytes after the previous section (which ended at end), at
+// an offset aligned to element; if so, end moves past them. Checked by
+// division, so damaged sizes can't overflow.
+static bool section_fits(uint64_t offset, uint64_t count, uint64_t element,
+                         uint64_t size, uint64_t& end) {
+    if ( offset < end || offset > size || offset % element != 0
+         || count > (size - offset) / element ) {
+        return false;
+    }
+    end = offset + count * element;
+    return true;
+}
+
+bool write_model_file(const std::string& path, const native_model& model,
+                      const std::string& spec, const double* hyp,
+                      const double* x, int n, const double* alpha,
+                      const double* sW, const double* L, bool L_is_chol,
+                      std::string& error) {
+    model_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MODEL_FILE_MAGIC, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.byte_order = MODEL_FILE_BYTE_ORDER;
+    header.header_size = sizeof(header);
+    header.cov_type = model.cov.type;
+    header.cov_ard = model.cov.ard;
+    header.cov_degree = model.cov.degree;
+    header.mean_type = model.mean;
+    header.lik_type = model.lik;
+    header.posterior_type = L_is_chol ? POSTERIOR_CHOL : POSTERIOR_SYMMETRIC;
+    header.n = n;
+    header.dim = model.cov.dim;
+    header.n_hyp = model.n_hyp();
+    uint64_t n_packed = static_cast<uint64_t>(n) * (n + 1) / 2;
+    header.spec_offset = align_section(sizeof(header));
+    header.spec_bytes = spec.size();
+    header.hyp_offset = align_section(header.spec_offset + spec.size());
+    header.x_offset = align_section(header.hyp_offset + 8 * header.n_hyp);
+    header.alpha_offset = align_section(header.x_offset + 8 * n * header.dim);
+    header.sW_offset = align_section(header.alpha_offset + 8 * header.n);
+    header.L_offset = align_section(header.sW_offset + 8 * header.n);
+    header.file_size = header.L_offset + 8 * n_packed;
+    // Pack L's upper triangle, column by column
+    std::vector<double> packed(n_packed);
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i <= j; ++i ) {
+            packed[packed_index(i, j)] = L[static_cast<long>(j) * n + i];
+        }
+    }
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if ( !file ) {
+        error = "Could not open " + path + " for writing.";
+        return false;
+    }
+    // Each section is written after padding up to its offset
+    struct section { uint64_t offset; const void* data; uint64_t bytes; };
+    section sections[7] = {
+        { 0, &header, sizeof(header) },
+        { header.spec_offset, spec.data(), spec.size() },
+        { header.hyp_offset, hyp, 8 * header.n_hyp },
+        { header.x_offset, x, 8 * header.n * header.dim },
+        { header.alpha_offset, alpha, 8 * header.n },
+        { header.sW_offset, sW, 8 * header.n },
+        { header.L_offset, packed.empty() ? 0 : &packed[0], 8 * n_packed }
+    };
+    const char zeros[MODEL_FILE_ALIGNMENT] = { 0 };
+    uint64_t position = 0;
+    bool ok = true;
+    for ( int s = 0; s < 7 && ok; ++s ) {
+        uint64_t padding = sections[s].offset - position;
+        ok = std::fwrite(zeros, 1, padding, file) == padding;
+        if ( ok && sections[s].bytes > 0 ) {
+            ok = std::fwrite(sections[s].data, 1, sections[s].bytes, file)
+                 == sections[s].bytes;
+        }
+        position = sections[s].offset + sections[s].bytes;
+    }
+    if ( std::fclose(file) != 0 || !ok ) {
+        error = "Could not write " + path + ".";
+        return false;
+    }
+    return true;
+}
+
+mapped_model::mapped_model() : hyp(0), x(0), data(0), size(0) {
+    posterior.n = 0;
+    posterior.alpha = 0;
+    posterior.sW = 0;
+    posterior.L = 0;
+    posterior.L_is_chol = true;
+    posterior.L_is_packed = true;
+}
+
+mapped_model::~mapped_model() {
+    if ( data ) {
+        munmap(data, size);
+    }
+}
+
+bool mapped_model::open(const std::string& path, std::string& error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if ( fd < 0 ) {
+        error = "Could not open " + path + ".";
+        return false;
+    }
+    struct stat info;
+    if ( fstat(fd, &info) != 0
+         || static_cast<size_t>(info.st_size) < sizeof(model_file_header) ) {
+        close(fd);
+        error = path + " is not a gpmlr model file.";
+        return false;
+    }
+    size = info.st_size;
+    data = mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        data = 0;
+        error = "Could not map " + path + " into memory.";
+        return false;
+    }
+    const char* bytes = static_cast<const char*>(data);
+    model_file_header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if ( std::memcmp(header.magic, MODEL_FILE_MAGIC, 8) != 0 ) {
+        error = path + " is not a gpmlr model file.";
+        return false;
+    }
+    if ( header.byte_order != MODEL_FILE_BYTE_ORDER ) {
+        error = path + " was written on a machine with another byte order.";
+        return false;
+    }
+    if ( header.version != MODEL_FILE_VERSION
+         || header.header_size != sizeof(header) ) {
+        error = path + " was written by an incompatible version of gpmlr.";
+        return false;
+    }
+    // Check the model is one we know and the sections follow the header in
+    // order, inside the file; n and dim are bounded before any products
+    uint64_t n = header.n;
+    uint64_t end = sizeof(header);
+    bool valid = header.cov_type <= COV_PP && header.mean_type <= MEAN_CONST
+        && header.lik_type <= LIK_ERF
+        && (header.cov_type != COV_MATERN || header.cov_degree == 1
+            || header.cov_degree == 3 || header.cov_degree == 5)
+        && (header.cov_type != COV_PP || header.cov_degree <= 3)
+        && header.posterior_type <= POSTERIOR_SYMMETRIC
+        && n > 0 && n < (1ULL << 31) && header.dim > 0
+        && header.dim < (1ULL << 31) && header.file_size == size
+        && section_fits(header.spec_offset, header.spec_bytes, 1, size, end)
+        && section_fits(header.hyp_offset, header.n_hyp, 8, size, end)
+        && section_fits(header.x_offset, n * header.dim, 8, size, end)
+        && section_fits(header.alpha_offset, n, 8, size, end)
+        && section_fits(header.sW_offset, n, 8, size, end)
+        && section_fits(header.L_offset, n * (n + 1) / 2, 8, size, end);
+    if ( valid ) {
+        model.cov.type = static_cast<native_cov_type>(header.cov_type);
+        model.cov.ard = header.cov_ard != 0;
+        model.cov.degree = header.cov_degree;
+        model.cov.dim = static_cast<int>(header.dim);
+        model.mean = static_cast<native_mean_type>(header.mean_type);
+        model.lik = static_cast<native_lik_type>(header.lik_type);
+        valid = header.n_hyp == static_cast<uint64_t>(model.n_hyp());
+    }
+    if ( !valid ) {
+        error = path + " is damaged.";
+        return false;
+    }
+    spec.assign(bytes + header.spec_offset, header.spec_bytes);
+    hyp = reinterpret_cast<const double*>(bytes + header.hyp_offset);
+    x = reinterpret_cast<const double*>(bytes + header.x_offset);
+    posterior.n = static_cast<int>(n);
+    posterior.alpha = reinterpret_cast<const double*>(bytes
+                                                      + header.alpha_offset);
+    posterior.sW = reinterpret_cast<const double*>(bytes + header.sW_offset);
+    posterior.L = reinterpret_cast<const double*>(bytes + header.L_offset);
+    posterior.L_is_chol = header.posterior_type == POSTERIOR_CHOL;
+    posterior.L_is_packed = true;
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef GPMLR_MODEL_FILE_H
+#define GPMLR_MODEL_FILE_H
+
+// A compact binary format for fitted models (see gp_save() in R), laid out
+// so a model can be mapped into memory and predicted from in place: opening
+// one only checks its header, and pages are read as predictions touch them.
+//
+// A file is a model_file_header followed by these sections, each starting
+// at a multiple of MODEL_FILE_ALIGNMENT bytes:
+//   spec   the model specification as text (R code, kept for gp_load())
+//   hyp    n_hyp doubles, in native_model order (mean, cov, lik)
+//   x      n * dim doubles, the training inputs, column by column
+//   alpha  n doubles
+//   sW     n doubles
+//   L      n * (n + 1) / 2 doubles, the upper triangle of POST's L packed
+//          column by column (see native_posterior)
+// Integers and doubles are in the writer's byte order; byte_order lets a
+// reader on a different machine refuse the file rather than misread it.
+
+#include "native.h"
+#include <stdint.h>
+#include <string>
+
+const char MODEL_FILE_MAGIC[8] = { 'G', 'P', 'M', 'L', 'R', 'M', 'D', 'L' };
+const uint32_t MODEL_FILE_VERSION = 1;
+const uint32_t MODEL_FILE_BYTE_ORDER = 0x01020304;
+const uint64_t MODEL_FILE_ALIGNMENT = 64;
+
+// How L is to be used (see native_posterior)
+enum model_file_posterior { POSTERIOR_CHOL = 0, POSTERIOR_SYMMETRIC = 1 };
+
+struct model_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;     // sizeof(model_file_header) when written
+    uint32_t cov_type;        // native_cov_type
+    uint32_t cov_ard;
+    uint32_t cov_degree;
+    uint32_t mean_type;       // native_mean_type
+    uint32_t lik_type;        // native_lik_type
+    uint32_t posterior_type;  // model_file_posterior
+    uint32_t reserved;
+    uint64_t n;
+    uint64_t dim;
+    uint64_t n_hyp;
+    uint64_t spec_offset;
+    uint64_t spec_bytes;
+    uint64_t hyp_offset;
+    uint64_t x_offset;
+    uint64_t alpha_offset;
+    uint64_t sW_offset;
+    uint64_t L_offset;
+    uint64_t file_size;
+};
+
+// Writes a model file; L is the full n x n matrix from POST. Returns false
+// (and says why in error) if the file can't be written.
+bool write_model_file(const std::string& path, const native_model& model,
+                      const std::string& spec, const double* hyp,
+                      const double* x, int n, const double* alpha,
+                      const double* sW, const double* L, bool L_is_chol,
+                      std::string& error);
+
+// A read-only memory mapping of a model file, unmapped on destruction
+class mapped_model {
+public:
+    mapped_model();
+    ~mapped_model();
+    // Maps the file at path and checks its header and section bounds
+    bool open(const std::string& path, std::string& error);
+    native_model model;
+    native_posterior posterior;
+    std::string spec;
+    const double* hyp;
+    const double* x;
+private:
+    mapped_model(const mapped_model&);
+    mapped_model& operator=(const mapped_model&);
+    void* data;
+    size_t size;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "gpmlr.h"
+#include "model-file.h"
+
+// Saving fitted models in the binary format of model-file.h, and predicting
+// from mapped model files in compiled code. Nothing here needs Octave, so a
+// saved model can be loaded and used without embedding it.
+
+bool is_cholesky_factor(const Rcpp::NumericMatrix& L) {
+    int n = L.nrow();
+    for ( int j = 0; j < n; ++j ) {
+        if ( !(L(j, j) > 0.0) ) {
+            return false;
+        }
+        for ( int i = j + 1; i < n; ++i ) {
+            if ( L(i, j) != 0.0 ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// [[Rcpp::export(.gp_save)]]
+void gp_save(Rcpp::List hyp,
+             Rcpp::List mean,
+             Rcpp::List cov,
+             Rcpp::List lik,
+             Rcpp::NumericVector x,
+             Rcpp::NumericVector alpha,
+             Rcpp::NumericVector sW,
+             Rcpp::NumericMatrix L,
+             std::string spec,
+             std::string path) {
+    int n = alpha.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim || sW.size() != n
+         || L.nrow() != n || L.ncol() != n ) {
+        Rcpp::stop("The posterior does not match the training inputs.\n");
+    }
+    native_model model;
+    std::vector<int> offsets;
+    if ( !parse_native_predictor(mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets) ) {
+        Rcpp::stop("This model cannot be saved for compiled prediction.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> native_hyp(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        native_hyp[k] = flat_hyp[offsets[k]];
+    }
+    std::string error;
+    bool ok = write_model_file(path, model, spec,
+                               native_hyp.empty() ? 0 : &native_hyp[0],
+                               x.begin(), n, alpha.begin(), sW.begin(),
+                               L.begin(), is_cholesky_factor(L), error);
+    if ( !ok ) {
+        Rcpp::stop(error);
+    }
+}
+
+// [[Rcpp::export(.gp_load)]]
+Rcpp::List gp_load(std::string path) {
+    mapped_model* model = new mapped_model();
+    std::string error;
+    if ( !model->open(path, error) ) {
+        delete model;
+        Rcpp::stop(error);
+    }
+    Rcpp::XPtr<mapped_model> pointer(model, true);
+    return Rcpp::List::create(Rcpp::_["pointer"] = pointer,
+                              Rcpp::_["spec"] = model->spec,
+                              Rcpp::_["n"] = model->posterior.n,
+                              Rcpp::_["dim"] = model->model.cov.dim);
+}
+
+// [[Rcpp::export(.gp_predict)]]
+Rcpp::List gp_predict(SEXP pointer, Rcpp::NumericMatrix xs, int threads) {
+    Rcpp::XPtr<mapped_model> model(pointer);
+    if ( !model.get() ) {
+        Rcpp::stop("The model is no longer loaded; call gp_load() again.\n");
+    }
+    int ns = xs.nrow();
+    if ( xs.ncol() != model->model.cov.dim ) {
+        Rcpp::stop("xs must have one column per input dimension.\n");
+    }
+    Rcpp::NumericMatrix ymu(ns, 1);
+    Rcpp::NumericMatrix ys2(ns, 1);
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    // The worker threads only see plain pointers, never Rcpp objects
+    native_predict(model->model, model->hyp, model->x, model->posterior,
+                   xs.begin(), ns, ymu.begin(), ys2.begin(), fmu.begin(),
+                   fs2.begin(), threads);
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2);
+}
@@ -0,0 +1,209 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+// covADD.m and elsympol.m, pair by pair: for a pair of inputs, the dim
+// values k_d of the base covariance give the power sums p_r, and from them
+// the elementary symmetric polynomials e_r by Newton-Girard, as elsympol.m
+// does for whole slices. Working memory is K (or Q) itself plus a few
+// vectors of length dim per thread, where covADD.m keeps n x n x dim
+// arrays and forms one for every derivative.
+
+// Pairs per side of a tile
+static const int ADDITIVE_TILE = 64;
+
+int additive_cov::max_order() const {
+    return *std::max_element(orders.begin(), orders.end());
+}
+
+namespace {
+
+// Everything about the kernel that depends only on hyp
+struct additive_params {
+    int nh;                         // base hyperparameters per input
+    std::vector<double> inv_ell2;   // per input
+    std::vector<double> sf2;        // base signal variance per input
+    std::vector<double> alpha;      // per input (covRQiso only)
+    std::vector<double> order_sf2;  // sf2_r for each r in R
+};
+
+additive_params prepare(const additive_cov& cov, const double* hyp) {
+    additive_params a;
+    a.nh = cov.base.n_hyp();
+    a.inv_ell2.resize(cov.dim);
+    a.sf2.resize(cov.dim);
+    a.alpha.resize(cov.dim, 0.0);
+    for ( int d = 0; d < cov.dim; ++d ) {
+        const double* h = hyp + d * a.nh;
+        a.inv_ell2[d] = std::exp(-2.0 * h[0]);
+        a.sf2[d] = std::exp(2.0 * h[1]);
+        if ( cov.base.type == COV_RQ ) {
+            a.alpha[d] = std::exp(h[2]);
+        }
+    }
+    const double* h = hyp + cov.dim * a.nh;
+    for ( size_t r = 0; r < cov.orders.size(); ++r ) {
+        a.order_sf2.push_back(std::exp(2.0 * h[r]));
+    }
+    return a;
+}
+
+// e[0], ..., e[R] of k[0], ..., k[dim - 1], with p (R + 1 long) as scratch
+void elementary(const double* k, int dim, int R, double* p, double* e) {
+    std::fill(p, p + R + 1, 0.0);
+    for ( int d = 0; d < dim; ++d ) {
+        double power = 1.0;
+        for ( int r = 1; r <= R; ++r ) {
+            power *= k[d];
+            p[r] += power;
+        }
+    }
+    e[0] = 1.0;
+    if ( R >= 1 ) {
+        e[1] = p[1];
+    }
+    for ( int r = 2; r <= R; ++r ) {
+        double sum = 0.0;
+        double sign = 1.0;
+        for ( int i = 1; i <= r; ++i ) {
+            sum += p[i] * e[r - i] * sign / r;
+            sign = -sign;
+        }
+        e[r] = sum;
+    }
+}
+
+// The pair (i, j)'s k_d, and their value sum_r sf2_r e_r
+double pair_value(const additive_cov& cov, const additive_params& a,
+                  const double* x, int n, int i, int j, double* k, double* p,
+                  double* e, double* r2 = 0, double* dr2 = 0,
+                  double* dalpha = 0) {
+    bool rq = cov.base.type == COV_RQ;
+    for ( int d = 0; d < cov.dim; ++d ) {
+        double diff = x[static_cast<long>(d) * n + i]
+                    - x[static_cast<long>(d) * n + j];
+        double s = diff * diff * a.inv_ell2[d];
+        if ( r2 ) {
+            r2[d] = s;
+        }
+        k[d] = a.sf2[d] * cov_profile(cov.base, a.alpha[d], s,
+                                      dr2 ? dr2 + d : 0,
+                                      dalpha && rq ? dalpha + d : 0);
+    }
+    elementary(k, cov.dim, cov.max_order(), p, e);
+    double value = 0.0;
+    for ( size_t r = 0; r < cov.orders.size(); ++r ) {
+        value += a.order_sf2[r] * e[cov.orders[r]];
+    }
+    return value;
+}
+
+// The tiles (I, J) with I <= J, numbered row by row
+void upper_tiles(int n, std::vector<int>& tile_row,
+                 std::vector<int>& tile_column) {
+    int n_tiles = (n + ADDITIVE_TILE - 1) / ADDITIVE_TILE;
+    for ( int J = 0; J < n_tiles; ++J ) {
+        for ( int I = 0; I <= J; ++I ) {
+            tile_row.push_back(I);
+            tile_column.push_back(J);
+        }
+    }
+}
+
+}
+
+void native_additive_matrix(const additive_cov& cov, const double* hyp,
+                            const double* x, int n, double* K,
+                            int n_threads) {
+    additive_params a = prepare(cov, hyp);
+    int R = cov.max_order();
+    std::vector<int> tile_row, tile_column;
+    upper_tiles(n, tile_row, tile_column);
+    n_threads = resolve_threads(n_threads);
+    parallel_for(static_cast<int>(tile_row.size()), n_threads,
+                 [&](int t, int) {
+        std::vector<double> k(cov.dim), p(R + 1), e(R + 1);
+        int i0 = tile_row[t] * ADDITIVE_TILE;
+        int j0 = tile_column[t] * ADDITIVE_TILE;
+        int j1 = std::min(j0 + ADDITIVE_TILE, n);
+        for ( int j = j0; j < j1; ++j ) {
+            int i1 = std::min(i0 + ADDITIVE_TILE, j + 1);
+            for ( int i = i0; i < i1; ++i ) {
+                double value = pair_value(cov, a, x, n, i, j, &k[0], &p[0],
+                                          &e[0]);
+                K[static_cast<long>(j) * n + i] = value;
+                K[static_cast<long>(i) * n + j] = value;
+            }
+        }
+    });
+}
+
+void native_additive_gradient(const additive_cov& cov, const double* hyp,
+                              const double* x, int n, const double* Q,
+                              double* grad, int n_threads) {
+    additive_params a = prepare(cov, hyp);
+    int dim = cov.dim;
+    int R = cov.max_order();
+    int n_orders = static_cast<int>(cov.orders.size());
+    int n_hyp = cov.n_hyp();
+    int first_order = dim * a.nh;
+    bool rq = cov.base.type == COV_RQ;
+    std::vector<int> tile_row, tile_column;
+    upper_tiles(n, tile_row, tile_column);
+    n_threads = resolve_threads(n_threads);
+    std::vector< std::vector<double> > partial(n_threads,
+                                               std::vector<double>(n_hyp,
+                                                                   0.0));
+    parallel_for(static_cast<int>(tile_row.size()), n_threads,
+                 [&](int t, int thread) {
+        std::vector<double> g(n_hyp, 0.0);
+        std::vector<double> k(dim), r2(dim), dr2(dim), dalpha(dim);
+        std::vector<double> p(R + 1), e(R + 1), e_without(R);
+        int i0 = tile_row[t] * ADDITIVE_TILE;
+        int j0 = tile_column[t] * ADDITIVE_TILE;
+        int j1 = std::min(j0 + ADDITIVE_TILE, n);
+        for ( int j = j0; j < j1; ++j ) {
+            const double* Qj = Q + static_cast<long>(j) * n;
+            int i1 = std::min(i0 + ADDITIVE_TILE, j + 1);
+            for ( int i = i0; i < i1; ++i ) {
+                // Off-diagonal pairs count twice, halving cancels
+                double q = i < j ? Qj[i] : 0.5 * Qj[i];
+                pair_value(cov, a, x, n, i, j, &k[0], &p[0], &e[0], &r2[0],
+                           &dr2[0], &dalpha[0]);
+                for ( int r = 0; r < n_orders; ++r ) {
+                    g[first_order + r] += 2.0 * q * a.order_sf2[r]
+                                          * e[cov.orders[r]];
+                }
+                for ( int d = 0; d < dim; ++d ) {
+                    // The polynomials without input d, up to order R - 1,
+                    // and their weighted sum, which k_d's derivatives
+                    // multiply
+                    e_without[0] = 1.0;
+                    for ( int r = 1; r < R; ++r ) {
+                        e_without[r] = e[r] - k[d] * e_without[r - 1];
+                    }
+                    double s = 0.0;
+                    for ( int r = 0; r < n_orders; ++r ) {
+                        s += a.order_sf2[r] * e_without[cov.orders[r] - 1];
+                    }
+                    double c = q * s;
+                    double* gd = &g[d * a.nh];
+                    gd[0] -= 2.0 * c * a.sf2[d] * r2[d] * dr2[d];
+                    gd[1] += 2.0 * c * k[d];
+                    if ( rq ) {
+                        gd[2] += c * a.sf2[d] * dalpha[d];
+                    }
+                }
+            }
+        }
+        for ( int h = 0; h < n_hyp; ++h ) {
+            partial[thread][h] += g[h];
+        }
+    });
+    for ( int h = 0; h < n_hyp; ++h ) {
+        grad[h] = 0.0;
+        for ( int thread = 0; thread < n_threads; ++thread ) {
+            grad[h] += partial[thread][h];
+        }
+    }
+}
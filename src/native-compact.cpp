@@ -0,0 +1,274 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+// Compactly supported covariances (covPPiso, covPPard): K's nonzeros by
+// radius searches in a k-d tree over the scaled inputs, triangular solves
+// with a sparse Cholesky factor, and the entries of inv(A) that the
+// gradient needs, from the factor alone.
+
+static const int POINT_BLOCK = 256;
+
+namespace {
+
+// The inputs divided by the length scales (point by point), so the support
+// is the unit ball
+void scale_inputs(const native_cov& cov, const double* hyp, const double* x,
+                  int n, std::vector<double>& scaled) {
+    int dim = cov.dim;
+    scaled.resize(static_cast<long>(n) * dim);
+    for ( int d = 0; d < dim; ++d ) {
+        double inv_ell = std::exp(-hyp[cov.ard ? d : 0]);
+        for ( int i = 0; i < n; ++i ) {
+            scaled[static_cast<long>(i) * dim + d]
+                = x[static_cast<long>(d) * n + i] * inv_ell;
+        }
+    }
+}
+
+// Point by point back to column-major, as build_kd_tree() wants
+void by_column(const std::vector<double>& scaled, int n, int dim,
+               std::vector<double>& result) {
+    result.resize(scaled.size());
+    for ( int i = 0; i < n; ++i ) {
+        for ( int d = 0; d < dim; ++d ) {
+            result[static_cast<long>(d) * n + i]
+                = scaled[static_cast<long>(i) * dim + d];
+        }
+    }
+}
+
+// The entry of Z at (i, j) and (j, i), both already computed
+inline double symmetric_entry(const sparse_matrix& R,
+                              const std::vector<double>& Z, int i, int j) {
+    return sparse_find(R, Z, std::min(i, j), std::max(i, j));
+}
+
+}
+
+void compact_cov(const native_cov& cov, const double* hyp, const double* x,
+                 int n, const double* xs, int ns, int n_threads,
+                 sparse_matrix& K) {
+    int dim = cov.dim;
+    int n_ell = cov.ard ? dim : 1;
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    std::vector<double> scaled, column_major;
+    scale_inputs(cov, hyp, x, n, scaled);
+    by_column(scaled, n, dim, column_major);
+    kd_tree tree;
+    build_kd_tree(&column_major[0], n, dim, tree);
+    std::vector<double>().swap(column_major);
+    std::vector<double> scaled_xs;
+    scale_inputs(cov, hyp, xs, ns, scaled_xs);
+    // Each block of test points collects its own columns, which are then
+    // put together in order
+    int n_blocks = (ns + POINT_BLOCK - 1) / POINT_BLOCK;
+    std::vector< std::vector<int> > block_row(n_blocks);
+    std::vector< std::vector<double> > block_value(n_blocks);
+    K.rows = n;
+    K.cols = ns;
+    K.start.assign(static_cast<long>(ns) + 1, 0);
+    parallel_for(n_blocks, n_threads, [&](int b, int) {
+        std::vector<int> found;
+        std::vector<double> d2;
+        int s1 = std::min(ns, (b + 1) * POINT_BLOCK);
+        for ( int s = b * POINT_BLOCK; s < s1; ++s ) {
+            kd_radius(tree, &scaled_xs[static_cast<long>(s) * dim], 1.0,
+                      found, d2);
+            for ( size_t k = 0; k < found.size(); ++k ) {
+                block_row[b].push_back(found[k]);
+                block_value[b].push_back(sf2 * cov_profile(cov, 0.0, d2[k]));
+            }
+            K.start[s + 1] = static_cast<long>(found.size());
+        }
+    });
+    for ( int s = 0; s < ns; ++s ) {
+        K.start[s + 1] += K.start[s];
+    }
+    K.row.resize(K.start[ns]);
+    K.value.resize(K.start[ns]);
+    for ( int b = 0; b < n_blocks; ++b ) {
+        long offset = K.start[b * POINT_BLOCK];
+        std::copy(block_row[b].begin(), block_row[b].end(),
+                  K.row.begin() + offset);
+        std::copy(block_value[b].begin(), block_value[b].end(),
+                  K.value.begin() + offset);
+        std::vector<int>().swap(block_row[b]);
+        std::vector<double>().swap(block_value[b]);
+    }
+}
+
+// The diagonal is the last entry of each column
+void sparse_solve_upper(const sparse_matrix& R, double* b) {
+    for ( int j = R.cols - 1; j >= 0; --j ) {
+        long diagonal = R.start[j + 1] - 1;
+        b[j] /= R.value[diagonal];
+        double bj = b[j];
+        for ( long p = R.start[j]; p < diagonal; ++p ) {
+            b[R.row[p]] -= R.value[p] * bj;
+        }
+    }
+}
+
+void sparse_solve_upper_transposed(const sparse_matrix& R, double* b,
+                                   int first) {
+    for ( int j = first; j < R.cols; ++j ) {
+        long diagonal = R.start[j + 1] - 1;
+        double sum = b[j];
+        for ( long p = R.start[j]; p < diagonal; ++p ) {
+            sum -= R.value[p] * b[R.row[p]];
+        }
+        b[j] = sum / R.value[diagonal];
+    }
+}
+
+double sparse_find(const sparse_matrix& R, const std::vector<double>& Z,
+                   int i, int j) {
+    std::vector<int>::const_iterator begin = R.row.begin() + R.start[j];
+    std::vector<int>::const_iterator end = R.row.begin() + R.start[j + 1];
+    std::vector<int>::const_iterator found = std::lower_bound(begin, end, i);
+    if ( found == end || *found != i ) {
+        return 0.0;
+    }
+    return Z[found - R.row.begin()];
+}
+
+// With R Z = inv(R'), which is lower triangular with diagonal 1 / R_ii,
+// row i of R gives, for j > i in the pattern,
+//   Z_ij = -sum_{k > i} R_ik Z_kj / R_ii,
+// and then Z_ii = (1 / R_ii - sum_{k > i} R_ik Z_ik) / R_ii, where every Z_kj
+// needed is in a later row. Rows are gathered from R's columns first.
+void sparse_chol_selected_inverse(const sparse_matrix& R,
+                                  std::vector<double>& Z) {
+    int n = R.cols;
+    Z.assign(R.value.size(), 0.0);
+    std::vector<long> row_start(static_cast<long>(n) + 1, 0);
+    for ( int j = 0; j < n; ++j ) {
+        for ( long p = R.start[j]; p < R.start[j + 1] - 1; ++p ) {
+            ++row_start[R.row[p] + 1];
+        }
+    }
+    for ( int i = 0; i < n; ++i ) {
+        row_start[i + 1] += row_start[i];
+    }
+    // Column and position in R of each off-diagonal entry, row by row (in
+    // increasing column order, as the columns are visited in order)
+    std::vector<int> column(row_start[n]);
+    std::vector<long> position(row_start[n]);
+    std::vector<long> next(row_start.begin(), row_start.end() - 1);
+    for ( int j = 0; j < n; ++j ) {
+        for ( long p = R.start[j]; p < R.start[j + 1] - 1; ++p ) {
+            column[next[R.row[p]]] = j;
+            position[next[R.row[p]]++] = p;
+        }
+    }
+    for ( int i = n - 1; i >= 0; --i ) {
+        long begin = row_start[i];
+        long end = row_start[i + 1];
+        double r_ii = R.value[R.start[i + 1] - 1];
+        for ( long q = begin; q < end; ++q ) {
+            int j = column[q];
+            double sum = 0.0;
+            for ( long u = begin; u < end; ++u ) {
+                sum += R.value[position[u]]
+                    * symmetric_entry(R, Z, column[u], j);
+            }
+            Z[position[q]] = -sum / r_ii;
+        }
+        double sum = 0.0;
+        for ( long q = begin; q < end; ++q ) {
+            sum += R.value[position[q]] * Z[position[q]];
+        }
+        Z[R.start[i + 1] - 1] = (1.0 / r_ii - sum) / r_ii;
+    }
+}
+
+// With b = Ks(perm, s), the form is |inv(R') b|^2; b's leading zeros carry
+// through the forward substitution, so it starts at b's first nonzero
+void compact_quadratic_forms(const sparse_matrix& R,
+                             const std::vector<int>& perm,
+                             const sparse_matrix& Ks, double* result,
+                             int n_threads) {
+    int n = R.cols;
+    int ns = Ks.cols;
+    std::vector<int> position(n);
+    for ( int k = 0; k < n; ++k ) {
+        position[perm[k]] = k;
+    }
+    int n_blocks = (ns + POINT_BLOCK - 1) / POINT_BLOCK;
+    n_threads = resolve_threads(n_threads);
+    std::vector< std::vector<double> > work(n_threads,
+                                            std::vector<double>(n, 0.0));
+    parallel_for(n_blocks, n_threads, [&](int b, int thread) {
+        std::vector<double>& v = work[thread];
+        int s1 = std::min(ns, (b + 1) * POINT_BLOCK);
+        for ( int s = b * POINT_BLOCK; s < s1; ++s ) {
+            int first = n;
+            for ( long p = Ks.start[s]; p < Ks.start[s + 1]; ++p ) {
+                int k = position[Ks.row[p]];
+                v[k] = Ks.value[p];
+                first = std::min(first, k);
+            }
+            sparse_solve_upper_transposed(R, &v[0], first);
+            double sum = 0.0;
+            for ( int k = first; k < n; ++k ) {
+                sum += v[k] * v[k];
+                v[k] = 0.0;
+            }
+            result[s] = sum;
+        }
+    });
+}
+
+// As in native_cov_gradient(), with s_d = ((x_id - x_jd) / ell_d)^2,
+// dK_ij / dlog(ell_d) = -2 sf2 g'(r2) s_d and dK_ij / dlog(sf) = 2 K_ij
+void compact_cov_gradient(const native_cov& cov, const double* hyp,
+                          const double* x, int n, const sparse_matrix& W,
+                          double* grad, int n_threads) {
+    int dim = cov.dim;
+    int n_ell = cov.ard ? dim : 1;
+    int n_hyp = cov.n_hyp();
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    std::vector<double> scaled;
+    scale_inputs(cov, hyp, x, n, scaled);
+    int n_blocks = (n + POINT_BLOCK - 1) / POINT_BLOCK;
+    n_threads = resolve_threads(n_threads);
+    std::vector< std::vector<double> > partial(n_threads,
+                                               std::vector<double>(n_hyp,
+                                                                   0.0));
+    parallel_for(n_blocks, n_threads, [&](int b, int thread) {
+        std::vector<double>& g = partial[thread];
+        std::vector<double> s(dim);
+        int j1 = std::min(n, (b + 1) * POINT_BLOCK);
+        for ( int j = b * POINT_BLOCK; j < j1; ++j ) {
+            const double* xj = &scaled[static_cast<long>(j) * dim];
+            for ( long p = W.start[j]; p < W.start[j + 1]; ++p ) {
+                const double* xi = &scaled[static_cast<long>(W.row[p]) * dim];
+                double r2 = 0.0;
+                for ( int d = 0; d < dim; ++d ) {
+                    double diff = xi[d] - xj[d];
+                    s[d] = diff * diff;
+                    r2 += s[d];
+                }
+                double dr2 = 0.0;
+                double k = cov_profile(cov, 0.0, r2, &dr2);
+                double q = 0.5 * W.value[p] * sf2;
+                if ( cov.ard ) {
+                    for ( int d = 0; d < dim; ++d ) {
+                        g[d] -= 2.0 * q * dr2 * s[d];
+                    }
+                }
+                else {
+                    g[0] -= 2.0 * q * dr2 * r2;
+                }
+                g[n_ell] += 2.0 * q * k;
+            }
+        }
+    });
+    std::fill(grad, grad + n_hyp, 0.0);
+    for ( int t = 0; t < n_threads; ++t ) {
+        for ( int i = 0; i < n_hyp; ++i ) {
+            grad[i] += partial[t][i];
+        }
+    }
+}
@@ -0,0 +1,297 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+// Parallel (damped) EP. GPML's infEP() visits the sites one at a time and
+// keeps Sigma up to date with a rank-1 update after each, so a sweep costs
+// O(n^3) in serial steps; here all sites are matched against the same
+// posterior, which parallelizes, and the posterior is recomputed once per
+// sweep as infEP()'s epComputeParams() does (without forming Sigma, of
+// which only the diagonal is needed). Damping keeps the simultaneous
+// updates from overshooting.
+
+// likErf() in 'infEP' mode, for one site
+static void erf_ep(double y, double mu, double s2, double* lZ, double* dlZ,
+                   double* d2lZ) {
+    double z = y * mu / std::sqrt(1.0 + s2);
+    double n_p;
+    native_logphi(z, lZ, &n_p, 0, 0);
+    *dlZ = y * n_p / std::sqrt(1.0 + s2);
+    *d2lZ = -n_p * (z + n_p) / (1.0 + s2);
+}
+
+// likLogistic() in 'infEP' mode, for one site: a scale mixture of five
+// likErf()s, blended with an analytic tail approximation far from zero
+static void logistic_ep(double y, double mu, double s2, double* lZ,
+                        double* dlZ, double* d2lZ) {
+    static const double c[5] = {
+        1.146480988574439e+02, -1.508871030070582e+03, 2.676085036831241e+03,
+        -1.356294962039222e+03, 7.543285642111850e+01
+    };
+    static const double lam0[5] = { 0.44, 0.41, 0.40, 0.39, 0.36 };
+    double A[5], B[5], D[5], lam[5];
+    double max_A = -HUGE_VAL;
+    for ( int k = 0; k < 5; ++k ) {
+        lam[k] = std::sqrt(2.0) * lam0[k];
+        erf_ep(y, mu * lam[k], s2 * lam[k] * lam[k], A + k, B + k, D + k);
+        max_A = std::max(max_A, A[k]);
+    }
+    // The log_expA_x() and expABz_expAx() helpers of likLogistic.m
+    double denominator = 0.0;
+    double first = 0.0;
+    double second = 0.0;
+    for ( int k = 0; k < 5; ++k ) {
+        double e = std::exp(A[k] - max_A);
+        denominator += e * c[k];
+        first += e * B[k] * c[k] * lam[k];
+        second += e * (B[k] * B[k] + D[k]) * c[k] * lam[k] * lam[k];
+    }
+    double mixture_lZ = std::log(denominator) + max_A;
+    double mixture_dlZ = first / denominator;
+    double mixture_d2lZ = second / denominator - mixture_dlZ * mixture_dlZ;
+    // ln(p(y|f)) is linear in f with slope y far in the tails
+    double val = std::fabs(mu) - 196.0 / 200.0 * s2 - 4.0;
+    double w = 1.0 / (1.0 + std::exp(-10.0 * val));
+    double tail_lZ = std::min(s2 / 2.0 - std::fabs(mu), -0.1);
+    double tail_dlZ = mu > 0.0 ? -1.0 : (mu < 0.0 ? 1.0 : 0.0);
+    if ( y * mu > 0.0 ) {
+        tail_lZ = std::log(1.0 - std::exp(tail_lZ));
+        tail_dlZ = 0.0;
+    }
+    *lZ = (1.0 - w) * mixture_lZ + w * tail_lZ;
+    *dlZ = (1.0 - w) * mixture_dlZ + w * tail_dlZ;
+    *d2lZ = (1.0 - w) * mixture_d2lZ;
+}
+
+void native_lik_ep(native_lik_type lik, const double* y, const double* mu,
+                   const double* s2, int n, double* lZ, double* dlZ,
+                   double* d2lZ, int n_threads) {
+    // Sites are cheap, so hand them out in chunks
+    const int chunk = 256;
+    int n_chunks = (n + chunk - 1) / chunk;
+    parallel_for(n_chunks, n_threads, [&](int c, int) {
+        int end = std::min(n, (c + 1) * chunk);
+        for ( int i = c * chunk; i < end; ++i ) {
+            // GPML only allows +/- 1 labels
+            double yi = y[i] < 0.0 ? -1.0 : 1.0;
+            if ( lik == LIK_ERF ) {
+                erf_ep(yi, mu[i], s2[i], lZ + i, dlZ + i, d2lZ + i);
+            }
+            else {
+                logistic_ep(yi, mu[i], s2[i], lZ + i, dlZ + i, d2lZ + i);
+            }
+        }
+    });
+}
+
+// result = K * v + m (or K * v if m is null)
+static void symmetric_product(const double* K, const double* v,
+                              const double* m, int n, double* result) {
+    for ( int i = 0; i < n; ++i ) {
+        result[i] = m ? m[i] : 0.0;
+    }
+    for ( int j = 0; j < n; ++j ) {
+        const double* Kj = K + static_cast<long>(j) * n;
+        double vj = v[j];
+        for ( int i = 0; i < n; ++i ) {
+            result[i] += Kj[i] * vj;
+        }
+    }
+}
+
+// infEP()'s epComputeParams(): the posterior, cavities, moments, and nlz
+// for the current site parameters
+static bool compute_params(native_lik_type lik, const double* K,
+                           const double* m, const double* y,
+                           int n_threads, ep_state& s) {
+    int n = s.n;
+    s.sW.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        s.sW[i] = std::sqrt(s.ttau[i]);
+    }
+    s.L.resize(static_cast<long>(n) * n);
+    for ( int j = 0; j < n; ++j ) {
+        const double* Kj = K + static_cast<long>(j) * n;
+        double* Lj = &s.L[static_cast<long>(j) * n];
+        for ( int i = 0; i <= j; ++i ) {
+            Lj[i] = s.sW[i] * s.sW[j] * Kj[i];
+        }
+        Lj[j] += 1.0;
+    }
+    if ( !chol_upper(&s.L[0], n) ) {
+        return false;
+    }
+    // diag(Sigma) = diag(K) - sum(V .* V) with V = L' \ (sW .* K), a column
+    // at a time so V is never stored
+    s.s2.resize(n);
+    int n_workers = resolve_threads(n_threads);
+    std::vector<std::vector<double> > columns(n_workers,
+                                              std::vector<double>(n));
+    parallel_for(n, n_workers, [&](int j, int thread) {
+        std::vector<double>& v = columns[thread];
+        const double* Kj = K + static_cast<long>(j) * n;
+        for ( int i = 0; i < n; ++i ) {
+            v[i] = s.sW[i] * Kj[i];
+        }
+        solve_upper_transposed(&s.L[0], n, &v[0]);
+        double total = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            total += v[i] * v[i];
+        }
+        s.s2[j] = Kj[j] - total;
+    });
+    // alpha = tnu - sW .* solve_chol(L, sW .* (K * tnu + m)), mu = K alpha + m
+    std::vector<double> b(n);
+    symmetric_product(K, &s.tnu[0], m, n, &b[0]);
+    for ( int i = 0; i < n; ++i ) {
+        b[i] *= s.sW[i];
+    }
+    solve_chol(&s.L[0], n, &b[0]);
+    s.alpha.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        s.alpha[i] = s.tnu[i] - s.sW[i] * b[i];
+    }
+    s.mu.resize(n);
+    symmetric_product(K, &s.alpha[0], m, n, &s.mu[0]);
+    // Cavities and their moments
+    s.tau_n.resize(n);
+    s.nu_n.resize(n);
+    std::vector<double> cavity_mu(n), cavity_s2(n);
+    for ( int i = 0; i < n; ++i ) {
+        s.tau_n[i] = 1.0 / s.s2[i] - s.ttau[i];
+        s.nu_n[i] = s.mu[i] / s.s2[i] - s.tnu[i];
+        cavity_mu[i] = s.nu_n[i] / s.tau_n[i];
+        cavity_s2[i] = 1.0 / s.tau_n[i];
+    }
+    s.lZ.resize(n);
+    s.dlZ.resize(n);
+    s.d2lZ.resize(n);
+    native_lik_ep(lik, y, &cavity_mu[0], &cavity_s2[0], n, &s.lZ[0],
+                  &s.dlZ[0], &s.d2lZ[0], n_threads);
+    // nlZ = sum(log(diag(L))) - sum(lZ) - p'*Sigma*p/2 + (v'*p.^2)/2
+    //       - q'*((ttau./tau_n.*q-2*p).*v)/2 - sum(log(1+ttau./tau_n))/2
+    // with p'*Sigma*p = p'*K*p - |L' \ (sW .* (K * p))|^2
+    std::vector<double> p(n), q(n), Kp(n);
+    for ( int i = 0; i < n; ++i ) {
+        p[i] = s.tnu[i] - m[i] * s.ttau[i];
+        q[i] = s.nu_n[i] - m[i] * s.tau_n[i];
+    }
+    symmetric_product(K, &p[0], 0, n, &Kp[0]);
+    double pSp = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        pSp += p[i] * Kp[i];
+        Kp[i] *= s.sW[i];
+    }
+    solve_upper_transposed(&s.L[0], n, &Kp[0]);
+    double nlz = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        double v = s.s2[i];
+        double ratio = s.ttau[i] / s.tau_n[i];
+        pSp -= Kp[i] * Kp[i];
+        nlz += std::log(s.L[static_cast<long>(i) * n + i]) - s.lZ[i]
+             + v * p[i] * p[i] / 2.0
+             - q[i] * (ratio * q[i] - 2.0 * p[i]) * v / 2.0
+             - std::log(1.0 + ratio) / 2.0;
+    }
+    s.nlz = nlz - pSp / 2.0;
+    return true;
+}
+
+static bool start_from_zero(native_lik_type lik, const double* K,
+                            const double* m, const double* y, int n_threads,
+                            ep_state& s) {
+    s.ttau.assign(s.n, 0.0);
+    s.tnu.assign(s.n, 0.0);
+    return compute_params(lik, K, m, y, n_threads, s);
+}
+
+bool native_ep(native_lik_type lik, const double* K, const double* m,
+               const double* y, int n, const ep_options& options,
+               const std::vector<double>& ttau, const std::vector<double>& tnu,
+               ep_state& state) {
+    state.n = n;
+    state.sweeps = 0;
+    // As infEP(), try the given site parameters, but fall back to zero if
+    // that gives a better marginal likelihood
+    bool started = false;
+    if ( static_cast<int>(ttau.size()) == n
+         && static_cast<int>(tnu.size()) == n ) {
+        state.ttau = ttau;
+        state.tnu = tnu;
+        if ( compute_params(lik, K, m, y, options.n_threads, state) ) {
+            // nlz0 = -sum(lZ(y, m, diag(K))), the value for zero sites
+            std::vector<double> s2(n), lZ(n), dlZ(n), d2lZ(n);
+            for ( int i = 0; i < n; ++i ) {
+                s2[i] = K[static_cast<long>(i) * n + i];
+            }
+            native_lik_ep(lik, y, m, &s2[0], n, &lZ[0], &dlZ[0], &d2lZ[0],
+                          options.n_threads);
+            double nlz0 = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                nlz0 -= lZ[i];
+            }
+            started = !(state.nlz > nlz0);
+        }
+    }
+    if ( !started && !start_from_zero(lik, K, m, y, options.n_threads,
+                                      state) ) {
+        return false;
+    }
+    double nlz_old = HUGE_VAL;
+    while ( (std::fabs(state.nlz - nlz_old) > options.tolerance
+             && state.sweeps < options.max_sweeps)
+            || state.sweeps < options.min_sweeps ) {
+        nlz_old = state.nlz;
+        ++state.sweeps;
+        double d = options.damping;
+        for ( int i = 0; i < n; ++i ) {
+            double tau_ni = state.tau_n[i];
+            // A site whose cavity is improper keeps its parameters
+            if ( !(tau_ni > 0.0) ) {
+                continue;
+            }
+            double d2lZ = state.d2lZ[i];
+            double ttau_i = std::max(-d2lZ / (1.0 + d2lZ / tau_ni), 0.0);
+            double tnu_i = (state.dlZ[i] - state.nu_n[i] / tau_ni * d2lZ)
+                         / (1.0 + d2lZ / tau_ni);
+            state.ttau[i] = (1.0 - d) * state.ttau[i] + d * ttau_i;
+            state.tnu[i] = (1.0 - d) * state.tnu[i] + d * tnu_i;
+        }
+        if ( !compute_params(lik, K, m, y, options.n_threads, state) ) {
+            return false;
+        }
+    }
+    state.converged = !(state.sweeps >= options.max_sweeps
+                        && std::fabs(state.nlz - nlz_old) > options.tolerance);
+    return true;
+}
+
+void ep_gradient_matrix(const ep_state& state, double* F) {
+    int n = state.n;
+    chol_inverse(&state.L[0], n, F);
+    for ( int j = 0; j < n; ++j ) {
+        double* Fj = F + static_cast<long>(j) * n;
+        for ( int i = 0; i < n; ++i ) {
+            Fj[i] = state.alpha[i] * state.alpha[j]
+                  - state.sW[i] * state.sW[j] * Fj[i];
+        }
+    }
+}
+
+double ep_cov_gradient(const ep_state& state, const double* F,
+                       const double* dK) {
+    long nn = static_cast<long>(state.n) * state.n;
+    double total = 0.0;
+    for ( long k = 0; k < nn; ++k ) {
+        total += F[k] * dK[k];
+    }
+    return -total / 2.0;
+}
+
+double ep_mean_gradient(const ep_state& state, const double* dm) {
+    double total = 0.0;
+    for ( int i = 0; i < state.n; ++i ) {
+        total += state.dlZ[i] * dm[i];
+    }
+    return -total;
+}
@@ -0,0 +1,124 @@
+#include "native.h"
+#include <cmath>
+
+// A line-by-line port of infExact.m for the models described by
+// native_model (and additive_model); see the comments there for the
+// numerics.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// infExact() once the n x n covariance matrix is in work.K: hyp holds
+// n_mean mean hyperparameters, n_cov covariance ones, then log(sn), and
+// cov_gradient(Q, grad) writes the covariance part of the gradient
+static bool exact_nlz(int n, const double* y, const double* hyp, int n_mean,
+                      int n_cov,
+                      const std::function<void(const double*, double*)>&
+                          cov_gradient,
+                      double* nlz, double* dnlz, exact_workspace& work) {
+    double hyp_lik = hyp[n_mean + n_cov];
+    long nn = static_cast<long>(n) * n;
+    // Residuals from the mean function
+    double m = n_mean > 0 ? hyp[0] : 0.0;
+    work.alpha.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        work.alpha[i] = y[i] - m;
+    }
+    // Factorize the covariance matrix
+    double* K = &work.K[0];
+    double sn2 = std::exp(2.0 * hyp_lik);
+    double sl = 1.0;
+    if ( sn2 < 1e-6 ) { // very tiny sn2 can lead to numerical trouble
+        for ( int i = 0; i < n; ++i ) {
+            K[static_cast<long>(i) * n + i] += sn2;
+        }
+    }
+    else {
+        sl = sn2;
+        for ( long k = 0; k < nn; ++k ) {
+            K[k] /= sn2;
+        }
+        for ( int i = 0; i < n; ++i ) {
+            K[static_cast<long>(i) * n + i] += 1.0;
+        }
+    }
+    if ( !chol_upper(K, n) ) {
+        return false;
+    }
+    // alpha = solve_chol(L, y - m) / sl, and the negative log likelihood
+    std::vector<double> r(work.alpha);
+    solve_chol(K, n, &work.alpha[0]);
+    double fit = 0.0;
+    double logdet = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        work.alpha[i] /= sl;
+        fit += r[i] * work.alpha[i];
+        logdet += std::log(K[static_cast<long>(i) * n + i]);
+    }
+    *nlz = 0.5 * fit + logdet + 0.5 * n * (LOG_2PI + std::log(sl));
+    if ( !dnlz ) {
+        return true;
+    }
+    // Q = solve_chol(L, eye(n)) / sl - alpha * alpha'
+    work.Q.resize(nn);
+    double* Q = &work.Q[0];
+    chol_inverse(K, n, Q);
+    const double* a = &work.alpha[0];
+    for ( int j = 0; j < n; ++j ) {
+        double* Qj = Q + static_cast<long>(j) * n;
+        for ( int i = 0; i < n; ++i ) {
+            Qj[i] = Qj[i] / sl - a[i] * a[j];
+        }
+    }
+    // Mean derivatives
+    if ( n_mean > 0 ) {
+        double s = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            s -= a[i];
+        }
+        dnlz[0] = s;
+    }
+    // Covariance derivatives, sum(sum(Q .* dK)) / 2 for every hyperparameter
+    // in one pass over the pairs instead of forming each dK
+    cov_gradient(Q, dnlz + n_mean);
+    // Likelihood derivative
+    double tr = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        tr += Q[static_cast<long>(i) * n + i];
+    }
+    dnlz[n_mean + n_cov] = sn2 * tr;
+    return true;
+}
+
+bool native_exact_nlz(const native_model& model, const distance_cache& cache,
+                      const double* x, const double* y, int n,
+                      const double* hyp, double* nlz, double* dnlz,
+                      exact_workspace& work, int n_threads) {
+    const native_cov& cov = model.cov;
+    int n_mean = model.n_mean();
+    const double* hyp_cov = hyp + n_mean;
+    work.K.resize(static_cast<long>(n) * n);
+    native_cov_matrix(cov, hyp_cov, cache, x, &work.K[0]);
+    return exact_nlz(n, y, hyp, n_mean, cov.n_hyp(),
+                     [&](const double* Q, double* grad) {
+                         native_cov_gradient(cov, hyp_cov, cache, x, Q, grad,
+                                             n_threads);
+                     },
+                     nlz, dnlz, work);
+}
+
+bool native_additive_nlz(const additive_model& model, const double* x,
+                         const double* y, int n, const double* hyp,
+                         double* nlz, double* dnlz, exact_workspace& work,
+                         int n_threads) {
+    const additive_cov& cov = model.cov;
+    int n_mean = model.n_mean();
+    const double* hyp_cov = hyp + n_mean;
+    work.K.resize(static_cast<long>(n) * n);
+    native_additive_matrix(cov, hyp_cov, x, n, &work.K[0], n_threads);
+    return exact_nlz(n, y, hyp, n_mean, cov.n_hyp(),
+                     [&](const double* Q, double* grad) {
+                         native_additive_gradient(cov, hyp_cov, x, n, Q, grad,
+                                                  n_threads);
+                     },
+                     nlz, dnlz, work);
+}
@@ -0,0 +1,509 @@
+#include "native.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+// Inducing input selection, and a port of GPML's infFITC() that never forms
+// anything n x m: the training inputs are visited in blocks, whose cross
+// covariances Ku with the inducing inputs are recomputed on every pass
+// rather than stored, and only m x m sums are kept between passes.
+
+static const int FITC_BLOCK = 256;
+static const int KMEANS_ITERATIONS = 10;
+
+// Squared Euclidean distance between row i of the n x dim matrix x and
+// row k of the m x dim matrix c
+static double squared_distance(const double* x, int n, int i,
+                               const double* c, int m, int k, int dim) {
+    double total = 0.0;
+    for ( int d = 0; d < dim; ++d ) {
+        double diff = x[static_cast<long>(d) * n + i]
+                    - c[static_cast<long>(d) * m + k];
+        total += diff * diff;
+    }
+    return total;
+}
+
+void select_inducing_kmeans(const double* x, int n, int dim, int m,
+                            unsigned seed, int n_threads, double* xu) {
+    std::mt19937 rng(seed);
+    const int chunk = 4096;
+    int n_chunks = (n + chunk - 1) / chunk;
+    // k-means++: each new centre is drawn with probability proportional to
+    // the squared distance to the nearest centre so far
+    std::vector<double> nearest(n, HUGE_VAL);
+    int pick = std::uniform_int_distribution<int>(0, n - 1)(rng);
+    for ( int k = 0; k < m; ++k ) {
+        for ( int d = 0; d < dim; ++d ) {
+            xu[static_cast<long>(d) * m + k] = x[static_cast<long>(d) * n
+                                                 + pick];
+        }
+        if ( k == m - 1 ) {
+            break;
+        }
+        parallel_for(n_chunks, n_threads, [&](int c, int) {
+            int end = std::min(n, (c + 1) * chunk);
+            for ( int i = c * chunk; i < end; ++i ) {
+                double d2 = squared_distance(x, n, i, xu, m, k, dim);
+                nearest[i] = std::min(nearest[i], d2);
+            }
+        });
+        double total = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            total += nearest[i];
+        }
+        if ( !(total > 0.0) ) {
+            // Every input is already a centre
+            pick = std::uniform_int_distribution<int>(0, n - 1)(rng);
+            continue;
+        }
+        double u = std::uniform_real_distribution<double>(0.0, total)(rng);
+        pick = n - 1;
+        for ( int i = 0; i < n; ++i ) {
+            u -= nearest[i];
+            if ( u < 0.0 ) {
+                pick = i;
+                break;
+            }
+        }
+    }
+    // Lloyd's iterations, with per-thread sums; empty clusters keep their
+    // centres
+    n_threads = resolve_threads(n_threads);
+    std::vector< std::vector<double> > sums(n_threads);
+    std::vector< std::vector<long> > counts(n_threads);
+    for ( int iteration = 0; iteration < KMEANS_ITERATIONS; ++iteration ) {
+        for ( int t = 0; t < n_threads; ++t ) {
+            sums[t].assign(static_cast<long>(m) * dim, 0.0);
+            counts[t].assign(m, 0);
+        }
+        parallel_for(n_chunks, n_threads, [&](int c, int t) {
+            int end = std::min(n, (c + 1) * chunk);
+            for ( int i = c * chunk; i < end; ++i ) {
+                int best = 0;
+                double best_d2 = HUGE_VAL;
+                for ( int k = 0; k < m; ++k ) {
+                    double d2 = squared_distance(x, n, i, xu, m, k, dim);
+                    if ( d2 < best_d2 ) {
+                        best_d2 = d2;
+                        best = k;
+                    }
+                }
+                counts[t][best] += 1;
+                for ( int d = 0; d < dim; ++d ) {
+                    sums[t][static_cast<long>(d) * m + best]
+                        += x[static_cast<long>(d) * n + i];
+                }
+            }
+        });
+        for ( int k = 0; k < m; ++k ) {
+            long count = 0;
+            for ( int t = 0; t < n_threads; ++t ) {
+                count += counts[t][k];
+            }
+            if ( count == 0 ) {
+                continue;
+            }
+            for ( int d = 0; d < dim; ++d ) {
+                double total = 0.0;
+                for ( int t = 0; t < n_threads; ++t ) {
+                    total += sums[t][static_cast<long>(d) * m + k];
+                }
+                xu[static_cast<long>(d) * m + k] = total / count;
+            }
+        }
+    }
+}
+
+void select_inducing_greedy(const native_cov& cov, const double* hyp,
+                            const double* x, int n, int m, int max_candidates,
+                            unsigned seed, double* xu) {
+    int dim = cov.dim;
+    std::mt19937 rng(seed);
+    // The candidates: all inputs, or a random subset of them
+    std::vector<int> index(n);
+    for ( int i = 0; i < n; ++i ) {
+        index[i] = i;
+    }
+    int c = std::min(n, std::max(max_candidates, m));
+    for ( int i = 0; i < c && c < n; ++i ) {
+        int j = std::uniform_int_distribution<int>(i, n - 1)(rng);
+        std::swap(index[i], index[j]);
+    }
+    std::vector<double> xc(static_cast<long>(c) * dim);
+    for ( int d = 0; d < dim; ++d ) {
+        for ( int i = 0; i < c; ++i ) {
+            xc[static_cast<long>(d) * c + i] = x[static_cast<long>(d) * n
+                                                 + index[i]];
+        }
+    }
+    // Pivoted partial Cholesky: residual[i] is the variance of candidate i
+    // left unexplained by the picks so far, rows[k] the k-th factor column
+    std::vector<double> residual(c);
+    native_cov_cross(cov, hyp, &xc[0], 1, &xc[0], 1, &residual[0]);
+    std::fill(residual.begin(), residual.end(), residual[0]);
+    std::vector<double> rows(static_cast<long>(m) * c);
+    std::vector<double> kp(c), xp(dim);
+    std::vector<char> picked(c, 0);
+    for ( int k = 0; k < m; ++k ) {
+        int p = -1;
+        for ( int i = 0; i < c; ++i ) {
+            if ( !picked[i] && (p < 0 || residual[i] > residual[p]) ) {
+                p = i;
+            }
+        }
+        picked[p] = 1;
+        for ( int d = 0; d < dim; ++d ) {
+            xp[d] = xc[static_cast<long>(d) * c + p];
+            xu[static_cast<long>(d) * m + k] = xp[d];
+        }
+        double pivot = residual[p];
+        if ( !(pivot > 1e-12 * residual.size()) ) {
+            // The rest are explained already, so there is nothing to
+            // update; later picks just take the largest remaining variance
+            residual[p] = -HUGE_VAL;
+            continue;
+        }
+        native_cov_cross(cov, hyp, &xc[0], c, &xp[0], 1, &kp[0]);
+        double* row = &rows[static_cast<long>(k) * c];
+        double scale = 1.0 / std::sqrt(pivot);
+        for ( int i = 0; i < c; ++i ) {
+            double v = kp[i];
+            for ( int j = 0; j < k; ++j ) {
+                const double* other = &rows[static_cast<long>(j) * c];
+                v -= other[i] * other[p];
+            }
+            row[i] = v * scale;
+            residual[i] -= row[i] * row[i];
+        }
+        residual[p] = -HUGE_VAL;
+    }
+}
+
+namespace {
+
+// Per-thread scratch space for one block of training inputs
+struct fitc_block {
+    std::vector<double> xb, Ku, V, B, W, Z, G;
+    // Per-thread sums
+    std::vector<double> A, c, BWt, T, S, w, grad, dxu;
+    double log_g, rr, e, al;
+};
+
+// Copies the nb rows of x from first into xb, and computes Ku = K(xu, xb)
+// and V = Luu' \ Ku
+void block_covariances(const native_cov& cov, const double* hyp_cov,
+                       const double* x, int n, const double* xu, int m,
+                       const std::vector<double>& Luu, int first, int nb,
+                       fitc_block& s) {
+    int dim = cov.dim;
+    s.xb.resize(static_cast<long>(nb) * dim);
+    for ( int d = 0; d < dim; ++d ) {
+        for ( int j = 0; j < nb; ++j ) {
+            s.xb[static_cast<long>(d) * nb + j] = x[static_cast<long>(d) * n
+                                                    + first + j];
+        }
+    }
+    s.Ku.resize(static_cast<long>(m) * nb);
+    native_cov_cross(cov, hyp_cov, xu, m, &s.xb[0], nb, &s.Ku[0]);
+    s.V = s.Ku;
+    solve_upper_transposed(&Luu[0], m, &s.V[0], nb);
+}
+
+// Adds a * b' (both m vectors) to the m x m matrix M, or only its upper
+// triangle if upper_only
+void add_outer(double* M, int m, const double* a, const double* b,
+               double scale, bool upper_only) {
+    for ( int j = 0; j < m; ++j ) {
+        double bj = b[j] * scale;
+        if ( bj == 0.0 ) {
+            continue;
+        }
+        double* Mj = M + static_cast<long>(j) * m;
+        int end = upper_only ? j + 1 : m;
+        for ( int i = 0; i < end; ++i ) {
+            Mj[i] += a[i] * bj;
+        }
+    }
+}
+
+double dot(const double* a, const double* b, int m) {
+    double total = 0.0;
+    for ( int i = 0; i < m; ++i ) {
+        total += a[i] * b[i];
+    }
+    return total;
+}
+
+}
+
+// The derivatives are those of infFITC(), reorganised so that each needs
+// only sums over the inputs. With al = (Kt + sn2 I) \ (y - m), B = iKuu Ku,
+// W = Lu' \ (V ./ g), w = B al, c = al.^2 + sum(W .* W)', Z = B W' W, and
+// T = B diag(c) B', S = Z B', the derivative for any change dKu, dKuu, and
+// d(diag(K)) is
+//   ( sum(d(diag(K)) .* (1 ./ g - c)) + sum(sum(dKu .* U))
+//     + sum(sum(dKuu .* (w w' - T + S))) ) / 2
+// with U(:, j) = 2 * (c(j) B(:, j) - al(j) w - Z(:, j)).
+bool native_fitc(const native_model& model, const double* hyp,
+                 const double* x, const double* y, int n, const double* xu,
+                 int m, bool derivatives, int n_threads, fitc_result& result) {
+    const native_cov& cov = model.cov;
+    int dim = cov.dim;
+    int n_mean = model.n_mean();
+    int n_cov = cov.n_hyp();
+    const double* hyp_cov = hyp + n_mean;
+    double mean = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sf2 = std::exp(2.0 * hyp_cov[cov.ard ? dim : 1]);
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    double snu2 = 1e-6 * sn2;
+    long mm = static_cast<long>(m) * m;
+    // Luu' Luu = Kuu + snu2 I
+    std::vector<double> Kuu(mm);
+    native_cov_cross(cov, hyp_cov, xu, m, xu, m, &Kuu[0]);
+    std::vector<double> Luu(Kuu);
+    for ( int i = 0; i < m; ++i ) {
+        Luu[static_cast<long>(i) * m + i] += snu2;
+    }
+    if ( !chol_upper(&Luu[0], m) ) {
+        return false;
+    }
+    n_threads = resolve_threads(n_threads);
+    int n_blocks = (n + FITC_BLOCK - 1) / FITC_BLOCK;
+    std::vector<fitc_block> scratch(n_threads);
+    std::vector<double> g(n);
+    // First pass: Lu' Lu = I + V diag(1 ./ g) V' and V * ((y - m) ./ g)
+    for ( int t = 0; t < n_threads; ++t ) {
+        scratch[t].A.assign(mm, 0.0);
+        scratch[t].c.assign(m, 0.0);
+        scratch[t].log_g = 0.0;
+        scratch[t].rr = 0.0;
+    }
+    parallel_for(n_blocks, n_threads, [&](int b, int t) {
+        fitc_block& s = scratch[t];
+        int first = b * FITC_BLOCK;
+        int nb = std::min(FITC_BLOCK, n - first);
+        block_covariances(cov, hyp_cov, x, n, xu, m, Luu, first, nb, s);
+        for ( int j = 0; j < nb; ++j ) {
+            const double* Vj = &s.V[static_cast<long>(j) * m];
+            double gj = sf2 + sn2 - dot(Vj, Vj, m);
+            double r = y[first + j] - mean;
+            g[first + j] = gj;
+            add_outer(&s.A[0], m, Vj, Vj, 1.0 / gj, true);
+            for ( int i = 0; i < m; ++i ) {
+                s.c[i] += Vj[i] * r / gj;
+            }
+            s.log_g += std::log(gj);
+            s.rr += r * r / gj;
+        }
+    });
+    std::vector<double> Lu(mm, 0.0), be(m, 0.0);
+    double log_g = 0.0;
+    double rr = 0.0;
+    for ( int t = 0; t < n_threads; ++t ) {
+        for ( long k = 0; k < mm; ++k ) {
+            Lu[k] += scratch[t].A[k];
+        }
+        for ( int i = 0; i < m; ++i ) {
+            be[i] += scratch[t].c[i];
+        }
+        log_g += scratch[t].log_g;
+        rr += scratch[t].rr;
+    }
+    for ( int i = 0; i < m; ++i ) {
+        Lu[static_cast<long>(i) * m + i] += 1.0;
+    }
+    for ( int i = 0; i < n; ++i ) {
+        if ( !(g[i] > 0.0) ) {
+            return false;
+        }
+    }
+    if ( !chol_upper(&Lu[0], m) ) {
+        return false;
+    }
+    solve_upper_transposed(&Lu[0], m, &be[0]);
+    double nlz = 0.0;
+    for ( int i = 0; i < m; ++i ) {
+        nlz += std::log(Lu[static_cast<long>(i) * m + i]);
+    }
+    result.nlz = nlz + (log_g + n * std::log(2.0 * 3.141592653589793238462643)
+                        + rr - dot(&be[0], &be[0], m)) / 2.0;
+    // POST: alpha = Luu \ (Lu \ be), L = inv((Lu Luu)' (Lu Luu)) - iKuu
+    std::vector<double> t_vec(be);
+    solve_upper(&Lu[0], m, &t_vec[0]);
+    result.alpha = t_vec;
+    solve_upper(&Luu[0], m, &result.alpha[0]);
+    std::vector<double> P(mm, 0.0);
+    for ( int j = 0; j < m; ++j ) {
+        for ( int i = 0; i <= j; ++i ) {
+            double total = 0.0;
+            for ( int k = i; k <= j; ++k ) {
+                total += Lu[static_cast<long>(k) * m + i]
+                       * Luu[static_cast<long>(j) * m + k];
+            }
+            P[static_cast<long>(j) * m + i] = total;
+        }
+    }
+    result.L.resize(mm);
+    chol_inverse(&P[0], m, &result.L[0]);
+    std::vector<double> iKuu(mm);
+    chol_inverse(&Luu[0], m, &iKuu[0]);
+    for ( long k = 0; k < mm; ++k ) {
+        result.L[k] -= iKuu[k];
+    }
+    result.sW = 1.0 / std::sqrt(sn2);
+    if ( !derivatives ) {
+        return true;
+    }
+    // Second pass: al, c, w, B W', and T
+    std::vector<double> al(n), c(n);
+    for ( int t = 0; t < n_threads; ++t ) {
+        scratch[t].w.assign(m, 0.0);
+        scratch[t].BWt.assign(mm, 0.0);
+        scratch[t].T.assign(mm, 0.0);
+    }
+    parallel_for(n_blocks, n_threads, [&](int b, int t) {
+        fitc_block& s = scratch[t];
+        int first = b * FITC_BLOCK;
+        int nb = std::min(FITC_BLOCK, n - first);
+        block_covariances(cov, hyp_cov, x, n, xu, m, Luu, first, nb, s);
+        s.B = s.V;
+        solve_upper(&Luu[0], m, &s.B[0], nb);
+        s.W = s.V;
+        for ( int j = 0; j < nb; ++j ) {
+            double* Wj = &s.W[static_cast<long>(j) * m];
+            for ( int i = 0; i < m; ++i ) {
+                Wj[i] /= g[first + j];
+            }
+        }
+        solve_upper_transposed(&Lu[0], m, &s.W[0], nb);
+        for ( int j = 0; j < nb; ++j ) {
+            const double* Vj = &s.V[static_cast<long>(j) * m];
+            const double* Bj = &s.B[static_cast<long>(j) * m];
+            const double* Wj = &s.W[static_cast<long>(j) * m];
+            int i = first + j;
+            al[i] = (y[i] - mean - dot(Vj, &t_vec[0], m)) / g[i];
+            c[i] = al[i] * al[i] + dot(Wj, Wj, m);
+            for ( int k = 0; k < m; ++k ) {
+                s.w[k] += Bj[k] * al[i];
+            }
+            add_outer(&s.BWt[0], m, Bj, Wj, 1.0, false);
+            add_outer(&s.T[0], m, Bj, Bj, c[i], true);
+        }
+    });
+    std::vector<double> w(m, 0.0), BWt(mm, 0.0), T(mm, 0.0);
+    for ( int t = 0; t < n_threads; ++t ) {
+        for ( int i = 0; i < m; ++i ) {
+            w[i] += scratch[t].w[i];
+        }
+        for ( long k = 0; k < mm; ++k ) {
+            BWt[k] += scratch[t].BWt[k];
+            T[k] += scratch[t].T[k];
+        }
+    }
+    for ( int j = 0; j < m; ++j ) {
+        for ( int i = j + 1; i < m; ++i ) {
+            T[static_cast<long>(j) * m + i] = T[static_cast<long>(i) * m + j];
+        }
+    }
+    // Third pass: S, and the Ku and diag(K) parts of the derivatives
+    for ( int t = 0; t < n_threads; ++t ) {
+        scratch[t].S.assign(mm, 0.0);
+        scratch[t].grad.assign(n_cov, 0.0);
+        scratch[t].dxu.assign(static_cast<long>(m) * dim, 0.0);
+        scratch[t].e = 0.0;
+        scratch[t].al = 0.0;
+    }
+    parallel_for(n_blocks, n_threads, [&](int b, int t) {
+        fitc_block& s = scratch[t];
+        int first = b * FITC_BLOCK;
+        int nb = std::min(FITC_BLOCK, n - first);
+        block_covariances(cov, hyp_cov, x, n, xu, m, Luu, first, nb, s);
+        s.B = s.V;
+        solve_upper(&Luu[0], m, &s.B[0], nb);
+        s.W = s.V;
+        for ( int j = 0; j < nb; ++j ) {
+            double* Wj = &s.W[static_cast<long>(j) * m];
+            for ( int i = 0; i < m; ++i ) {
+                Wj[i] /= g[first + j];
+            }
+        }
+        solve_upper_transposed(&Lu[0], m, &s.W[0], nb);
+        s.Z.assign(static_cast<long>(m) * nb, 0.0);
+        s.G.resize(static_cast<long>(m) * nb);
+        for ( int j = 0; j < nb; ++j ) {
+            int i = first + j;
+            const double* Bj = &s.B[static_cast<long>(j) * m];
+            const double* Wj = &s.W[static_cast<long>(j) * m];
+            double* Zj = &s.Z[static_cast<long>(j) * m];
+            for ( int k = 0; k < m; ++k ) {
+                const double* BWt_k = &BWt[static_cast<long>(k) * m];
+                double v = Wj[k];
+                for ( int l = 0; l < m; ++l ) {
+                    Zj[l] += BWt_k[l] * v;
+                }
+            }
+            add_outer(&s.S[0], m, Zj, Bj, 1.0, false);
+            // G = U / 2 is what multiplies dKu
+            double* Gj = &s.G[static_cast<long>(j) * m];
+            for ( int k = 0; k < m; ++k ) {
+                Gj[k] = c[i] * Bj[k] - al[i] * w[k] - Zj[k];
+            }
+            s.e += (1.0 / g[i] - c[i]) / 2.0;
+            s.al += al[i];
+        }
+        native_cov_cross_gradient(cov, hyp_cov, xu, m, &s.xb[0], nb,
+                                  &s.G[0], &s.grad[0], &s.dxu[0]);
+    });
+    std::vector<double> S(mm, 0.0), grad(n_cov, 0.0);
+    result.dxu.assign(static_cast<long>(m) * dim, 0.0);
+    double e = 0.0;
+    double al_sum = 0.0;
+    for ( int t = 0; t < n_threads; ++t ) {
+        for ( long k = 0; k < mm; ++k ) {
+            S[k] += scratch[t].S[k];
+        }
+        for ( int k = 0; k < n_cov; ++k ) {
+            grad[k] += scratch[t].grad[k];
+        }
+        for ( long k = 0; k < static_cast<long>(m) * dim; ++k ) {
+            result.dxu[k] += scratch[t].dxu[k];
+        }
+        e += scratch[t].e;
+        al_sum += scratch[t].al;
+    }
+    // The Kuu part, with Guu = (w w' - T + (S + S') / 2) / 2 symmetric; as
+    // both arguments of Kuu are xu, its xu derivative counts twice
+    std::vector<double> Guu(mm);
+    double trace_T = 0.0;
+    double trace_S = 0.0;
+    for ( int j = 0; j < m; ++j ) {
+        for ( int i = 0; i < m; ++i ) {
+            long ij = static_cast<long>(j) * m + i;
+            long ji = static_cast<long>(i) * m + j;
+            Guu[ij] = (w[i] * w[j] - T[ij] + (S[ij] + S[ji]) / 2.0) / 2.0;
+        }
+        trace_T += T[static_cast<long>(j) * m + j];
+        trace_S += S[static_cast<long>(j) * m + j];
+    }
+    std::vector<double> dxu_uu(static_cast<long>(m) * dim, 0.0);
+    native_cov_cross_gradient(cov, hyp_cov, xu, m, xu, m, &Guu[0], &grad[0],
+                              &dxu_uu[0]);
+    for ( long k = 0; k < static_cast<long>(m) * dim; ++k ) {
+        result.dxu[k] += 2.0 * dxu_uu[k];
+    }
+    // diag(K) = sf2 only depends on log(sf)
+    grad[cov.ard ? dim : 1] += 2.0 * sf2 * e;
+    result.dnlz.assign(model.n_hyp(), 0.0);
+    if ( model.mean == MEAN_CONST ) {
+        result.dnlz[0] = -al_sum;
+    }
+    for ( int k = 0; k < n_cov; ++k ) {
+        result.dnlz[n_mean + k] = grad[k];
+    }
+    // sn2 enters through g and, as snu2 = sn2 / 1e6, through Kuu
+    result.dnlz[n_mean + n_cov] = 2.0 * sn2 * e
+                                + snu2 * (dot(&w[0], &w[0], m) - trace_T
+                                          + trace_S);
+    return true;
+}
@@ -0,0 +1,443 @@
+#include "native.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// A port of GPML's infGrid() (and the kronmvm() and eigr() helpers in it)
+// for covGrid() with a native covariance function on each axis.
+
+void kron_mvm(const std::vector<kron_factor>& factors, const double* x,
+              int nrhs, double* result, int n_threads) {
+    long post = nrhs;
+    for ( std::size_t j = 0; j < factors.size(); ++j ) {
+        post *= factors[j].cols;
+    }
+    std::vector<double> a(x, x + post);
+    std::vector<double> b;
+    long pre = 1;
+    n_threads = resolve_threads(n_threads);
+    for ( std::size_t j = 0; j < factors.size(); ++j ) {
+        const kron_factor& F = factors[j];
+        post /= F.cols;
+        if ( !F.A ) {
+            pre *= F.cols;
+            continue;
+        }
+        // Viewing a as pre x cols x post, apply F along the middle
+        b.assign(pre * F.rows * post, 0.0);
+        int n_chunks = static_cast<int>(std::min<long>(post, 4L * n_threads));
+        parallel_for(n_chunks, n_threads, [&](int chunk, int) {
+            long first = post * chunk / n_chunks;
+            long last = post * (chunk + 1) / n_chunks;
+            for ( long c = first; c < last; ++c ) {
+                for ( int k = 0; k < F.cols; ++k ) {
+                    const double* in = &a[pre * (k + F.cols * c)];
+                    for ( int i = 0; i < F.rows; ++i ) {
+                        double v = F.transpose
+                                 ? F.A[static_cast<long>(i) * F.cols + k]
+                                 : F.A[static_cast<long>(k) * F.rows + i];
+                        if ( v == 0.0 ) {
+                            continue;
+                        }
+                        double* out = &b[pre * (i + F.rows * c)];
+                        for ( long q = 0; q < pre; ++q ) {
+                            out[q] += v * in[q];
+                        }
+                    }
+                }
+            }
+        });
+        a.swap(b);
+        pre *= F.rows;
+    }
+    std::copy(a.begin(), a.end(), result);
+}
+
+namespace {
+
+// (F_p x ... x F_1) x for one column, with F_j the K_j, V_j, or V_j'
+enum grid_factor { FACTOR_K, FACTOR_V, FACTOR_VT };
+void grid_mvm(const grid_state& state, grid_factor which, const double* x,
+              double* result, int n_threads) {
+    std::vector<kron_factor> factors;
+    for ( std::size_t j = 0; j < state.V.size(); ++j ) {
+        int n = static_cast<int>(state.E[j].size());
+        const double* A = which == FACTOR_K ? &state.K[j][0] : &state.V[j][0];
+        kron_factor F = { A, n, n, which == FACTOR_VT };
+        factors.push_back(F);
+    }
+    kron_mvm(factors, x, 1, result, n_threads);
+}
+
+// GPML's conjgrad() for one right hand side: solves A x = b, with
+// A(p, q) writing A p to q, until |b - A x| < tol |b|. Returns the number of
+// iterations, or -1 if maxit was reached first.
+int conjugate_gradients(const std::function<void(const double*, double*)>& A,
+                        const double* b, long n, double tol, int maxit,
+                        double* x) {
+    std::vector<double> r(b, b + n), d(b, b + n), z(n);
+    std::fill(x, x + n, 0.0);
+    double r2 = 0.0;
+    for ( long i = 0; i < n; ++i ) {
+        r2 += r[i] * r[i];
+    }
+    double nb = std::sqrt(r2);
+    if ( nb == 0.0 || tol > 1.0 ) {
+        return 1;
+    }
+    for ( int iteration = 2; iteration <= maxit; ++iteration ) {
+        A(&d[0], &z[0]);
+        double dz = 0.0;
+        for ( long i = 0; i < n; ++i ) {
+            dz += d[i] * z[i];
+        }
+        double a = r2 / dz;
+        double r2_new = 0.0;
+        for ( long i = 0; i < n; ++i ) {
+            x[i] += a * d[i];
+            r[i] -= a * z[i];
+            r2_new += r[i] * r[i];
+        }
+        if ( std::sqrt(r2_new) < tol * nb ) {
+            return iteration;
+        }
+        double beta = r2_new / r2;
+        for ( long i = 0; i < n; ++i ) {
+            d[i] = r[i] + beta * d[i];
+        }
+        r2 = r2_new;
+    }
+    return -1;
+}
+
+// q = M K M' p + sn2 p for the observed points M
+void observed_mvm(const grid_state& state, const double* p, double* q,
+                  int n_threads) {
+    long n = static_cast<long>(state.observed.size());
+    std::vector<double> full(state.N, 0.0), Kfull(state.N);
+    for ( long i = 0; i < n; ++i ) {
+        full[state.observed[i]] = p[i];
+    }
+    grid_mvm(state, FACTOR_K, &full[0], &Kfull[0], n_threads);
+    for ( long i = 0; i < n; ++i ) {
+        q[i] = Kfull[state.observed[i]] + state.sn2 * p[i];
+    }
+}
+
+// kron(v_p, ..., v_1) for vectors v_j (one per axis)
+std::vector<double> kron_vector(const std::vector<const double*>& v,
+                                const std::vector<int>& sizes) {
+    std::vector<kron_factor> factors;
+    for ( std::size_t j = 0; j < v.size(); ++j ) {
+        kron_factor F = { v[j], sizes[j], 1, false };
+        factors.push_back(F);
+    }
+    long N = 1;
+    for ( std::size_t j = 0; j < sizes.size(); ++j ) {
+        N *= sizes[j];
+    }
+    std::vector<double> result(N);
+    double one = 1.0;
+    kron_mvm(factors, &one, 1, &result[0], 1);
+    return result;
+}
+
+}
+
+bool native_grid(const std::vector<grid_axis>& axes, native_mean_type mean,
+                 const double* hyp, const double* y,
+                 const std::vector<long>& observed, bool derivatives,
+                 const grid_options& options, grid_state& state) {
+    int p = static_cast<int>(axes.size());
+    int n_threads = resolve_threads(options.n_threads);
+    state.mean = mean == MEAN_CONST ? hyp[0] : 0.0;
+    std::vector<const double*> hyp_axis(p);
+    const double* h = hyp + (mean == MEAN_CONST ? 1 : 0);
+    for ( int j = 0; j < p; ++j ) {
+        hyp_axis[j] = h;
+        h += axes[j].cov.n_hyp();
+    }
+    state.sn2 = std::exp(2.0 * h[0]);
+    double sn2 = state.sn2;
+    // The axes' covariance matrices, and eigr(): eigenvalues below the
+    // numerical rank are set to zero
+    state.K.resize(p);
+    state.V.resize(p);
+    state.E.resize(p);
+    state.N = 1;
+    for ( int j = 0; j < p; ++j ) {
+        int nj = axes[j].n;
+        state.K[j].resize(static_cast<long>(nj) * nj);
+        native_cov_cross(axes[j].cov, hyp_axis[j], axes[j].x, nj, axes[j].x,
+                         nj, &state.K[j][0]);
+        state.V[j] = state.K[j];
+        state.E[j].resize(nj);
+        sym_eigen(&state.V[j][0], nj, &state.E[j][0]);
+        double top = std::max(state.E[j][nj - 1], 0.0);
+        double tol = nj * top * DBL_EPSILON;
+        for ( int i = 0; i < nj; ++i ) {
+            if ( !(state.E[j][i] > tol) ) {
+                state.E[j][i] = 0.0;
+            }
+        }
+        state.N *= nj;
+    }
+    long N = state.N;
+    state.observed = observed;
+    long n = static_cast<long>(observed.size());
+    std::vector<double> r(n);
+    for ( long i = 0; i < n; ++i ) {
+        r[i] = y[i] - state.mean;
+    }
+    std::vector<double> e;
+    std::vector<int> sizes(p);
+    std::vector<const double*> eigenvalues(p);
+    for ( int j = 0; j < p; ++j ) {
+        sizes[j] = axes[j].n;
+        eigenvalues[j] = &state.E[j][0];
+    }
+    e = kron_vector(eigenvalues, sizes);
+    // s (length n) as in infGrid(), and s_grid, its spread over the grid
+    // for the derivatives' trace terms
+    std::vector<double> s(n), s_grid(N, 0.0);
+    state.alpha.assign(n, 0.0);
+    state.cg_iterations = 0;
+    bool complete = n == N;
+    if ( complete ) {
+        for ( long i = 0; i < N; ++i ) {
+            s[i] = 1.0 / (e[i] + sn2);
+            s_grid[i] = s[i];
+        }
+        state.s = s;
+        std::vector<double> t(N);
+        grid_mvm(state, FACTOR_VT, &r[0], &t[0], n_threads);
+        for ( long i = 0; i < N; ++i ) {
+            t[i] *= s[i];
+        }
+        grid_mvm(state, FACTOR_V, &t[0], &state.alpha[0], n_threads);
+    } else {
+        std::vector<long> order(N);
+        for ( long i = 0; i < N; ++i ) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&e](long a, long b) {
+            return e[a] > e[b];
+        });
+        double scale = static_cast<double>(n) / N;
+        for ( long i = 0; i < n; ++i ) {
+            s[i] = 1.0 / (scale * e[order[i]] + sn2);
+            s_grid[order[i]] = scale * s[i];
+        }
+        state.s.clear();
+        int iterations = conjugate_gradients(
+            [&](const double* a, double* b) {
+                observed_mvm(state, a, b, n_threads);
+            },
+            &r[0], n, options.cg_tol, options.cg_maxit, &state.alpha[0]
+        );
+        if ( iterations < 0 ) {
+            return false;
+        }
+        state.cg_iterations = iterations;
+    }
+    double lda = 0.0;
+    double r_alpha = 0.0;
+    for ( long i = 0; i < n; ++i ) {
+        lda -= std::log(s[i]);
+        r_alpha += r[i] * state.alpha[i];
+    }
+    state.nlz = r_alpha / 2.0 + n * std::log(2.0 * 3.141592653589793238462643)
+              / 2.0 + lda / 2.0;
+    if ( !derivatives ) {
+        return true;
+    }
+    // With dK = K_p x .. x dK_j x .. x K_1 and P_l = diag(V_l' K_l V_l),
+    // infGrid()'s p' s is sum(sum(dK_j .* (V_j diag(c_j) V_j'))), where c_j
+    // contracts s_grid with the P_l for l != j, and Mtal' dK Mtal is
+    // sum(sum(dK_j .* Q_j)) for Q_j contracting Mtal with K_l Mtal
+    std::vector<double> Mtal(N, 0.0);
+    for ( long i = 0; i < n; ++i ) {
+        Mtal[observed[i]] = state.alpha[i];
+    }
+    std::vector< std::vector<double> > P(p);
+    for ( int j = 0; j < p; ++j ) {
+        int nj = axes[j].n;
+        P[j].assign(nj, 0.0);
+        for ( int i = 0; i < nj; ++i ) {
+            const double* vi = &state.V[j][static_cast<long>(i) * nj];
+            for ( int l = 0; l < nj; ++l ) {
+                double Kv = 0.0;
+                const double* Kl = &state.K[j][static_cast<long>(l) * nj];
+                for ( int k = 0; k < nj; ++k ) {
+                    Kv += Kl[k] * vi[k];
+                }
+                P[j][i] += vi[l] * Kv;
+            }
+        }
+    }
+    int n_mean = mean == MEAN_CONST ? 1 : 0;
+    state.dnlz.assign(h - hyp + 1, 0.0);
+    if ( mean == MEAN_CONST ) {
+        for ( long i = 0; i < n; ++i ) {
+            state.dnlz[0] -= state.alpha[i];
+        }
+    }
+    double* grad = &state.dnlz[n_mean];
+    long pre = 1;
+    for ( int j = 0; j < p; ++j ) {
+        int nj = axes[j].n;
+        long post = N / pre / nj;
+        std::vector<kron_factor> trace_factors, quad_factors;
+        for ( int l = 0; l < p; ++l ) {
+            int nl = axes[l].n;
+            kron_factor T = { l == j ? 0 : &P[l][0], l == j ? nl : 1, nl,
+                              false };
+            kron_factor Q = { l == j ? 0 : &state.K[l][0], nl, nl, false };
+            trace_factors.push_back(T);
+            quad_factors.push_back(Q);
+        }
+        std::vector<double> c(nj), u(N);
+        kron_mvm(trace_factors, &s_grid[0], 1, &c[0], n_threads);
+        kron_mvm(quad_factors, &Mtal[0], 1, &u[0], n_threads);
+        // G = (V_j diag(c) V_j' - Q_j) / 2, with Q_j summed over threads
+        long nn = static_cast<long>(nj) * nj;
+        std::vector< std::vector<double> > Q(n_threads,
+                                             std::vector<double>(nn, 0.0));
+        int n_chunks = static_cast<int>(std::min<long>(post, 4L * n_threads));
+        parallel_for(n_chunks, n_threads, [&](int chunk, int t) {
+            long first = post * chunk / n_chunks;
+            long last = post * (chunk + 1) / n_chunks;
+            for ( long b = first; b < last; ++b ) {
+                for ( int l = 0; l < nj; ++l ) {
+                    const double* ul = &u[pre * (l + nj * b)];
+                    double* Ql = &Q[t][static_cast<long>(l) * nj];
+                    for ( int k = 0; k < nj; ++k ) {
+                        const double* mk = &Mtal[pre * (k + nj * b)];
+                        double total = 0.0;
+                        for ( long a = 0; a < pre; ++a ) {
+                            total += mk[a] * ul[a];
+                        }
+                        Ql[k] += total;
+                    }
+                }
+            }
+        });
+        std::vector<double> G(nn, 0.0);
+        const std::vector<double>& Vj = state.V[j];
+        for ( int l = 0; l < nj; ++l ) {
+            for ( int k = 0; k < nj; ++k ) {
+                double total = 0.0;
+                for ( int i = 0; i < nj; ++i ) {
+                    total += Vj[static_cast<long>(i) * nj + k] * c[i]
+                           * Vj[static_cast<long>(i) * nj + l];
+                }
+                for ( int t = 0; t < n_threads; ++t ) {
+                    total -= Q[t][static_cast<long>(l) * nj + k];
+                }
+                G[static_cast<long>(l) * nj + k] = total / 2.0;
+            }
+        }
+        native_cov_cross_gradient(axes[j].cov, hyp_axis[j], axes[j].x, nj,
+                                  axes[j].x, nj, &G[0], grad, 0);
+        grad += axes[j].cov.n_hyp();
+        pre *= nj;
+    }
+    // dnlZ.lik = sn2 * (sum(s) - alpha' * alpha)
+    double sum_s = 0.0;
+    double alpha2 = 0.0;
+    for ( long i = 0; i < n; ++i ) {
+        sum_s += s[i];
+        alpha2 += state.alpha[i] * state.alpha[i];
+    }
+    grad[0] = sn2 * (sum_s - alpha2);
+    return true;
+}
+
+bool native_grid_predict(const std::vector<grid_axis>& axes,
+                         native_mean_type mean, const double* hyp,
+                         const grid_state& state, const double* xs, int ns,
+                         const grid_options& options, double* fmu,
+                         double* fs2) {
+    int p = static_cast<int>(axes.size());
+    int n_threads = resolve_threads(options.n_threads);
+    // Each axis' cross covariances with its columns of xs, and kss, the
+    // product of the axes' signal variances
+    std::vector< std::vector<double> > ks(p);
+    std::vector<int> sizes(p);
+    const double* h = hyp + (mean == MEAN_CONST ? 1 : 0);
+    const double* xs_j = xs;
+    double kss = 1.0;
+    for ( int j = 0; j < p; ++j ) {
+        const native_cov& cov = axes[j].cov;
+        sizes[j] = axes[j].n;
+        ks[j].resize(static_cast<long>(axes[j].n) * ns);
+        native_cov_cross(cov, h, axes[j].x, axes[j].n, xs_j, ns, &ks[j][0]);
+        kss *= std::exp(2.0 * h[cov.ard ? cov.dim : 1]);
+        h += cov.n_hyp();
+        xs_j += static_cast<long>(ns) * cov.dim;
+    }
+    long N = state.N;
+    long n = static_cast<long>(state.observed.size());
+    std::vector<double> Mtal(N, 0.0);
+    for ( long i = 0; i < n; ++i ) {
+        Mtal[state.observed[i]] = state.alpha[i];
+    }
+    bool complete = n == N;
+    std::vector<char> failed(ns, 0);
+    parallel_for(ns, n_threads, [&](int c, int) {
+        std::vector<const double*> v(p);
+        std::vector<kron_factor> rows;
+        for ( int j = 0; j < p; ++j ) {
+            v[j] = &ks[j][static_cast<long>(c) * axes[j].n];
+            kron_factor F = { v[j], 1, axes[j].n, false };
+            rows.push_back(F);
+        }
+        double f = 0.0;
+        kron_mvm(rows, &Mtal[0], 1, &f, 1);
+        fmu[c] = state.mean + f;
+        double explained = 0.0;
+        if ( complete ) {
+            // ks' V diag(s) V' ks, with V' ks = kron(V_p' ks_p, ..)
+            std::vector< std::vector<double> > w(p);
+            for ( int j = 0; j < p; ++j ) {
+                int nj = axes[j].n;
+                w[j].resize(nj);
+                for ( int i = 0; i < nj; ++i ) {
+                    const double* vi = &state.V[j][static_cast<long>(i) * nj];
+                    double total = 0.0;
+                    for ( int k = 0; k < nj; ++k ) {
+                        total += vi[k] * v[j][k];
+                    }
+                    w[j][i] = total * total;
+                }
+                rows[j].A = &w[j][0];
+            }
+            kron_mvm(rows, &state.s[0], 1, &explained, 1);
+        } else {
+            std::vector<double> k_full = kron_vector(v, sizes);
+            std::vector<double> b(n), solution(n);
+            for ( long i = 0; i < n; ++i ) {
+                b[i] = k_full[state.observed[i]];
+            }
+            int iterations = conjugate_gradients(
+                [&](const double* a, double* q) {
+                    observed_mvm(state, a, q, 1);
+                },
+                &b[0], n, options.cg_tol, options.cg_maxit, &solution[0]
+            );
+            if ( iterations < 0 ) {
+                failed[c] = 1;
+            }
+            for ( long i = 0; i < n; ++i ) {
+                explained += b[i] * solution[i];
+            }
+        }
+        fs2[c] = std::max(kss - explained, 0.0);
+    });
+    for ( int c = 0; c < ns; ++c ) {
+        if ( failed[c] ) {
+            return false;
+        }
+    }
+    return true;
+}
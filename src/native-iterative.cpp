@@ -0,0 +1,541 @@
+#include "native.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+// Exact GP inference without ever storing K: K is applied to blocks of
+// vectors one tile at a time, systems are solved by preconditioned conjugate
+// gradients run on the mean's system and the probe vectors together, and
+// log det(K + sn2 I) and the traces in its derivatives are estimated from
+// those same runs (stochastic Lanczos quadrature and Hutchinson's
+// estimator, as in Gardner et al., 2018, "GPyTorch").
+
+static const int TILE = 128;
+static const double LOG_2PI = 1.8378770664093454836;
+
+namespace {
+
+// The training inputs split into tiles of TILE rows, each stored
+// column-major on its own so kernel tiles can be computed directly
+struct tiled_inputs {
+    int n;
+    int dim;
+    std::vector< std::vector<double> > blocks;
+    std::vector<int> first;
+    std::vector<int> size;
+    tiled_inputs(const double* x, int n, int dim) : n(n), dim(dim) {
+        for ( int start = 0; start < n; start += TILE ) {
+            int b = std::min(TILE, n - start);
+            std::vector<double> block(static_cast<long>(b) * dim);
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int i = 0; i < b; ++i ) {
+                    block[static_cast<long>(d) * b + i]
+                        = x[static_cast<long>(d) * n + start + i];
+                }
+            }
+            blocks.push_back(block);
+            first.push_back(start);
+            size.push_back(b);
+        }
+    }
+    int count() const { return static_cast<int>(blocks.size()); }
+};
+
+// out = (K + sn2 I) V for the n x nrhs matrix V; each thread computes whole
+// row tiles of out, so there is nothing to reduce
+void apply_kernel(const native_cov& cov, const double* hyp, double sn2,
+                  const tiled_inputs& x, const double* V, int nrhs,
+                  double* out, int n_threads) {
+    int n = x.n;
+    parallel_for(x.count(), n_threads, [&](int I, int) {
+        std::vector<double> tile(static_cast<long>(TILE) * TILE);
+        int bI = x.size[I];
+        int fI = x.first[I];
+        for ( int c = 0; c < nrhs; ++c ) {
+            const double* v = V + static_cast<long>(c) * n + fI;
+            double* o = out + static_cast<long>(c) * n + fI;
+            for ( int i = 0; i < bI; ++i ) {
+                o[i] = sn2 * v[i];
+            }
+        }
+        for ( int J = 0; J < x.count(); ++J ) {
+            int bJ = x.size[J];
+            int fJ = x.first[J];
+            native_cov_cross(cov, hyp, &x.blocks[I][0], bI, &x.blocks[J][0],
+                             bJ, &tile[0]);
+            for ( int c = 0; c < nrhs; ++c ) {
+                const double* v = V + static_cast<long>(c) * n + fJ;
+                double* o = out + static_cast<long>(c) * n + fI;
+                for ( int j = 0; j < bJ; ++j ) {
+                    const double* t = &tile[static_cast<long>(j) * bI];
+                    double vj = v[j];
+                    for ( int i = 0; i < bI; ++i ) {
+                        o[i] += t[i] * vj;
+                    }
+                }
+            }
+        }
+    });
+}
+
+// The preconditioner P = L L' + sn2 I, with L (n x rank) from a pivoted
+// partial Cholesky factorization of K, applied through Woodbury's identity
+struct preconditioner {
+    int n;
+    int rank;
+    double sn2;
+    std::vector<double> L;
+    std::vector<double> C;  // chol(sn2 I + L' L)
+    double logdet;          // log det(P)
+    double missed;          // tr(K - L L'), what the factorization misses
+};
+
+void build_preconditioner(const native_cov& cov, const double* hyp,
+                          double sn2, const double* x, int n, int max_rank,
+                          preconditioner& P) {
+    int dim = cov.dim;
+    P.n = n;
+    P.sn2 = sn2;
+    max_rank = std::min(max_rank, n);
+    std::vector<double> residual(n);
+    std::vector<double> xp(dim);
+    native_cov_cross(cov, hyp, x, 1, x, 1, &residual[0]);
+    std::fill(residual.begin(), residual.end(), residual[0]);
+    double tiny = 1e-10 * residual[0];
+    P.L.assign(static_cast<long>(n) * max_rank, 0.0);
+    std::vector<double> column(n);
+    int rank = 0;
+    for ( ; rank < max_rank; ++rank ) {
+        int p = static_cast<int>(std::max_element(residual.begin(),
+                                                  residual.end())
+                                 - residual.begin());
+        double pivot = residual[p];
+        if ( !(pivot > tiny) ) {
+            break;
+        }
+        for ( int d = 0; d < dim; ++d ) {
+            xp[d] = x[static_cast<long>(d) * n + p];
+        }
+        native_cov_cross(cov, hyp, x, n, &xp[0], 1, &column[0]);
+        double* Lk = &P.L[static_cast<long>(rank) * n];
+        double scale = 1.0 / std::sqrt(pivot);
+        for ( int i = 0; i < n; ++i ) {
+            double v = column[i];
+            for ( int j = 0; j < rank; ++j ) {
+                const double* Lj = &P.L[static_cast<long>(j) * n];
+                v -= Lj[i] * Lj[p];
+            }
+            Lk[i] = v * scale;
+            residual[i] -= Lk[i] * Lk[i];
+        }
+        residual[p] = 0.0;
+    }
+    P.rank = rank;
+    P.missed = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        P.missed += residual[i];
+    }
+    P.L.resize(static_cast<long>(n) * rank);
+    P.C.assign(static_cast<long>(rank) * rank, 0.0);
+    for ( int j = 0; j < rank; ++j ) {
+        for ( int i = 0; i <= j; ++i ) {
+            const double* Li = &P.L[static_cast<long>(i) * n];
+            const double* Lj = &P.L[static_cast<long>(j) * n];
+            double total = 0.0;
+            for ( int k = 0; k < n; ++k ) {
+                total += Li[k] * Lj[k];
+            }
+            P.C[static_cast<long>(j) * rank + i] = total;
+        }
+        P.C[static_cast<long>(j) * rank + j] += sn2;
+    }
+    chol_upper(&P.C[0], rank);
+    // log det(P) = log det(sn2 I + L' L) + (n - rank) log(sn2)
+    P.logdet = (n - rank) * std::log(sn2);
+    for ( int i = 0; i < rank; ++i ) {
+        P.logdet += 2.0 * std::log(P.C[static_cast<long>(i) * rank + i]);
+    }
+}
+
+// out = inv(P) v = (v - L inv(sn2 I + L' L) L' v) / sn2
+void apply_preconditioner(const preconditioner& P, const double* v,
+                          double* out) {
+    int n = P.n;
+    std::vector<double> t(P.rank);
+    for ( int k = 0; k < P.rank; ++k ) {
+        const double* Lk = &P.L[static_cast<long>(k) * n];
+        double total = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            total += Lk[i] * v[i];
+        }
+        t[k] = total;
+    }
+    if ( P.rank > 0 ) {
+        solve_chol(&P.C[0], P.rank, &t[0]);
+    }
+    for ( int i = 0; i < n; ++i ) {
+        out[i] = v[i];
+    }
+    for ( int k = 0; k < P.rank; ++k ) {
+        const double* Lk = &P.L[static_cast<long>(k) * n];
+        for ( int i = 0; i < n; ++i ) {
+            out[i] -= Lk[i] * t[k];
+        }
+    }
+    for ( int i = 0; i < n; ++i ) {
+        out[i] /= P.sn2;
+    }
+}
+
+// Preconditioned conjugate gradients on the nrhs columns of B at once (one
+// kernel pass per iteration serves all of them), writing the solutions to X.
+// If lanczos is not null, lanczos[c] gets e1' log(T) e1 * |b_c|^2_inv(P)
+// for the Lanczos tridiagonal matrix T that column c's run implies.
+// Returns false if a column in [0, n_required) did not converge.
+bool block_pcg(const native_cov& cov, const double* hyp, double sn2,
+               const tiled_inputs& x, const preconditioner& P,
+               const double* B, int nrhs, int n_required,
+               const iterative_options& options, double* X,
+               double* lanczos, int* iterations) {
+    int n = x.n;
+    long size = static_cast<long>(n) * nrhs;
+    std::vector<double> R(B, B + size), Z(size), D(size), Q(size);
+    std::fill(X, X + size, 0.0);
+    std::vector<double> rz(nrhs), b_norm(nrhs), start(nrhs);
+    std::vector<char> active(nrhs, 1);
+    std::vector< std::vector<double> > steps(nrhs), betas(nrhs);
+    for ( int c = 0; c < nrhs; ++c ) {
+        const double* r = &R[static_cast<long>(c) * n];
+        double* z = &Z[static_cast<long>(c) * n];
+        apply_preconditioner(P, r, z);
+        double total = 0.0;
+        double norm = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            total += r[i] * z[i];
+            norm += r[i] * r[i];
+        }
+        rz[c] = total;
+        start[c] = total;
+        b_norm[c] = std::sqrt(norm);
+        if ( b_norm[c] == 0.0 ) {
+            active[c] = 0;
+        }
+    }
+    D = Z;
+    int iteration = 0;
+    for ( ; iteration < options.max_iterations; ++iteration ) {
+        bool any = false;
+        for ( int c = 0; c < nrhs; ++c ) {
+            any = any || active[c];
+        }
+        if ( !any ) {
+            break;
+        }
+        apply_kernel(cov, hyp, sn2, x, &D[0], nrhs, &Q[0], options.n_threads);
+        parallel_for(nrhs, options.n_threads, [&](int c, int) {
+            if ( !active[c] ) {
+                return;
+            }
+            long offset = static_cast<long>(c) * n;
+            double* xc = X + offset;
+            double* r = &R[offset];
+            double* z = &Z[offset];
+            double* d = &D[offset];
+            const double* q = &Q[offset];
+            double dq = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                dq += d[i] * q[i];
+            }
+            double a = rz[c] / dq;
+            double norm = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                xc[i] += a * d[i];
+                r[i] -= a * q[i];
+                norm += r[i] * r[i];
+            }
+            apply_preconditioner(P, r, z);
+            double rz_new = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                rz_new += r[i] * z[i];
+            }
+            double beta = rz_new / rz[c];
+            steps[c].push_back(a);
+            betas[c].push_back(beta);
+            rz[c] = rz_new;
+            if ( std::sqrt(norm) < options.tolerance * b_norm[c] ) {
+                active[c] = 0;
+                return;
+            }
+            for ( int i = 0; i < n; ++i ) {
+                d[i] = z[i] + beta * d[i];
+            }
+        });
+    }
+    *iterations = iteration;
+    bool converged = true;
+    for ( int c = 0; c < n_required; ++c ) {
+        converged = converged && !active[c];
+    }
+    if ( !lanczos ) {
+        return converged;
+    }
+    // T(j, j) = 1 / a_j + beta_{j-1} / a_{j-1} and
+    // T(j - 1, j) = sqrt(beta_{j-1}) / a_{j-1}
+    for ( int c = 0; c < nrhs; ++c ) {
+        int k = static_cast<int>(steps[c].size());
+        if ( k == 0 ) {
+            lanczos[c] = 0.0;
+            continue;
+        }
+        const std::vector<double>& a = steps[c];
+        const std::vector<double>& beta = betas[c];
+        std::vector<double> T(static_cast<long>(k) * k, 0.0), values(k);
+        for ( int j = 0; j < k; ++j ) {
+            T[static_cast<long>(j) * k + j] = 1.0 / a[j];
+            if ( j > 0 ) {
+                T[static_cast<long>(j) * k + j] += beta[j - 1] / a[j - 1];
+                double off = std::sqrt(beta[j - 1]) / a[j - 1];
+                T[static_cast<long>(j) * k + j - 1] = off;
+                T[static_cast<long>(j - 1) * k + j] = off;
+            }
+        }
+        sym_eigen(&T[0], k, &values[0]);
+        double quadrature = 0.0;
+        for ( int j = 0; j < k; ++j ) {
+            double v = T[static_cast<long>(j) * k];
+            quadrature += v * v * std::log(std::max(values[j], 1e-300));
+        }
+        lanczos[c] = quadrature * start[c];
+    }
+    return converged;
+}
+
+}
+
+bool native_iterative(const native_model& model, const double* hyp,
+                      const double* x, const double* y, int n,
+                      bool derivatives, const iterative_options& options,
+                      iterative_result& result) {
+    const native_cov& cov = model.cov;
+    int n_mean = model.n_mean();
+    int n_cov = cov.n_hyp();
+    const double* hyp_cov = hyp + n_mean;
+    double mean = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    int n_threads = resolve_threads(options.n_threads);
+    tiled_inputs tiles(x, n, cov.dim);
+    preconditioner P;
+    build_preconditioner(cov, hyp_cov, sn2, x, n, options.rank, P);
+    // The right hand sides: y - m, then probes z ~ N(0, P), z = L e + sn e'
+    int t = options.probes;
+    int nrhs = 1 + t;
+    std::vector<double> B(static_cast<long>(n) * nrhs);
+    for ( int i = 0; i < n; ++i ) {
+        B[i] = y[i] - mean;
+    }
+    std::mt19937 rng(options.seed);
+    std::normal_distribution<double> normal;
+    double sn = std::sqrt(sn2);
+    std::vector<double> e(P.rank);
+    for ( int c = 1; c < nrhs; ++c ) {
+        double* z = &B[static_cast<long>(c) * n];
+        for ( int k = 0; k < P.rank; ++k ) {
+            e[k] = normal(rng);
+        }
+        for ( int i = 0; i < n; ++i ) {
+            double v = sn * normal(rng);
+            for ( int k = 0; k < P.rank; ++k ) {
+                v += P.L[static_cast<long>(k) * n + i] * e[k];
+            }
+            z[i] = v;
+        }
+    }
+    std::vector<double> X(static_cast<long>(n) * nrhs);
+    std::vector<double> lanczos(nrhs);
+    if ( !block_pcg(cov, hyp_cov, sn2, tiles, P, &B[0], nrhs, 1, options,
+                    &X[0], &lanczos[0], &result.iterations) ) {
+        return false;
+    }
+    result.alpha.assign(X.begin(), X.begin() + n);
+    // log det(K + sn2 I) = log det(P) + log det(inv(P) (K + sn2 I))
+    double fit = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        fit += B[i] * result.alpha[i];
+    }
+    double logdet = P.logdet;
+    for ( int c = 1; c < nrhs; ++c ) {
+        logdet += lanczos[c] / t;
+    }
+    result.nlz = 0.5 * fit + 0.5 * logdet + 0.5 * n * LOG_2PI;
+    if ( !derivatives ) {
+        return true;
+    }
+    // The derivatives are sum(sum(dK .* G)) with
+    // G = (inv(K + sn2 I) - alpha alpha') / 2, taken one tile of G (and dK)
+    // at a time. As E[z_i z_i'] = P, inv(K + sn2 I) ~ mean of u_i w_i', with
+    // u_i the solutions for the probes z_i and w_i = inv(P) z_i. When the
+    // preconditioner misses less of K than the noise adds, inv(P) is close
+    // to inv(K + sn2 I), and it is used as is, with only the difference
+    // estimated (as the mean of (u_i - w_i) w_i'), which is far less noisy.
+    bool control = P.missed < n * sn2;
+    std::vector<double> W(static_cast<long>(n) * t);
+    double* U = &X[n];
+    for ( int c = 0; c < t; ++c ) {
+        double* w = &W[static_cast<long>(c) * n];
+        double* u = U + static_cast<long>(c) * n;
+        apply_preconditioner(P, &B[static_cast<long>(c + 1) * n], w);
+        for ( int i = 0; control && i < n; ++i ) {
+            u[i] -= w[i];
+        }
+    }
+    // inv(P) = (I - M L') / sn2 with M = L inv(sn2 I + L' L)
+    int rank = control ? P.rank : 0;
+    std::vector<double> M(static_cast<long>(n) * rank, 0.0);
+    double trace = control ? n : 0.0;
+    if ( rank > 0 ) {
+        std::vector<double> C_inv(static_cast<long>(rank) * rank);
+        chol_inverse(&P.C[0], rank, &C_inv[0]);
+        for ( int k = 0; k < rank; ++k ) {
+            double* Mk = &M[static_cast<long>(k) * n];
+            for ( int j = 0; j < rank; ++j ) {
+                const double* Lj = &P.L[static_cast<long>(j) * n];
+                double c = C_inv[static_cast<long>(k) * rank + j];
+                for ( int i = 0; i < n; ++i ) {
+                    Mk[i] += Lj[i] * c;
+                }
+            }
+            const double* Lk = &P.L[static_cast<long>(k) * n];
+            for ( int i = 0; i < n; ++i ) {
+                trace -= Mk[i] * Lk[i];
+            }
+        }
+    }
+    trace /= sn2;
+    const double* alpha = &result.alpha[0];
+    std::vector< std::vector<double> > grad(n_threads,
+                                            std::vector<double>(n_cov, 0.0));
+    parallel_for(tiles.count(), n_threads, [&](int I, int thread) {
+        std::vector<double> G(static_cast<long>(TILE) * TILE);
+        int bI = tiles.size[I];
+        int fI = tiles.first[I];
+        for ( int J = 0; J < tiles.count(); ++J ) {
+            int bJ = tiles.size[J];
+            int fJ = tiles.first[J];
+            for ( int j = 0; j < bJ; ++j ) {
+                double* g = &G[static_cast<long>(j) * bI];
+                for ( int i = 0; i < bI; ++i ) {
+                    g[i] = -alpha[fI + i] * alpha[fJ + j];
+                }
+                for ( int k = 0; k < rank; ++k ) {
+                    const double* m = &M[static_cast<long>(k) * n + fI];
+                    double l = P.L[static_cast<long>(k) * n + fJ + j] / sn2;
+                    for ( int i = 0; i < bI; ++i ) {
+                        g[i] -= m[i] * l;
+                    }
+                }
+                if ( control && fI <= fJ + j && fJ + j < fI + bI ) {
+                    g[fJ + j - fI] += 1.0 / sn2;
+                }
+                for ( int c = 0; c < t; ++c ) {
+                    const double* u = U + static_cast<long>(c) * n + fI;
+                    double w = W[static_cast<long>(c) * n + fJ + j] / t;
+                    for ( int i = 0; i < bI; ++i ) {
+                        g[i] += u[i] * w;
+                    }
+                }
+                for ( int i = 0; i < bI; ++i ) {
+                    g[i] /= 2.0;
+                }
+            }
+            native_cov_cross_gradient(cov, hyp_cov, &tiles.blocks[I][0], bI,
+                                      &tiles.blocks[J][0], bJ, &G[0],
+                                      &grad[thread][0], 0);
+        }
+    });
+    result.dnlz.assign(model.n_hyp(), 0.0);
+    double alpha_sum = 0.0;
+    double alpha2 = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        alpha_sum += alpha[i];
+        alpha2 += alpha[i] * alpha[i];
+    }
+    if ( model.mean == MEAN_CONST ) {
+        result.dnlz[0] = -alpha_sum;
+    }
+    for ( int k = 0; k < n_cov; ++k ) {
+        for ( int thread = 0; thread < n_threads; ++thread ) {
+            result.dnlz[n_mean + k] += grad[thread][k];
+        }
+    }
+    // d/dlog(sn) = sn2 * (tr(inv(K + sn2 I)) - alpha' alpha)
+    for ( int c = 0; c < t; ++c ) {
+        const double* u = U + static_cast<long>(c) * n;
+        const double* w = &W[static_cast<long>(c) * n];
+        for ( int i = 0; i < n; ++i ) {
+            trace += u[i] * w[i] / t;
+        }
+    }
+    result.dnlz[n_mean + n_cov] = sn2 * (trace - alpha2);
+    return true;
+}
+
+bool native_iterative_predict(const native_model& model, const double* hyp,
+                              const double* x, int n, const double* alpha,
+                              const double* xs, int ns,
+                              const iterative_options& options, double* fmu,
+                              double* fs2) {
+    const native_cov& cov = model.cov;
+    int dim = cov.dim;
+    int n_mean = model.n_mean();
+    const double* hyp_cov = hyp + n_mean;
+    double mean = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + cov.n_hyp()]);
+    double kss = std::exp(2.0 * hyp_cov[cov.ard ? dim : 1]);
+    tiled_inputs tiles(x, n, dim);
+    preconditioner P;
+    build_preconditioner(cov, hyp_cov, sn2, x, n, options.rank, P);
+    // Test points go through in batches that share each kernel pass
+    const int batch = 64;
+    std::vector<double> Ks(static_cast<long>(n) * batch);
+    std::vector<double> S(static_cast<long>(n) * batch);
+    std::vector<double> xb(static_cast<long>(batch) * dim);
+    for ( int start = 0; start < ns; start += batch ) {
+        int b = std::min(batch, ns - start);
+        for ( int d = 0; d < dim; ++d ) {
+            for ( int i = 0; i < b; ++i ) {
+                xb[static_cast<long>(d) * b + i]
+                    = xs[static_cast<long>(d) * ns + start + i];
+            }
+        }
+        parallel_for(tiles.count(), options.n_threads, [&](int I, int) {
+            int bI = tiles.size[I];
+            int fI = tiles.first[I];
+            std::vector<double> tile(static_cast<long>(bI) * b);
+            native_cov_cross(cov, hyp_cov, &tiles.blocks[I][0], bI, &xb[0],
+                             b, &tile[0]);
+            for ( int c = 0; c < b; ++c ) {
+                std::copy(&tile[static_cast<long>(c) * bI],
+                          &tile[static_cast<long>(c) * bI] + bI,
+                          &Ks[static_cast<long>(c) * n + fI]);
+            }
+        });
+        int iterations = 0;
+        if ( !block_pcg(cov, hyp_cov, sn2, tiles, P, &Ks[0], b, b, options,
+                        &S[0], 0, &iterations) ) {
+            return false;
+        }
+        for ( int c = 0; c < b; ++c ) {
+            const double* k = &Ks[static_cast<long>(c) * n];
+            const double* s = &S[static_cast<long>(c) * n];
+            double mu = 0.0;
+            double explained = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                mu += k[i] * alpha[i];
+                explained += k[i] * s[i];
+            }
+            fmu[start + c] = mean + mu;
+            fs2[start + c] = std::max(kss - explained, 0.0);
+        }
+    }
+    return true;
+}
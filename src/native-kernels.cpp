@@ -0,0 +1,362 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+int native_cov::n_hyp() const {
+    int result = ard ? dim + 1 : 2;
+    if ( type == COV_RQ ) {
+        result += 1;
+    }
+    return result;
+}
+
+// g(r2) for each covariance type, following the parameterizations in
+// covSEiso.m, covMaterniso.m, covRQiso.m, and covPPiso.m (and their ARD
+// versions)
+double cov_profile(const native_cov& cov, double alpha, double r2,
+                   double* dr2, double* dalpha) {
+    double g = 0.0;
+    switch ( cov.type ) {
+        case COV_SE : {
+            g = std::exp(-0.5 * r2);
+            if ( dr2 ) {
+                *dr2 = -0.5 * g;
+            }
+            break;
+        }
+        case COV_MATERN : {
+            double t = std::sqrt(cov.degree * r2);
+            double e = std::exp(-t);
+            // f(t) * exp(-t), and d/dr2 of that, for nu = d/2
+            double d_g = 0.0;
+            if ( cov.degree == 1 ) {
+                g = e;
+                // Any ARD derivative multiplies this by s <= r2 = 0 at t = 0
+                d_g = t > 0.0 ? -0.5 * e / t : 0.0;
+            }
+            else if ( cov.degree == 3 ) {
+                g = (1.0 + t) * e;
+                d_g = -1.5 * e;
+            }
+            else {
+                g = (1.0 + t * (1.0 + t / 3.0)) * e;
+                d_g = -5.0 * (1.0 + t) * e / 6.0;
+            }
+            if ( dr2 ) {
+                *dr2 = d_g;
+            }
+            break;
+        }
+        case COV_RQ : {
+            double base = 1.0 + 0.5 * r2 / alpha;
+            g = std::pow(base, -alpha);
+            if ( dr2 ) {
+                *dr2 = -0.5 * g / base;
+            }
+            if ( dalpha ) {
+                *dalpha = g * (0.5 * r2 / base - alpha * std::log(base));
+            }
+            break;
+        }
+        case COV_PP : {
+            // (1 - r)^(j + v) f(r), with j = floor(D / 2) + v + 1
+            double r = std::sqrt(r2);
+            double d_g = 0.0;
+            if ( r < 1.0 ) {
+                double j = cov.dim / 2 + cov.degree + 1;
+                double e = j + cov.degree;
+                double f = 1.0;
+                double df = 0.0;
+                if ( cov.degree == 1 ) {
+                    f = 1.0 + (j + 1.0) * r;
+                    df = j + 1.0;
+                }
+                else if ( cov.degree == 2 ) {
+                    double c2 = (j * j + 4.0 * j + 3.0) / 3.0;
+                    f = 1.0 + r * ((j + 2.0) + r * c2);
+                    df = (j + 2.0) + 2.0 * c2 * r;
+                }
+                else if ( cov.degree == 3 ) {
+                    double c2 = (6.0 * j * j + 36.0 * j + 45.0) / 15.0;
+                    double c3 = (j * j * j + 9.0 * j * j + 23.0 * j + 15.0)
+                        / 15.0;
+                    f = 1.0 + r * ((j + 3.0) + r * (c2 + r * c3));
+                    df = (j + 3.0) + r * (2.0 * c2 + 3.0 * c3 * r);
+                }
+                double t = 1.0 - r;
+                double te = std::pow(t, e - 1.0);
+                g = te * t * f;
+                // dg/dr = t^(e - 1) (t f' - e f); as for Matern 1/2, any
+                // ARD derivative multiplies this by s <= r2 = 0 at r = 0
+                d_g = r > 0.0 ? 0.5 * te * (t * df - e * f) / r : 0.0;
+            }
+            if ( dr2 ) {
+                *dr2 = d_g;
+            }
+            break;
+        }
+    }
+    return g;
+}
+
+void build_distance_cache(const native_cov& cov, const double* x, int n,
+                          double max_bytes, distance_cache& cache) {
+    int dim = cov.dim;
+    long n_pairs = static_cast<long>(n) * (n - 1) / 2;
+    bool per_dim = cov.ard && n_pairs * dim * sizeof(double) <= max_bytes;
+    cache.n = n;
+    cache.dim = dim;
+    cache.per_dim = per_dim;
+    cache.d2.clear();
+    if ( cov.ard && !per_dim ) {
+        return;
+    }
+    cache.d2.assign(per_dim ? n_pairs * dim : n_pairs, 0.0);
+    for ( int d = 0; d < dim; ++d ) {
+        const double* xd = x + static_cast<long>(d) * n;
+        double* out = &cache.d2[0] + (per_dim ? n_pairs * d : 0);
+        for ( int j = 1; j < n; ++j ) {
+            double* outj = out + pair_index(0, j);
+            for ( int i = 0; i < j; ++i ) {
+                double diff = xd[i] - xd[j];
+                outj[i] += diff * diff;
+            }
+        }
+    }
+}
+
+void native_cov_matrix(const native_cov& cov, const double* hyp,
+                       const distance_cache& cache, const double* x,
+                       double* K) {
+    int n = cache.n;
+    int dim = cache.dim;
+    int n_ell = cov.ard ? dim : 1;
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    double alpha = cov.type == COV_RQ ? std::exp(hyp[n_ell + 1]) : 0.0;
+    std::vector<double> inv_ell2(n_ell);
+    for ( int d = 0; d < n_ell; ++d ) {
+        inv_ell2[d] = std::exp(-2.0 * hyp[d]);
+    }
+    long n_pairs = static_cast<long>(n) * (n - 1) / 2;
+    for ( int j = 0; j < n; ++j ) {
+        double* Kj = K + static_cast<long>(j) * n;
+        for ( int i = 0; i < j; ++i ) {
+            double r2 = 0.0;
+            long p = pair_index(i, j);
+            if ( !cov.ard ) {
+                r2 = cache.d2[p] * inv_ell2[0];
+            }
+            else if ( cache.per_dim ) {
+                for ( int d = 0; d < dim; ++d ) {
+                    r2 += cache.d2[n_pairs * d + p] * inv_ell2[d];
+                }
+            }
+            else {
+                for ( int d = 0; d < dim; ++d ) {
+                    double diff = x[static_cast<long>(d) * n + i]
+                                - x[static_cast<long>(d) * n + j];
+                    r2 += diff * diff * inv_ell2[d];
+                }
+            }
+            double k = sf2 * cov_profile(cov, alpha, r2);
+            Kj[i] = k;
+            K[static_cast<long>(i) * n + j] = k;
+        }
+        Kj[j] = sf2;
+    }
+}
+
+// Each off-diagonal pair appears twice in sum(sum(Q .* dK)), so the halves
+// cancel; on the diagonal r2 = 0 and only log(sf) has a nonzero derivative.
+// The pairs are visited in GRADIENT_TILE x GRADIENT_TILE tiles of Q's upper
+// triangle, spread over the threads, each with its own gradient. For ARD,
+// the inputs are first copied point by point and divided by the length
+// scales, so each pair's terms for all dimensions are contiguous: with
+// s_d = ((x_id - x_jd) / ell_d)^2, dK_ij / dlog(ell_d) = -2 sf2 g'(r2) s_d.
+static const int GRADIENT_TILE = 128;
+
+void native_cov_gradient(const native_cov& cov, const double* hyp,
+                         const distance_cache& cache, const double* x,
+                         const double* Q, double* grad, int n_threads) {
+    int n = cache.n;
+    int dim = cache.dim;
+    int n_ell = cov.ard ? dim : 1;
+    int n_hyp = cov.n_hyp();
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    double alpha = cov.type == COV_RQ ? std::exp(hyp[n_ell + 1]) : 0.0;
+    std::vector<double> inv_ell(n_ell);
+    for ( int d = 0; d < n_ell; ++d ) {
+        inv_ell[d] = std::exp(-hyp[d]);
+    }
+    std::vector<double> scaled;
+    if ( cov.ard ) {
+        scaled.resize(static_cast<long>(n) * dim);
+        for ( int d = 0; d < dim; ++d ) {
+            for ( int i = 0; i < n; ++i ) {
+                scaled[static_cast<long>(i) * dim + d]
+                    = x[static_cast<long>(d) * n + i] * inv_ell[d];
+            }
+        }
+    }
+    // The tiles (I, J) with I <= J, numbered row by row
+    int n_tiles = (n + GRADIENT_TILE - 1) / GRADIENT_TILE;
+    std::vector<int> tile_row, tile_column;
+    for ( int J = 0; J < n_tiles; ++J ) {
+        for ( int I = 0; I <= J; ++I ) {
+            tile_row.push_back(I);
+            tile_column.push_back(J);
+        }
+    }
+    n_threads = resolve_threads(n_threads);
+    std::vector< std::vector<double> > partial(n_threads,
+                                               std::vector<double>(n_hyp,
+                                                                   0.0));
+    parallel_for(static_cast<int>(tile_row.size()), n_threads,
+                 [&](int t, int thread) {
+        std::vector<double> g(n_hyp, 0.0);
+        std::vector<double> s(dim);
+        int i0 = tile_row[t] * GRADIENT_TILE;
+        int j0 = tile_column[t] * GRADIENT_TILE;
+        int j1 = std::min(j0 + GRADIENT_TILE, n);
+        for ( int j = j0; j < j1; ++j ) {
+            const double* Qj = Q + static_cast<long>(j) * n;
+            int i1 = std::min(i0 + GRADIENT_TILE, j);
+            for ( int i = i0; i < i1; ++i ) {
+                double r2 = 0.0;
+                if ( !cov.ard ) {
+                    r2 = cache.d2[pair_index(i, j)] * inv_ell[0]
+                       * inv_ell[0];
+                }
+                else {
+                    const double* xi = &scaled[static_cast<long>(i) * dim];
+                    const double* xj = &scaled[static_cast<long>(j) * dim];
+                    for ( int d = 0; d < dim; ++d ) {
+                        double diff = xi[d] - xj[d];
+                        s[d] = diff * diff;
+                        r2 += s[d];
+                    }
+                }
+                double dr2 = 0.0;
+                double dalpha = 0.0;
+                double k = cov_profile(cov, alpha, r2, &dr2,
+                                       cov.type == COV_RQ ? &dalpha : 0);
+                double q = Qj[i] * sf2;
+                if ( cov.ard ) {
+                    double c = 2.0 * q * dr2;
+                    for ( int d = 0; d < dim; ++d ) {
+                        g[d] -= c * s[d];
+                    }
+                }
+                else {
+                    g[0] -= 2.0 * q * r2 * dr2;
+                }
+                g[n_ell] += 2.0 * q * k;
+                if ( cov.type == COV_RQ ) {
+                    g[n_ell + 1] += q * dalpha;
+                }
+            }
+            if ( i0 <= j && j < i0 + GRADIENT_TILE ) {
+                g[n_ell] += Qj[j] * sf2;
+            }
+        }
+        for ( int k = 0; k < n_hyp; ++k ) {
+            partial[thread][k] += g[k];
+        }
+    });
+    for ( int k = 0; k < n_hyp; ++k ) {
+        grad[k] = 0.0;
+        for ( int thread = 0; thread < n_threads; ++thread ) {
+            grad[k] += partial[thread][k];
+        }
+    }
+}
+
+void native_cov_cross(const native_cov& cov, const double* hyp,
+                      const double* x, int n, const double* xs, int ns,
+                      double* Ks) {
+    int dim = cov.dim;
+    int n_ell = cov.ard ? dim : 1;
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    double alpha = cov.type == COV_RQ ? std::exp(hyp[n_ell + 1]) : 0.0;
+    std::vector<double> inv_ell2(dim);
+    for ( int d = 0; d < dim; ++d ) {
+        inv_ell2[d] = std::exp(-2.0 * hyp[cov.ard ? d : 0]);
+    }
+    for ( int s = 0; s < ns; ++s ) {
+        double* Ks_s = Ks + static_cast<long>(s) * n;
+        for ( int i = 0; i < n; ++i ) {
+            Ks_s[i] = 0.0;
+        }
+        // Accumulate scaled squared distances one dimension at a time,
+        // which keeps the inner loop contiguous in x
+        for ( int d = 0; d < dim; ++d ) {
+            const double* xd = x + static_cast<long>(d) * n;
+            double xsd = xs[static_cast<long>(d) * ns + s];
+            double w = inv_ell2[d];
+            for ( int i = 0; i < n; ++i ) {
+                double diff = xd[i] - xsd;
+                Ks_s[i] += diff * diff * w;
+            }
+        }
+        for ( int i = 0; i < n; ++i ) {
+            Ks_s[i] = sf2 * cov_profile(cov, alpha, Ks_s[i]);
+        }
+    }
+}
+
+// d Ks(i, s) / d x(i, d) = sf2 * g'(r2) * 2 * (x(i, d) - xs(s, d)) / ell_d^2;
+// for the hyperparameters this follows native_cov_gradient()
+void native_cov_cross_gradient(const native_cov& cov, const double* hyp,
+                               const double* x, int n, const double* xs,
+                               int ns, const double* G, double* grad,
+                               double* dx) {
+    int dim = cov.dim;
+    int n_ell = cov.ard ? dim : 1;
+    double sf2 = std::exp(2.0 * hyp[n_ell]);
+    double alpha = cov.type == COV_RQ ? std::exp(hyp[n_ell + 1]) : 0.0;
+    std::vector<double> inv_ell2(dim);
+    for ( int d = 0; d < dim; ++d ) {
+        inv_ell2[d] = std::exp(-2.0 * hyp[cov.ard ? d : 0]);
+    }
+    std::vector<double> s(dim);
+    for ( int c = 0; c < ns; ++c ) {
+        const double* Gc = G + static_cast<long>(c) * n;
+        for ( int i = 0; i < n; ++i ) {
+            double q = Gc[i] * sf2;
+            if ( q == 0.0 ) {
+                continue;
+            }
+            double r2 = 0.0;
+            for ( int d = 0; d < dim; ++d ) {
+                double diff = x[static_cast<long>(d) * n + i]
+                            - xs[static_cast<long>(d) * ns + c];
+                s[d] = diff * diff * inv_ell2[d];
+                r2 += s[d];
+            }
+            double dr2 = 0.0;
+            double dalpha = 0.0;
+            double g = cov_profile(cov, alpha, r2, &dr2,
+                                   cov.type == COV_RQ ? &dalpha : 0);
+            if ( cov.ard ) {
+                for ( int d = 0; d < dim; ++d ) {
+                    grad[d] -= 2.0 * q * s[d] * dr2;
+                }
+            }
+            else {
+                grad[0] -= 2.0 * q * r2 * dr2;
+            }
+            grad[n_ell] += 2.0 * q * g;
+            if ( cov.type == COV_RQ ) {
+                grad[n_ell + 1] += q * dalpha;
+            }
+            if ( dx ) {
+                for ( int d = 0; d < dim; ++d ) {
+                    double diff = x[static_cast<long>(d) * n + i]
+                                - xs[static_cast<long>(d) * ns + c];
+                    dx[static_cast<long>(d) * n + i] += 2.0 * q * dr2 * diff
+                                                      * inv_ell2[d];
+                }
+            }
+        }
+    }
+}
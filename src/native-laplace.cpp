@@ -0,0 +1,452 @@
+#include "native.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// A port of GPML's infLaplace(), its IRLS Newton iterations, brentmin(), and
+// the 'infLaplace' modes of likErf() (via logphi()) and likLogistic().
+// Because both likelihoods are log-concave, W = -d2lp is never negative, so
+// only infLaplace()'s Cholesky parametrisation is needed.
+
+static const double PI = 3.141592653589793238462643;
+
+void native_logphi(double z, double* lp, double* dlp, double* d2lp,
+                   double* d3lp) {
+    static const double c[14] = {
+        0.00048204, -0.00142906, 0.0013200243174, 0.0009461589032,
+        -0.0045563339802, 0.00556964649138, 0.00125993961762116,
+        -0.01621575378835404, 0.02629651521057465, -0.001829764677455021,
+        2.0 * (1.0 - PI / 3.0), (4.0 - PI) / 3.0, 1.0, 1.0
+    };
+    static const double r[5] = {
+        1.2753666447299659525, 5.019049726784267463450,
+        6.1602098531096305441, 7.409740605964741794425,
+        2.9788656263939928886
+    };
+    static const double q[6] = {
+        2.260528520767326969592, 9.3960340162350541504,
+        12.048951927855129036034, 17.081440747466004316,
+        9.608965327192787870698, 3.3690752069827527677
+    };
+    double value;
+    double derivative;
+    if ( z < -11.3137 ) {
+        // Very small: a rational approximation of erfc
+        double num = 0.5641895835477550741;
+        for ( int i = 0; i < 5; ++i ) {
+            num = -z * num / std::sqrt(2.0) + r[i];
+        }
+        double den = 1.0;
+        for ( int i = 0; i < 6; ++i ) {
+            den = -z * den / std::sqrt(2.0) + q[i];
+        }
+        value = std::log(num / den / 2.0) - z * z / 2.0;
+        derivative = std::fabs(den / num) * std::sqrt(2.0 / PI);
+    }
+    else {
+        if ( z * z < 0.0492 ) {
+            // Close to zero: a series expansion
+            double lp0 = -z / std::sqrt(2.0 * PI);
+            double f = 0.0;
+            for ( int i = 0; i < 14; ++i ) {
+                f = lp0 * (c[i] + f);
+            }
+            value = -2.0 * f - std::log(2.0);
+        }
+        else {
+            value = std::log(std::erfc(-z / std::sqrt(2.0)) / 2.0);
+        }
+        derivative = std::exp(-z * z / 2.0 - value) / std::sqrt(2.0 * PI);
+    }
+    *lp = value;
+    if ( dlp ) {
+        *dlp = derivative;
+    }
+    double second = -derivative * std::fabs(z + derivative);
+    if ( d2lp ) {
+        *d2lp = second;
+    }
+    if ( d3lp ) {
+        *d3lp = -second * std::fabs(z + 2.0 * derivative) - derivative;
+    }
+}
+
+void native_lik_laplace(native_lik_type lik, const double* y, const double* f,
+                        int n, double* lp, double* dlp, double* d2lp,
+                        double* d3lp) {
+    for ( int i = 0; i < n; ++i ) {
+        // GPML only allows +/- 1 labels
+        double yi = y[i] < 0.0 ? -1.0 : 1.0;
+        double d1, d2, d3;
+        if ( lik == LIK_ERF ) {
+            native_logphi(yi * f[i], lp + i, &d1, &d2, &d3);
+            d1 *= yi;
+            d3 *= yi;
+        }
+        else {
+            double s = -yi * f[i];
+            double ps = std::max(0.0, s);
+            lp[i] = -(ps + std::log(std::exp(-ps) + std::exp(s - ps)));
+            double t = std::min(0.0, f[i]);
+            double denominator = std::exp(t) + std::exp(t - f[i]);
+            double p = std::exp(t) / denominator;
+            d1 = (yi + 1.0) / 2.0 - p;
+            d2 = -std::exp(2.0 * t - f[i]) / (denominator * denominator);
+            d3 = 2.0 * d2 * (0.5 - p);
+        }
+        if ( dlp ) {
+            dlp[i] = d1;
+        }
+        if ( d2lp ) {
+            d2lp[i] = d2;
+        }
+        if ( d3lp ) {
+            d3lp[i] = d3;
+        }
+    }
+}
+
+namespace {
+
+// Psi(alpha) = alpha' * K * alpha / 2 - sum(lp(K * alpha + m)), which the
+// Newton iterations minimise, along with the quantities it needs on the way
+struct psi_point {
+    std::vector<double> alpha;
+    std::vector<double> f;
+    std::vector<double> lp;
+    std::vector<double> dlp;
+    std::vector<double> W;
+};
+
+struct psi_evaluator {
+    native_lik_type lik;
+    const double* K;
+    const double* m;
+    const double* y;
+    int n;
+    double operator()(psi_point& p) const {
+        p.f.resize(n);
+        p.lp.resize(n);
+        p.dlp.resize(n);
+        p.W.resize(n);
+        for ( int i = 0; i < n; ++i ) {
+            p.f[i] = m[i];
+        }
+        for ( int j = 0; j < n; ++j ) {
+            const double* Kj = K + static_cast<long>(j) * n;
+            double a = p.alpha[j];
+            for ( int i = 0; i < n; ++i ) {
+                p.f[i] += Kj[i] * a;
+            }
+        }
+        native_lik_laplace(lik, y, &p.f[0], n, &p.lp[0], &p.dlp[0], &p.W[0],
+                           0);
+        double psi = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            p.W[i] = -p.W[i];
+            psi += p.alpha[i] * (p.f[i] - m[i]) / 2.0 - p.lp[i];
+        }
+        return psi;
+    }
+};
+
+// GPML's brentmin() (Brent's method, from Numerical Recipes) minimising
+// Psi(alpha + s * dalpha) over s in [low, high]. As in brentmin(), current
+// is left holding the point evaluated *last*, which is what infLaplace()
+// continues from, and the minimal value found is returned.
+double brent_line_search(const psi_evaluator& psi, const psi_point& start,
+                         const std::vector<double>& dalpha, double low,
+                         double high, int max_evaluations, double tol,
+                         psi_point& current) {
+    int n = psi.n;
+    psi_point endpoint;
+    auto evaluate = [&](double s, psi_point& p) {
+        p.alpha.resize(n);
+        for ( int i = 0; i < n; ++i ) {
+            p.alpha[i] = start.alpha[i] + s * dalpha[i];
+        }
+        return psi(p);
+    };
+    tol = std::max(tol, std::numeric_limits<double>::epsilon());
+    double fa = evaluate(low, endpoint);
+    double fb = evaluate(high, endpoint);
+    int count = 2;
+    double seps = std::sqrt(std::numeric_limits<double>::epsilon());
+    double c = 0.5 * (3.0 - std::sqrt(5.0));
+    double a = low;
+    double b = high;
+    double v = a + c * (b - a);
+    double w = v;
+    double xf = v;
+    double d = 0.0;
+    double e = 0.0;
+    double x = xf;
+    double fx = evaluate(x, current);
+    count += 1;
+    double fv = fx;
+    double fw = fx;
+    double xm = 0.5 * (a + b);
+    double tol1 = seps * std::fabs(xf) + tol / 3.0;
+    double tol2 = 2.0 * tol1;
+    while ( std::fabs(xf - xm) > (tol2 - 0.5 * (b - a)) ) {
+        bool golden = true;
+        if ( std::fabs(e) > tol1 ) {
+            // Try a parabolic fit
+            golden = false;
+            double r = (xf - w) * (fx - fv);
+            double q = (xf - v) * (fx - fw);
+            double p = (xf - v) * q - (xf - w) * r;
+            q = 2.0 * (q - r);
+            if ( q > 0.0 ) {
+                p = -p;
+            }
+            q = std::fabs(q);
+            r = e;
+            e = d;
+            if ( std::fabs(p) < std::fabs(0.5 * q * r) && p > q * (a - xf)
+                 && p < q * (b - xf) ) {
+                d = p / q;
+                x = xf + d;
+                if ( (x - a) < tol2 || (b - x) < tol2 ) {
+                    double si = (xm - xf > 0) - (xm - xf < 0) + (xm == xf);
+                    d = tol1 * si;
+                }
+            }
+            else {
+                golden = true;
+            }
+        }
+        if ( golden ) {
+            e = xf >= xm ? a - xf : b - xf;
+            d = c * e;
+        }
+        double si = (d > 0) - (d < 0) + (d == 0);
+        x = xf + si * std::max(std::fabs(d), tol1);
+        double fu = evaluate(x, current);
+        count += 1;
+        if ( fu <= fx ) {
+            if ( x >= xf ) {
+                a = xf;
+            }
+            else {
+                b = xf;
+            }
+            v = w;
+            fv = fw;
+            w = xf;
+            fw = fx;
+            xf = x;
+            fx = fu;
+        }
+        else {
+            if ( x < xf ) {
+                a = x;
+            }
+            else {
+                b = x;
+            }
+            if ( fu <= fw || w == xf ) {
+                v = w;
+                fv = fw;
+                w = x;
+                fw = fu;
+            }
+            else if ( fu <= fv || v == xf || v == w ) {
+                v = x;
+                fv = fu;
+            }
+        }
+        xm = 0.5 * (a + b);
+        tol1 = seps * std::fabs(xf) + tol / 3.0;
+        tol2 = 2.0 * tol1;
+        if ( count >= max_evaluations ) {
+            break;
+        }
+    }
+    // The end points may beat the interior
+    if ( fa < fx && fa <= fb ) {
+        fx = fa;
+    }
+    else if ( fb < fx ) {
+        fx = fb;
+    }
+    return fx;
+}
+
+}
+
+bool native_laplace(native_lik_type lik, const double* K, const double* m,
+                    const double* y, int n, const laplace_options& options,
+                    const std::vector<double>& alpha, laplace_state& state) {
+    psi_evaluator psi = { lik, K, m, y, n };
+    // Start from the given alpha if it beats starting from the mean
+    psi_point current;
+    current.alpha.assign(n, 0.0);
+    bool usable = static_cast<int>(alpha.size()) == n;
+    for ( int i = 0; usable && i < n; ++i ) {
+        usable = !std::isnan(alpha[i]);
+    }
+    if ( usable ) {
+        psi_point previous;
+        previous.alpha = alpha;
+        double psi_mean = psi(current);
+        if ( !(psi(previous) > psi_mean) ) {
+            current = previous;
+        }
+    }
+    // Newton's method, one Cholesky factorization per step
+    std::vector<double> B(static_cast<long>(n) * n);
+    std::vector<double> sW(n), b(n), v(n), dalpha(n);
+    double psi_new = psi(current);
+    double psi_old = std::numeric_limits<double>::infinity();
+    int iteration = 0;
+    while ( psi_old - psi_new > options.tolerance
+            && iteration < options.max_iterations ) {
+        psi_old = psi_new;
+        ++iteration;
+        for ( int i = 0; i < n; ++i ) {
+            sW[i] = std::sqrt(std::max(current.W[i], options.w_min));
+        }
+        for ( int j = 0; j < n; ++j ) {
+            for ( int i = 0; i < n; ++i ) {
+                long k = static_cast<long>(j) * n + i;
+                B[k] = sW[i] * sW[j] * K[k] + (i == j ? 1.0 : 0.0);
+            }
+        }
+        if ( !chol_upper(&B[0], n) ) {
+            return false;
+        }
+        for ( int i = 0; i < n; ++i ) {
+            double W = sW[i] * sW[i];
+            b[i] = W * (current.f[i] - m[i]) + current.dlp[i];
+        }
+        // dalpha = b - sW .* solve_chol(L, sW .* (K * b)) - alpha
+        std::fill(v.begin(), v.end(), 0.0);
+        for ( int j = 0; j < n; ++j ) {
+            const double* Kj = K + static_cast<long>(j) * n;
+            for ( int i = 0; i < n; ++i ) {
+                v[i] += Kj[i] * b[j];
+            }
+        }
+        for ( int i = 0; i < n; ++i ) {
+            v[i] *= sW[i];
+        }
+        solve_chol(&B[0], n, &v[0]);
+        for ( int i = 0; i < n; ++i ) {
+            dalpha[i] = b[i] - sW[i] * v[i] - current.alpha[i];
+        }
+        psi_point start = current;
+        psi_new = brent_line_search(psi, start, dalpha, 0.0, 2.0, 10, 1e-4,
+                                    current);
+    }
+    // The posterior at the mode
+    state.n = n;
+    state.alpha = current.alpha;
+    state.f = current.f;
+    state.lp.resize(n);
+    state.dlp.resize(n);
+    state.d2lp.resize(n);
+    state.d3lp.resize(n);
+    native_lik_laplace(lik, y, &state.f[0], n, &state.lp[0], &state.dlp[0],
+                       &state.d2lp[0], &state.d3lp[0]);
+    state.sW.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        state.sW[i] = std::sqrt(std::fabs(state.d2lp[i]));
+    }
+    state.L.resize(static_cast<long>(n) * n);
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i < n; ++i ) {
+            long k = static_cast<long>(j) * n + i;
+            state.L[k] = state.sW[i] * state.sW[j] * K[k]
+                         + (i == j ? 1.0 : 0.0);
+        }
+    }
+    if ( !chol_upper(&state.L[0], n) ) {
+        return false;
+    }
+    state.nlz = 0.0;
+    for ( int i = 0; i < n; ++i ) {
+        state.nlz += state.alpha[i] * (state.f[i] - m[i]) / 2.0
+                     + std::log(state.L[static_cast<long>(i) * n + i])
+                     - state.lp[i];
+    }
+    return true;
+}
+
+void laplace_prepare_gradient(const double* K, laplace_state& state) {
+    int n = state.n;
+    const std::vector<double>& sW = state.sW;
+    // Z = sW .* inv(B) .* sW'
+    state.Z.resize(static_cast<long>(n) * n);
+    chol_inverse(&state.L[0], n, &state.Z[0]);
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i < n; ++i ) {
+            state.Z[static_cast<long>(j) * n + i] *= sW[i] * sW[j];
+        }
+    }
+    // g = diag(inv(inv(K) + W)) / 2 = (diag(K) - sum(C.^2)') / 2,
+    // where C = L' \ (sW .* K)
+    std::vector<double> C(static_cast<long>(n) * n);
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i < n; ++i ) {
+            long k = static_cast<long>(j) * n + i;
+            C[k] = sW[i] * K[k];
+        }
+    }
+    solve_upper_transposed(&state.L[0], n, &C[0], n);
+    std::vector<double> dfhat(n);
+    for ( int j = 0; j < n; ++j ) {
+        const double* Cj = &C[static_cast<long>(j) * n];
+        double s = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            s += Cj[i] * Cj[i];
+        }
+        double g = (K[static_cast<long>(j) * n + j] - s) / 2.0;
+        dfhat[j] = g * state.d3lp[j];
+    }
+    // The implicit parts are dfhat' * (b - K * (Z * b)) for various b, which
+    // is (dfhat - Z * (K * dfhat))' * b as K and Z are symmetric
+    std::vector<double> Kd(n, 0.0);
+    for ( int j = 0; j < n; ++j ) {
+        const double* Kj = K + static_cast<long>(j) * n;
+        for ( int i = 0; i < n; ++i ) {
+            Kd[i] += Kj[i] * dfhat[j];
+        }
+    }
+    state.implicit = dfhat;
+    for ( int j = 0; j < n; ++j ) {
+        const double* Zj = &state.Z[static_cast<long>(j) * n];
+        for ( int i = 0; i < n; ++i ) {
+            state.implicit[i] -= Zj[i] * Kd[j];
+        }
+    }
+}
+
+double laplace_cov_gradient(const laplace_state& state, const double* dK) {
+    int n = state.n;
+    double explicit_part = 0.0;
+    double implicit_part = 0.0;
+    for ( int j = 0; j < n; ++j ) {
+        const double* dKj = dK + static_cast<long>(j) * n;
+        const double* Zj = &state.Z[static_cast<long>(j) * n];
+        double dK_alpha = 0.0;
+        double dK_dlp = 0.0;
+        for ( int i = 0; i < n; ++i ) {
+            explicit_part += Zj[i] * dKj[i];
+            dK_alpha += dKj[i] * state.alpha[i];
+            dK_dlp += dKj[i] * state.dlp[i];
+        }
+        // Column j of dK is row j, so these are (dK * alpha)[j] etc.
+        explicit_part -= state.alpha[j] * dK_alpha;
+        implicit_part += state.implicit[j] * dK_dlp;
+    }
+    return explicit_part / 2.0 - implicit_part;
+}
+
+double laplace_mean_gradient(const laplace_state& state, const double* dm) {
+    double result = 0.0;
+    for ( int i = 0; i < state.n; ++i ) {
+        result -= (state.alpha[i] + state.implicit[i]) * dm[i];
+    }
+    return result;
+}
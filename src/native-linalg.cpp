@@ -0,0 +1,282 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+// Small dense routines for the native inference paths. Columns of an upper
+// triangular factor are contiguous in column-major storage, so everything
+// here is written in terms of column dot products and axpys.
+
+// This is the "up-looking" Cholesky: column j of R only needs columns 0..j-1
+bool chol_upper(double* A, int n) {
+    for ( int j = 0; j < n; ++j ) {
+        double* colj = A + static_cast<long>(j) * n;
+        for ( int i = 0; i < j; ++i ) {
+            const double* coli = A + static_cast<long>(i) * n;
+            double s = colj[i];
+            for ( int k = 0; k < i; ++k ) {
+                s -= coli[k] * colj[k];
+            }
+            colj[i] = s / coli[i];
+        }
+        double d = colj[j];
+        for ( int k = 0; k < j; ++k ) {
+            d -= colj[k] * colj[k];
+        }
+        if ( !(d > 0.0) ) {
+            return false;
+        }
+        colj[j] = std::sqrt(d);
+        for ( int i = j + 1; i < n; ++i ) {
+            colj[i] = 0.0;
+        }
+    }
+    return true;
+}
+
+void solve_upper(const double* R, int n, double* b, int nrhs) {
+    for ( int c = 0; c < nrhs; ++c ) {
+        double* x = b + static_cast<long>(c) * n;
+        for ( int j = n - 1; j >= 0; --j ) {
+            const double* colj = R + static_cast<long>(j) * n;
+            x[j] /= colj[j];
+            double xj = x[j];
+            for ( int i = 0; i < j; ++i ) {
+                x[i] -= colj[i] * xj;
+            }
+        }
+    }
+}
+
+void solve_upper_transposed(const double* R, int n, double* b, int nrhs) {
+    for ( int c = 0; c < nrhs; ++c ) {
+        double* x = b + static_cast<long>(c) * n;
+        for ( int j = 0; j < n; ++j ) {
+            const double* colj = R + static_cast<long>(j) * n;
+            double s = x[j];
+            for ( int i = 0; i < j; ++i ) {
+                s -= colj[i] * x[i];
+            }
+            x[j] = s / colj[j];
+        }
+    }
+}
+
+void solve_chol(const double* R, int n, double* b, int nrhs) {
+    solve_upper_transposed(R, n, b, nrhs);
+    solve_upper(R, n, b, nrhs);
+}
+
+// inv(R'R) = inv(R) inv(R)'; we invert R in place of the result's upper
+// triangle, then form the product one column at a time
+void chol_inverse(const double* R, int n, double* result) {
+    std::vector<double> Rinv(static_cast<long>(n) * n, 0.0);
+    for ( int j = 0; j < n; ++j ) {
+        double* colj = &Rinv[static_cast<long>(j) * n];
+        colj[j] = 1.0;
+        // Back substitution for column j of inv(R), which is zero below j
+        for ( int k = j; k >= 0; --k ) {
+            const double* colk = R + static_cast<long>(k) * n;
+            colj[k] /= colk[k];
+            double v = colj[k];
+            for ( int i = 0; i < k; ++i ) {
+                colj[i] -= colk[i] * v;
+            }
+        }
+    }
+    // result(i, j) = sum_k Rinv(i, k) Rinv(j, k) over k >= max(i, j)
+    for ( int j = 0; j < n; ++j ) {
+        double* out = result + static_cast<long>(j) * n;
+        for ( int i = 0; i < n; ++i ) {
+            out[i] = 0.0;
+        }
+        for ( int k = j; k < n; ++k ) {
+            const double* colk = &Rinv[static_cast<long>(k) * n];
+            double v = colk[j];
+            for ( int i = 0; i <= k; ++i ) {
+                out[i] += colk[i] * v;
+            }
+        }
+    }
+}
+
+// Householder reduction to tridiagonal form followed by the implicit QL
+// method, after EISPACK's tred2 and tql2 (by way of JAMA). A(i, j) is
+// A[j * n + i], so the rotations below run down contiguous columns.
+void sym_eigen(double* A, int n, double* values) {
+    if ( n == 0 ) {
+        return;
+    }
+    double* d = values;
+    std::vector<double> e(n, 0.0);
+    auto V = [A, n](int i, int j) -> double& {
+        return A[static_cast<long>(j) * n + i];
+    };
+    for ( int j = 0; j < n; ++j ) {
+        d[j] = V(n - 1, j);
+    }
+    for ( int i = n - 1; i > 0; --i ) {
+        double scale = 0.0;
+        double h = 0.0;
+        for ( int k = 0; k < i; ++k ) {
+            scale += std::fabs(d[k]);
+        }
+        if ( scale == 0.0 ) {
+            e[i] = d[i - 1];
+            for ( int j = 0; j < i; ++j ) {
+                d[j] = V(i - 1, j);
+                V(i, j) = 0.0;
+                V(j, i) = 0.0;
+            }
+        } else {
+            for ( int k = 0; k < i; ++k ) {
+                d[k] /= scale;
+                h += d[k] * d[k];
+            }
+            double f = d[i - 1];
+            double g = std::sqrt(h);
+            if ( f > 0 ) {
+                g = -g;
+            }
+            e[i] = scale * g;
+            h -= f * g;
+            d[i - 1] = f - g;
+            for ( int j = 0; j < i; ++j ) {
+                e[j] = 0.0;
+            }
+            for ( int j = 0; j < i; ++j ) {
+                f = d[j];
+                V(j, i) = f;
+                g = e[j] + V(j, j) * f;
+                for ( int k = j + 1; k <= i - 1; ++k ) {
+                    g += V(k, j) * d[k];
+                    e[k] += V(k, j) * f;
+                }
+                e[j] = g;
+            }
+            f = 0.0;
+            for ( int j = 0; j < i; ++j ) {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            double hh = f / (h + h);
+            for ( int j = 0; j < i; ++j ) {
+                e[j] -= hh * d[j];
+            }
+            for ( int j = 0; j < i; ++j ) {
+                f = d[j];
+                g = e[j];
+                for ( int k = j; k <= i - 1; ++k ) {
+                    V(k, j) -= (f * e[k] + g * d[k]);
+                }
+                d[j] = V(i - 1, j);
+                V(i, j) = 0.0;
+            }
+        }
+        d[i] = h;
+    }
+    // Accumulate the transformations
+    for ( int i = 0; i < n - 1; ++i ) {
+        V(n - 1, i) = V(i, i);
+        V(i, i) = 1.0;
+        double h = d[i + 1];
+        if ( h != 0.0 ) {
+            for ( int k = 0; k <= i; ++k ) {
+                d[k] = V(k, i + 1) / h;
+            }
+            for ( int j = 0; j <= i; ++j ) {
+                double g = 0.0;
+                for ( int k = 0; k <= i; ++k ) {
+                    g += V(k, i + 1) * V(k, j);
+                }
+                for ( int k = 0; k <= i; ++k ) {
+                    V(k, j) -= g * d[k];
+                }
+            }
+        }
+        for ( int k = 0; k <= i; ++k ) {
+            V(k, i + 1) = 0.0;
+        }
+    }
+    for ( int j = 0; j < n; ++j ) {
+        d[j] = V(n - 1, j);
+        V(n - 1, j) = 0.0;
+    }
+    V(n - 1, n - 1) = 1.0;
+    e[0] = 0.0;
+    // The QL iterations on the tridiagonal matrix
+    for ( int i = 1; i < n; ++i ) {
+        e[i - 1] = e[i];
+    }
+    e[n - 1] = 0.0;
+    double f = 0.0;
+    double tst1 = 0.0;
+    const double eps = std::ldexp(1.0, -52);
+    for ( int l = 0; l < n; ++l ) {
+        tst1 = std::max(tst1, std::fabs(d[l]) + std::fabs(e[l]));
+        int m = l;
+        while ( m < n - 1 && std::fabs(e[m]) > eps * tst1 ) {
+            ++m;
+        }
+        if ( m > l ) {
+            do {
+                double g = d[l];
+                double p = (d[l + 1] - g) / (2.0 * e[l]);
+                double r = std::hypot(p, 1.0);
+                if ( p < 0 ) {
+                    r = -r;
+                }
+                d[l] = e[l] / (p + r);
+                d[l + 1] = e[l] * (p + r);
+                double dl1 = d[l + 1];
+                double h = g - d[l];
+                for ( int i = l + 2; i < n; ++i ) {
+                    d[i] -= h;
+                }
+                f += h;
+                p = d[m];
+                double c = 1.0;
+                double c2 = c;
+                double c3 = c;
+                double el1 = e[l + 1];
+                double s = 0.0;
+                double s2 = 0.0;
+                for ( int i = m - 1; i >= l; --i ) {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i + 1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i + 1] = h + s * (c * g + s * d[i]);
+                    for ( int k = 0; k < n; ++k ) {
+                        h = V(k, i + 1);
+                        V(k, i + 1) = s * V(k, i) + c * h;
+                        V(k, i) = c * V(k, i) - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            } while ( std::fabs(e[l]) > eps * tst1 );
+        }
+        d[l] += f;
+        e[l] = 0.0;
+    }
+    // Sort the eigenvalues (and vectors) into ascending order
+    for ( int i = 0; i < n - 1; ++i ) {
+        int k = i;
+        for ( int j = i + 1; j < n; ++j ) {
+            if ( d[j] < d[k] ) {
+                k = j;
+            }
+        }
+        if ( k != i ) {
+            std::swap(d[i], d[k]);
+            std::swap_ranges(&V(0, i), &V(0, i) + n, &V(0, k));
+        }
+    }
+}
@@ -0,0 +1,418 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+// A port of the prediction half of gp.m for the models native_predict()
+// supports, fused so the n x ns cross covariances Ks are never formed.
+// Test points are processed in blocks, and for each block the training
+// inputs in tiles: each tile's cross covariances are computed, added into
+// the means (Ks' * alpha), and taken straight into the tile's part of the
+// variance term, L' \ (sW .* Ks) or L * Ks, one block of L at a time. A
+// block of test points thus reads L once, and the only scratch memory that
+// grows with n is the solved (or, for symmetric L, raw) cross covariances of
+// the block, which PREDICT_SCRATCH bounds.
+
+// Training inputs per kernel tile
+static const int PREDICT_TILE = 256;
+// Test points per block at most, and scratch doubles per thread at most
+// (beyond a few tiles), which sets fewer test points per block for large n
+static const int PREDICT_BLOCK = 64;
+static const long PREDICT_SCRATCH = 1L << 22;
+
+namespace {
+
+struct predict_scratch {
+    std::vector<double> v;     // n x nb, row-major: v[i * nb + s]
+    std::vector<double> acc;   // PREDICT_TILE x nb, row-major
+    std::vector<double> tile;  // PREDICT_TILE x nb, column-major
+    std::vector<double> xt;    // PREDICT_TILE x dim
+    std::vector<double> xb;    // nb x dim
+    std::vector<double> mu, var;
+};
+
+// acc(j, :) += sum over i in [first, last) of L(i, j) * v(i, :), four rows
+// of v at a time so acc is loaded and stored a quarter as often
+inline void add_column(const double* Lj, const double* v, int first, int last,
+                       int nb, double* acc) {
+    int i = first;
+    for ( ; i + 4 <= last; i += 4 ) {
+        double l0 = Lj[i], l1 = Lj[i + 1], l2 = Lj[i + 2], l3 = Lj[i + 3];
+        const double* v0 = v + static_cast<long>(i) * nb;
+        const double* v1 = v0 + nb;
+        const double* v2 = v1 + nb;
+        const double* v3 = v2 + nb;
+        for ( int s = 0; s < nb; ++s ) {
+            acc[s] += l0 * v0[s] + l1 * v1[s] + l2 * v2[s] + l3 * v3[s];
+        }
+    }
+    for ( ; i < last; ++i ) {
+        double l = Lj[i];
+        const double* vi = v + static_cast<long>(i) * nb;
+        for ( int s = 0; s < nb; ++s ) {
+            acc[s] += l * vi[s];
+        }
+    }
+}
+
+}
+
+void native_predict(const native_model& model, const double* hyp,
+                    const double* x, const native_posterior& post,
+                    const double* xs, int ns, double* ymu, double* ys2,
+                    double* fmu, double* fs2, int n_threads) {
+    const native_cov& cov = model.cov;
+    int n = post.n;
+    int dim = cov.dim;
+    int n_mean = model.n_mean();
+    const double* hyp_cov = hyp + n_mean;
+    double m = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sf2 = std::exp(2.0 * hyp_cov[cov.ard ? dim : 1]);
+    double sn2 = 0.0;
+    if ( model.lik == LIK_GAUSS ) {
+        sn2 = std::exp(2.0 * hyp[n_mean + cov.n_hyp()]);
+    }
+    n_threads = resolve_threads(n_threads);
+    // As many test points per block as the scratch allows, but enough
+    // blocks to keep every thread busy
+    long fit = PREDICT_SCRATCH / std::max(n, 1);
+    int block = static_cast<int>(std::min<long>(PREDICT_BLOCK,
+                                                std::max<long>(fit, 1)));
+    int per_thread = (ns + n_threads - 1) / n_threads;
+    block = std::max(1, std::min(block, per_thread));
+    int n_blocks = (ns + block - 1) / block;
+    std::vector<predict_scratch> scratch(n_threads);
+    parallel_for(n_blocks, n_threads, [&](int b, int t) {
+        int first = b * block;
+        int nb = std::min(block, ns - first);
+        predict_scratch& work = scratch[t];
+        work.v.resize(static_cast<long>(n) * nb);
+        work.acc.resize(static_cast<long>(PREDICT_TILE) * nb);
+        work.tile.resize(static_cast<long>(PREDICT_TILE) * nb);
+        work.xt.resize(static_cast<long>(PREDICT_TILE) * dim);
+        work.xb.resize(static_cast<long>(nb) * dim);
+        work.mu.assign(nb, m);
+        // Stationary kernels all have k(x, x) = sf2
+        work.var.assign(nb, sf2);
+        double* v = &work.v[0];
+        double* mu = &work.mu[0];
+        double* var = &work.var[0];
+        // This block's test inputs, as their own column-major matrix
+        double* xb = &work.xb[0];
+        for ( int d = 0; d < dim; ++d ) {
+            for ( int s = 0; s < nb; ++s ) {
+                xb[d * nb + s] = xs[static_cast<long>(d) * ns + first + s];
+            }
+        }
+        for ( int t0 = 0; t0 < n; t0 += PREDICT_TILE ) {
+            int bt = std::min(PREDICT_TILE, n - t0);
+            int t1 = t0 + bt;
+            double* xt = &work.xt[0];
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int r = 0; r < bt; ++r ) {
+                    xt[d * bt + r] = x[static_cast<long>(d) * n + t0 + r];
+                }
+            }
+            double* tile = &work.tile[0];
+            native_cov_cross(cov, hyp_cov, xt, bt, xb, nb, tile);
+            // The means, and this tile's rows of v: sW .* Ks to be solved
+            // for with L', or Ks itself for symmetric L
+            for ( int r = 0; r < bt; ++r ) {
+                int i = t0 + r;
+                double scale = post.L_is_chol ? post.sW[i] : 1.0;
+                double* vi = v + static_cast<long>(i) * nb;
+                for ( int s = 0; s < nb; ++s ) {
+                    double k = tile[static_cast<long>(s) * bt + r];
+                    mu[s] += k * post.alpha[i];
+                    vi[s] = scale * k;
+                }
+            }
+            // acc(j, :) = L(0:j-1, j)' * v(0:j-1, :) for the tile's rows j;
+            // the earlier tiles' rows of v are final already, and each of
+            // them is used for all of this tile's rows while in cache
+            double* acc = &work.acc[0];
+            std::fill(acc, acc + static_cast<long>(bt) * nb, 0.0);
+            for ( int i0 = 0; i0 < t0; i0 += PREDICT_TILE ) {
+                int i1 = std::min(i0 + PREDICT_TILE, t0);
+                for ( int j = t0; j < t1; ++j ) {
+                    add_column(posterior_column(post, j), v, i0, i1, nb,
+                               acc + static_cast<long>(j - t0) * nb);
+                }
+            }
+            // Then, row by row, the rest of the sums and the variances
+            for ( int j = t0; j < t1; ++j ) {
+                const double* Lj = posterior_column(post, j);
+                double* aj = acc + static_cast<long>(j - t0) * nb;
+                double* vj = v + static_cast<long>(j) * nb;
+                add_column(Lj, v, t0, j, nb, aj);
+                if ( post.L_is_chol ) {
+                    for ( int s = 0; s < nb; ++s ) {
+                        vj[s] = (vj[s] - aj[s]) / Lj[j];
+                        var[s] -= vj[s] * vj[s];
+                    }
+                }
+                else {
+                    for ( int s = 0; s < nb; ++s ) {
+                        var[s] += vj[s] * (2.0 * aj[s] + Lj[j] * vj[s]);
+                    }
+                }
+            }
+        }
+        for ( int s = 0; s < nb; ++s ) {
+            double f = mu[s];
+            double f2 = std::max(var[s], 0.0);
+            long k = first + s;
+            fmu[k] = f;
+            fs2[k] = f2;
+            if ( model.lik == LIK_GAUSS ) {
+                ymu[k] = f;
+                ys2[k] = f2 + sn2;
+            }
+            else {
+                double p = 0.5 * std::erfc(-f / std::sqrt(1.0 + f2)
+                                           / std::sqrt(2.0));
+                ymu[k] = 2.0 * p - 1.0;
+                ys2[k] = 4.0 * p * (1.0 - p);
+            }
+        }
+    });
+}
+
+// Test points per tile of native_predict_cov(), and scratch doubles at most
+// for a group's solved cross covariances (unless one block or the band
+// needs more)
+static const int COV_TILE = 64;
+static const long COV_SCRATCH = 1L << 25;
+// Training inputs per chunk of the tiles' dot products
+static const int COV_CHUNK = 256;
+
+namespace {
+
+// A run of test points (positions in the block-sorted order) whose
+// covariances are computed together; [first, mid) only overlaps the
+// previous group, so pairs there were computed with it
+struct cov_group {
+    int first, mid, end;
+    // Where each block starts within [first, end), and end itself
+    std::vector<int> segments;
+};
+
+struct cov_tile {
+    int a0, a1, b0, b1;  // positions relative to the group's first
+};
+
+}
+
+void native_predict_cov(const native_model& model, const double* hyp,
+                        const double* x, const native_posterior& post,
+                        const double* xs, int ns, int band, const int* block,
+                        const predict_cov_output& out, int n_threads) {
+    const native_cov& cov = model.cov;
+    const double* hyp_cov = hyp + model.n_mean();
+    int n = post.n;
+    int dim = cov.dim;
+    // Blocks are made contiguous, keeping the points' order within each
+    std::vector<int> order(ns);
+    for ( int k = 0; k < ns; ++k ) {
+        order[k] = k;
+    }
+    if ( block ) {
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return block[a] < block[b];
+        });
+    }
+    // Symmetric posteriors keep Ks and L * Ks, so need twice the scratch
+    int buffers = post.L_is_chol ? 1 : 2;
+    long fit = COV_SCRATCH / (static_cast<long>(std::max(n, 1)) * buffers);
+    int size = static_cast<int>(std::min<long>(std::max<long>(fit, COV_TILE),
+                                               std::max(ns, 1)));
+    std::vector<cov_group> groups;
+    if ( block ) {
+        int k = 0;
+        while ( k < ns ) {
+            cov_group g;
+            g.first = g.mid = k;
+            while ( k < ns ) {
+                int run = k;
+                while ( run < ns && block[order[run]] == block[order[k]] ) {
+                    ++run;
+                }
+                if ( k > g.first && run - g.first > size ) {
+                    break;
+                }
+                g.segments.push_back(k - g.first);
+                k = run;
+            }
+            g.end = k;
+            g.segments.push_back(g.end - g.first);
+            groups.push_back(g);
+        }
+    }
+    else {
+        int overlap = band < 0 ? 0 : band;
+        for ( int k = 0; k < ns; k += size ) {
+            cov_group g;
+            g.mid = k;
+            g.first = band < 0 ? 0 : std::max(0, k - overlap);
+            g.end = band < 0 ? ns : std::min(ns, k + size);
+            g.segments.push_back(0);
+            g.segments.push_back(g.end - g.first);
+            groups.push_back(g);
+            if ( band < 0 ) {
+                break;
+            }
+        }
+    }
+    n_threads = resolve_threads(n_threads);
+    std::vector<double> A, B, xg;
+    for ( size_t gi = 0; gi < groups.size(); ++gi ) {
+        const cov_group& g = groups[gi];
+        int m = g.end - g.first;
+        // The group's test inputs, as their own column-major matrix
+        xg.resize(static_cast<long>(m) * dim);
+        for ( int d = 0; d < dim; ++d ) {
+            for ( int s = 0; s < m; ++s ) {
+                xg[static_cast<long>(d) * m + s]
+                    = xs[static_cast<long>(d) * ns + order[g.first + s]];
+            }
+        }
+        // A(:, s) = L' \ (sW .* ks_s), or ks_s and B(:, s) = L * ks_s
+        A.resize(static_cast<long>(n) * m);
+        B.resize(post.L_is_chol ? 0 : static_cast<long>(n) * m);
+        int n_panels = (m + COV_TILE - 1) / COV_TILE;
+        parallel_for(n_panels, n_threads, [&](int panel, int) {
+            int s0 = panel * COV_TILE;
+            int nb = std::min(COV_TILE, m - s0);
+            std::vector<double> xb(static_cast<long>(nb) * dim);
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int s = 0; s < nb; ++s ) {
+                    xb[d * nb + s] = xg[static_cast<long>(d) * m + s0 + s];
+                }
+            }
+            double* As = &A[static_cast<long>(s0) * n];
+            native_cov_cross(cov, hyp_cov, x, n, &xb[0], nb, As);
+            for ( int s = 0; s < nb; ++s ) {
+                double* v = As + static_cast<long>(s) * n;
+                if ( post.L_is_chol ) {
+                    for ( int j = 0; j < n; ++j ) {
+                        const double* Lj = posterior_column(post, j);
+                        double sum = post.sW[j] * v[j];
+                        for ( int i = 0; i < j; ++i ) {
+                            sum -= Lj[i] * v[i];
+                        }
+                        v[j] = sum / Lj[j];
+                    }
+                }
+                else {
+                    double* w = &B[(static_cast<long>(s0) + s) * n];
+                    std::fill(w, w + n, 0.0);
+                    for ( int j = 0; j < n; ++j ) {
+                        const double* Lj = posterior_column(post, j);
+                        double sum = 0.0;
+                        for ( int i = 0; i < j; ++i ) {
+                            sum += Lj[i] * v[i];
+                            w[i] += Lj[i] * v[j];
+                        }
+                        w[j] += sum + Lj[j] * v[j];
+                    }
+                }
+            }
+        });
+        // The tiles holding selected pairs, a <= b, within each block
+        std::vector<cov_tile> tiles;
+        int mid = g.mid - g.first;
+        for ( size_t k = 0; k + 1 < g.segments.size(); ++k ) {
+            int lo = g.segments[k];
+            int hi = g.segments[k + 1];
+            for ( int b0 = lo; b0 < hi; b0 += COV_TILE ) {
+                int b1 = std::min(hi, b0 + COV_TILE);
+                if ( b1 <= mid ) {
+                    continue;
+                }
+                for ( int a0 = lo; a0 <= b0; a0 += COV_TILE ) {
+                    int a1 = std::min(hi, a0 + COV_TILE);
+                    // (positions follow the points' order without blocks)
+                    if ( !block && band >= 0 && b0 - (a1 - 1) > band ) {
+                        continue;
+                    }
+                    cov_tile tile = { a0, a1, b0, b1 };
+                    tiles.push_back(tile);
+                }
+            }
+        }
+        const double* Bp = post.L_is_chol ? &A[0] : &B[0];
+        double sign = post.L_is_chol ? -1.0 : 1.0;
+        parallel_for(static_cast<int>(tiles.size()), n_threads,
+                     [&](int k, int) {
+            const cov_tile& tile = tiles[k];
+            int na = tile.a1 - tile.a0;
+            int nb = tile.b1 - tile.b0;
+            std::vector<double> xa(static_cast<long>(na) * dim);
+            std::vector<double> xb(static_cast<long>(nb) * dim);
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int s = 0; s < na; ++s ) {
+                    xa[d * na + s] = xg[static_cast<long>(d) * m + tile.a0
+                                        + s];
+                }
+                for ( int s = 0; s < nb; ++s ) {
+                    xb[d * nb + s] = xg[static_cast<long>(d) * m + tile.b0
+                                        + s];
+                }
+            }
+            // kss for the tile, then the dot products chunk by chunk, so
+            // both tiles' columns stay in cache
+            std::vector<double> C(static_cast<long>(na) * nb);
+            native_cov_cross(cov, hyp_cov, &xa[0], na, &xb[0], nb, &C[0]);
+            std::vector<double> dots(static_cast<long>(na) * nb, 0.0);
+            for ( int i0 = 0; i0 < n; i0 += COV_CHUNK ) {
+                int i1 = std::min(n, i0 + COV_CHUNK);
+                for ( int b = 0; b < nb; ++b ) {
+                    const double* Bb = Bp + (static_cast<long>(tile.b0) + b)
+                                            * n;
+                    for ( int a = 0; a < na; ++a ) {
+                        const double* Aa = &A[(static_cast<long>(tile.a0)
+                                               + a) * n];
+                        double sum = 0.0;
+                        for ( int i = i0; i < i1; ++i ) {
+                            sum += Aa[i] * Bb[i];
+                        }
+                        dots[static_cast<long>(b) * na + a] += sum;
+                    }
+                }
+            }
+            for ( int b = 0; b < nb; ++b ) {
+                int pb = tile.b0 + b;
+                int ob = order[g.first + pb];
+                for ( int a = 0; a < na; ++a ) {
+                    int pa = tile.a0 + a;
+                    int oa = order[g.first + pa];
+                    if ( pa > pb || pb < mid ) {
+                        continue;
+                    }
+                    if ( band >= 0 && std::abs(oa - ob) > band ) {
+                        continue;
+                    }
+                    long index = static_cast<long>(b) * na + a;
+                    double c = C[index] + sign * dots[index];
+                    if ( pa == pb ) {
+                        // (as gp.m clamps fs2)
+                        c = std::max(c, 0.0);
+                    }
+                    if ( out.dense ) {
+                        out.dense[static_cast<long>(ob) * ns + oa] = c;
+                        out.dense[static_cast<long>(oa) * ns + ob] = c;
+                        continue;
+                    }
+                    const int* rows = out.i + out.p[ob];
+                    long at = std::lower_bound(rows, out.i + out.p[ob + 1],
+                                               oa) - out.i;
+                    out.x[at] = c;
+                    rows = out.i + out.p[oa];
+                    at = std::lower_bound(rows, out.i + out.p[oa + 1], ob)
+                         - out.i;
+                    out.x[at] = c;
+                }
+            }
+        });
+    }
+}
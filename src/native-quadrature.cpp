@@ -0,0 +1,291 @@
+#include "native.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// GPML's likelihoods in prediction mode integrate the likelihood against
+// the latent Gaussian with gauher(20) nodes, forming ns x 20 matrices in
+// interpreted code for every block of test points; here each test point
+// goes through its 20 nodes on its own.
+
+// gauher(20)'s precalculated nodes and weights (rounded as in gauher.m,
+// so that the sums match GPML's)
+static const int N_NODES = 20;
+static const double NODES[N_NODES] = {
+    -7.619048541679757, -6.510590157013656, -5.578738805893203,
+    -4.734581334046057, -3.943967350657318, -3.18901481655339,
+    -2.458663611172367, -1.745247320814127, -1.042945348802751,
+    -0.346964157081356, 0.346964157081356, 1.042945348802751,
+    1.745247320814127, 2.458663611172367, 3.18901481655339,
+    3.943967350657316, 4.734581334046057, 5.578738805893202,
+    6.510590157013653, 7.619048541679757
+};
+static const double WEIGHTS[N_NODES] = {
+    0.000000000000126, 0.000000000248206, 0.000000061274903,
+    0.00000440212109, 0.000128826279962, 0.00183010313108,
+    0.013997837447101, 0.061506372063977, 0.161739333984,
+    0.260793063449555, 0.260793063449555, 0.161739333984,
+    0.061506372063977, 0.013997837447101, 0.00183010313108,
+    0.000128826279962, 0.00000440212109, 0.000000061274903,
+    0.000000000248206, 0.000000000000126
+};
+
+// gp.m hands the likelihood this many test points at a time
+static const int PREDICT_BATCH = 1000;
+
+static const double LOG_2PI = 1.8378770664093454836;
+static const double PI = 3.14159265358979323846;
+// (as likGumbel.m rounds it)
+static const double EULER_GAMMA = 0.5772156649;
+
+// Everything about the likelihood that depends only on hyp.lik
+struct lik_constants {
+    double nu, sn2, lZ;     // likT and likGumbel (lZ = -log(be))
+    double be;              // likGumbel
+    double r, lr;           // likNegBinom
+    double al;              // likGamma (1 for likExp)
+    double phi;             // likBeta
+    double lam;             // likInvGauss
+    double ka, lg1, g1, g2; // likWeibull
+};
+
+static lik_constants prepare(const quadrature_lik& lik, const double* hyp) {
+    lik_constants c = lik_constants();
+    switch ( lik.type ) {
+    case QLIK_T:
+        c.nu = std::exp(hyp[0]) + 1.0;
+        c.sn2 = std::exp(2.0 * hyp[1]);
+        c.lZ = std::lgamma(c.nu / 2.0 + 0.5) - std::lgamma(c.nu / 2.0)
+               - std::log(c.nu * PI * c.sn2) / 2.0;
+        break;
+    case QLIK_GUMBEL:
+        c.sn2 = std::exp(2.0 * hyp[0]);
+        c.be = std::sqrt(6.0 * c.sn2) / PI;
+        c.lZ = -std::log(c.be);
+        break;
+    case QLIK_NEGBINOM:
+        c.lr = hyp[0];
+        c.r = std::exp(c.lr);
+        break;
+    case QLIK_GAMMA:
+        c.al = std::exp(hyp[0]);
+        break;
+    case QLIK_EXP:
+        c.al = 1.0;
+        break;
+    case QLIK_BETA:
+        c.phi = std::exp(hyp[0]);
+        break;
+    case QLIK_INVGAUSS:
+        c.lam = std::exp(hyp[0]);
+        break;
+    case QLIK_WEIBULL:
+        c.ka = std::exp(hyp[0]);
+        c.lg1 = std::lgamma(1.0 + 1.0 / c.ka);
+        c.g1 = std::exp(c.lg1);
+        c.g2 = std::tgamma(1.0 + 2.0 / c.ka);
+        break;
+    default:
+        break;
+    }
+    return c;
+}
+
+// log(g(f)), as glm_invlink_*.m compute it
+static double log_g(glm_link link, double f) {
+    switch ( link ) {
+    case LINK_EXP:
+        return f;
+    case LINK_EXPEXP:
+        return -std::exp(-f);
+    default:
+        break;
+    }
+    // log(1 + exp(f)), safely, and log(log(1 + exp(f))) with its limit
+    double l1pef = std::max(0.0, f) + std::log(1.0 + std::exp(-std::fabs(f)));
+    double lg = f < -15.0 ? f : std::log(l1pef);
+    if ( link == LINK_LOGISTIC ) {
+        return lg;
+    }
+    return f - std::exp(lg);
+}
+
+// The terms of the log likelihood that depend on y but not on f (they are
+// the same at every node)
+static double y_terms(const quadrature_lik& lik, const lik_constants& c,
+                      double y) {
+    switch ( lik.type ) {
+    case QLIK_POISSON:
+        return -std::lgamma(y + 1.0);
+    case QLIK_NEGBINOM:
+        return -(std::lgamma(y + 1.0) + std::lgamma(c.r)
+                 - std::lgamma(y + c.r) - c.r * c.lr);
+    case QLIK_GAMMA:
+    case QLIK_EXP:
+        return -(std::lgamma(c.al) - c.al * std::log(c.al)
+                 + (1.0 - c.al) * std::log(y));
+    case QLIK_BETA:
+        return std::lgamma(c.phi) - std::log(y) - std::log(1.0 - y);
+    case QLIK_INVGAUSS:
+        return (std::log(c.lam) - (LOG_2PI + 3.0 * std::log(y))) / 2.0;
+    case QLIK_WEIBULL:
+        return c.lg1 + std::log(c.ka) + (c.ka - 1.0) * (c.lg1 + std::log(y));
+    default:
+        return 0.0;
+    }
+}
+
+// The log likelihood of y at latent value f ('infLaplace' mode's lp), given
+// lg = log(g(f)) for the GLM likelihoods and y_terms() of y
+static double log_lik(const quadrature_lik& lik, const lik_constants& c,
+                      double y, double terms, double f, double lg) {
+    switch ( lik.type ) {
+    case QLIK_T: {
+        double r = y - f;
+        return c.lZ - (c.nu + 1.0) * std::log(1.0 + r * r / (c.nu * c.sn2))
+                      / 2.0;
+    }
+    case QLIK_GUMBEL: {
+        double z = EULER_GAMMA + lik.sign * (y - f) / c.be;
+        return c.lZ - z - std::exp(-z);
+    }
+    case QLIK_POISSON:
+        return lg * y - std::exp(lg) + terms;
+    case QLIK_NEGBINOM: {
+        // log(exp(lg) + r)
+        double mx = std::max(lg, c.lr);
+        double lgr = std::log(std::exp(lg - mx) + std::exp(c.lr - mx)) + mx;
+        return y * lg - (y + c.r) * lgr + terms;
+    }
+    case QLIK_GAMMA:
+    case QLIK_EXP:
+        return -c.al * (lg + y * std::exp(-lg)) + terms;
+    case QLIK_BETA: {
+        double v = c.phi * std::exp(lg);
+        double w = c.phi - v;
+        return v * std::log(y) + w * std::log(1.0 - y) - std::lgamma(v)
+               - std::lgamma(w) + terms;
+    }
+    case QLIK_INVGAUSS: {
+        double r = y * std::exp(-lg) - 1.0;
+        return -c.lam * r * r / (2.0 * y) + terms;
+    }
+    case QLIK_WEIBULL: {
+        double ly = c.lg1 + std::log(y);
+        return -c.ka * lg - std::exp(c.ka * (ly - lg)) + terms;
+    }
+    default:
+        return 0.0;
+    }
+}
+
+// The variance of y given g(f) = elg, for the GLM likelihoods
+static double glm_variance(const quadrature_lik& lik, const lik_constants& c,
+                           double elg) {
+    switch ( lik.type ) {
+    case QLIK_POISSON:
+        return elg;
+    case QLIK_NEGBINOM:
+        return elg * (elg / c.r + 1.0);
+    case QLIK_GAMMA:
+    case QLIK_EXP:
+        return elg * elg / c.al;
+    case QLIK_BETA:
+        return elg * (1.0 - elg) / (1.0 + c.phi);
+    case QLIK_INVGAUSS:
+        return elg * elg * elg / c.lam;
+    case QLIK_WEIBULL:
+        return elg * elg * (c.g2 / (c.g1 * c.g1) - 1.0);
+    default:
+        return 0.0;
+    }
+}
+
+// log(sum_j exp(a[j])), subtracting the largest term first
+static double log_sum_exp(const double* a) {
+    double max_a = a[0];
+    for ( int j = 1; j < N_NODES; ++j ) {
+        max_a = std::max(max_a, a[j]);
+    }
+    double sum = 0.0;
+    for ( int j = 0; j < N_NODES; ++j ) {
+        sum += std::exp(a[j] - max_a);
+    }
+    return std::log(sum) + max_a;
+}
+
+void native_quadrature_predict(const quadrature_lik& lik, const double* hyp,
+                               const double* ys, const double* fmu,
+                               const double* fs2, int ns, double* lp,
+                               double* ymu, double* ys2, int n_threads) {
+    lik_constants c = prepare(lik, hyp);
+    bool glm = lik.type != QLIK_T && lik.type != QLIK_GUMBEL;
+    double log_w[N_NODES];
+    for ( int j = 0; j < N_NODES; ++j ) {
+        log_w[j] = std::log(WEIGHTS[j]);
+    }
+    int n_blocks = (ns + PREDICT_BATCH - 1) / PREDICT_BATCH;
+    parallel_for(n_blocks, n_threads, [&](int b, int) {
+        int first = b * PREDICT_BATCH;
+        int end = std::min(ns, first + PREDICT_BATCH);
+        // The likelihoods' s2zero test: norm(s2) > eps over the block
+        double norm2 = 0.0;
+        for ( int i = first; i < end; ++i ) {
+            norm2 += fs2[i] * fs2[i];
+        }
+        bool s2zero = !(std::sqrt(norm2) > DBL_EPSILON);
+        double a[N_NODES];
+        double lg[N_NODES];
+        for ( int i = first; i < end; ++i ) {
+            double y = ys ? ys[i] : 0.0;
+            double mu = fmu[i];
+            double sig = std::sqrt(fs2[i]);
+            if ( glm ) {
+                for ( int j = 0; j < N_NODES; ++j ) {
+                    lg[j] = log_g(lik.link, sig * NODES[j] + mu);
+                }
+            }
+            if ( lp ) {
+                double terms = y_terms(lik, c, y);
+                if ( s2zero ) {
+                    lp[i] = log_lik(lik, c, y, terms, mu,
+                                    glm ? log_g(lik.link, mu) : 0.0);
+                }
+                else {
+                    for ( int j = 0; j < N_NODES; ++j ) {
+                        a[j] = log_lik(lik, c, y, terms,
+                                       sig * NODES[j] + mu, lg[j])
+                               + log_w[j];
+                    }
+                    lp[i] = log_sum_exp(a);
+                }
+            }
+            if ( !glm ) {
+                // ymu is the mode (likT with nu <= 1 has no mean)
+                double s2 = s2zero ? 0.0 : fs2[i];
+                ymu[i] = mu;
+                if ( lik.type == QLIK_GUMBEL ) {
+                    ys2[i] = s2 + c.sn2;
+                }
+                else {
+                    ys2[i] = c.nu <= 2.0 ? HUGE_VAL
+                                         : s2 + c.nu * c.sn2 / (c.nu - 2.0);
+                }
+                continue;
+            }
+            // The first moment of g(f), then the second of y around it
+            for ( int j = 0; j < N_NODES; ++j ) {
+                a[j] = lg[j] + log_w[j];
+            }
+            double m = std::exp(log_sum_exp(a));
+            double v = 0.0;
+            for ( int j = 0; j < N_NODES; ++j ) {
+                double elg = std::exp(lg[j]);
+                double d = elg - m;
+                v += (glm_variance(lik, c, elg) + d * d) * WEIGHTS[j];
+            }
+            ymu[i] = m;
+            ys2[i] = v;
+        }
+    });
+}
@@ -0,0 +1,208 @@
+#include "native.h"
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+// Posterior draws by pathwise conditioning (Wilson et al., 2020): GPML's
+// usageSampling.m forms the dense test covariance and factorizes it, which
+// is O(ns^3); here a prior draw comes from random Fourier features, so it
+// can be evaluated anywhere in O(n_features) per point, and the data enter
+// through one solve against the stored L per draw and the cross covariances
+// Ks, which are computed tile by tile and never kept.
+
+// Draws per batch: the batch's corrections (n doubles per draw) are kept
+// while every tile of test points goes through them
+static const int SAMPLE_BATCH = 64;
+// Test points per tile at most, and doubles of Ks per thread at most,
+// which sets fewer test points per tile for large n
+static const int SAMPLE_TILE = 256;
+static const long SAMPLE_SCRATCH = 1L << 22;
+
+static const double TWO_PI = 6.28318530717958647693;
+
+namespace {
+
+// cos(omega_k' x + phase_k) * scale for k = 1, ..., n_features; the omega_k
+// are drawn from the covariance's spectral density
+struct fourier_features {
+    int n_features;
+    int dim;
+    std::vector<double> omega;  // n_features x dim, row-major
+    std::vector<double> phase;
+    double scale;               // sqrt(2 * sf2 / n_features)
+};
+
+// Frequencies for covSE* (Gaussian), covMatern* (a multivariate t with d
+// degrees of freedom, as a Gaussian scaled by sqrt(d / chi2_d)), and covRQ*
+// (a Gaussian scaled by sqrt(tau), tau ~ Gamma(alpha, 1 / alpha)), each
+// divided by the length scale(s)
+fourier_features draw_features(const native_cov& cov, const double* hyp_cov,
+                               int n_features, unsigned seed) {
+    fourier_features ff;
+    ff.n_features = n_features;
+    ff.dim = cov.dim;
+    ff.omega.resize(static_cast<long>(n_features) * cov.dim);
+    ff.phase.resize(n_features);
+    double sf2 = std::exp(2.0 * hyp_cov[cov.ard ? cov.dim : 1]);
+    ff.scale = std::sqrt(2.0 * sf2 / n_features);
+    std::vector<double> inv_ell(cov.dim);
+    for ( int d = 0; d < cov.dim; ++d ) {
+        inv_ell[d] = std::exp(-hyp_cov[cov.ard ? d : 0]);
+    }
+    double alpha = cov.type == COV_RQ ? std::exp(hyp_cov[cov.n_hyp() - 1])
+                                      : 1.0;
+    std::seed_seq seq{ seed, 0u };
+    std::mt19937 rng(seq);
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> uniform(0.0, TWO_PI);
+    std::chi_squared_distribution<double> chi2(cov.degree);
+    std::gamma_distribution<double> gamma(alpha, 1.0 / alpha);
+    for ( int k = 0; k < n_features; ++k ) {
+        double s = 1.0;
+        if ( cov.type == COV_MATERN ) {
+            s = std::sqrt(cov.degree / chi2(rng));
+        }
+        else if ( cov.type == COV_RQ ) {
+            s = std::sqrt(gamma(rng));
+        }
+        for ( int d = 0; d < cov.dim; ++d ) {
+            ff.omega[static_cast<long>(k) * cov.dim + d]
+                = normal(rng) * s * inv_ell[d];
+        }
+        ff.phase[k] = uniform(rng);
+    }
+    return ff;
+}
+
+// acc[i * nb + b] += f_b(x_i) for the m rows of the column-major x (with
+// ld rows in all), where f_b has feature weights w[k * nb + b]
+void add_prior(const fourier_features& ff, const double* x, long ld, int m,
+               const double* w, int nb, double* acc) {
+    for ( int i = 0; i < m; ++i ) {
+        double* ai = acc + static_cast<long>(i) * nb;
+        for ( int k = 0; k < ff.n_features; ++k ) {
+            const double* omega = &ff.omega[static_cast<long>(k) * ff.dim];
+            double arg = ff.phase[k];
+            for ( int d = 0; d < ff.dim; ++d ) {
+                arg += omega[d] * x[d * ld + i];
+            }
+            double phi = ff.scale * std::cos(arg);
+            const double* wk = w + static_cast<long>(k) * nb;
+            for ( int b = 0; b < nb; ++b ) {
+                ai[b] += phi * wk[b];
+            }
+        }
+    }
+}
+
+}
+
+bool native_sample(const native_model& model, const double* hyp,
+                   const double* x, const native_posterior& post,
+                   const double* xs, int ns, int n_draws, int n_features,
+                   unsigned seed, double* out, int n_threads) {
+    const native_cov& cov = model.cov;
+    if ( cov.type == COV_PP || !post.L_is_chol || !post.sW ) {
+        return false;
+    }
+    int n = post.n;
+    int dim = cov.dim;
+    const double* hyp_cov = hyp + model.n_mean();
+    double m = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    n_threads = resolve_threads(n_threads);
+    fourier_features ff = draw_features(cov, hyp_cov, n_features, seed);
+    long fit = SAMPLE_SCRATCH / std::max(n, 1);
+    int tile = static_cast<int>(std::min<long>(SAMPLE_TILE,
+                                               std::max<long>(fit, 1)));
+    int n_tiles = (ns + tile - 1) / tile;
+    int train_tiles = (n + SAMPLE_TILE - 1) / SAMPLE_TILE;
+    std::vector<double> w, v, c;
+    for ( int d0 = 0; d0 < n_draws; d0 += SAMPLE_BATCH ) {
+        int nb = std::min(SAMPLE_BATCH, n_draws - d0);
+        // Each draw's feature weights and noise, from its own stream
+        w.resize(static_cast<long>(n_features) * nb);
+        v.assign(static_cast<long>(n) * nb, 0.0);
+        std::vector<double> z(static_cast<long>(n) * nb);
+        parallel_for(nb, n_threads, [&](int b, int) {
+            std::seed_seq seq{ seed, static_cast<unsigned>(d0 + b) + 1u };
+            std::mt19937 rng(seq);
+            std::normal_distribution<double> normal;
+            for ( int k = 0; k < n_features; ++k ) {
+                w[static_cast<long>(k) * nb + b] = normal(rng);
+            }
+            for ( int i = 0; i < n; ++i ) {
+                z[static_cast<long>(i) * nb + b] = normal(rng);
+            }
+        });
+        // The prior draws at the training inputs (row-major in v)
+        parallel_for(train_tiles, n_threads, [&](int t, int) {
+            int first = t * SAMPLE_TILE;
+            int m_t = std::min(SAMPLE_TILE, n - first);
+            add_prior(ff, x + first, n, m_t, &w[0], nb,
+                      &v[static_cast<long>(first) * nb]);
+        });
+        // c = alpha - sW .* (L \ (L' \ (sW .* f(x) + z))), one draw per task
+        c.resize(static_cast<long>(n) * nb);
+        parallel_for(nb, n_threads, [&](int b, int) {
+            std::vector<double> u(n);
+            for ( int i = 0; i < n; ++i ) {
+                long at = static_cast<long>(i) * nb + b;
+                u[i] = post.sW[i] * v[at] + z[at];
+            }
+            for ( int j = 0; j < n; ++j ) {
+                const double* Lj = posterior_column(post, j);
+                double sum = u[j];
+                for ( int i = 0; i < j; ++i ) {
+                    sum -= Lj[i] * u[i];
+                }
+                u[j] = sum / Lj[j];
+            }
+            for ( int j = n - 1; j >= 0; --j ) {
+                const double* Lj = posterior_column(post, j);
+                u[j] /= Lj[j];
+                double uj = u[j];
+                for ( int i = 0; i < j; ++i ) {
+                    u[i] -= Lj[i] * uj;
+                }
+            }
+            for ( int i = 0; i < n; ++i ) {
+                c[static_cast<long>(i) * nb + b]
+                    = post.alpha[i] - post.sW[i] * u[i];
+            }
+        });
+        // m + f(xs) + Ks' * c, a tile of test points at a time
+        parallel_for(n_tiles, n_threads, [&](int t, int) {
+            int s0 = t * tile;
+            int nt = std::min(tile, ns - s0);
+            std::vector<double> xt(static_cast<long>(nt) * dim);
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int s = 0; s < nt; ++s ) {
+                    xt[static_cast<long>(d) * nt + s]
+                        = xs[static_cast<long>(d) * ns + s0 + s];
+                }
+            }
+            std::vector<double> Ks(static_cast<long>(n) * nt);
+            native_cov_cross(cov, hyp_cov, x, n, &xt[0], nt, &Ks[0]);
+            std::vector<double> acc(static_cast<long>(nt) * nb, m);
+            add_prior(ff, &xt[0], nt, nt, &w[0], nb, &acc[0]);
+            for ( int s = 0; s < nt; ++s ) {
+                const double* ks = &Ks[static_cast<long>(s) * n];
+                double* as = &acc[static_cast<long>(s) * nb];
+                for ( int i = 0; i < n; ++i ) {
+                    double k = ks[i];
+                    const double* ci = &c[static_cast<long>(i) * nb];
+                    for ( int b = 0; b < nb; ++b ) {
+                        as[b] += k * ci[b];
+                    }
+                }
+            }
+            for ( int b = 0; b < nb; ++b ) {
+                double* column = out + static_cast<long>(d0 + b) * ns + s0;
+                for ( int s = 0; s < nt; ++s ) {
+                    column[s] = acc[static_cast<long>(s) * nb + b];
+                }
+            }
+        });
+    }
+    return true;
+}
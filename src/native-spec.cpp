@@ -0,0 +1,328 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// Deciding whether a GPML specification can use the native (Octave-free)
+// code paths. The specifications arrive as the lists gp() builds with
+// listfix(), e.g. list("covMaterniso", 3) or list("infExact").
+
+// The function name at the head of a specification list, or "" if the head
+// is not a single string (e.g. a nested composite covariance)
+std::string spec_name(const Rcpp::List& x) {
+    if ( x.size() == 0 ) {
+        return "";
+    }
+    Rcpp::RObject head = x[0];
+    if ( head.sexp_type() != STRSXP ) {
+        return "";
+    }
+    Rcpp::CharacterVector name = Rcpp::as<Rcpp::CharacterVector>(head);
+    if ( name.size() != 1 ) {
+        return "";
+    }
+    return Rcpp::as<std::string>(name(0));
+}
+
+bool parse_native_cov(const Rcpp::List& cov, int dim, native_cov& result) {
+    std::string name = spec_name(cov);
+    result.dim = dim;
+    result.degree = 0;
+    if ( name == "covSEiso" || name == "covSEard" ) {
+        result.type = COV_SE;
+        result.ard = name == "covSEard";
+        return cov.size() == 1;
+    }
+    if ( name == "covRQiso" || name == "covRQard" ) {
+        result.type = COV_RQ;
+        result.ard = name == "covRQard";
+        return cov.size() == 1;
+    }
+    if ( name == "covMaterniso" || name == "covMaternard" ) {
+        result.type = COV_MATERN;
+        result.ard = name == "covMaternard";
+        if ( cov.size() != 2 ) {
+            return false;
+        }
+        Rcpp::RObject d = cov[1];
+        if ( d.sexp_type() != REALSXP && d.sexp_type() != INTSXP ) {
+            return false;
+        }
+        result.degree = Rcpp::as<int>(d);
+        return result.degree == 1 || result.degree == 3 || result.degree == 5;
+    }
+    if ( name == "covPPiso" || name == "covPPard" ) {
+        result.type = COV_PP;
+        result.ard = name == "covPPard";
+        if ( cov.size() != 2 ) {
+            return false;
+        }
+        Rcpp::RObject v = cov[1];
+        if ( v.sexp_type() != REALSXP && v.sexp_type() != INTSXP ) {
+            return false;
+        }
+        result.degree = Rcpp::as<int>(v);
+        return result.degree >= 0 && result.degree <= 3;
+    }
+    return false;
+}
+
+static bool parse_native_mean(const Rcpp::List& mean,
+                              native_mean_type& result) {
+    std::string name = spec_name(mean);
+    if ( name == "meanZero" && mean.size() == 1 ) {
+        result = MEAN_ZERO;
+        return true;
+    }
+    if ( name == "meanConst" && mean.size() == 1 ) {
+        result = MEAN_CONST;
+        return true;
+    }
+    return false;
+}
+
+bool parse_native_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                        const Rcpp::List& cov, const Rcpp::List& lik,
+                        int dim, native_model& result) {
+    if ( spec_name(inf) != "infExact" || inf.size() != 1 ) {
+        return false;
+    }
+    if ( spec_name(lik) != "likGauss" || lik.size() != 1 ) {
+        return false;
+    }
+    result.lik = LIK_GAUSS;
+    return parse_native_mean(mean, result.mean)
+        && parse_native_cov(cov, dim, result.cov);
+}
+
+// Prediction from a stored posterior doesn't care how it was inferred,
+// so any inference method will do here
+bool parse_native_predictor(const Rcpp::List& mean, const Rcpp::List& cov,
+                            const Rcpp::List& lik, int dim,
+                            native_model& result) {
+    std::string lik_name = spec_name(lik);
+    if ( lik_name == "likGauss" && lik.size() == 1 ) {
+        result.lik = LIK_GAUSS;
+    }
+    else if ( lik_name == "likErf" && lik.size() == 1 ) {
+        result.lik = LIK_ERF;
+    }
+    else {
+        return false;
+    }
+    return parse_native_mean(mean, result.mean)
+        && parse_native_cov(cov, dim, result.cov);
+}
+
+// The likelihoods whose prediction mode native_quadrature_predict() knows.
+// Like GPML, the GLM likelihoods take any link but 'exp' ('expexp' for
+// likBeta) as the other one they offer.
+bool parse_quadrature_lik(const Rcpp::List& lik, quadrature_lik& result) {
+    std::string name = spec_name(lik);
+    result.link = LINK_EXP;
+    result.sign = 1.0;
+    if ( name == "likT" ) {
+        result.type = QLIK_T;
+        return lik.size() == 1;
+    }
+    if ( lik.size() != 2 ) {
+        return false;
+    }
+    Rcpp::RObject option = lik[1];
+    if ( option.sexp_type() != STRSXP ) {
+        return false;
+    }
+    std::string value = Rcpp::as<std::string>(option);
+    if ( name == "likGumbel" ) {
+        result.type = QLIK_GUMBEL;
+        result.sign = value == "-" ? -1.0 : 1.0;
+        return true;
+    }
+    if ( name == "likBeta" ) {
+        result.type = QLIK_BETA;
+        result.link = value == "expexp" ? LINK_EXPEXP : LINK_LOGIT;
+        return true;
+    }
+    if ( name == "likPoisson" ) {
+        result.type = QLIK_POISSON;
+    }
+    else if ( name == "likNegBinom" ) {
+        result.type = QLIK_NEGBINOM;
+    }
+    else if ( name == "likGamma" ) {
+        result.type = QLIK_GAMMA;
+    }
+    else if ( name == "likExp" ) {
+        result.type = QLIK_EXP;
+    }
+    else if ( name == "likInvGauss" ) {
+        result.type = QLIK_INVGAUSS;
+    }
+    else if ( name == "likWeibull" ) {
+        result.type = QLIK_WEIBULL;
+    }
+    else {
+        return false;
+    }
+    result.link = value == "exp" ? LINK_EXP : LINK_LOGISTIC;
+    return true;
+}
+
+// The covariance functions with a state-space form (see native.h); covSum
+// and covProd take their parts as a list, or as a character vector of names
+bool parse_state_space_cov(const Rcpp::List& cov, state_space_cov& result) {
+    std::string name = spec_name(cov);
+    result.degree = 0;
+    result.parts.clear();
+    if ( name == "covMaterniso" || name == "covMaternard" ) {
+        // (one input dimension, so covMaternard is covMaterniso)
+        result.type = SS_MATERN;
+        if ( cov.size() != 2 ) {
+            return false;
+        }
+        Rcpp::RObject d = cov[1];
+        if ( d.sexp_type() != REALSXP && d.sexp_type() != INTSXP ) {
+            return false;
+        }
+        result.degree = Rcpp::as<int>(d);
+        return result.degree == 1 || result.degree == 3 || result.degree == 5;
+    }
+    if ( name == "covCos" || name == "covPeriodic"
+         || name == "covPeriodicNoDC" ) {
+        result.type = name == "covCos" ? SS_COS
+            : name == "covPeriodic" ? SS_PERIODIC : SS_PERIODIC_NODC;
+        return cov.size() == 1;
+    }
+    if ( name != "covSum" && name != "covProd" ) {
+        return false;
+    }
+    result.type = name == "covSum" ? SS_SUM : SS_PROD;
+    if ( cov.size() != 2 ) {
+        return false;
+    }
+    Rcpp::RObject parts = cov[1];
+    Rcpp::List part_list;
+    if ( parts.sexp_type() == STRSXP ) {
+        Rcpp::CharacterVector names = Rcpp::as<Rcpp::CharacterVector>(parts);
+        for ( int k = 0; k < names.size(); ++k ) {
+            part_list.push_back(Rcpp::List::create(names(k)));
+        }
+    }
+    else if ( parts.sexp_type() == VECSXP ) {
+        part_list = Rcpp::as<Rcpp::List>(parts);
+    }
+    else {
+        return false;
+    }
+    for ( int k = 0; k < part_list.size(); ++k ) {
+        Rcpp::RObject part = part_list[k];
+        Rcpp::List spec = part.sexp_type() == VECSXP
+            ? Rcpp::as<Rcpp::List>(part) : Rcpp::List::create(part);
+        result.parts.push_back(state_space_cov());
+        if ( !parse_state_space_cov(spec, result.parts.back()) ) {
+            return false;
+        }
+    }
+    return !result.parts.empty();
+}
+
+bool parse_state_space_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                             const Rcpp::List& cov, const Rcpp::List& lik,
+                             state_space_model& result) {
+    if ( spec_name(inf) != "infExact" || inf.size() != 1 ) {
+        return false;
+    }
+    if ( spec_name(lik) != "likGauss" || lik.size() != 1 ) {
+        return false;
+    }
+    return parse_native_mean(mean, result.mean)
+        && parse_state_space_cov(cov, result.cov);
+}
+
+// covADD({R, base}) with a base native_cov can evaluate on one input
+// dimension (covADD.m fevals the base, so it is a bare name) and orders R
+// between 1 and dim
+bool parse_additive_cov(const Rcpp::List& cov, int dim,
+                        additive_cov& result) {
+    if ( spec_name(cov) != "covADD" || cov.size() != 2 ) {
+        return false;
+    }
+    Rcpp::RObject args = cov[1];
+    if ( args.sexp_type() != VECSXP ) {
+        return false;
+    }
+    Rcpp::List arg_list = Rcpp::as<Rcpp::List>(args);
+    if ( arg_list.size() != 2 ) {
+        return false;
+    }
+    Rcpp::RObject orders = arg_list[0];
+    Rcpp::RObject base = arg_list[1];
+    if ( (orders.sexp_type() != REALSXP && orders.sexp_type() != INTSXP)
+         || base.sexp_type() != STRSXP ) {
+        return false;
+    }
+    Rcpp::NumericVector R = Rcpp::as<Rcpp::NumericVector>(orders);
+    result.dim = dim;
+    result.orders.clear();
+    for ( int k = 0; k < R.size(); ++k ) {
+        if ( R[k] != std::floor(R[k]) || R[k] < 1 || R[k] > dim ) {
+            return false;
+        }
+        result.orders.push_back(static_cast<int>(R[k]));
+    }
+    if ( result.orders.empty()
+         || !parse_native_cov(Rcpp::List::create(base), 1, result.base) ) {
+        return false;
+    }
+    return result.base.type == COV_SE || result.base.type == COV_RQ;
+}
+
+bool parse_additive_model(const Rcpp::List& inf, const Rcpp::List& mean,
+                          const Rcpp::List& cov, const Rcpp::List& lik,
+                          int dim, additive_model& result) {
+    if ( spec_name(inf) != "infExact" || inf.size() != 1 ) {
+        return false;
+    }
+    if ( spec_name(lik) != "likGauss" || lik.size() != 1 ) {
+        return false;
+    }
+    return parse_native_mean(mean, result.mean)
+        && parse_additive_cov(cov, dim, result.cov);
+}
+
+// Maps a hyperparameter list such as list(mean = ..., cov = ..., lik = ...)
+// (in any field order, as with GPML's structs) onto the mean, cov, lik order
+// native_model uses. Sets offsets[k] to where the k-th native hyperparameter
+// sits in unlist(hyp); returns false if the lengths don't match the model.
+bool native_hyp_offsets(const Rcpp::List& hyp, const native_model& model,
+                        std::vector<int>& offsets) {
+    const char* fields[3] = { "mean", "cov", "lik" };
+    int expected[3] = { model.n_mean(), model.cov.n_hyp(), model.n_lik() };
+    int start[3] = { -1, -1, -1 };
+    if ( !hyp.hasAttribute("names") ) {
+        return false;
+    }
+    Rcpp::CharacterVector names = hyp.names();
+    int position = 0;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        std::string name = Rcpp::as<std::string>(names(i));
+        int length = Rf_length(hyp[i]);
+        for ( int k = 0; k < 3; ++k ) {
+            if ( name == fields[k] ) {
+                if ( length != expected[k] ) {
+                    return false;
+                }
+                start[k] = position;
+            }
+        }
+        position += length;
+    }
+    offsets.clear();
+    for ( int k = 0; k < 3; ++k ) {
+        if ( start[k] < 0 && expected[k] > 0 ) {
+            return false;
+        }
+        for ( int j = 0; j < expected[k]; ++j ) {
+            offsets.push_back(start[k] + j);
+        }
+    }
+    return true;
+}
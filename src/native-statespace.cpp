@@ -0,0 +1,877 @@
+#include "native.h"
+#include <cmath>
+#include <algorithm>
+
+// State-space inference for 1-D inputs: each covariance function becomes a
+// linear SDE through its discrete-time transition A(dt) and stationary
+// state covariance Pinf (with f = H x), so that Q(dt) = Pinf - A Pinf A'.
+// Matern forms follow Hartikainen and Sarkka (2010), the periodic series
+// Solin and Sarkka (2014), and the gradient the sensitivity equations of
+// Sarkka (2013), Bayesian Filtering and Smoothing, Section 12.3.
+
+static const double LOG_2PI = 1.8378770664093454836;
+static const double PI = 3.14159265358979323846;
+static const double SERIES_TOL = 1e-10;
+static const int MAX_HARMONICS = 64;
+static const int MAX_STATES = 256;
+
+int state_space_cov::n_hyp() const {
+    switch ( type ) {
+    case SS_MATERN:
+    case SS_COS:
+        return 2;
+    case SS_PERIODIC:
+    case SS_PERIODIC_NODC:
+        return 3;
+    default:
+        break;
+    }
+    int result = 0;
+    for ( size_t k = 0; k < parts.size(); ++k ) {
+        result += parts[k].n_hyp();
+    }
+    return result;
+}
+
+namespace {
+
+// A covariance function's SDE at given hyperparameters. Pinf and its
+// derivatives are d x d (column-major); harmonics and c only describe
+// periodic parts, where harmonic j > 0 takes two states and j = 0 one.
+struct sde {
+    state_space_type type;
+    int d;
+    int n_hyp;
+    std::vector<double> Pinf;
+    std::vector<double> dPinf;  // n_hyp blocks of d x d
+    std::vector<double> H;
+    double lambda;              // Matern: sqrt(degree) / ell
+    double omega;               // periodic: 2 pi / p
+    std::vector<int> harmonics;
+    std::vector<sde> parts;
+};
+
+// exp(-z) I_j(z) for j = 0, ..., b.size() - 1, by Miller's backward
+// recurrence normalized with exp(z) = I_0(z) + 2 sum_j I_j(z)
+void scaled_bessel_i(double z, std::vector<double>& b) {
+    int m = static_cast<int>(b.size());
+    std::fill(b.begin(), b.end(), 0.0);
+    if ( z <= 0.0 ) {
+        b[0] = 1.0;
+        return;
+    }
+    int start = m + 40 + static_cast<int>(10.0 * std::sqrt(z));
+    double next = 0.0;
+    double current = 1e-300;
+    double sum = 0.0;
+    for ( int j = start; j > 0; --j ) {
+        double previous = next + 2.0 * j / z * current;
+        next = current;
+        current = previous;
+        sum += 2.0 * next;
+        if ( j - 1 < m ) {
+            b[j - 1] = current;
+        }
+        if ( j < m ) {
+            b[j] = next;
+        }
+        if ( current > 1e250 ) {
+            next *= 1e-250;
+            current *= 1e-250;
+            sum *= 1e-250;
+            for ( int k = j - 1; k < m; ++k ) {
+                b[k] *= 1e-250;
+            }
+        }
+    }
+    sum += current;
+    for ( int k = 0; k < m; ++k ) {
+        b[k] /= sum;
+    }
+}
+
+// The series k0(tau) = sum_j c_j cos(j omega tau) behind covPeriodic (from
+// j = 0) and covPeriodicNoDC (from j = 1, rescaled to unit variance), with
+// dc_j / dlog(ell); returns false if it is too long
+bool periodic_series(bool no_dc, double log_ell, std::vector<int>& j_used,
+                     std::vector<double>& c, std::vector<double>& dc) {
+    double z = std::exp(-2.0 * log_ell);
+    if ( z > 1e4 ) {
+        return false;
+    }
+    std::vector<double> b(MAX_HARMONICS + 2);
+    scaled_bessel_i(z, b);
+    // d(exp(-z) I_j(z)) / dz, with I_{-1} = I_1
+    std::vector<double> db(MAX_HARMONICS + 1);
+    for ( int j = 0; j <= MAX_HARMONICS; ++j ) {
+        double below = j == 0 ? b[1] : b[j - 1];
+        db[j] = 0.5 * (below + b[j + 1]) - b[j];
+    }
+    double scale = no_dc ? 1.0 / (1.0 - b[0]) : 1.0;
+    j_used.clear();
+    c.clear();
+    dc.clear();
+    double covered = 0.0;
+    for ( int j = no_dc ? 1 : 0; j <= MAX_HARMONICS; ++j ) {
+        double weight = j == 0 ? 1.0 : 2.0;
+        double cj = weight * b[j] * scale;
+        double dcj = weight * db[j] * scale;
+        if ( no_dc ) {
+            dcj += cj * db[0] * scale;
+        }
+        j_used.push_back(j);
+        c.push_back(cj);
+        dc.push_back(-2.0 * z * dcj);
+        covered += cj;
+        if ( 1.0 - covered <= SERIES_TOL ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// C += A B for d x d matrices, visiting only A's nonzeros (A and dA are
+// often block diagonal)
+void add_product(const double* A, const double* B, double* C, int d) {
+    for ( int k = 0; k < d; ++k ) {
+        for ( int i = 0; i < d; ++i ) {
+            double a = A[i + k * d];
+            if ( a == 0.0 ) {
+                continue;
+            }
+            for ( int j = 0; j < d; ++j ) {
+                C[i + j * d] += a * B[k + j * d];
+            }
+        }
+    }
+}
+
+// c += A b for a d x d matrix A and a vector b
+void add_product_vector(const double* A, const double* b, double* c, int d) {
+    for ( int k = 0; k < d; ++k ) {
+        double bk = b[k];
+        for ( int i = 0; i < d; ++i ) {
+            c[i] += A[i + k * d] * bk;
+        }
+    }
+}
+
+// C = A X A' for symmetric X, as A (A X)'; work is d x d
+void congruence(const double* A, const double* X, double* C, double* work,
+                int d) {
+    long dd = static_cast<long>(d) * d;
+    std::fill(work, work + dd, 0.0);
+    add_product(A, X, work, d);
+    for ( int i = 0; i < d; ++i ) {
+        for ( int j = 0; j < i; ++j ) {
+            std::swap(work[i + j * d], work[j + i * d]);
+        }
+    }
+    std::fill(C, C + dd, 0.0);
+    add_product(A, work, C, d);
+}
+
+bool build_sde(const state_space_cov& cov, const double* hyp, sde& s) {
+    s.type = cov.type;
+    s.n_hyp = cov.n_hyp();
+    s.parts.clear();
+    if ( cov.type == SS_MATERN ) {
+        int d = (cov.degree + 1) / 2;
+        double sf2 = std::exp(2.0 * hyp[1]);
+        double lambda = std::sqrt(static_cast<double>(cov.degree))
+            * std::exp(-hyp[0]);
+        s.d = d;
+        s.lambda = lambda;
+        s.Pinf.assign(d * d, 0.0);
+        double l2 = lambda * lambda;
+        if ( d == 1 ) {
+            s.Pinf[0] = sf2;
+        }
+        else if ( d == 2 ) {
+            s.Pinf[0] = sf2;
+            s.Pinf[3] = sf2 * l2;
+        }
+        else {
+            double kappa = sf2 * l2 / 3.0;
+            s.Pinf[0] = sf2;
+            s.Pinf[4] = kappa;
+            s.Pinf[2] = s.Pinf[6] = -kappa;
+            s.Pinf[8] = sf2 * l2 * l2;
+        }
+        // State k is the k-th derivative, so Pinf_ij scales as
+        // lambda^(i + j) = ell^-(i + j)
+        s.dPinf.assign(2 * d * d, 0.0);
+        for ( int j = 0; j < d; ++j ) {
+            for ( int i = 0; i < d; ++i ) {
+                s.dPinf[i + j * d] = -(i + j) * s.Pinf[i + j * d];
+                s.dPinf[d * d + i + j * d] = 2.0 * s.Pinf[i + j * d];
+            }
+        }
+        s.H.assign(d, 0.0);
+        s.H[0] = 1.0;
+        return true;
+    }
+    if ( cov.type == SS_COS || cov.type == SS_PERIODIC
+         || cov.type == SS_PERIODIC_NODC ) {
+        std::vector<double> c, dc;
+        double log_p, log_sf;
+        if ( cov.type == SS_COS ) {
+            s.harmonics.assign(1, 1);
+            c.assign(1, 1.0);
+            dc.assign(1, 0.0);
+            log_p = hyp[0];
+            log_sf = hyp[1];
+        }
+        else {
+            if ( !periodic_series(cov.type == SS_PERIODIC_NODC, hyp[0],
+                                  s.harmonics, c, dc) ) {
+                return false;
+            }
+            log_p = hyp[1];
+            log_sf = hyp[2];
+        }
+        double sf2 = std::exp(2.0 * log_sf);
+        s.omega = 2.0 * PI * std::exp(-log_p);
+        int d = 0;
+        for ( size_t k = 0; k < s.harmonics.size(); ++k ) {
+            d += s.harmonics[k] == 0 ? 1 : 2;
+        }
+        s.d = d;
+        long dd = static_cast<long>(d) * d;
+        s.Pinf.assign(dd, 0.0);
+        s.dPinf.assign(s.n_hyp * dd, 0.0);
+        s.H.assign(d, 0.0);
+        // dPinf for log(ell) (not covCos) and log(sf); the period only
+        // moves A
+        int ell_block = cov.type == SS_COS ? -1 : 0;
+        int sf_block = s.n_hyp - 1;
+        int i = 0;
+        for ( size_t k = 0; k < s.harmonics.size(); ++k ) {
+            int width = s.harmonics[k] == 0 ? 1 : 2;
+            s.H[i] = 1.0;
+            for ( int u = i; u < i + width; ++u ) {
+                s.Pinf[u + u * d] = sf2 * c[k];
+                s.dPinf[sf_block * dd + u + u * d] = 2.0 * sf2 * c[k];
+                if ( ell_block >= 0 ) {
+                    s.dPinf[ell_block * dd + u + u * d] = sf2 * dc[k];
+                }
+            }
+            i += width;
+        }
+        return true;
+    }
+    // covSum stacks the parts' states, covProd takes the Kronecker product
+    int offset = 0;
+    for ( size_t k = 0; k < cov.parts.size(); ++k ) {
+        s.parts.push_back(sde());
+        if ( !build_sde(cov.parts[k], hyp + offset, s.parts.back()) ) {
+            return false;
+        }
+        offset += cov.parts[k].n_hyp();
+    }
+    if ( cov.type == SS_SUM ) {
+        int d = 0;
+        for ( size_t k = 0; k < s.parts.size(); ++k ) {
+            d += s.parts[k].d;
+        }
+        s.d = d;
+        long dd = static_cast<long>(d) * d;
+        s.Pinf.assign(dd, 0.0);
+        s.dPinf.assign(s.n_hyp * dd, 0.0);
+        s.H.clear();
+        int start = 0;
+        int h = 0;
+        for ( size_t k = 0; k < s.parts.size(); ++k ) {
+            const sde& part = s.parts[k];
+            int dk = part.d;
+            long ddk = static_cast<long>(dk) * dk;
+            for ( int j = 0; j < dk; ++j ) {
+                for ( int i = 0; i < dk; ++i ) {
+                    long to = start + i + (start + j) * static_cast<long>(d);
+                    s.Pinf[to] = part.Pinf[i + j * dk];
+                    for ( int q = 0; q < part.n_hyp; ++q ) {
+                        s.dPinf[(h + q) * dd + to]
+                            = part.dPinf[q * ddk + i + j * dk];
+                    }
+                }
+            }
+            s.H.insert(s.H.end(), part.H.begin(), part.H.end());
+            start += dk;
+            h += part.n_hyp;
+        }
+        return true;
+    }
+    s.d = 1;
+    for ( size_t k = 0; k < s.parts.size(); ++k ) {
+        s.d *= s.parts[k].d;
+    }
+    if ( s.d > MAX_STATES ) {
+        return false;
+    }
+    s.Pinf.assign(1, 1.0);
+    s.H.assign(1, 1.0);
+    s.dPinf.clear();
+    // Fold the parts in one at a time, (left) kron (part)
+    int d_left = 1;
+    int h_left = 0;
+    for ( size_t k = 0; k < s.parts.size(); ++k ) {
+        const sde& part = s.parts[k];
+        int dk = part.d;
+        long ddk = static_cast<long>(dk) * dk;
+        int dn = d_left * dk;
+        long ddn = static_cast<long>(dn) * dn;
+        long ddl = static_cast<long>(d_left) * d_left;
+        std::vector<double> Pinf(ddn), dPinf((h_left + part.n_hyp) * ddn);
+        std::vector<double> H(dn);
+        for ( int jl = 0; jl < d_left; ++jl )
+        for ( int jk = 0; jk < dk; ++jk )
+        for ( int il = 0; il < d_left; ++il )
+        for ( int ik = 0; ik < dk; ++ik ) {
+            long to = il * dk + ik + static_cast<long>(jl * dk + jk) * dn;
+            double left = s.Pinf[il + jl * d_left];
+            double right = part.Pinf[ik + jk * dk];
+            Pinf[to] = left * right;
+            for ( int q = 0; q < h_left; ++q ) {
+                dPinf[q * ddn + to] = s.dPinf[q * ddl + il + jl * d_left]
+                    * right;
+            }
+            for ( int q = 0; q < part.n_hyp; ++q ) {
+                dPinf[(h_left + q) * ddn + to]
+                    = left * part.dPinf[q * ddk + ik + jk * dk];
+            }
+        }
+        for ( int il = 0; il < d_left; ++il ) {
+            for ( int ik = 0; ik < dk; ++ik ) {
+                H[il * dk + ik] = s.H[il] * part.H[ik];
+            }
+        }
+        s.Pinf.swap(Pinf);
+        s.dPinf.swap(dPinf);
+        s.H.swap(H);
+        d_left = dn;
+        h_left += part.n_hyp;
+    }
+    return true;
+}
+
+// A(dt) into A (d x d), and if dA is not null, dA / dhyp into its n_hyp
+// blocks
+void transition(const sde& s, double dt, double* A, double* dA) {
+    int d = s.d;
+    long dd = static_cast<long>(d) * d;
+    std::fill(A, A + dd, 0.0);
+    if ( dA ) {
+        std::fill(dA, dA + s.n_hyp * dd, 0.0);
+    }
+    if ( s.type == SS_MATERN ) {
+        // F is the companion matrix of (D + lambda)^d, so N = F + lambda I
+        // is nilpotent and A = exp(-lambda dt) sum_k (N dt)^k / k!
+        double lambda = s.lambda;
+        std::vector<double> F(dd, 0.0), N(dd), term(dd), next(dd);
+        double binomial = 1.0;
+        for ( int k = 0; k < d; ++k ) {
+            F[d - 1 + k * d] = -binomial * std::pow(lambda, d - k);
+            binomial = binomial * (d - k) / (k + 1);
+        }
+        for ( int k = 0; k + 1 < d; ++k ) {
+            F[k + (k + 1) * d] = 1.0;
+        }
+        N = F;
+        for ( int k = 0; k < d; ++k ) {
+            N[k + k * d] += lambda;
+        }
+        double decay = std::exp(-lambda * dt);
+        std::fill(term.begin(), term.end(), 0.0);
+        for ( int k = 0; k < d; ++k ) {
+            term[k + k * d] = 1.0;
+        }
+        for ( int power = 0; power < d; ++power ) {
+            for ( long u = 0; u < dd; ++u ) {
+                A[u] += decay * term[u];
+            }
+            std::fill(next.begin(), next.end(), 0.0);
+            add_product(&N[0], &term[0], &next[0], d);
+            for ( long u = 0; u < dd; ++u ) {
+                term[u] = next[u] * dt / (power + 1);
+            }
+        }
+        if ( dA ) {
+            // With K = diag(0, ..., d - 1), A = D A_1(lambda dt) inv(D) for
+            // D = lambda^K, so dA / dlog(lambda) = K A - A K + dt F A
+            std::vector<double> FA(dd, 0.0);
+            add_product(&F[0], A, &FA[0], d);
+            for ( int j = 0; j < d; ++j ) {
+                for ( int i = 0; i < d; ++i ) {
+                    long u = i + j * d;
+                    dA[u] = -((i - j) * A[u] + dt * FA[u]);
+                }
+            }
+        }
+        return;
+    }
+    if ( s.type == SS_COS || s.type == SS_PERIODIC
+         || s.type == SS_PERIODIC_NODC ) {
+        int p_block = s.type == SS_COS ? 0 : 1;
+        int i = 0;
+        for ( size_t k = 0; k < s.harmonics.size(); ++k ) {
+            int j = s.harmonics[k];
+            if ( j == 0 ) {
+                A[i + i * d] = 1.0;
+                i += 1;
+                continue;
+            }
+            double theta = j * s.omega * dt;
+            double cs = std::cos(theta);
+            double sn = std::sin(theta);
+            A[i + i * d] = cs;
+            A[i + 1 + i * d] = sn;
+            A[i + (i + 1) * d] = -sn;
+            A[i + 1 + (i + 1) * d] = cs;
+            if ( dA ) {
+                // dtheta / dlog(p) = -theta
+                double* block = dA + p_block * dd;
+                block[i + i * d] = theta * sn;
+                block[i + 1 + i * d] = -theta * cs;
+                block[i + (i + 1) * d] = theta * cs;
+                block[i + 1 + (i + 1) * d] = theta * sn;
+            }
+            i += 2;
+        }
+        return;
+    }
+    if ( s.type == SS_SUM ) {
+        int start = 0;
+        int h = 0;
+        for ( size_t k = 0; k < s.parts.size(); ++k ) {
+            const sde& part = s.parts[k];
+            int dk = part.d;
+            long ddk = static_cast<long>(dk) * dk;
+            std::vector<double> Ak(ddk), dAk(dA ? part.n_hyp * ddk : 0);
+            transition(part, dt, &Ak[0], dA ? &dAk[0] : 0);
+            for ( int j = 0; j < dk; ++j ) {
+                for ( int i = 0; i < dk; ++i ) {
+                    long to = start + i + (start + j) * static_cast<long>(d);
+                    A[to] = Ak[i + j * dk];
+                    for ( int q = 0; dA && q < part.n_hyp; ++q ) {
+                        dA[(h + q) * dd + to] = dAk[q * ddk + i + j * dk];
+                    }
+                }
+            }
+            start += dk;
+            h += part.n_hyp;
+        }
+        return;
+    }
+    std::vector<double> left(1, 1.0), dleft;
+    int d_left = 1;
+    int h_left = 0;
+    for ( size_t k = 0; k < s.parts.size(); ++k ) {
+        const sde& part = s.parts[k];
+        int dk = part.d;
+        long ddk = static_cast<long>(dk) * dk;
+        std::vector<double> Ak(ddk), dAk(dA ? part.n_hyp * ddk : 0);
+        transition(part, dt, &Ak[0], dA ? &dAk[0] : 0);
+        int dn = d_left * dk;
+        long ddn = static_cast<long>(dn) * dn;
+        long ddl = static_cast<long>(d_left) * d_left;
+        std::vector<double> An(ddn);
+        std::vector<double> dAn(dA ? (h_left + part.n_hyp) * ddn : 0);
+        for ( int jl = 0; jl < d_left; ++jl )
+        for ( int jk = 0; jk < dk; ++jk )
+        for ( int il = 0; il < d_left; ++il )
+        for ( int ik = 0; ik < dk; ++ik ) {
+            long to = il * dk + ik + static_cast<long>(jl * dk + jk) * dn;
+            double a_left = left[il + jl * d_left];
+            double a_right = Ak[ik + jk * dk];
+            An[to] = a_left * a_right;
+            if ( !dA ) {
+                continue;
+            }
+            for ( int q = 0; q < h_left; ++q ) {
+                dAn[q * ddn + to] = dleft[q * ddl + il + jl * d_left]
+                    * a_right;
+            }
+            for ( int q = 0; q < part.n_hyp; ++q ) {
+                dAn[(h_left + q) * ddn + to]
+                    = a_left * dAk[q * ddk + ik + jk * dk];
+            }
+        }
+        left.swap(An);
+        dleft.swap(dAn);
+        d_left = dn;
+        h_left += part.n_hyp;
+    }
+    std::copy(left.begin(), left.end(), A);
+    if ( dA ) {
+        std::copy(dleft.begin(), dleft.end(), dA);
+    }
+}
+
+// What the smoother needs from each step of the filter
+struct filter_path {
+    std::vector<double> m, P;            // filtered
+    std::vector<double> m_pred, P_pred;  // predicted
+    std::vector<double> A;               // transition into the step
+};
+
+// Runs the filter over the points in time order (t sorted), updating only
+// where observed; with derivatives, dnlz gets the gradient in
+// state_space_model's order (n_mean mean entries first, log(sn) last)
+bool kalman_filter(const sde& s, double mu, double sn2, int n_mean,
+                   const std::vector<double>& t, const std::vector<double>& y,
+                   const std::vector<char>& observed, bool derivatives,
+                   double& nlz, std::vector<double>& dnlz, filter_path* path) {
+    int d = s.d;
+    long dd = static_cast<long>(d) * d;
+    int n_steps = static_cast<int>(t.size());
+    int n_par = derivatives ? n_mean + s.n_hyp + 1 : 0;
+    int lik = n_par - 1;
+    std::vector<double> m(d, 0.0), P(s.Pinf);
+    std::vector<double> A(dd), dA(derivatives ? s.n_hyp * dd : 0);
+    std::vector<double> E(dd), W(dd), work(dd), T(dd), Ph(d), dPh(d);
+    std::vector<double> m_prev(d);
+    std::vector<double> dm(n_par * d, 0.0), dP(n_par * dd, 0.0);
+    std::vector<double> dm_prev(d), dS(n_par), dv(n_par);
+    for ( int q = 0; q < s.n_hyp && derivatives; ++q ) {
+        std::copy(s.dPinf.begin() + q * dd, s.dPinf.begin() + (q + 1) * dd,
+                  dP.begin() + (n_mean + q) * dd);
+    }
+    if ( path ) {
+        path->m.resize(n_steps * d);
+        path->P.resize(n_steps * dd);
+        path->m_pred.resize(n_steps * d);
+        path->P_pred.resize(n_steps * dd);
+        path->A.resize(n_steps * dd);
+    }
+    nlz = 0.0;
+    dnlz.assign(n_par, 0.0);
+    for ( int k = 0; k < n_steps; ++k ) {
+        if ( k == 0 ) {
+            std::fill(A.begin(), A.end(), 0.0);
+        }
+        else {
+            // m = A m, P = Pinf + A (P - Pinf) A'
+            transition(s, t[k] - t[k - 1], &A[0], derivatives ? &dA[0] : 0);
+            for ( long u = 0; u < dd; ++u ) {
+                E[u] = P[u] - s.Pinf[u];
+            }
+            m_prev = m;
+            std::fill(m.begin(), m.end(), 0.0);
+            add_product_vector(&A[0], &m_prev[0], &m[0], d);
+            congruence(&A[0], &E[0], &P[0], &work[0], d);
+            for ( long u = 0; u < dd; ++u ) {
+                P[u] += s.Pinf[u];
+            }
+            if ( derivatives ) {
+                // W = E A'
+                std::fill(work.begin(), work.end(), 0.0);
+                add_product(&A[0], &E[0], &work[0], d);
+                for ( int j = 0; j < d; ++j ) {
+                    for ( int i = 0; i < d; ++i ) {
+                        W[i + j * d] = work[j + i * d];
+                    }
+                }
+                for ( int q = 0; q < n_par; ++q ) {
+                    int c = q - n_mean;
+                    bool is_cov = c >= 0 && c < s.n_hyp;
+                    double* dmq = &dm[q * d];
+                    double* dPq = &dP[q * dd];
+                    // dm = dA m + A dm
+                    std::copy(dmq, dmq + d, dm_prev.begin());
+                    std::fill(dmq, dmq + d, 0.0);
+                    add_product_vector(&A[0], &dm_prev[0], dmq, d);
+                    // dP = dPinf + A (dP - dPinf) A' + dA E A' + A E dA'
+                    if ( is_cov ) {
+                        for ( long u = 0; u < dd; ++u ) {
+                            dPq[u] -= s.dPinf[c * dd + u];
+                        }
+                    }
+                    congruence(&A[0], dPq, &T[0], &work[0], d);
+                    std::copy(T.begin(), T.end(), dPq);
+                    if ( is_cov ) {
+                        const double* dAc = &dA[c * dd];
+                        add_product_vector(dAc, &m_prev[0], dmq, d);
+                        std::fill(T.begin(), T.end(), 0.0);
+                        add_product(dAc, &W[0], &T[0], d);
+                        for ( int j = 0; j < d; ++j ) {
+                            for ( int i = 0; i < d; ++i ) {
+                                dPq[i + j * d] += T[i + j * d] + T[j + i * d]
+                                    + s.dPinf[c * dd + i + j * d];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        if ( path ) {
+            std::copy(m.begin(), m.end(), path->m_pred.begin() + k * d);
+            std::copy(P.begin(), P.end(), path->P_pred.begin() + k * dd);
+            std::copy(A.begin(), A.end(), path->A.begin() + k * dd);
+        }
+        if ( observed[k] ) {
+            // Update with y = H x + mu + noise
+            double S = sn2;
+            double v = y[k] - mu;
+            for ( int i = 0; i < d; ++i ) {
+                double sum = 0.0;
+                for ( int j = 0; j < d; ++j ) {
+                    sum += P[i + j * d] * s.H[j];
+                }
+                Ph[i] = sum;
+                S += s.H[i] * sum;
+                v -= s.H[i] * m[i];
+            }
+            if ( !(S > 0.0) ) {
+                return false;
+            }
+            nlz += 0.5 * (LOG_2PI + std::log(S) + v * v / S);
+            for ( int q = 0; q < n_par; ++q ) {
+                double* dmq = &dm[q * d];
+                double* dPq = &dP[q * dd];
+                double dSq = q == lik ? 2.0 * sn2 : 0.0;
+                double dvq = q < n_mean ? -1.0 : 0.0;
+                for ( int i = 0; i < d; ++i ) {
+                    double sum = 0.0;
+                    for ( int j = 0; j < d; ++j ) {
+                        sum += dPq[i + j * d] * s.H[j];
+                    }
+                    dPh[i] = sum;
+                    dSq += s.H[i] * sum;
+                    dvq -= s.H[i] * dmq[i];
+                }
+                dnlz[q] += 0.5 * dSq / S + v * dvq / S
+                    - 0.5 * v * v * dSq / (S * S);
+                // dm = dm + dK v + K dv, dP = dP - d(Ph Ph' / S)
+                for ( int i = 0; i < d; ++i ) {
+                    double dK = dPh[i] / S - Ph[i] * dSq / (S * S);
+                    dmq[i] += dK * v + Ph[i] / S * dvq;
+                }
+                for ( int j = 0; j < d; ++j ) {
+                    for ( int i = 0; i < d; ++i ) {
+                        dPq[i + j * d] -= (dPh[i] * Ph[j] + Ph[i] * dPh[j])
+                            / S - Ph[i] * Ph[j] * dSq / (S * S);
+                    }
+                }
+            }
+            for ( int i = 0; i < d; ++i ) {
+                m[i] += Ph[i] / S * v;
+            }
+            for ( int j = 0; j < d; ++j ) {
+                for ( int i = 0; i <= j; ++i ) {
+                    double value = 0.5 * (P[i + j * d] + P[j + i * d])
+                        - Ph[i] * Ph[j] / S;
+                    P[i + j * d] = P[j + i * d] = value;
+                }
+            }
+        }
+        if ( path ) {
+            std::copy(m.begin(), m.end(), path->m.begin() + k * d);
+            std::copy(P.begin(), P.end(), path->P.begin() + k * dd);
+        }
+    }
+    return true;
+}
+
+// Solves the symmetric positive semidefinite S X = B (nrhs columns) in
+// place, by Cholesky or, if S is numerically singular, its pseudoinverse
+void solve_psd(const double* S, int d, double* B, int nrhs) {
+    long dd = static_cast<long>(d) * d;
+    std::vector<double> R(S, S + dd);
+    if ( chol_upper(&R[0], d) ) {
+        solve_chol(&R[0], d, B, nrhs);
+        return;
+    }
+    std::vector<double> V(S, S + dd), values(d);
+    sym_eigen(&V[0], d, &values[0]);
+    double cutoff = d * 1e-13 * std::max(values[d - 1], 0.0);
+    std::vector<double> projected(d);
+    for ( int r = 0; r < nrhs; ++r ) {
+        double* b = B + static_cast<long>(r) * d;
+        for ( int k = 0; k < d; ++k ) {
+            double sum = 0.0;
+            for ( int i = 0; i < d; ++i ) {
+                sum += V[i + k * d] * b[i];
+            }
+            projected[k] = values[k] > cutoff ? sum / values[k] : 0.0;
+        }
+        for ( int i = 0; i < d; ++i ) {
+            double sum = 0.0;
+            for ( int k = 0; k < d; ++k ) {
+                sum += V[i + k * d] * projected[k];
+            }
+            b[i] = sum;
+        }
+    }
+}
+
+// Rauch-Tung-Striebel: the smoothed mean and variance of f = H x at every
+// step
+void rts_smoother(const sde& s, const filter_path& path, int n_steps,
+                  double* mean, double* variance) {
+    int d = s.d;
+    long dd = static_cast<long>(d) * d;
+    std::vector<double> ms(path.m.end() - d, path.m.end());
+    std::vector<double> Ps(path.P.end() - dd, path.P.end());
+    std::vector<double> G(dd), GT(dd), diff(d), Pdiff(dd), work(dd);
+    std::vector<double> next_ms(d), next_Ps(dd);
+    for ( int k = n_steps - 1; k >= 0; --k ) {
+        if ( k < n_steps - 1 ) {
+            // G' = inv(P_pred[k + 1]) A[k + 1] P[k]
+            const double* A = &path.A[(k + 1) * dd];
+            const double* P = &path.P[k * dd];
+            const double* P_pred = &path.P_pred[(k + 1) * dd];
+            std::fill(GT.begin(), GT.end(), 0.0);
+            add_product(A, P, &GT[0], d);
+            solve_psd(P_pred, d, &GT[0], d);
+            for ( int j = 0; j < d; ++j ) {
+                for ( int i = 0; i < d; ++i ) {
+                    G[i + j * d] = GT[j + i * d];
+                }
+            }
+            for ( int i = 0; i < d; ++i ) {
+                diff[i] = next_ms[i] - path.m_pred[(k + 1) * d + i];
+            }
+            for ( long u = 0; u < dd; ++u ) {
+                Pdiff[u] = next_Ps[u] - P_pred[u];
+            }
+            for ( int i = 0; i < d; ++i ) {
+                double sum = path.m[k * d + i];
+                for ( int j = 0; j < d; ++j ) {
+                    sum += G[i + j * d] * diff[j];
+                }
+                ms[i] = sum;
+            }
+            congruence(&G[0], &Pdiff[0], &Ps[0], &work[0], d);
+            for ( long u = 0; u < dd; ++u ) {
+                Ps[u] += P[u];
+            }
+        }
+        double mu = 0.0;
+        double var = 0.0;
+        for ( int i = 0; i < d; ++i ) {
+            mu += s.H[i] * ms[i];
+            for ( int j = 0; j < d; ++j ) {
+                var += s.H[i] * Ps[i + j * d] * s.H[j];
+            }
+        }
+        mean[k] = mu;
+        variance[k] = std::max(var, 0.0);
+        next_ms = ms;
+        next_Ps = Ps;
+    }
+}
+
+// The points in time order (training before test where tied), as indices
+// into x (training) or n + index into xs (test)
+void time_order(const double* x, int n, const double* xs, int ns,
+                std::vector<int>& order, std::vector<double>& t) {
+    order.resize(n + ns);
+    for ( int i = 0; i < n + ns; ++i ) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        double ta = a < n ? x[a] : xs[a - n];
+        double tb = b < n ? x[b] : xs[b - n];
+        return ta < tb;
+    });
+    t.resize(n + ns);
+    for ( int k = 0; k < n + ns; ++k ) {
+        t[k] = order[k] < n ? x[order[k]] : xs[order[k] - n];
+    }
+}
+
+}
+
+int state_space_order(const state_space_model& model, const double* hyp) {
+    sde s;
+    if ( !build_sde(model.cov, hyp + model.n_mean(), s) ) {
+        return 0;
+    }
+    return s.d;
+}
+
+bool native_state_space(const state_space_model& model, const double* hyp,
+                        const double* x, const double* y, int n,
+                        double* nlz, double* dnlz, double* alpha) {
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    sde s;
+    if ( n < 1 || !build_sde(model.cov, hyp + n_mean, s) ) {
+        return false;
+    }
+    double mu = n_mean > 0 ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    std::vector<int> order;
+    std::vector<double> t;
+    time_order(x, n, 0, 0, order, t);
+    std::vector<double> y_sorted(n);
+    for ( int k = 0; k < n; ++k ) {
+        y_sorted[k] = y[order[k]];
+    }
+    std::vector<char> observed(n, 1);
+    std::vector<double> gradient;
+    filter_path path;
+    if ( !kalman_filter(s, mu, sn2, n_mean, t, y_sorted, observed,
+                        dnlz != 0, *nlz, gradient, alpha ? &path : 0) ) {
+        return false;
+    }
+    if ( dnlz ) {
+        std::copy(gradient.begin(), gradient.end(), dnlz);
+    }
+    if ( alpha ) {
+        // K alpha is the smoothed mean, and y - mu = (K + sn2 I) alpha
+        std::vector<double> mean(n), variance(n);
+        rts_smoother(s, path, n, &mean[0], &variance[0]);
+        for ( int k = 0; k < n; ++k ) {
+            alpha[order[k]] = (y_sorted[k] - mu - mean[k]) / sn2;
+        }
+    }
+    return true;
+}
+
+bool native_state_space_predict(const state_space_model& model,
+                                const double* hyp, const double* x,
+                                const double* y, int n, const double* xs,
+                                int ns, double* fmu, double* fs2,
+                                double* alpha) {
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    sde s;
+    if ( !build_sde(model.cov, hyp + n_mean, s) ) {
+        return false;
+    }
+    double mu = n_mean > 0 ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    // Test points go into the sequence as steps without an observation
+    std::vector<int> order;
+    std::vector<double> t;
+    time_order(x, n, xs, ns, order, t);
+    int n_steps = n + ns;
+    std::vector<double> values(n_steps, 0.0);
+    std::vector<char> observed(n_steps, 0);
+    for ( int k = 0; k < n_steps; ++k ) {
+        if ( order[k] < n ) {
+            values[k] = y[order[k]];
+            observed[k] = 1;
+        }
+    }
+    double nlz = 0.0;
+    std::vector<double> gradient;
+    filter_path path;
+    if ( !kalman_filter(s, mu, sn2, n_mean, t, values, observed, false, nlz,
+                        gradient, &path) ) {
+        return false;
+    }
+    std::vector<double> mean(n_steps), variance(n_steps);
+    rts_smoother(s, path, n_steps, &mean[0], &variance[0]);
+    for ( int k = 0; k < n_steps; ++k ) {
+        if ( order[k] >= n ) {
+            fmu[order[k] - n] = mu + mean[k];
+            fs2[order[k] - n] = variance[k];
+        }
+        else if ( alpha ) {
+            alpha[order[k]] = (values[k] - mu - mean[k]) / sn2;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#include "native.h"
+#include <thread>
+#include <atomic>
+
+// Set by gp_threads(); zero leaves the default at one thread per core
+static std::atomic<int> thread_budget(0);
+
+void set_thread_budget(int n_threads) {
+    thread_budget = n_threads > 0 ? n_threads : 0;
+}
+
+int available_cores() {
+    int n_cores = static_cast<int>(std::thread::hardware_concurrency());
+    return n_cores > 0 ? n_cores : 1;
+}
+
+int resolve_threads(int n_threads) {
+    if ( n_threads > 0 ) {
+        return n_threads;
+    }
+    int budget = thread_budget;
+    return budget > 0 ? budget : available_cores();
+}
+
+// Work is handed out one index at a time from a shared counter, since the
+// cost of an index (e.g. a failed Cholesky vs. a full gradient) can vary.
+// f must not call into R or Octave.
+void parallel_for(int n, int n_threads,
+                  const std::function<void(int, int)>& f) {
+    n_threads = resolve_threads(n_threads);
+    if ( n_threads > n ) {
+        n_threads = n;
+    }
+    if ( n_threads <= 1 ) {
+        for ( int i = 0; i < n; ++i ) {
+            f(i, 0);
+        }
+        return;
+    }
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for ( int t = 0; t < n_threads; ++t ) {
+        workers.push_back(std::thread([&next, &f, n, t]() {
+            for ( int i = next++; i < n; i = next++ ) {
+                f(i, t);
+            }
+        }));
+    }
+    for ( int t = 0; t < n_threads; ++t ) {
+        workers[t].join();
+    }
+}
@@ -0,0 +1,374 @@
+#include "native.h"
+#include <cmath>
+#include <complex>
+#include <algorithm>
+
+// Exact inference on a regular 1-D grid, where K + sn2 I is a symmetric
+// Toeplitz matrix T with first column c: the Levinson recursion (Golub and
+// Van Loan, Algorithm 4.7.2) for alpha and log det(T), Trench's algorithm
+// (Algorithm 4.7.3) for the sums along inv(T)'s diagonals, and the
+// Gohberg-Semencul formula, applied by FFT, for predictive variances.
+
+static const double LOG_2PI = 1.8378770664093454836;
+static const double PI = 3.14159265358979323846;
+static const int POINT_BLOCK = 64;
+
+namespace {
+
+typedef std::complex<double> complex;
+
+// Radix-2 FFT of a fixed length m (a power of two), with the twiddle factors
+// computed once
+struct fft_plan {
+    int m;
+    std::vector<complex> roots;   // exp(-2 pi i k / m) for k < m / 2
+    std::vector<int> reversed;    // bit reversal permutation
+    explicit fft_plan(int length) : m(1) {
+        while ( m < length ) {
+            m *= 2;
+        }
+        roots.resize(m / 2);
+        for ( int k = 0; k < m / 2; ++k ) {
+            roots[k] = std::polar(1.0, -2.0 * PI * k / m);
+        }
+        reversed.assign(m, 0);
+        int log_m = 0;
+        while ( (1 << log_m) < m ) {
+            ++log_m;
+        }
+        for ( int i = 0; i < m; ++i ) {
+            int r = 0;
+            for ( int b = 0; b < log_m; ++b ) {
+                r |= ((i >> b) & 1) << (log_m - 1 - b);
+            }
+            reversed[i] = r;
+        }
+    }
+    // In place; the inverse includes the 1 / m
+    void transform(complex* a, bool inverse) const {
+        for ( int i = 0; i < m; ++i ) {
+            if ( i < reversed[i] ) {
+                std::swap(a[i], a[reversed[i]]);
+            }
+        }
+        for ( int length = 2; length <= m; length *= 2 ) {
+            int half = length / 2;
+            int stride = m / length;
+            for ( int start = 0; start < m; start += length ) {
+                for ( int k = 0; k < half; ++k ) {
+                    complex w = roots[k * stride];
+                    if ( inverse ) {
+                        w = std::conj(w);
+                    }
+                    complex u = a[start + k];
+                    complex v = a[start + k + half] * w;
+                    a[start + k] = u + v;
+                    a[start + k + half] = u - v;
+                }
+            }
+        }
+        if ( inverse ) {
+            for ( int i = 0; i < m; ++i ) {
+                a[i] /= m;
+            }
+        }
+    }
+};
+
+// T's first column c (with sn2 added to c[0]), and if dc is not null, the
+// derivative of c with respect to each covariance hyperparameter in turn
+// (n entries each)
+void toeplitz_column(const native_model& model, const double* hyp,
+                     double step, int n, std::vector<double>& c,
+                     std::vector<double>* dc) {
+    const native_cov& cov = model.cov;
+    const double* cov_hyp = hyp + model.n_mean();
+    int n_cov = cov.n_hyp();
+    double inv_ell = std::exp(-cov_hyp[0]);
+    double sf2 = std::exp(2.0 * cov_hyp[1]);
+    double alpha = cov.type == COV_RQ ? std::exp(cov_hyp[2]) : 0.0;
+    double sn2 = std::exp(2.0 * hyp[model.n_mean() + n_cov]);
+    c.resize(n);
+    if ( dc ) {
+        dc->assign(static_cast<long>(n) * n_cov, 0.0);
+    }
+    for ( int k = 0; k < n; ++k ) {
+        double t = k * step * inv_ell;
+        double r2 = t * t;
+        double dr2 = 0.0;
+        double dalpha = 0.0;
+        double g = cov_profile(cov, alpha, r2, dc ? &dr2 : 0,
+                               dc && cov.type == COV_RQ ? &dalpha : 0);
+        c[k] = sf2 * g;
+        if ( dc ) {
+            (*dc)[k] = -2.0 * sf2 * dr2 * r2;
+            (*dc)[n + k] = 2.0 * sf2 * g;
+            if ( cov.type == COV_RQ ) {
+                (*dc)[2 * n + k] = sf2 * dalpha;
+            }
+        }
+    }
+    c[0] += sn2;
+}
+
+// Solves T x = b by the Levinson recursion for T with unit diagonal and
+// first column r, also returning the Yule-Walker solution y of order n - 1
+// (T_{n-1} y = -r(1:n-1)) and log det(T). Returns false if T is not
+// positive definite.
+bool levinson(const std::vector<double>& r, const std::vector<double>& b,
+              std::vector<double>& x, std::vector<double>& y,
+              double& log_det) {
+    int n = static_cast<int>(r.size());
+    x.assign(n, 0.0);
+    y.assign(std::max(n - 1, 1), 0.0);
+    std::vector<double> work(n);
+    x[0] = b[0];
+    log_det = 0.0;
+    if ( n == 1 ) {
+        return true;
+    }
+    y[0] = -r[1];
+    double beta = 1.0;
+    double a = -r[1];
+    for ( int k = 1; k < n; ++k ) {
+        beta *= 1.0 - a * a;
+        if ( !(beta > 0.0) ) {
+            return false;
+        }
+        log_det += std::log(beta);
+        double mu = b[k];
+        for ( int i = 0; i < k; ++i ) {
+            mu -= r[i + 1] * x[k - 1 - i];
+        }
+        mu /= beta;
+        for ( int i = 0; i < k; ++i ) {
+            work[i] = x[i] + mu * y[k - 1 - i];
+        }
+        std::copy(work.begin(), work.begin() + k, x.begin());
+        x[k] = mu;
+        if ( k < n - 1 ) {
+            a = -r[k + 1];
+            for ( int i = 0; i < k; ++i ) {
+                a -= r[i + 1] * y[k - 1 - i];
+            }
+            a /= beta;
+            for ( int i = 0; i < k; ++i ) {
+                work[i] = y[i] + a * y[k - 1 - i];
+            }
+            std::copy(work.begin(), work.begin() + k, y.begin());
+            y[k] = a;
+        }
+    }
+    return true;
+}
+
+// The sums S[k] of inv(T)'s entries (i, j) with |i - j| = k, for T with unit
+// diagonal, from the Yule-Walker solution y of order n - 1. Trench's
+// algorithm computes B = inv(T) one row at a time on the wedge
+// i <= j <= n + 1 - i (1-based); symmetry and persymmetry give the rest,
+// each entry standing for up to four on the same pair of diagonals.
+void trench_diagonal_sums(const std::vector<double>& r,
+                          const std::vector<double>& y,
+                          std::vector<double>& S) {
+    int n = static_cast<int>(r.size());
+    S.assign(n, 0.0);
+    double gamma_inv = 1.0;
+    for ( int i = 0; i < n - 1; ++i ) {
+        gamma_inv += r[i + 1] * y[i];
+    }
+    double gamma = 1.0 / gamma_inv;
+    // v(m) = gamma y(n - m), 1-based
+    std::vector<double> v(n + 1, 0.0);
+    for ( int m = 1; m <= n - 1; ++m ) {
+        v[m] = gamma * y[n - m - 1];
+    }
+    // Rows of B, 1-based columns
+    std::vector<double> previous(n + 2, 0.0), current(n + 2, 0.0);
+    previous[1] = gamma;
+    for ( int j = 2; j <= n; ++j ) {
+        previous[j] = v[n + 1 - j];
+    }
+    for ( int j = 1; j <= n; ++j ) {
+        double weight = (j == 1 ? 1.0 : 2.0) * (1 + j == n + 1 ? 1.0 : 2.0);
+        S[j - 1] += weight * previous[j];
+    }
+    for ( int i = 2; i <= (n - 1) / 2 + 1; ++i ) {
+        for ( int j = i; j <= n - i + 1; ++j ) {
+            current[j] = previous[j - 1]
+                + (v[n + 1 - j] * v[n + 1 - i] - v[i - 1] * v[j - 1])
+                / gamma;
+            double weight = (i == j ? 1.0 : 2.0)
+                * (i + j == n + 1 ? 1.0 : 2.0);
+            S[j - i] += weight * current[j];
+        }
+        std::swap(previous, current);
+    }
+}
+
+}
+
+bool regular_grid(const double* x, int n, std::vector<int>& order,
+                  double& step) {
+    if ( n < 2 ) {
+        return false;
+    }
+    order.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(),
+              [x](int i, int j) { return x[i] < x[j]; });
+    double x0 = x[order[0]];
+    step = (x[order[n - 1]] - x0) / (n - 1);
+    if ( !(step > 0.0) ) {
+        return false;
+    }
+    for ( int i = 1; i < n; ++i ) {
+        if ( std::fabs(x[order[i]] - (x0 + i * step)) > 1e-7 * step ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// NLZ = (y - m)' alpha / 2 + log det(T) / 2 + n log(2 pi) / 2, and
+// dNLZ / dtheta = (sum_k dc_k (S_k - A_k)) / 2, where S_k sums inv(T) and
+// A_k sums alpha alpha' along the diagonals |i - j| = k; A comes from one
+// FFT of alpha
+bool native_toeplitz(const native_model& model, const double* hyp,
+                     double step, const double* y, int n, bool derivatives,
+                     toeplitz_result& result) {
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    double m = n_mean > 0 ? hyp[0] : 0.0;
+    std::vector<double> c, dc;
+    toeplitz_column(model, hyp, step, n, c, derivatives ? &dc : 0);
+    double c0 = c[0];
+    std::vector<double> r(n), b(n);
+    for ( int k = 0; k < n; ++k ) {
+        r[k] = c[k] / c0;
+        b[k] = (y[k] - m) / c0;
+    }
+    std::vector<double> yule_walker;
+    double log_det = 0.0;
+    if ( !levinson(r, b, result.alpha, yule_walker, log_det) ) {
+        return false;
+    }
+    log_det += n * std::log(c0);
+    double fit = 0.0;
+    for ( int k = 0; k < n; ++k ) {
+        fit += (y[k] - m) * result.alpha[k];
+    }
+    result.nlz = fit / 2.0 + log_det / 2.0 + n * LOG_2PI / 2.0;
+    // The first column of inv(T) is gamma (1, y) / c0
+    result.first.resize(n);
+    double gamma_inv = 1.0;
+    for ( int i = 0; i < n - 1; ++i ) {
+        gamma_inv += r[i + 1] * yule_walker[i];
+    }
+    result.first[0] = 1.0 / (gamma_inv * c0);
+    for ( int i = 1; i < n; ++i ) {
+        result.first[i] = yule_walker[i - 1] * result.first[0];
+    }
+    if ( !derivatives ) {
+        result.dnlz.clear();
+        return true;
+    }
+    std::vector<double> S;
+    trench_diagonal_sums(r, yule_walker, S);
+    fft_plan plan(2 * n);
+    std::vector<complex> spectrum(plan.m, 0.0);
+    for ( int k = 0; k < n; ++k ) {
+        spectrum[k] = result.alpha[k];
+    }
+    plan.transform(&spectrum[0], false);
+    for ( int k = 0; k < plan.m; ++k ) {
+        spectrum[k] = std::norm(spectrum[k]);
+    }
+    plan.transform(&spectrum[0], true);
+    std::vector<double> difference(n);
+    for ( int k = 0; k < n; ++k ) {
+        double A = (k == 0 ? 1.0 : 2.0) * spectrum[k].real();
+        difference[k] = S[k] / c0 - A;
+    }
+    result.dnlz.assign(model.n_hyp(), 0.0);
+    double alpha_sum = 0.0;
+    for ( int k = 0; k < n; ++k ) {
+        alpha_sum += result.alpha[k];
+    }
+    if ( n_mean > 0 ) {
+        result.dnlz[0] = -alpha_sum;
+    }
+    for ( int i = 0; i < n_cov; ++i ) {
+        double sum = 0.0;
+        for ( int k = 0; k < n; ++k ) {
+            sum += dc[static_cast<long>(i) * n + k] * difference[k];
+        }
+        result.dnlz[n_mean + i] = sum / 2.0;
+    }
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    result.dnlz[n_mean + n_cov] = sn2 * difference[0];
+    return true;
+}
+
+// By Gohberg-Semencul, with x the first column of inv(T) and
+// z = (0, x_{n-1}, ..., x_1), inv(T) = (L(x) L(x)' - L(z) L(z)') / x_0 for
+// the lower triangular Toeplitz L(.), so k' inv(T) k needs only L(x)' k and
+// L(z)' k: correlations, done by FFT with x, z, and k zero-padded to at
+// least 2n so nothing wraps around
+void native_toeplitz_predict(const native_model& model, const double* hyp,
+                             double x0, double step, int n,
+                             const toeplitz_result& result, const double* xs,
+                             int ns, double* fmu, double* fs2,
+                             int n_threads) {
+    const native_cov& cov = model.cov;
+    const double* cov_hyp = hyp + model.n_mean();
+    double m = model.n_mean() > 0 ? hyp[0] : 0.0;
+    double inv_ell = std::exp(-cov_hyp[0]);
+    double sf2 = std::exp(2.0 * cov_hyp[1]);
+    double alpha = cov.type == COV_RQ ? std::exp(cov_hyp[2]) : 0.0;
+    fft_plan plan(2 * n);
+    std::vector<complex> X(plan.m, 0.0), Z(plan.m, 0.0);
+    for ( int k = 0; k < n; ++k ) {
+        X[k] = result.first[k];
+        if ( k > 0 ) {
+            Z[k] = result.first[n - k];
+        }
+    }
+    plan.transform(&X[0], false);
+    plan.transform(&Z[0], false);
+    // Both correlations are real, so one inverse transform gives L(x)' k as
+    // its real part and L(z)' k as its imaginary part
+    std::vector<complex> XZ(plan.m);
+    for ( int k = 0; k < plan.m; ++k ) {
+        XZ[k] = std::conj(X[k]) + complex(0.0, 1.0) * std::conj(Z[k]);
+    }
+    int n_blocks = (ns + POINT_BLOCK - 1) / POINT_BLOCK;
+    parallel_for(n_blocks, n_threads, [&](int b, int) {
+        std::vector<double> ks(n);
+        std::vector<complex> K(plan.m), UW(plan.m);
+        int s1 = std::min(ns, (b + 1) * POINT_BLOCK);
+        for ( int s = b * POINT_BLOCK; s < s1; ++s ) {
+            double mu = m;
+            std::fill(K.begin(), K.end(), 0.0);
+            for ( int i = 0; i < n; ++i ) {
+                double t = (xs[s] - (x0 + i * step)) * inv_ell;
+                ks[i] = sf2 * cov_profile(cov, alpha, t * t);
+                mu += ks[i] * result.alpha[i];
+                K[i] = ks[i];
+            }
+            plan.transform(&K[0], false);
+            for ( int k = 0; k < plan.m; ++k ) {
+                UW[k] = XZ[k] * K[k];
+            }
+            plan.transform(&UW[0], true);
+            double quadratic = 0.0;
+            for ( int i = 0; i < n; ++i ) {
+                quadratic += UW[i].real() * UW[i].real()
+                    - UW[i].imag() * UW[i].imag();
+            }
+            fmu[s] = mu;
+            fs2[s] = std::max(sf2 - quadratic / result.first[0], 0.0);
+        }
+    });
+}
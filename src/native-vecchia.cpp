@@ -0,0 +1,569 @@
+#include "native.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Nearest neighbour (Vecchia) GPs: a k-d tree over the inputs, the maxmin
+// ordering and each point's nearest earlier neighbours (found once, before
+// any hyperparameters are tried), and the Vecchia likelihood, which is a
+// sum over points of the negative log density of y_i given the y of its
+// neighbours. As in Guinness (2018) the noise is included, i.e. it is the
+// y rather than the latent f that are conditioned on each other.
+
+static const int LEAF_SIZE = 16;
+static const int POINT_BLOCK = 256;
+static const double LOG_2PI = 1.8378770664093454836;
+
+namespace {
+
+// Splits point[begin, end) at the median of its widest dimension
+int build_node(const double* x, int n, int dim, int begin, int end,
+               kd_tree& tree) {
+    int index = static_cast<int>(tree.nodes.size());
+    kd_node node;
+    node.begin = begin;
+    node.end = end;
+    node.left = -1;
+    node.right = -1;
+    node.min_rank = 0;
+    tree.nodes.push_back(node);
+    tree.box.resize(tree.box.size() + 2 * dim);
+    double* lower = &tree.box[static_cast<long>(index) * 2 * dim];
+    double* upper = lower + dim;
+    for ( int d = 0; d < dim; ++d ) {
+        const double* xd = x + static_cast<long>(d) * n;
+        lower[d] = upper[d] = xd[tree.point[begin]];
+        for ( int p = begin + 1; p < end; ++p ) {
+            double v = xd[tree.point[p]];
+            lower[d] = std::min(lower[d], v);
+            upper[d] = std::max(upper[d], v);
+        }
+    }
+    if ( end - begin <= LEAF_SIZE ) {
+        return index;
+    }
+    int split = 0;
+    for ( int d = 1; d < dim; ++d ) {
+        if ( upper[d] - lower[d] > upper[split] - lower[split] ) {
+            split = d;
+        }
+    }
+    if ( !(upper[split] > lower[split]) ) {
+        return index;  // all the points coincide
+    }
+    const double* xs = x + static_cast<long>(split) * n;
+    int middle = begin + (end - begin) / 2;
+    std::nth_element(tree.point.begin() + begin, tree.point.begin() + middle,
+                     tree.point.begin() + end,
+                     [xs](int a, int b) { return xs[a] < xs[b]; });
+    int left = build_node(x, n, dim, begin, middle, tree);
+    int right = build_node(x, n, dim, middle, end, tree);
+    tree.nodes[index].left = left;
+    tree.nodes[index].right = right;
+    return index;
+}
+
+// The squared distance from q to node's bounding box
+inline double box_distance(const kd_tree& tree, int node, const double* q) {
+    int dim = tree.dim;
+    const double* lower = &tree.box[static_cast<long>(node) * 2 * dim];
+    const double* upper = lower + dim;
+    double d2 = 0.0;
+    for ( int d = 0; d < dim; ++d ) {
+        double gap = q[d] < lower[d] ? lower[d] - q[d]
+                   : q[d] > upper[d] ? q[d] - upper[d] : 0.0;
+        d2 += gap * gap;
+    }
+    return d2;
+}
+
+inline double point_distance(const kd_tree& tree, int position,
+                             const double* q) {
+    const double* p = &tree.coords[static_cast<long>(position) * tree.dim];
+    double d2 = 0.0;
+    for ( int d = 0; d < tree.dim; ++d ) {
+        double diff = p[d] - q[d];
+        d2 += diff * diff;
+    }
+    return d2;
+}
+
+// The best k candidates so far, as a max-heap on distance
+struct nearest_search {
+    const kd_tree& tree;
+    const double* q;
+    int k;
+    int limit;
+    std::vector< std::pair<double, int> > heap;
+    nearest_search(const kd_tree& tree, const double* q, int k, int limit)
+        : tree(tree), q(q), k(k), limit(limit) {}
+    void visit(int index, double d2_box) {
+        const kd_node& node = tree.nodes[index];
+        if ( limit >= 0 && node.min_rank >= limit ) {
+            return;
+        }
+        if ( static_cast<int>(heap.size()) == k
+             && d2_box >= heap.front().first ) {
+            return;
+        }
+        if ( node.left < 0 ) {
+            for ( int p = node.begin; p < node.end; ++p ) {
+                int i = tree.point[p];
+                if ( limit >= 0 && tree.rank[i] >= limit ) {
+                    continue;
+                }
+                double d2 = point_distance(tree, p, q);
+                if ( static_cast<int>(heap.size()) < k ) {
+                    heap.push_back(std::make_pair(d2, i));
+                    std::push_heap(heap.begin(), heap.end());
+                }
+                else if ( d2 < heap.front().first ) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = std::make_pair(d2, i);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            return;
+        }
+        double d2_left = box_distance(tree, node.left, q);
+        double d2_right = box_distance(tree, node.right, q);
+        if ( d2_left <= d2_right ) {
+            visit(node.left, d2_left);
+            visit(node.right, d2_right);
+        }
+        else {
+            visit(node.right, d2_right);
+            visit(node.left, d2_left);
+        }
+    }
+};
+
+// Calls f(i, d2) for every point i less than sqrt(r2) from q
+template <typename F>
+void kd_within(const kd_tree& tree, int index, const double* q, double r2,
+               F& f) {
+    if ( box_distance(tree, index, q) >= r2 ) {
+        return;
+    }
+    const kd_node& node = tree.nodes[index];
+    if ( node.left < 0 ) {
+        for ( int p = node.begin; p < node.end; ++p ) {
+            double d2 = point_distance(tree, p, q);
+            if ( d2 < r2 ) {
+                f(tree.point[p], d2);
+            }
+        }
+        return;
+    }
+    kd_within(tree, node.left, q, r2, f);
+    kd_within(tree, node.right, q, r2, f);
+}
+
+// A max-heap of the points not yet ordered, keyed by their squared distance
+// to those that are, which only ever decreases
+struct distance_heap {
+    std::vector<double> key;
+    std::vector<int> heap;
+    std::vector<int> position;  // -1 once a point has left the heap
+    explicit distance_heap(const std::vector<double>& keys)
+        : key(keys), heap(keys.size()), position(keys.size()) {
+        int n = static_cast<int>(keys.size());
+        for ( int i = 0; i < n; ++i ) {
+            heap[i] = i;
+            position[i] = i;
+        }
+        for ( int i = n / 2 - 1; i >= 0; --i ) {
+            sift_down(i);
+        }
+    }
+    bool empty() const { return heap.empty(); }
+    int pop() {
+        int top = heap[0];
+        position[top] = -1;
+        int last = heap.back();
+        heap.pop_back();
+        if ( !heap.empty() ) {
+            heap[0] = last;
+            position[last] = 0;
+            sift_down(0);
+        }
+        return top;
+    }
+    void decrease(int i, double value) {
+        key[i] = value;
+        sift_down(position[i]);
+    }
+    void sift_down(int at) {
+        int size = static_cast<int>(heap.size());
+        int i = heap[at];
+        while ( true ) {
+            int child = 2 * at + 1;
+            if ( child >= size ) {
+                break;
+            }
+            if ( child + 1 < size && key[heap[child + 1]] > key[heap[child]] ) {
+                ++child;
+            }
+            if ( key[heap[child]] <= key[i] ) {
+                break;
+            }
+            heap[at] = heap[child];
+            position[heap[at]] = at;
+            at = child;
+        }
+        heap[at] = i;
+        position[i] = at;
+    }
+};
+
+void maxmin_order(const double* x, int n, int dim, const kd_tree& tree,
+                  std::vector<int>& order) {
+    order.clear();
+    order.reserve(n);
+    // The first point is the one nearest the mean
+    std::vector<double> centre(dim, 0.0);
+    for ( int d = 0; d < dim; ++d ) {
+        const double* xd = x + static_cast<long>(d) * n;
+        for ( int i = 0; i < n; ++i ) {
+            centre[d] += xd[i];
+        }
+        centre[d] /= n;
+    }
+    std::vector<int> first;
+    kd_nearest(tree, &centre[0], 1, -1, first);
+    // Every other point's distance to it starts the heap
+    std::vector<double> d2(n);
+    for ( int i = 0; i < n; ++i ) {
+        double s = 0.0;
+        for ( int d = 0; d < dim; ++d ) {
+            double diff = x[static_cast<long>(d) * n + i]
+                        - x[static_cast<long>(d) * n + first[0]];
+            s += diff * diff;
+        }
+        d2[i] = s;
+    }
+    d2[first[0]] = std::numeric_limits<double>::infinity();
+    distance_heap remaining(d2);
+    std::vector<double> q(dim);
+    // Only points nearer the newly ordered point than to any earlier one
+    // change, and they all lie within its own distance to the earlier ones
+    auto update = [&remaining](int i, double d2_new) {
+        if ( remaining.position[i] >= 0 && d2_new < remaining.key[i] ) {
+            remaining.decrease(i, d2_new);
+        }
+    };
+    while ( !remaining.empty() ) {
+        int i = remaining.pop();
+        order.push_back(i);
+        if ( order.size() == 1 ) {
+            continue;
+        }
+        for ( int d = 0; d < dim; ++d ) {
+            q[d] = x[static_cast<long>(d) * n + i];
+        }
+        kd_within(tree, 0, &q[0], remaining.key[i], update);
+    }
+}
+
+}
+
+void build_kd_tree(const double* x, int n, int dim, kd_tree& tree) {
+    tree.n = n;
+    tree.dim = dim;
+    tree.point.resize(n);
+    for ( int i = 0; i < n; ++i ) {
+        tree.point[i] = i;
+    }
+    tree.nodes.clear();
+    tree.box.clear();
+    tree.rank.clear();
+    if ( n > 0 ) {
+        build_node(x, n, dim, 0, n, tree);
+    }
+    tree.coords.resize(static_cast<long>(n) * dim);
+    for ( int p = 0; p < n; ++p ) {
+        for ( int d = 0; d < dim; ++d ) {
+            tree.coords[static_cast<long>(p) * dim + d]
+                = x[static_cast<long>(d) * n + tree.point[p]];
+        }
+    }
+}
+
+// Children always come after their parent, so a backwards pass sees them
+// first
+void kd_set_rank(kd_tree& tree, const std::vector<int>& rank) {
+    tree.rank = rank;
+    for ( int index = static_cast<int>(tree.nodes.size()) - 1; index >= 0;
+          --index ) {
+        kd_node& node = tree.nodes[index];
+        if ( node.left < 0 ) {
+            node.min_rank = std::numeric_limits<int>::max();
+            for ( int p = node.begin; p < node.end; ++p ) {
+                node.min_rank = std::min(node.min_rank, rank[tree.point[p]]);
+            }
+        }
+        else {
+            node.min_rank = std::min(tree.nodes[node.left].min_rank,
+                                     tree.nodes[node.right].min_rank);
+        }
+    }
+}
+
+void kd_nearest(const kd_tree& tree, const double* q, int k, int limit,
+                std::vector<int>& result) {
+    result.clear();
+    if ( k <= 0 || tree.nodes.empty() ) {
+        return;
+    }
+    nearest_search search(tree, q, k, limit);
+    search.visit(0, box_distance(tree, 0, q));
+    std::sort_heap(search.heap.begin(), search.heap.end());
+    for ( size_t j = 0; j < search.heap.size(); ++j ) {
+        result.push_back(search.heap[j].second);
+    }
+}
+
+void kd_radius(const kd_tree& tree, const double* q, double r2,
+               std::vector<int>& result, std::vector<double>& d2) {
+    std::vector< std::pair<int, double> > found;
+    if ( !tree.nodes.empty() ) {
+        auto collect = [&](int i, double d2_i) {
+            found.push_back(std::make_pair(i, d2_i));
+        };
+        kd_within(tree, 0, q, r2, collect);
+    }
+    std::sort(found.begin(), found.end());
+    result.resize(found.size());
+    d2.resize(found.size());
+    for ( size_t k = 0; k < found.size(); ++k ) {
+        result[k] = found[k].first;
+        d2[k] = found[k].second;
+    }
+}
+
+void vecchia_index(const double* x, int n, int dim, int m, int n_threads,
+                   std::vector<int>& order, std::vector<int>& neighbours) {
+    kd_tree tree;
+    build_kd_tree(x, n, dim, tree);
+    maxmin_order(x, n, dim, tree, order);
+    std::vector<int> rank(n);
+    for ( int r = 0; r < n; ++r ) {
+        rank[order[r]] = r;
+    }
+    kd_set_rank(tree, rank);
+    neighbours.assign(static_cast<long>(n) * m, -1);
+    int n_blocks = (n + POINT_BLOCK - 1) / POINT_BLOCK;
+    parallel_for(n_blocks, n_threads, [&](int b, int) {
+        std::vector<double> q(dim);
+        std::vector<int> found;
+        int end = std::min(n, (b + 1) * POINT_BLOCK);
+        for ( int i = b * POINT_BLOCK; i < end; ++i ) {
+            for ( int d = 0; d < dim; ++d ) {
+                q[d] = x[static_cast<long>(d) * n + i];
+            }
+            kd_nearest(tree, &q[0], std::min(m, rank[i]), rank[i], found);
+            std::copy(found.begin(), found.end(),
+                      neighbours.begin() + static_cast<long>(i) * m);
+        }
+    });
+}
+
+// Point i's term is the negative log density of y_i given its neighbours'
+// y, which the Cholesky factor R of their joint covariance C (with i last)
+// gives directly: R's last diagonal entry is the conditional standard
+// deviation, and the last entry of R' \ (y - m) the standardized residual.
+// Its gradient is that of the joint block's NLZ minus that of the
+// neighbours' alone, 0.5 * sum(sum(Q .* dC)) with
+// Q = (1 / v - r^2 / v^2) b b' - (r / v) (a b' + b a'), where r and v are
+// the conditional residual and variance, b = [-inv(C_NN) C_Ni; 1], and
+// a = [inv(C_NN) (y_N - m); 0].
+bool native_vecchia(const native_model& model, const double* hyp,
+                    const double* x, const double* y, int n,
+                    const int* neighbours, int m, double* nlz, double* dnlz,
+                    int n_threads) {
+    const native_cov& cov = model.cov;
+    int dim = cov.dim;
+    int n_mean = model.n_mean();
+    int n_cov = cov.n_hyp();
+    int n_hyp = model.n_hyp();
+    const double* cov_hyp = hyp + n_mean;
+    double mu = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + n_cov]);
+    n_threads = resolve_threads(n_threads);
+    std::vector<double> partial_nlz(n_threads, 0.0);
+    std::vector< std::vector<double> > partial_dnlz(
+        n_threads, std::vector<double>(n_hyp, 0.0));
+    std::vector<char> failed(n_threads, 0);
+    int n_blocks = (n + POINT_BLOCK - 1) / POINT_BLOCK;
+    parallel_for(n_blocks, n_threads, [&](int b, int thread) {
+        int s_max = m + 1;
+        std::vector<double> xb(static_cast<long>(s_max) * dim);
+        std::vector<double> R(static_cast<long>(s_max) * s_max);
+        std::vector<double> R_nn(static_cast<long>(m) * m);
+        std::vector<double> z(s_max), u(m), a(s_max), bv(s_max);
+        std::vector<double> Q(static_cast<long>(s_max) * s_max);
+        double* g = &partial_dnlz[thread][0];
+        int end = std::min(n, (b + 1) * POINT_BLOCK);
+        for ( int i = b * POINT_BLOCK; i < end && !failed[thread]; ++i ) {
+            const int* nb = neighbours + static_cast<long>(i) * m;
+            int k = 0;
+            while ( k < m && nb[k] >= 0 ) {
+                ++k;
+            }
+            int s = k + 1;
+            for ( int d = 0; d < dim; ++d ) {
+                const double* xd = x + static_cast<long>(d) * n;
+                for ( int j = 0; j < k; ++j ) {
+                    xb[static_cast<long>(d) * s + j] = xd[nb[j]];
+                }
+                xb[static_cast<long>(d) * s + k] = xd[i];
+            }
+            for ( int j = 0; j < k; ++j ) {
+                z[j] = y[nb[j]] - mu;
+            }
+            z[k] = y[i] - mu;
+            native_cov_cross(cov, cov_hyp, &xb[0], s, &xb[0], s, &R[0]);
+            for ( int j = 0; j < s; ++j ) {
+                R[static_cast<long>(j) * s + j] += sn2;
+            }
+            if ( !chol_upper(&R[0], s) ) {
+                failed[thread] = 1;
+                break;
+            }
+            if ( dnlz ) {
+                std::copy(z.begin(), z.begin() + k, a.begin());
+            }
+            solve_upper_transposed(&R[0], s, &z[0]);
+            double sd = R[static_cast<long>(k) * s + k];
+            partial_nlz[thread] += 0.5 * z[k] * z[k] + std::log(sd)
+                                 + 0.5 * LOG_2PI;
+            if ( !dnlz ) {
+                continue;
+            }
+            double v = sd * sd;
+            double r = z[k] * sd;
+            // u = inv(C_NN) C_Ni = inv(R_NN) w, with w R's last column
+            for ( int j = 0; j < k; ++j ) {
+                std::copy(R.begin() + static_cast<long>(j) * s,
+                          R.begin() + static_cast<long>(j) * s + k,
+                          R_nn.begin() + static_cast<long>(j) * k);
+            }
+            std::copy(R.begin() + static_cast<long>(k) * s,
+                      R.begin() + static_cast<long>(k) * s + k, u.begin());
+            if ( k > 0 ) {
+                solve_upper(&R_nn[0], k, &u[0]);
+                solve_chol(&R_nn[0], k, &a[0]);
+            }
+            a[k] = 0.0;
+            double sum_u = 0.0;
+            for ( int j = 0; j < k; ++j ) {
+                bv[j] = -u[j];
+                sum_u += u[j];
+            }
+            bv[k] = 1.0;
+            double c1 = (1.0 - r * r / v) / v;
+            double c2 = r / v;
+            double trace = 0.0;
+            for ( int c = 0; c < s; ++c ) {
+                for ( int j = 0; j < s; ++j ) {
+                    Q[static_cast<long>(c) * s + j] = 0.5 * (
+                        c1 * bv[j] * bv[c] - c2 * (a[j] * bv[c]
+                                                    + bv[j] * a[c]));
+                }
+                trace += Q[static_cast<long>(c) * s + c];
+            }
+            native_cov_cross_gradient(cov, cov_hyp, &xb[0], s, &xb[0], s,
+                                      &Q[0], g + n_mean, 0);
+            g[n_mean + n_cov] += 2.0 * sn2 * trace;
+            if ( model.mean == MEAN_CONST ) {
+                g[0] -= c2 * (1.0 - sum_u);
+            }
+        }
+    });
+    for ( int t = 0; t < n_threads; ++t ) {
+        if ( failed[t] ) {
+            return false;
+        }
+    }
+    *nlz = 0.0;
+    for ( int t = 0; t < n_threads; ++t ) {
+        *nlz += partial_nlz[t];
+    }
+    if ( dnlz ) {
+        for ( int h = 0; h < n_hyp; ++h ) {
+            dnlz[h] = 0.0;
+            for ( int t = 0; t < n_threads; ++t ) {
+                dnlz[h] += partial_dnlz[t][h];
+            }
+        }
+    }
+    return true;
+}
+
+bool native_vecchia_predict(const native_model& model, const double* hyp,
+                            const double* x, const double* y, int n,
+                            const kd_tree& tree, int m, const double* xs,
+                            int ns, double* fmu, double* fs2,
+                            int n_threads) {
+    const native_cov& cov = model.cov;
+    int dim = cov.dim;
+    int n_mean = model.n_mean();
+    const double* cov_hyp = hyp + n_mean;
+    double mu = model.mean == MEAN_CONST ? hyp[0] : 0.0;
+    double sn2 = std::exp(2.0 * hyp[n_mean + cov.n_hyp()]);
+    m = std::min(m, n);
+    std::vector<char> failed(resolve_threads(n_threads), 0);
+    int n_blocks = (ns + POINT_BLOCK - 1) / POINT_BLOCK;
+    parallel_for(n_blocks, static_cast<int>(failed.size()),
+                 [&](int b, int thread) {
+        std::vector<double> q(dim);
+        std::vector<int> nb;
+        std::vector<double> xb(static_cast<long>(m) * dim);
+        std::vector<double> R(static_cast<long>(m) * m);
+        std::vector<double> ks(m), alpha(m);
+        int end = std::min(ns, (b + 1) * POINT_BLOCK);
+        for ( int t = b * POINT_BLOCK; t < end; ++t ) {
+            for ( int d = 0; d < dim; ++d ) {
+                q[d] = xs[static_cast<long>(d) * ns + t];
+            }
+            kd_nearest(tree, &q[0], m, -1, nb);
+            int k = static_cast<int>(nb.size());
+            for ( int d = 0; d < dim; ++d ) {
+                for ( int j = 0; j < k; ++j ) {
+                    xb[static_cast<long>(d) * k + j]
+                        = x[static_cast<long>(d) * n + nb[j]];
+                }
+            }
+            native_cov_cross(cov, cov_hyp, &xb[0], k, &xb[0], k, &R[0]);
+            for ( int j = 0; j < k; ++j ) {
+                R[static_cast<long>(j) * k + j] += sn2;
+                alpha[j] = y[nb[j]] - mu;
+            }
+            if ( !chol_upper(&R[0], k) ) {
+                failed[thread] = 1;
+                return;
+            }
+            solve_chol(&R[0], k, &alpha[0]);
+            double kss = 0.0;
+            native_cov_cross(cov, cov_hyp, &q[0], 1, &q[0], 1, &kss);
+            native_cov_cross(cov, cov_hyp, &xb[0], k, &q[0], 1, &ks[0]);
+            double mean = mu;
+            for ( int j = 0; j < k; ++j ) {
+                mean += ks[j] * alpha[j];
+            }
+            solve_upper_transposed(&R[0], k, &ks[0]);
+            double explained = 0.0;
+            for ( int j = 0; j < k; ++j ) {
+                explained += ks[j] * ks[j];
+            }
+            fmu[t] = mean;
+            fs2[t] = std::max(kss - explained, 0.0);
+        }
+    });
+    for ( size_t t = 0; t < failed.size(); ++t ) {
+        if ( failed[t] ) {
+            return false;
+        }
+    }
+    return true;
+}
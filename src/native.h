@@ -0,0 +1,762 @@
+#ifndef GPMLR_NATIVE_H
+#define GPMLR_NATIVE_H
+
+// Compiled counterparts of a few GPML building blocks.
+// Nothing in here touches Rcpp or Octave, so it is safe to call from worker
+// threads (the embedded Octave interpreter is not).
+// All matrices are stored column-major, as in R and Octave.
+
+#include <vector>
+#include <functional>
+
+
+// ----------------------- Dense linear algebra ------------------------------
+// GPML's convention is an upper triangular Cholesky factor R with A = R'R.
+// Overwrites the upper triangle of the n x n matrix A with R and zeroes the
+// lower triangle; returns false if A is not (numerically) positive definite:
+bool chol_upper(double* A, int n);
+// Solves R x = b in place for nrhs right hand sides stored in b:
+void solve_upper(const double* R, int n, double* b, int nrhs = 1);
+// Solves R' x = b in place:
+void solve_upper_transposed(const double* R, int n, double* b, int nrhs = 1);
+// Solves R'R x = b in place, like GPML's solve_chol():
+void solve_chol(const double* R, int n, double* b, int nrhs = 1);
+// Writes inv(R'R) into the (full, symmetric) n x n matrix result:
+void chol_inverse(const double* R, int n, double* result);
+// Eigendecomposition of the symmetric n x n matrix A: overwrites A with the
+// orthonormal eigenvectors (as columns) and writes the eigenvalues, in
+// ascending order, to values
+void sym_eigen(double* A, int n, double* values);
+
+
+// ----------------------- Covariance functions ------------------------------
+// The stationary GPML covariance functions we can evaluate natively.
+// Each one is sf2 * g(r2), where r2 is the squared distance scaled by the
+// length scale(s), so they share their distance computations. The piecewise
+// polynomials (covPPiso, covPPard) are zero from r2 = 1 on.
+enum native_cov_type { COV_SE, COV_MATERN, COV_RQ, COV_PP };
+
+struct native_cov {
+    native_cov_type type;
+    bool ard;    // covSEard etc. rather than covSEiso etc.
+    int degree;  // d for covMaterniso/covMaternard (1, 3, or 5), or v for
+                 // covPPiso/covPPard (0 to 3)
+    int dim;     // number of input dimensions
+    // Number of hyperparameters, in GPML's order:
+    // log(ell) (one per dimension if ard), log(sf), and log(alpha) for RQ
+    int n_hyp() const;
+};
+
+// The profile g(r2) of a covariance function; if dr2 is not null it gets
+// dg/dr2, and if dalpha is not null (RQ only) it gets dg/dlog(alpha)
+double cov_profile(const native_cov& cov, double alpha, double r2,
+                   double* dr2 = 0, double* dalpha = 0);
+
+// Squared distances between training inputs, computed once and reused for
+// every set of hyperparameters. Pairs i < j are packed column by column, so
+// pair (i, j) lives at j * (j - 1) / 2 + i. For ARD covariances we keep one
+// such block per dimension when that fits under max_bytes; otherwise nothing
+// is stored and distances are recomputed from x as needed.
+struct distance_cache {
+    int n;
+    int dim;
+    bool per_dim;
+    std::vector<double> d2;
+};
+inline long pair_index(int i, int j) {
+    return static_cast<long>(j) * (j - 1) / 2 + i;
+}
+void build_distance_cache(const native_cov& cov, const double* x, int n,
+                          double max_bytes, distance_cache& cache);
+
+// Fills the n x n matrix K (both triangles) for the hyperparameters hyp
+void native_cov_matrix(const native_cov& cov, const double* hyp,
+                       const distance_cache& cache, const double* x,
+                       double* K);
+// Writes sum(sum(Q .* dK_i)) / 2 into grad[i] for every hyperparameter i,
+// where dK_i is the derivative of K; Q must be symmetric. All of them come
+// from one pass over tiles of Q, spread over n_threads threads, without
+// forming any dK_i (per-dimension distances in cache are not needed).
+void native_cov_gradient(const native_cov& cov, const double* hyp,
+                         const distance_cache& cache, const double* x,
+                         const double* Q, double* grad, int n_threads = 1);
+
+
+// ------------------------- Exact GP inference ------------------------------
+// A model the native paths can handle: meanZero or meanConst, one of the
+// above, and likGauss (or, for prediction only, likErf).
+// (likLogistic is only used by the Laplace approximation below.)
+// Inference is always infExact, so the likelihood must be likGauss there.
+enum native_mean_type { MEAN_ZERO, MEAN_CONST };
+enum native_lik_type { LIK_GAUSS, LIK_ERF, LIK_LOGISTIC };
+
+struct native_model {
+    native_cov cov;
+    native_mean_type mean;
+    native_lik_type lik;
+    int n_mean() const { return mean == MEAN_CONST ? 1 : 0; }
+    int n_lik() const { return lik == LIK_GAUSS ? 1 : 0; }
+    // Hyperparameters are ordered as mean, cov, then lik (log(sn) if any)
+    int n_hyp() const { return n_mean() + cov.n_hyp() + n_lik(); }
+};
+
+// Per-thread scratch space, so repeated evaluations don't reallocate
+struct exact_workspace {
+    std::vector<double> K;
+    std::vector<double> Q;
+    std::vector<double> alpha;
+};
+
+// Computes the negative log marginal likelihood exactly as GPML's infExact()
+// does, and if dnlz is not null, its gradient (in hyperparameter order),
+// whose covariance part is spread over n_threads threads.
+// Returns false if the covariance matrix could not be factorized.
+bool native_exact_nlz(const native_model& model, const distance_cache& cache,
+                      const double* x, const double* y, int n,
+                      const double* hyp, double* nlz, double* dnlz,
+                      exact_workspace& work, int n_threads = 1);
+
+
+// ----------------------------- Prediction ----------------------------------
+// Cross covariances between n training inputs x and ns test inputs xs
+// (both column-major with cov.dim columns), written to the n x ns matrix Ks
+void native_cov_cross(const native_cov& cov, const double* hyp,
+                      const double* x, int n, const double* xs, int ns,
+                      double* Ks);
+// Adds sum(sum(G .* dKs_i)) to grad[i] for every hyperparameter i, where
+// dKs_i is the derivative of the cross covariances above and G is n x ns,
+// and if dx is not null, adds the derivative of sum(sum(G .* Ks)) with
+// respect to x to the n x cov.dim matrix dx
+void native_cov_cross_gradient(const native_cov& cov, const double* hyp,
+                               const double* x, int n, const double* xs,
+                               int ns, const double* G, double* grad,
+                               double* dx);
+
+// The posterior representation gp() predicts from (POST in R). Only L's
+// upper triangle is read; if L_is_packed, it is packed column by column, so
+// entry (i, j), i <= j, lives at j * (j + 1) / 2 + i, and otherwise L is the
+// full n x n column-major matrix. If L_is_chol, L is the Cholesky factor
+// GPML's Lchol test accepts and variances are kss - |L' \ (sW .* ks)|^2;
+// otherwise L is the symmetric matrix with variances kss + ks' * L * ks.
+struct native_posterior {
+    int n;
+    const double* alpha;
+    const double* sW;
+    const double* L;
+    bool L_is_chol;
+    bool L_is_packed;
+};
+inline long packed_index(int i, int j) {
+    return static_cast<long>(j) * (j + 1) / 2 + i;
+}
+// Column j of L, from row 0 to row j
+inline const double* posterior_column(const native_posterior& post, int j) {
+    return post.L + (post.L_is_packed ? packed_index(0, j)
+                                      : static_cast<long>(j) * post.n);
+}
+
+// Predictive moments ymu, ys2, fmu, and fs2 at the ns test inputs xs, as
+// GPML's gp() computes them, without forming the cross covariances: blocks
+// of test points are spread over n_threads threads, and each goes through
+// the training inputs tile by tile, reading L once, with scratch memory
+// bounded however large n and ns are.
+void native_predict(const native_model& model, const double* hyp,
+                    const double* x, const native_posterior& post,
+                    const double* xs, int ns, double* ymu, double* ys2,
+                    double* fmu, double* fs2, int n_threads);
+
+// Where native_predict_cov() writes: the full ns x ns matrix (column-major;
+// it may be a mapped file), or, if dense is null, the values x of a
+// compressed sparse column matrix whose pattern (column starts p and, within
+// each column, increasing row indices i) is exactly the pairs selected
+struct predict_cov_output {
+    double* dense;
+    const int* p;
+    const int* i;
+    double* x;
+};
+
+// Latent predictive covariances cov(f(xs_a), f(xs_b)) between the ns test
+// inputs xs, kss - (L' \ (sW .* ks_a))' (L' \ (sW .* ks_b)) or
+// kss + ks_a' * L * ks_b, for every pair, or only those with |a - b| <=
+// band (if band >= 0) and, if block is not null, block[a] == block[b].
+// The diagonal is FS2. Test points are taken in groups (whole blocks, or
+// consecutive points overlapping the previous group by band), and the
+// solved cross covariances of a group are kept while its tiles of
+// covariances are computed, both spread over n_threads threads; scratch is
+// n doubles per point of a group, so up to n x ns for the full matrix.
+void native_predict_cov(const native_model& model, const double* hyp,
+                        const double* x, const native_posterior& post,
+                        const double* xs, int ns, int band, const int* block,
+                        const predict_cov_output& out, int n_threads);
+
+// n_draws joint draws of the latent function at the ns test inputs xs from
+// a Cholesky posterior, by pathwise conditioning: a prior draw f, the sum
+// of n_features random Fourier features of the covariance, is moved to the
+// posterior as m + f(xs) + Ks' * (alpha - sW .* (L \ (L' \ (sW .* f(x) +
+// z)))) with z ~ N(0, I), so the ns x ns covariance is never formed. Draws
+// go through in batches, each solved against L and taken through the test
+// points tile by tile over n_threads threads, into the ns x n_draws matrix
+// out (which may be a mapped file). Draw d depends only on seed and d, and
+// the features only on seed. Returns false for covPPiso/covPPard, which
+// have no spectral density to sample, or a posterior with no Cholesky
+// factor.
+bool native_sample(const native_model& model, const double* hyp,
+                   const double* x, const native_posterior& post,
+                   const double* xs, int ns, int n_draws, int n_features,
+                   unsigned seed, double* out, int n_threads);
+
+
+// ----------------------- Laplace approximation -----------------------------
+// A port of GPML's infLaplace() for the hyperparameter-free, log-concave
+// likelihoods likErf and likLogistic, working from a covariance matrix and
+// mean vector computed elsewhere (so any covariance function can be used).
+
+// logphi(z) = log(normcdf(z)) and its derivatives, as in GPML's logphi.m;
+// any of dlp, d2lp, and d3lp may be null
+void native_logphi(double z, double* lp, double* dlp, double* d2lp,
+                   double* d3lp);
+
+// Log likelihoods lp and their first three derivatives with respect to f,
+// as GPML's likelihoods return them in 'infLaplace' mode; y is +1 or -1.
+// Any of dlp, d2lp, and d3lp may be null.
+void native_lik_laplace(native_lik_type lik, const double* y, const double* f,
+                        int n, double* lp, double* dlp, double* d2lp,
+                        double* d3lp);
+
+// infLaplace()'s opt.irls_maxit, opt.irls_Wmin, and opt.irls_tol
+struct laplace_options {
+    int max_iterations;
+    double w_min;
+    double tolerance;
+    laplace_options() : max_iterations(20), w_min(0.0), tolerance(1e-6) {}
+};
+
+// Everything known at the posterior mode
+struct laplace_state {
+    int n;
+    std::vector<double> alpha;
+    std::vector<double> f;
+    std::vector<double> lp, dlp, d2lp, d3lp;
+    std::vector<double> sW;
+    std::vector<double> L;      // upper Cholesky factor of I + sW * sW' .* K
+    double nlz;
+    // Filled in by laplace_prepare_gradient():
+    std::vector<double> Z;         // sW .* inv(B) .* sW' = inv(K + inv(W))
+    std::vector<double> implicit;  // dfhat - Z * K * dfhat, where dfhat is
+                                   // the derivative of nlz wrt the mode
+};
+
+// Finds the posterior mode by Newton's method (with infLaplace()'s Brent
+// line search; one Cholesky factorization per Newton step), starting from
+// alpha (if it has n elements and beats starting from the mean, as in
+// infLaplace()), and computes the negative log marginal likelihood.
+// Returns false if a factorization fails.
+bool native_laplace(native_lik_type lik, const double* K, const double* m,
+                    const double* y, int n, const laplace_options& options,
+                    const std::vector<double>& alpha, laplace_state& state);
+// Prepares for the derivatives below
+void laplace_prepare_gradient(const double* K, laplace_state& state);
+// The derivative of nlz with respect to a covariance hyperparameter,
+// given the derivative dK of K, and with respect to a mean hyperparameter,
+// given the derivative dm of m
+double laplace_cov_gradient(const laplace_state& state, const double* dK);
+double laplace_mean_gradient(const laplace_state& state, const double* dm);
+
+
+// --------------------- Parallel expectation propagation ---------------------
+// Parallel EP for likErf and likLogistic: every sweep matches the moments of
+// all sites at once (from the same posterior, spread over threads), takes a
+// damped step towards the new site parameters, and refactorizes once.
+// It converges to the same fixed points as GPML's sequential infEP().
+
+// Log partition functions lZ of the tilted distributions and their first two
+// derivatives with respect to the cavity means mu, given cavity variances s2,
+// as likErf() and likLogistic() return them in 'infEP' mode
+void native_lik_ep(native_lik_type lik, const double* y, const double* mu,
+                   const double* s2, int n, double* lZ, double* dlZ,
+                   double* d2lZ, int n_threads);
+
+struct ep_options {
+    double damping;    // fraction of the full site update taken each sweep
+    double tolerance;  // stop once nlz changes less than this ...
+    int max_sweeps;    // ... or after this many sweeps
+    int min_sweeps;
+    int n_threads;
+    ep_options() : damping(0.5), tolerance(1e-4), max_sweeps(50),
+                   min_sweeps(2), n_threads(0) {}
+};
+
+struct ep_state {
+    int n;
+    std::vector<double> ttau, tnu;   // site precisions and shifts
+    std::vector<double> alpha, sW;
+    std::vector<double> L;           // upper Cholesky factor of
+                                     // I + sW * sW' .* K
+    std::vector<double> mu, s2;      // posterior means and variances
+    std::vector<double> tau_n, nu_n; // cavity parameters
+    std::vector<double> lZ, dlZ, d2lZ;
+    double nlz;
+    int sweeps;
+    bool converged;  // false if max_sweeps ran out first
+};
+
+// Runs parallel EP from the site parameters ttau and tnu (if they have n
+// elements and beat starting from zero, as in infEP()). Returns false if a
+// factorization fails.
+bool native_ep(native_lik_type lik, const double* K, const double* m,
+               const double* y, int n, const ep_options& options,
+               const std::vector<double>& ttau, const std::vector<double>& tnu,
+               ep_state& state);
+// F = alpha * alpha' - sW * sW' .* inv(I + sW * sW' .* K), which the
+// covariance gradients below need (n x n)
+void ep_gradient_matrix(const ep_state& state, double* F);
+// The derivative of nlz with respect to a covariance hyperparameter,
+// given F and the derivative dK of K, and with respect to a mean
+// hyperparameter, given the derivative dm of m
+double ep_cov_gradient(const ep_state& state, const double* F,
+                       const double* dK);
+double ep_mean_gradient(const ep_state& state, const double* dm);
+
+
+// ----------------- Predictive likelihoods by quadrature ---------------------
+// The prediction mode of GPML's likelihoods that integrate over the latent
+// Gaussian N(fmu, fs2) with 20-point Gauss-Hermite quadrature (gauher(20)):
+// likT and likGumbel for the log predictive probabilities, and the GLM
+// likelihoods (through lik_epquad()) for those and the predictive moments.
+
+enum quadrature_lik_type { QLIK_T, QLIK_GUMBEL, QLIK_POISSON, QLIK_NEGBINOM,
+                           QLIK_GAMMA, QLIK_EXP, QLIK_BETA, QLIK_INVGAUSS,
+                           QLIK_WEIBULL };
+// The GLM likelihoods' inverse links g(f), as util/glm_invlink_*.m
+enum glm_link { LINK_EXP, LINK_LOGISTIC, LINK_EXPEXP, LINK_LOGIT };
+
+struct quadrature_lik {
+    quadrature_lik_type type;
+    glm_link link;
+    double sign;  // likGumbel's skewness, +1 or -1
+    int n_hyp() const {
+        if ( type == QLIK_T ) {
+            return 2;
+        }
+        return type == QLIK_POISSON || type == QLIK_EXP ? 0 : 1;
+    }
+};
+
+// Log predictive probabilities lp of ys (if not null; zero otherwise, as in
+// GPML) and predictive moments ymu and ys2 at ns test points with latent
+// means fmu and variances fs2, exactly as gp() gets them from
+// feval(lik{:}, hyp.lik, ys, fmu, fs2): in blocks of 1000 test points, so
+// whether fs2 counts as zero (and lp is the likelihood at fmu) is decided
+// block by block. Blocks are spread over n_threads threads, with no scratch
+// beyond the 20 nodes of the point at hand. lp may be null.
+void native_quadrature_predict(const quadrature_lik& lik, const double* hyp,
+                               const double* ys, const double* fmu,
+                               const double* fs2, int ns, double* lp,
+                               double* ymu, double* ys2, int n_threads);
+
+
+// ------------------------ Sparse approximations -----------------------------
+// Choosing m inducing inputs xu (m x dim, column-major) among or near the n
+// training inputs x, and GPML's infFITC() with covFITC() for likGauss in
+// O(n m^2) time and O(m^2) memory beyond the data, for n in the millions.
+
+// k-means++ seeding (Arthur & Vassilvitskii, 2007) followed by a few Lloyd
+// iterations, so the inducing inputs are cluster centres of x
+void select_inducing_kmeans(const double* x, int n, int dim, int m,
+                            unsigned seed, int n_threads, double* xu);
+// Greedy variance reduction: repeatedly picks the input whose prior variance
+// is least explained by those already picked (a pivoted partial Cholesky
+// factorization of K), among a random subset of at most max_candidates of
+// them so memory stays at m * max_candidates
+void select_inducing_greedy(const native_cov& cov, const double* hyp,
+                            const double* x, int n, int m, int max_candidates,
+                            unsigned seed, double* xu);
+
+struct fitc_result {
+    double nlz;
+    std::vector<double> dnlz;   // in native_model's hyperparameter order
+    std::vector<double> dxu;    // m x dim, the derivatives for hyp.xu
+    std::vector<double> alpha;  // POST as infFITC() returns it: alpha (m),
+    std::vector<double> L;      // L = inv(Kuu + snu2 I + Ku inv(G) Ku')
+                                // - inv(Kuu + snu2 I) (m x m), and sW
+    double sW;                  // (1 / sn, the same for every point)
+};
+
+// model must have likGauss; the training inputs are visited in blocks
+// spread over n_threads threads, once without derivatives and three times
+// with them. Returns false if a factorization fails.
+bool native_fitc(const native_model& model, const double* hyp,
+                 const double* x, const double* y, int n, const double* xu,
+                 int m, bool derivatives, int n_threads, fitc_result& result);
+
+
+// ------------------------ Kronecker (grid) inference ------------------------
+// GPML's infGrid() with covGrid() for likGauss, where the inputs are the
+// Cartesian product of p axes and K = K_p x ... x K_1 (with the first axis
+// varying fastest along y). Only the axes are ever stored; nothing is
+// N x N, or even N x D, for the N grid points.
+
+// One factor of a Kronecker product: the rows x cols matrix A, or A' if
+// transpose (A is then stored as cols x rows), or the identity if A is null
+struct kron_factor {
+    const double* A;
+    int rows;
+    int cols;
+    bool transpose;
+};
+// result = (F_p x ... x F_1) x for the nrhs columns of x, one factor at a
+// time, so the cost is that of p small matrix products
+void kron_mvm(const std::vector<kron_factor>& factors, const double* x,
+              int nrhs, double* result, int n_threads);
+
+struct grid_axis {
+    native_cov cov;    // the axis' own covariance function
+    int n;             // number of points on the axis
+    const double* x;   // n x cov.dim
+};
+
+struct grid_options {
+    double cg_tol;     // as infGrid()'s opt.cg_tol and opt.cg_maxit, for
+    int cg_maxit;      // when only part of the grid is observed
+    int n_threads;
+    grid_options() : cg_tol(1e-5), cg_maxit(1000), n_threads(0) {}
+};
+
+struct grid_state {
+    long N;                        // number of grid points
+    std::vector<long> observed;    // the n observed ones, in increasing order
+    double sn2;
+    double mean;
+    // Per axis: K_j and its eigendecomposition V_j diag(E_j) V_j'
+    std::vector< std::vector<double> > K, V, E;
+    // For a complete grid, inv(K + sn2 I) = V diag(s) V' exactly
+    std::vector<double> s;
+    std::vector<double> alpha;     // inv(K + sn2 I) (y - m), length n
+    double nlz;
+    std::vector<double> dnlz;      // mean, then cov axis by axis, then lik
+    int cg_iterations;             // zero for a complete grid
+};
+
+// hyp is the mean hyperparameter (if mean is MEAN_CONST), each axis'
+// covariance hyperparameters in turn, and log(sn). y holds the values at the
+// observed grid points. A complete grid is solved exactly through the
+// eigendecompositions; otherwise alpha comes from conjugate gradients and
+// the log determinant from the scaled top n eigenvalues, as in infGrid().
+// Returns false if conjugate gradients did not converge.
+bool native_grid(const std::vector<grid_axis>& axes, native_mean_type mean,
+                 const double* hyp, const double* y,
+                 const std::vector<long>& observed, bool derivatives,
+                 const grid_options& options, grid_state& state);
+// Latent predictive means and variances at the ns x D points xs, whose
+// columns follow the axes' dimensions in order, for the same axes, mean,
+// and hyp as the native_grid() call that filled state; returns false if
+// conjugate gradients did not converge for some test point
+bool native_grid_predict(const std::vector<grid_axis>& axes,
+                         native_mean_type mean, const double* hyp,
+                         const grid_state& state, const double* xs, int ns,
+                         const grid_options& options, double* fmu,
+                         double* fs2);
+
+
+// ------------------------ Iterative exact inference -------------------------
+// infExact() for likGauss without ever forming K: K + sn2 I is applied to
+// blocks of vectors one kernel tile at a time, solves are by preconditioned
+// conjugate gradients (the preconditioner being a pivoted partial Cholesky
+// factorization of K plus sn2 I), and log det(K + sn2 I) and the traces in
+// its derivatives are estimated from random probes by stochastic Lanczos
+// quadrature. Time is O(n^2) per iteration and memory O(n (probes + rank)).
+
+struct iterative_options {
+    double tolerance;   // relative residual at which conjugate gradients stop
+    int max_iterations;
+    int probes;         // random probe vectors for the log determinant
+    int rank;           // rank of the preconditioner's Cholesky factor
+    unsigned seed;      // for the probes
+    int n_threads;
+    iterative_options() : tolerance(1e-6), max_iterations(1000), probes(16),
+                          rank(20), seed(0), n_threads(0) {}
+};
+
+struct iterative_result {
+    double nlz;
+    std::vector<double> dnlz;   // in native_model's hyperparameter order
+    std::vector<double> alpha;  // inv(K + sn2 I) (y - m)
+    int iterations;             // conjugate gradient iterations taken
+};
+
+// model must have likGauss. nlz and dnlz are unbiased stochastic estimates
+// (for the same seed, the same function of hyp); alpha is solved to the
+// tolerance. Returns false if conjugate gradients did not converge.
+bool native_iterative(const native_model& model, const double* hyp,
+                      const double* x, const double* y, int n,
+                      bool derivatives, const iterative_options& options,
+                      iterative_result& result);
+// Latent predictive means and variances at the ns test inputs xs, given the
+// alpha from native_iterative(); each batch of test points costs one set of
+// conjugate gradient solves. Returns false if one did not converge.
+bool native_iterative_predict(const native_model& model, const double* hyp,
+                              const double* x, int n, const double* alpha,
+                              const double* xs, int ns,
+                              const iterative_options& options, double* fmu,
+                              double* fs2);
+
+// --------------------- Nearest neighbour (Vecchia) GPs ----------------------
+// The Vecchia approximation for likGauss: the points are put in maxmin
+// order, and each y_i is conditioned only on the y of its (at most) m
+// nearest neighbours earlier in that order, so the likelihood is a product
+// of n Gaussians of dimension m + 1 and costs O(n m^3) time with O(n m)
+// memory. Neighbours are found with a k-d tree over the inputs, with
+// Euclidean distances in the inputs' own units.
+
+// A k-d tree over n points (column-major with dim columns); the points are
+// copied point by point in leaf order. If rank is set (see kd_set_rank()),
+// searches can be limited to the points of lower rank.
+struct kd_node {
+    int begin, end;      // the node's points are point[begin, end)
+    int left, right;     // children, or -1 for a leaf
+    int min_rank;        // lowest rank in the node
+};
+struct kd_tree {
+    int n;
+    int dim;
+    std::vector<int> point;        // original indices, in leaf order
+    std::vector<double> coords;    // n x dim, point by point in leaf order
+    std::vector<kd_node> nodes;    // the root first
+    std::vector<double> box;       // per node: dim lower, then dim upper
+                                   // bounds
+    std::vector<int> rank;         // per original index, or empty
+};
+void build_kd_tree(const double* x, int n, int dim, kd_tree& tree);
+void kd_set_rank(kd_tree& tree, const std::vector<int>& rank);
+// The (up to) k points nearest to the dim coordinates q, nearest first,
+// among those with rank below limit (or all of them if limit < 0)
+void kd_nearest(const kd_tree& tree, const double* q, int k, int limit,
+                std::vector<int>& result);
+// The points less than sqrt(r2) from q, in increasing order, and their
+// squared distances
+void kd_radius(const kd_tree& tree, const double* q, double r2,
+               std::vector<int>& result, std::vector<double>& d2);
+
+// The maxmin ordering (Guinness, 2018): first the point nearest the inputs'
+// mean, then repeatedly the one farthest from all those before it. order
+// gets the original indices in that order, and neighbours the n x m
+// (point by point) indices of each point's nearest earlier neighbours,
+// nearest first, padded with -1 for the first m points.
+void vecchia_index(const double* x, int n, int dim, int m, int n_threads,
+                   std::vector<int>& order, std::vector<int>& neighbours);
+
+// The Vecchia negative log marginal likelihood of y for model (which must
+// have likGauss), and if dnlz is not null its gradient in native_model's
+// hyperparameter order, given the neighbours vecchia_index() found.
+// Returns false if a conditional variance is not positive.
+bool native_vecchia(const native_model& model, const double* hyp,
+                    const double* x, const double* y, int n,
+                    const int* neighbours, int m, double* nlz, double* dnlz,
+                    int n_threads);
+// Latent predictive means and variances at the ns test inputs xs, each
+// conditioned on the y of its m nearest training inputs, found with tree
+// (built over x)
+bool native_vecchia_predict(const native_model& model, const double* hyp,
+                            const double* x, const double* y, int n,
+                            const kd_tree& tree, int m, const double* xs,
+                            int ns, double* fmu, double* fs2, int n_threads);
+
+// ------------------- Compactly supported covariances ------------------------
+// covPPiso and covPPard are zero beyond one length scale, so for length
+// scales short next to the inputs' spread K is sparse. Its nonzeros are found
+// with a k-d tree over the inputs divided by the length scales, and exact
+// inference for likGauss works from the sparse Cholesky factor R of the
+// permuted P'AP, A = K / sl + I, which is computed elsewhere (by CHOLMOD,
+// with a fill-reducing ordering). Time and memory scale with the number of
+// nonzeros of K and R rather than with n^2.
+
+// Compressed sparse columns: column j's row indices are
+// row[start[j], start[j + 1]), in increasing order, with their values
+struct sparse_matrix {
+    int rows;
+    int cols;
+    std::vector<long> start;
+    std::vector<int> row;
+    std::vector<double> value;
+};
+// K(x, xs) for the compactly supported cov (n x ns, both triangles when xs
+// is x), with only the entries inside the support stored; the test inputs
+// are spread over n_threads threads
+void compact_cov(const native_cov& cov, const double* hyp, const double* x,
+                 int n, const double* xs, int ns, int n_threads,
+                 sparse_matrix& K);
+// Solves R x = b and R' x = b in place for upper triangular R; the latter
+// skips b's leading zeros, from row first on
+void sparse_solve_upper(const sparse_matrix& R, double* b);
+void sparse_solve_upper_transposed(const sparse_matrix& R, double* b,
+                                   int first = 0);
+// The entries of inv(R'R) on the pattern of R, in R's layout (Takahashi
+// et al., 1973): the pattern of a Cholesky factor is closed under the
+// recurrence, so no other entry of the inverse is ever needed
+void sparse_chol_selected_inverse(const sparse_matrix& R,
+                                  std::vector<double>& Z);
+// The value at (i, j) of a matrix with R's pattern, or 0 if there is none
+double sparse_find(const sparse_matrix& R, const std::vector<double>& Z,
+                   int i, int j);
+// Writes Ks(:, s)' inv(A) Ks(:, s) into result[s] for every column of the
+// n x ns Ks, given A's factor R and perm, where A(perm, perm) = R'R (perm
+// being 0-based); the columns are spread over n_threads threads
+void compact_quadratic_forms(const sparse_matrix& R,
+                             const std::vector<int>& perm,
+                             const sparse_matrix& Ks, double* result,
+                             int n_threads);
+// Writes sum(sum(W .* dK_i)) / 2 into grad[i] for every covariance
+// hyperparameter i, where W has the pattern of K = compact_cov(x, x) and is
+// symmetric
+void compact_cov_gradient(const native_cov& cov, const double* hyp,
+                          const double* x, int n, const sparse_matrix& W,
+                          double* grad, int n_threads);
+
+// --------------------- Toeplitz (regular 1-D grid) inference ----------------
+// infExact() for likGauss when the inputs are one-dimensional and equally
+// spaced: K + sn2 I is then a symmetric Toeplitz matrix T, given by its
+// first column, and the Levinson recursion solves for alpha and gives
+// log det(T) in O(n^2) time and O(n) memory. The gradient's traces need
+// only the sums along inv(T)'s diagonals, which Trench's algorithm gives
+// in O(n^2) time without storing inv(T). Predictive variances apply inv(T)
+// through the Gohberg-Semencul formula, as products with triangular
+// Toeplitz matrices done by FFT on a circulant embedding, in O(n log n)
+// per test point.
+
+// Whether the n one-dimensional inputs x are equally spaced (in any order,
+// with no gaps); if so, order gets their indices in increasing order of x
+// and step the spacing
+bool regular_grid(const double* x, int n, std::vector<int>& order,
+                  double& step);
+
+struct toeplitz_result {
+    double nlz;
+    std::vector<double> dnlz;   // in native_model's hyperparameter order
+    std::vector<double> alpha;  // inv(T) (y - m), in grid order
+    std::vector<double> first;  // the first column of inv(T)
+};
+
+// y is in grid order, with spacing step. Returns false if T is not
+// (numerically) positive definite.
+bool native_toeplitz(const native_model& model, const double* hyp,
+                     double step, const double* y, int n, bool derivatives,
+                     toeplitz_result& result);
+// Latent predictive means and variances at the ns test inputs xs, for the
+// grid of n points from x0 with spacing step that native_toeplitz() filled
+// result for; test points are spread over n_threads threads
+void native_toeplitz_predict(const native_model& model, const double* hyp,
+                             double x0, double step, int n,
+                             const toeplitz_result& result, const double* xs,
+                             int ns, double* fmu, double* fs2,
+                             int n_threads);
+
+// ------------------- State-space (Kalman filter) inference ------------------
+// infExact() for likGauss when the inputs are one-dimensional (times) and
+// the covariance function is that of a linear stochastic differential
+// equation's stationary solution: covMaterniso with d = 1, 3, or 5 exactly,
+// with (d + 1) / 2 states, covCos with two, covPeriodic and covPeriodicNoDC
+// as series of harmonics (two states each) cut off once what is left is
+// below 1e-10 of the variance, and covSum and covProd of those. The
+// Kalman filter gives NLZ in O(n) time, its gradient follows along the
+// filter (the sensitivity equations), and the Rauch-Tung-Striebel smoother
+// gives the posterior at the training and test inputs.
+enum state_space_type { SS_MATERN, SS_COS, SS_PERIODIC, SS_PERIODIC_NODC,
+                        SS_SUM, SS_PROD };
+
+struct state_space_cov {
+    state_space_type type;
+    int degree;                          // d for covMaterniso
+    std::vector<state_space_cov> parts;  // for covSum and covProd
+    // Number of hyperparameters, in GPML's order (the parts' in turn for
+    // covSum and covProd)
+    int n_hyp() const;
+};
+
+struct state_space_model {
+    state_space_cov cov;
+    native_mean_type mean;
+    int n_mean() const { return mean == MEAN_CONST ? 1 : 0; }
+    // Hyperparameters are ordered as mean, cov, then log(sn)
+    int n_hyp() const { return n_mean() + cov.n_hyp() + 1; }
+};
+
+// The number of states at hyp, or 0 if a periodic part would need more
+// than 64 harmonics (its length scale being very short) or the whole model
+// more than 256 states
+int state_space_order(const state_space_model& model, const double* hyp);
+
+// NLZ at hyp for the n training points (x in any order), and if dnlz is not
+// null its gradient, in hyperparameter order; alpha, if not null, gets
+// inv(K + sn2 I) (y - m) from the smoothed means. Returns false if the
+// filter breaks down (or state_space_order() is 0).
+bool native_state_space(const state_space_model& model, const double* hyp,
+                        const double* x, const double* y, int n,
+                        double* nlz, double* dnlz, double* alpha);
+// Latent predictive means and variances at the ns test inputs xs (in any
+// order, and possibly among the training inputs), and alpha as above if it
+// is not null, all from one pass of the filter and smoother
+bool native_state_space_predict(const state_space_model& model,
+                                const double* hyp, const double* x,
+                                const double* y, int n, const double* xs,
+                                int ns, double* fmu, double* fs2,
+                                double* alpha);
+
+// ------------------------ Additive covariances (covADD) ---------------------
+// covADD({R, base}) on dim-dimensional inputs: with k_d the one-dimensional
+// base covariance of input d (each with its own hyperparameters), the
+// kernel is the sum over r in R of sf2_r * e_r(k_1, ..., k_dim), where e_r
+// is the r-th elementary symmetric polynomial. covADD.m stacks the k_d in
+// an n x n x dim array for elsympol.m, and calls elsympol.m again, with one
+// slice left out, for each derivative; here each pair of inputs gets its
+// e_r from the Newton-Girard recursion on its own dim values, and the
+// polynomials with k_d left out by deflation, e_r = e_r(-d) + k_d e_r-1(-d),
+// so every order and derivative comes from one pass over tiles of pairs.
+struct additive_cov {
+    native_cov base;          // covSEiso or covRQiso, with dim 1
+    int dim;
+    std::vector<int> orders;  // R, each between 1 and dim
+    int max_order() const;
+    // Number of hyperparameters, in covADD's order: base's for input 1,
+    // ..., base's for input dim, then log(sf_r) for each r in R
+    int n_hyp() const {
+        return dim * base.n_hyp() + static_cast<int>(orders.size());
+    }
+};
+
+struct additive_model {
+    additive_cov cov;
+    native_mean_type mean;
+    int n_mean() const { return mean == MEAN_CONST ? 1 : 0; }
+    // Hyperparameters are ordered as mean, cov, then log(sn)
+    int n_hyp() const { return n_mean() + cov.n_hyp() + 1; }
+};
+
+// Fills the n x n matrix K (both triangles), tiles of pairs spread over
+// n_threads threads
+void native_additive_matrix(const additive_cov& cov, const double* hyp,
+                            const double* x, int n, double* K,
+                            int n_threads = 1);
+// Writes sum(sum(Q .* dK_i)) / 2 into grad[i] for every hyperparameter i,
+// as native_cov_gradient() does; Q must be symmetric
+void native_additive_gradient(const additive_cov& cov, const double* hyp,
+                              const double* x, int n, const double* Q,
+                              double* grad, int n_threads = 1);
+// infExact() for an additive model, as native_exact_nlz() computes it
+bool native_additive_nlz(const additive_model& model, const double* x,
+                         const double* y, int n, const double* hyp,
+                         double* nlz, double* dnlz, exact_workspace& work,
+                         int n_threads = 1);
+
+// ---------------------------- Threading ------------------------------------
+// Number of threads to actually use when the user asks for n_threads
+// (zero or less means the budget set_thread_budget() gave, or if none was
+// given, one per available core)
+int resolve_threads(int n_threads);
+void set_thread_budget(int n_threads);
+int available_cores();
+// Calls f(i, thread_id) for i in [0, n), spread over n_threads threads
+void parallel_for(int n, int n_threads,
+                  const std::function<void(int, int)>& f);
+
+#endif
@@ -0,0 +1,130 @@
+#include "gpmlr.h"
+
+// Evaluating the negative log marginal likelihood (and optionally its
+// gradient) at many hyperparameter vectors in one call.
+// Models native_model can describe are evaluated in compiled code, reusing
+// the training distances across grid points and spreading the grid points
+// across threads. Anything else falls back to calling GPML's gp() in the
+// embedded Octave, one grid point at a time (Octave is single threaded),
+// but at least skipping the derivatives when they aren't wanted.
+
+// Per-dimension distance blocks for ARD covariances are only kept up to this
+static const double DISTANCE_CACHE_MAX_BYTES = 1024.0 * 1024.0 * 1024.0;
+
+// Rebuilds a hyperparameter list shaped like skeleton from a flat vector
+Rcpp::List rewrap_hyp(const Rcpp::List& skeleton, const double* values) {
+    int n = skeleton.size();
+    Rcpp::List result(n);
+    int position = 0;
+    for ( int i = 0; i < n; ++i ) {
+        int length = Rf_length(skeleton[i]);
+        Rcpp::NumericVector element(length);
+        for ( int j = 0; j < length; ++j ) {
+            element(j) = values[position++];
+        }
+        result[i] = element;
+    }
+    result.names() = skeleton.names();
+    return result;
+}
+
+// [[Rcpp::export(.gp_nlz_grid)]]
+Rcpp::NumericMatrix gp_nlz_grid(Rcpp::List hyp,
+                                Rcpp::List inf,
+                                Rcpp::List mean,
+                                Rcpp::List cov,
+                                Rcpp::List lik,
+                                Rcpp::NumericVector x,
+                                Rcpp::NumericVector y,
+                                Rcpp::NumericMatrix hyp_grid,
+                                bool gradient,
+                                int threads) {
+    int n_points = hyp_grid.nrow();
+    int n_hyp = hyp_grid.ncol();
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    Rcpp::NumericMatrix result(n_points, gradient ? n_hyp + 1 : 1);
+    // Try the native path first
+    native_model model;
+    std::vector<int> offsets;
+    if ( parse_native_model(inf, mean, cov, lik, dim, model)
+         && native_hyp_offsets(hyp, model, offsets)
+         && static_cast<int>(offsets.size()) == n_hyp ) {
+        distance_cache cache;
+        build_distance_cache(model.cov, x.begin(), n,
+                             DISTANCE_CACHE_MAX_BYTES, cache);
+        int n_threads = resolve_threads(threads);
+        std::vector<exact_workspace> work(n_threads);
+        // Rcpp objects must not be touched from worker threads,
+        // so we work on plain buffers and copy back at the end
+        std::vector<double> grid(hyp_grid.begin(), hyp_grid.end());
+        std::vector<double> out(static_cast<long>(n_points) * result.ncol());
+        const double* x_ptr = x.begin();
+        const double* y_ptr = y.begin();
+        parallel_for(n_points, n_threads, [&](int i, int t) {
+            std::vector<double> h(n_hyp);
+            std::vector<double> g(n_hyp);
+            for ( int k = 0; k < n_hyp; ++k ) {
+                h[k] = grid[static_cast<long>(offsets[k]) * n_points + i];
+            }
+            double nlz = 0.0;
+            bool ok = native_exact_nlz(model, cache, x_ptr, y_ptr, n, &h[0],
+                                       &nlz, gradient ? &g[0] : 0, work[t]);
+            out[i] = ok ? nlz : R_NaN;
+            if ( gradient ) {
+                for ( int k = 0; k < n_hyp; ++k ) {
+                    long column = offsets[k] + 1;
+                    out[column * n_points + i] = ok ? g[k] : R_NaN;
+                }
+            }
+        });
+        std::copy(out.begin(), out.end(), result.begin());
+        return result;
+    }
+    // Otherwise go through Octave
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    Cell inf_func = list_to_cell(inf);
+    Cell mean_func = list_to_cell(mean);
+    Cell lik_func = list_to_cell(lik);
+    Cell cov_func = list_to_cell(cov);
+    Matrix octave_x = rcppmat_to_octmat(x);
+    Matrix octave_y = rcppmat_to_octmat(y);
+    octave_value_list in;
+    in(1) = octave_value(inf_func);
+    in(2) = octave_value(mean_func);
+    in(3) = octave_value(cov_func);
+    in(4) = octave_value(lik_func);
+    in(5) = octave_value(octave_x);
+    in(6) = octave_value(octave_y);
+    Rcpp::CharacterVector fields = hyp.names();
+    std::vector<double> row(n_hyp);
+    for ( int i = 0; i < n_points; ++i ) {
+        Rcpp::checkUserInterrupt();
+        for ( int k = 0; k < n_hyp; ++k ) {
+            row[k] = hyp_grid(i, k);
+        }
+        in(0) = octave_value(list_to_map(rewrap_hyp(hyp, &row[0])));
+        // gp() only computes derivatives if asked for a second output
+        octave_value_list octave_result = OCT("gp", in, gradient ? 2 : 1);
+        result(i, 0) = octave_result(0).double_value();
+        if ( gradient ) {
+            octave_scalar_map DNLZ = octave_result(1).scalar_map_value();
+            int column = 1;
+            for ( int f = 0; f < fields.size(); ++f ) {
+                std::string field = Rcpp::as<std::string>(fields(f));
+                Matrix d = DNLZ.getfield(field).matrix_value();
+                int length = Rf_length(hyp[f]);
+                for ( int k = 0; k < length; ++k ) {
+                    result(i, column++) = k < d.numel() ? d(k) : R_NaN;
+                }
+            }
+        }
+    }
+    return result;
+}
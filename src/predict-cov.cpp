@@ -0,0 +1,152 @@
+#include "gpmlr.h"
+#include <algorithm>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// gp_predict_cov(): latent predictive covariances between test points (see
+// native_predict_cov()), from a fitted model's posterior. The full matrix
+// can go straight into a file mapped into memory, so it never has to fit
+// in RAM; banded or block-diagonal covariances come back as a dgCMatrix.
+
+// [[Rcpp::export(.gp_predict_cov)]]
+SEXP gp_predict_cov(Rcpp::List hyp,
+                    Rcpp::List mean,
+                    Rcpp::List cov,
+                    Rcpp::List lik,
+                    Rcpp::NumericMatrix x,
+                    Rcpp::NumericVector alpha,
+                    Rcpp::NumericVector sW,
+                    Rcpp::NumericMatrix L,
+                    Rcpp::NumericMatrix xs,
+                    int band,
+                    Rcpp::IntegerVector block,
+                    std::string path,
+                    int threads) {
+    int n = x.nrow();
+    int dim = x.ncol();
+    int ns = xs.nrow();
+    if ( alpha.size() != n || L.nrow() != n || L.ncol() != n ) {
+        Rcpp::stop("The posterior does not match the training inputs.\n");
+    }
+    if ( xs.ncol() != dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( block.size() > 0 && block.size() != ns ) {
+        Rcpp::stop("blocks must have one element per test point.\n");
+    }
+    native_model model;
+    std::vector<int> offsets;
+    if ( !parse_native_predictor(mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets) ) {
+        Rcpp::stop("This model's covariances cannot be computed in compiled "
+                   "code.\n");
+    }
+    bool L_is_chol = is_cholesky_factor(L);
+    if ( L_is_chol && sW.size() != n ) {
+        Rcpp::stop("The posterior does not match the training inputs.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    native_posterior post;
+    post.n = n;
+    post.alpha = alpha.begin();
+    post.sW = L_is_chol ? sW.begin() : 0;
+    post.L = L.begin();
+    post.L_is_chol = L_is_chol;
+    post.L_is_packed = false;
+    const int* labels = block.size() > 0 ? block.begin() : 0;
+    predict_cov_output out = { 0, 0, 0, 0 };
+    if ( band < 0 && !labels ) {
+        if ( path.empty() ) {
+            Rcpp::NumericMatrix result(ns, ns);
+            out.dense = result.begin();
+            native_predict_cov(model, &h[0], x.begin(), post, xs.begin(), ns,
+                               band, labels, out, threads);
+            return result;
+        }
+        // Straight into the file, which the OS pages out as it fills
+        size_t bytes = static_cast<size_t>(ns) * ns * sizeof(double);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if ( fd < 0 ) {
+            Rcpp::stop("Could not open " + path + " for writing.\n");
+        }
+        if ( ftruncate(fd, bytes) != 0 ) {
+            close(fd);
+            Rcpp::stop("Could not make " + path + " large enough.\n");
+        }
+        void* data = bytes > 0 ? mmap(0, bytes, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, fd, 0)
+                               : 0;
+        close(fd);
+        if ( data == MAP_FAILED ) {
+            Rcpp::stop("Could not map " + path + " into memory.\n");
+        }
+        out.dense = static_cast<double*>(data);
+        native_predict_cov(model, &h[0], x.begin(), post, xs.begin(), ns,
+                           band, labels, out, threads);
+        if ( data ) {
+            msync(data, bytes, MS_SYNC);
+            munmap(data, bytes);
+        }
+        return Rcpp::wrap(path);
+    }
+    // The sparsity pattern: for each column, the test points in its block
+    // (in order) within band of it
+    std::vector< std::vector<int> > members;
+    if ( labels ) {
+        for ( int k = 0; k < ns; ++k ) {
+            if ( labels[k] < 1 ) {
+                Rcpp::stop("Block labels must be positive integers.\n");
+            }
+            if ( labels[k] > static_cast<int>(members.size()) ) {
+                members.resize(labels[k]);
+            }
+            members[labels[k] - 1].push_back(k);
+        }
+    }
+    std::vector<int> p(ns + 1, 0);
+    std::vector<int> rows;
+    for ( int j = 0; j < ns; ++j ) {
+        int lo = band < 0 ? 0 : std::max(0, j - band);
+        int hi = band < 0 ? ns - 1 : std::min(ns - 1, j + band);
+        if ( labels ) {
+            const std::vector<int>& m = members[labels[j] - 1];
+            std::vector<int>::const_iterator first
+                = std::lower_bound(m.begin(), m.end(), lo);
+            std::vector<int>::const_iterator last
+                = std::upper_bound(m.begin(), m.end(), hi);
+            rows.insert(rows.end(), first, last);
+        }
+        else {
+            for ( int i = lo; i <= hi; ++i ) {
+                rows.push_back(i);
+            }
+        }
+        if ( rows.size() > static_cast<size_t>(INT_MAX) ) {
+            Rcpp::stop("Too many covariances for a sparse matrix; use a "
+                       "narrower band or smaller blocks.\n");
+        }
+        p[j + 1] = static_cast<int>(rows.size());
+    }
+    Rcpp::NumericVector values(rows.size());
+    out.p = &p[0];
+    out.i = rows.empty() ? 0 : &rows[0];
+    out.x = values.begin();
+    native_predict_cov(model, &h[0], x.begin(), post, xs.begin(), ns, band,
+                       labels, out, threads);
+    Rcpp::S4 result("dgCMatrix");
+    result.slot("Dim") = Rcpp::IntegerVector::create(ns, ns);
+    result.slot("i") = Rcpp::IntegerVector(rows.begin(), rows.end());
+    result.slot("p") = Rcpp::IntegerVector(p.begin(), p.end());
+    result.slot("x") = values;
+    return result;
+}
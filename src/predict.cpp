@@ -0,0 +1,153 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s prediction mode in compiled code (see native-predict.cpp) for the
+// models native_predict() supports: gp.m would form the cross covariances
+// for a thousand test points at a time, and several temporaries of the same
+// size for the variances, which for tens of thousands of training points
+// means hundreds of MB per batch. Only inference itself is left to GPML.
+// For the likelihoods GPML predicts with by Gauss-Hermite quadrature, the
+// quadrature is compiled too (see native-quadrature.cpp).
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// Returns NULL when the model needs GPML's gp() to predict
+// [[Rcpp::export(.gp_predict_post)]]
+SEXP gp_predict_post(Rcpp::List hyp,
+                     Rcpp::List inf,
+                     Rcpp::List mean,
+                     Rcpp::List cov,
+                     Rcpp::List lik,
+                     Rcpp::NumericVector x,
+                     Rcpp::NumericVector y,
+                     Rcpp::Nullable<Rcpp::List> post,
+                     Rcpp::NumericVector xs,
+                     Rcpp::NumericVector ys,
+                     int threads) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    int n = x.size() / dim;
+    int ns = xs.size() / dim;
+    if ( xs.size() != static_cast<R_xlen_t>(ns) * dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    // The latent moments don't depend on the likelihood, so for those
+    // predicted by quadrature native_predict() is run as for likErf (which
+    // has no hyperparameters), and hyp.lik is set aside for the quadrature
+    quadrature_lik q_lik;
+    bool quadrature = parse_quadrature_lik(lik, q_lik);
+    Rcpp::List latent_hyp = hyp;
+    std::vector<double> lik_hyp;
+    if ( quadrature ) {
+        if ( !hyp.containsElementNamed("lik") ) {
+            return R_NilValue;
+        }
+        Rcpp::NumericVector values = hyp["lik"];
+        if ( values.size() != q_lik.n_hyp() ) {
+            return R_NilValue;
+        }
+        lik_hyp.assign(values.begin(), values.end());
+        latent_hyp = Rcpp::clone(hyp);
+        latent_hyp["lik"] = Rcpp::NumericVector(0);
+    }
+    native_model model;
+    std::vector<int> offsets;
+    if ( spec_name(inf) == "infMCMC"
+         || !parse_native_predictor(mean, cov,
+                                    quadrature ? Rcpp::List::create("likErf")
+                                               : lik,
+                                    dim, model)
+         || !native_hyp_offsets(latent_hyp, model, offsets) ) {
+        return R_NilValue;
+    }
+    // post = feval(inf{:}, hyp, mean, cov, lik, x, y), unless given
+    Rcpp::List posterior;
+    if ( post.isNotNull() ) {
+        posterior = post.get();
+    } else {
+        if ( !octave_is_embedded() ) {
+            Rcpp::stop("You must call embed_octave() before this "
+                       "function.\n");
+        }
+        octave_value_list in;
+        in(0) = octave_value(list_to_map(hyp));
+        in(1) = octave_value(list_to_cell(mean));
+        in(2) = octave_value(list_to_cell(cov));
+        in(3) = octave_value(list_to_cell(lik));
+        in(4) = octave_value(rcppmat_to_octmat(x));
+        in(5) = octave_value(rcppmat_to_octmat(y));
+        octave_value result = feval_spec(inf, in);
+        posterior = map_to_list(result.scalar_map_value());
+    }
+    // Sparse posteriors (dgCMatrix) are left to GPML
+    if ( is_dgcmatrix(posterior["alpha"]) || is_dgcmatrix(posterior["sW"])
+         || is_dgcmatrix(posterior["L"]) ) {
+        return R_NilValue;
+    }
+    Rcpp::NumericVector alpha = posterior["alpha"];
+    Rcpp::NumericVector sW = posterior["sW"];
+    Rcpp::NumericMatrix L = posterior["L"];
+    bool L_is_chol = is_cholesky_factor(L);
+    if ( alpha.size() != n || L.nrow() != n || L.ncol() != n
+         || (L_is_chol && sW.size() != n) ) {
+        return R_NilValue;
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < latent_hyp.size(); ++i ) {
+        Rcpp::NumericVector element = latent_hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    native_posterior native_post;
+    native_post.n = n;
+    native_post.alpha = alpha.begin();
+    native_post.sW = L_is_chol ? sW.begin() : 0;
+    native_post.L = L.begin();
+    native_post.L_is_chol = L_is_chol;
+    native_post.L_is_packed = false;
+    Rcpp::NumericMatrix ymu(ns, 1);
+    Rcpp::NumericMatrix ys2(ns, 1);
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    native_predict(model, &h[0], x.begin(), native_post, xs.begin(), ns,
+                   ymu.begin(), ys2.begin(), fmu.begin(), fs2.begin(),
+                   threads);
+    Rcpp::NumericMatrix lp(ns, 1);
+    if ( quadrature ) {
+        native_quadrature_predict(q_lik, lik_hyp.empty() ? 0 : &lik_hyp[0],
+                                  ys.size() > 0 ? ys.begin() : 0,
+                                  fmu.begin(), fs2.begin(), ns,
+                                  ys.size() > 0 ? lp.begin() : 0,
+                                  ymu.begin(), ys2.begin(), threads);
+    }
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2,
+                                  Rcpp::_["POST"] = posterior);
+    }
+    // The log predictive probabilities, as likGauss() and likErf() give them
+    for ( int i = 0; i < ns && !quadrature; ++i ) {
+        if ( model.lik == LIK_GAUSS ) {
+            double r = ys[i] - ymu[i];
+            lp[i] = -r * r / (2.0 * ys2[i])
+                    - 0.5 * (LOG_2PI + std::log(ys2[i]));
+        } else {
+            native_logphi(ys[i] * fmu[i] / std::sqrt(1.0 + fs2[i]), &lp[i],
+                          0, 0, 0);
+        }
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp,
+                              Rcpp::_["POST"] = posterior);
+}
@@ -0,0 +1,99 @@
+#include "gpmlr.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// gp_sample(): joint posterior draws of the latent function at test points
+// by pathwise conditioning (see native_sample()), from a fitted model's
+// posterior. The draws can go straight into a file mapped into memory, so
+// they never have to fit in RAM.
+
+// [[Rcpp::export(.gp_sample)]]
+SEXP gp_sample(Rcpp::List hyp,
+               Rcpp::List mean,
+               Rcpp::List cov,
+               Rcpp::List lik,
+               Rcpp::NumericMatrix x,
+               Rcpp::NumericVector alpha,
+               Rcpp::NumericVector sW,
+               Rcpp::NumericMatrix L,
+               Rcpp::NumericMatrix xs,
+               int n_draws,
+               int n_features,
+               double seed,
+               std::string path,
+               int threads) {
+    int n = x.nrow();
+    int dim = x.ncol();
+    int ns = xs.nrow();
+    if ( alpha.size() != n || sW.size() != n || L.nrow() != n
+         || L.ncol() != n ) {
+        Rcpp::stop("The posterior does not match the training inputs.\n");
+    }
+    if ( xs.ncol() != dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( n_draws < 0 || n_features < 1 ) {
+        Rcpp::stop("n_draws and n_features must be positive.\n");
+    }
+    native_model model;
+    std::vector<int> offsets;
+    if ( !parse_native_predictor(mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets)
+         || model.cov.type == COV_PP ) {
+        Rcpp::stop("This model cannot be sampled in compiled code; it needs "
+                   "a zero or constant mean and covSE, covMatern, or covRQ "
+                   "(iso or ard).\n");
+    }
+    if ( !is_cholesky_factor(L) ) {
+        Rcpp::stop("Sampling needs a posterior whose L is a Cholesky "
+                   "factor.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    std::vector<double> h(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    native_posterior post;
+    post.n = n;
+    post.alpha = alpha.begin();
+    post.sW = sW.begin();
+    post.L = L.begin();
+    post.L_is_chol = true;
+    post.L_is_packed = false;
+    unsigned s = static_cast<unsigned>(seed);
+    if ( path.empty() ) {
+        Rcpp::NumericMatrix result(ns, n_draws);
+        native_sample(model, &h[0], x.begin(), post, xs.begin(), ns, n_draws,
+                      n_features, s, result.begin(), threads);
+        return result;
+    }
+    // Straight into the file, which the OS pages out as it fills
+    size_t bytes = static_cast<size_t>(ns) * n_draws * sizeof(double);
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( fd < 0 ) {
+        Rcpp::stop("Could not open " + path + " for writing.\n");
+    }
+    if ( ftruncate(fd, bytes) != 0 ) {
+        close(fd);
+        Rcpp::stop("Could not make " + path + " large enough.\n");
+    }
+    void* data = bytes > 0 ? mmap(0, bytes, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, fd, 0)
+                           : 0;
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        Rcpp::stop("Could not map " + path + " into memory.\n");
+    }
+    native_sample(model, &h[0], x.begin(), post, xs.begin(), ns, n_draws,
+                  n_features, s, static_cast<double*>(data), threads);
+    if ( data ) {
+        msync(data, bytes, MS_SYNC);
+        munmap(data, bytes);
+    }
+    return Rcpp::wrap(path);
+}
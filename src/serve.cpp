@@ -0,0 +1,140 @@
+#include "gpmlr.h"
+#include "server.h"
+
+// The Octave side of the prediction server. Each fitted model is converted
+// to Octave values once, up front; every batch then goes straight to GPML's
+// gp() with the stored posterior in place of y, so no inference is redone.
+
+struct served_model {
+    octave_value hyp;
+    octave_value inf;
+    octave_value mean;
+    octave_value cov;
+    octave_value lik;
+    octave_value x;
+    octave_value post;
+};
+
+// R_CheckUserInterrupt() longjmps, so we call it where it can't escape
+static void check_interrupt(void*) {
+    R_CheckUserInterrupt();
+}
+static bool r_interrupted() {
+    return !R_ToplevelExec(check_interrupt, 0);
+}
+
+// [[Rcpp::export(.gp_serve)]]
+Rcpp::List gp_serve(Rcpp::List models,
+                    std::string path,
+                    int max_batch,
+                    double max_wait) {
+    // Make sure Octave is embedded
+    if ( !octave_is_embedded() ) {
+        Rcpp::stop("You must call embed_octave() before this function.\n");
+    }
+    int n_models = models.size();
+    Rcpp::CharacterVector names = models.names();
+    std::vector<std::string> model_names(n_models);
+    std::vector<int> model_dims(n_models);
+    std::vector<served_model> served(n_models);
+    for ( int i = 0; i < n_models; ++i ) {
+        Rcpp::List model = models[i];
+        model_names[i] = Rcpp::as<std::string>(names(i));
+        Rcpp::List hyp = model["hyp"];
+        Rcpp::List inf = model["inf"];
+        Rcpp::List mean = model["mean"];
+        Rcpp::List cov = model["cov"];
+        Rcpp::List lik = model["lik"];
+        Rcpp::NumericVector rcpp_x = model["x"];
+        Rcpp::List post = model["post"];
+        served[i].hyp = octave_value(list_to_map(hyp));
+        served[i].inf = octave_value(list_to_cell(inf));
+        served[i].mean = octave_value(list_to_cell(mean));
+        served[i].cov = octave_value(list_to_cell(cov));
+        served[i].lik = octave_value(list_to_cell(lik));
+        Matrix x = rcppmat_to_octmat(rcpp_x);
+        model_dims[i] = x.cols();
+        served[i].x = octave_value(x);
+        served[i].post = octave_value(list_to_map(post));
+    }
+    batch_predictor predict = [&](int model, const std::vector<double>& xs,
+                                  int n, int d, std::vector<double>& out) {
+        Matrix octave_xs(n, d);
+        std::copy(xs.begin(), xs.end(), octave_xs.fortran_vec());
+        const served_model& m = served[model];
+        octave_value_list in;
+        in(0) = m.hyp;
+        in(1) = m.inf;
+        in(2) = m.mean;
+        in(3) = m.cov;
+        in(4) = m.lik;
+        in(5) = m.x;
+        in(6) = m.post;
+        in(7) = octave_value(octave_xs);
+        try {
+            octave_value_list octave_result = OCT("gp", in, 4);
+            out.resize(4 * static_cast<size_t>(n));
+            for ( int j = 0; j < 4; ++j ) {
+                ColumnVector v = octave_result(j).column_vector_value();
+                std::copy(v.data(), v.data() + n, out.begin() + j * n);
+            }
+        }
+        catch ( ... ) {
+            return std::string("Prediction failed in GPML's gp().");
+        }
+        return std::string();
+    };
+    server_options options;
+    options.path = path;
+    options.max_batch = max_batch;
+    options.max_wait_ms = max_wait;
+    server_stats stats;
+    std::string error;
+    bool finished = run_server(options, model_names, model_dims, predict,
+                               r_interrupted, stats, error);
+    if ( !finished && error != "Interrupted." ) {
+        Rcpp::stop(error);
+    }
+    return Rcpp::List::create(Rcpp::_["requests"] = stats.requests,
+                              Rcpp::_["errors"] = stats.errors,
+                              Rcpp::_["batches"] = stats.batches,
+                              Rcpp::_["rows"] = stats.rows,
+                              Rcpp::_["latency"] = stats.latency,
+                              Rcpp::_["batch_rows"] = stats.batch_rows,
+                              Rcpp::_["interrupted"] = !finished);
+}
+
+// A client, mostly for testing: type is 1 (predict), 2 (statistics),
+// or 3 (shutdown), as in server-protocol.h
+// [[Rcpp::export(.gp_server_request)]]
+Rcpp::NumericMatrix gp_server_request(std::string path,
+                                      int type,
+                                      std::string model,
+                                      Rcpp::NumericMatrix xs) {
+    int n = xs.nrow();
+    int d = xs.ncol();
+    // The protocol sends inputs row by row
+    std::vector<double> rows(static_cast<size_t>(n) * d);
+    for ( int i = 0; i < n; ++i ) {
+        for ( int j = 0; j < d; ++j ) {
+            rows[static_cast<size_t>(i) * d + j] = xs(i, j);
+        }
+    }
+    int fd = server_connect(path);
+    if ( fd < 0 ) {
+        Rcpp::stop("Could not connect to " + path + ".");
+    }
+    std::vector<double> result;
+    uint32_t result_rows = 0;
+    uint32_t result_cols = 0;
+    std::string error;
+    bool ok = server_exchange(fd, type, model, rows.empty() ? 0 : &rows[0],
+                              n, d, result, result_rows, result_cols, error);
+    close(fd);
+    if ( !ok ) {
+        Rcpp::stop(error);
+    }
+    Rcpp::NumericMatrix out(result_rows, result_cols);
+    std::copy(result.begin(), result.end(), out.begin());
+    return out;
+}
@@ -0,0 +1,408 @@
+#include "server.h"
+#include <chrono>
+#include <map>
+#include <cmath>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+
+// A single threaded poll() loop. Requests are read as they arrive but only
+// answered in batches: once enough rows are waiting, or the oldest request
+// has waited long enough, all waiting requests for a model are stacked into
+// one matrix and handed to the predictor in a single call. Sockets are
+// non-blocking, and responses wait in each connection's output buffer until
+// the client takes them, so a client that stops reading only holds up
+// itself.
+
+typedef std::chrono::steady_clock server_clock;
+
+namespace {
+
+struct connection {
+    int fd;
+    std::string buffer;  // received, not yet a complete request
+    std::string output;  // responses not yet sent
+    bool closing;        // close once output is sent
+};
+
+struct pending_request {
+    int fd;
+    int model;
+    int n_rows;
+    std::vector<double> x; // row by row, as received
+    server_clock::time_point received;
+};
+
+double elapsed_ms(server_clock::time_point since) {
+    std::chrono::duration<double, std::milli> d = server_clock::now() - since;
+    return d.count();
+}
+
+connection* find_connection(std::vector<connection>& connections, int fd) {
+    for ( size_t i = 0; i < connections.size(); ++i ) {
+        if ( connections[i].fd == fd ) {
+            return &connections[i];
+        }
+    }
+    return 0;
+}
+
+// Responses are queued on the connection, and go out as flush() sends them
+void send_error(connection& c, const std::string& message) {
+    server_response_header response;
+    response.magic = SERVER_MAGIC;
+    response.status = STATUS_ERROR;
+    response.n_rows = static_cast<uint32_t>(message.size());
+    response.n_cols = 0;
+    c.output.append(reinterpret_cast<const char*>(&response),
+                    sizeof(response));
+    c.output.append(message);
+}
+
+void send_values(connection& c, const double* values, uint32_t n_rows,
+                 uint32_t n_cols) {
+    server_response_header response;
+    response.magic = SERVER_MAGIC;
+    response.status = STATUS_OK;
+    response.n_rows = n_rows;
+    response.n_cols = n_cols;
+    c.output.append(reinterpret_cast<const char*>(&response),
+                    sizeof(response));
+    size_t n = static_cast<size_t>(n_rows) * n_cols;
+    if ( n > 0 ) {
+        c.output.append(reinterpret_cast<const char*>(values),
+                        n * sizeof(double));
+    }
+}
+
+// Sends as much of c's output as the socket takes without blocking; false
+// if the connection has failed
+bool flush(connection& c) {
+    while ( !c.output.empty() ) {
+        ssize_t sent = send(c.fd, c.output.data(), c.output.size(),
+                            MSG_NOSIGNAL);
+        if ( sent < 0 && errno == EINTR ) {
+            continue;
+        }
+        if ( sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ) {
+            return true;
+        }
+        if ( sent <= 0 ) {
+            return false;
+        }
+        c.output.erase(0, sent);
+    }
+    return true;
+}
+
+// Closes connection i, dropping its waiting requests: nobody is left to
+// answer, and the descriptor may be reused
+void drop_connection(std::vector<connection>& connections, size_t i,
+                     std::vector<pending_request>& pending,
+                     int& pending_rows) {
+    int fd = connections[i].fd;
+    for ( size_t j = pending.size(); j-- > 0; ) {
+        if ( pending[j].fd == fd ) {
+            pending_rows -= pending[j].n_rows;
+            pending.erase(pending.begin() + j);
+        }
+    }
+    close(fd);
+    connections.erase(connections.begin() + i);
+}
+
+// Columns: bucket upper bound (microseconds), latency count, batch count
+std::vector<double> stats_table(const server_stats& stats) {
+    int B = SERVER_HISTOGRAM_BUCKETS;
+    std::vector<double> result(3 * B);
+    for ( int b = 0; b < B; ++b ) {
+        result[b] = std::ldexp(1.0, b + 1);
+        result[B + b] = stats.latency[b];
+        result[2 * B + b] = stats.batch_rows[b];
+    }
+    return result;
+}
+
+}
+
+void server_stats::record(std::vector<double>& histogram, double value) {
+    int b = 0;
+    int last = SERVER_HISTOGRAM_BUCKETS - 1;
+    while ( b < last && value >= std::ldexp(1.0, b + 1) ) {
+        ++b;
+    }
+    histogram[b] += 1.0;
+}
+
+bool run_server(const server_options& options,
+                const std::vector<std::string>& model_names,
+                const std::vector<int>& model_dims,
+                const batch_predictor& predict,
+                const std::function<bool()>& interrupted,
+                server_stats& stats, std::string& error) {
+    // Set up the listening socket, replacing a stale socket file if need be
+    sockaddr_un address;
+    if ( options.path.size() >= sizeof(address.sun_path) ) {
+        error = "Socket path is too long.";
+        return false;
+    }
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, options.path.c_str());
+    struct stat existing;
+    if ( stat(options.path.c_str(), &existing) == 0 ) {
+        if ( !S_ISSOCK(existing.st_mode) ) {
+            error = options.path + " exists and is not a socket.";
+            return false;
+        }
+        // Only a socket nobody answers on is stale
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0
+            && connect(probe, reinterpret_cast<sockaddr*>(&address),
+                       sizeof(address)) == 0;
+        if ( probe >= 0 ) {
+            close(probe);
+        }
+        if ( live ) {
+            error = "Another server is listening on " + options.path + ".";
+            return false;
+        }
+        unlink(options.path.c_str());
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( listener < 0 ) {
+        error = "Could not create socket.";
+        return false;
+    }
+    if ( bind(listener, reinterpret_cast<sockaddr*>(&address),
+              sizeof(address)) != 0 || listen(listener, 64) != 0 ) {
+        close(listener);
+        error = "Could not listen on " + options.path + ".";
+        return false;
+    }
+    std::map<std::string, int> model_index;
+    for ( size_t i = 0; i < model_names.size(); ++i ) {
+        model_index[model_names[i]] = static_cast<int>(i);
+    }
+    std::vector<connection> connections;
+    std::vector<pending_request> pending;
+    int pending_rows = 0;
+    bool shutting_down = false;
+    bool result = true;
+    while ( true ) {
+        // Sleep until there is something to read, or the oldest waiting
+        // request is due; wake up regularly to check for interrupts
+        int timeout = 100;
+        if ( !pending.empty() ) {
+            double due = options.max_wait_ms - elapsed_ms(pending[0].received);
+            timeout = due <= 0 ? 0 : std::min(timeout, int(std::ceil(due)));
+        }
+        std::vector<pollfd> fds(connections.size() + 1);
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for ( size_t i = 0; i < connections.size(); ++i ) {
+            fds[i + 1].fd = connections[i].fd;
+            fds[i + 1].events = connections[i].closing ? 0 : POLLIN;
+            if ( !connections[i].output.empty() ) {
+                fds[i + 1].events |= POLLOUT;
+            }
+        }
+        if ( !shutting_down ) {
+            poll(&fds[0], fds.size(), timeout);
+        }
+        if ( interrupted() ) {
+            result = false;
+            error = "Interrupted.";
+            break;
+        }
+        if ( fds[0].revents & POLLIN ) {
+            int fd = accept(listener, 0, 0);
+            if ( fd >= 0 ) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                connection c;
+                c.fd = fd;
+                c.closing = false;
+                connections.push_back(c);
+            }
+        }
+        // Read whatever has arrived and pull complete requests out of it
+        for ( size_t i = connections.size(); i-- > 0; ) {
+            if ( !(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+                 || connections[i].closing ) {
+                continue;
+            }
+            connection& c = connections[i];
+            char chunk[65536];
+            ssize_t got = recv(c.fd, chunk, sizeof(chunk), 0);
+            bool closed = got == 0
+                || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK
+                    && errno != EINTR);
+            if ( got > 0 ) {
+                c.buffer.append(chunk, got);
+            }
+            size_t header_size = sizeof(server_request_header);
+            while ( !closed && c.buffer.size() >= header_size ) {
+                server_request_header request;
+                std::memcpy(&request, c.buffer.data(), sizeof(request));
+                uint64_t n_values = uint64_t(request.n_rows) * request.n_cols;
+                uint64_t payload = request.name_length + 8 * n_values;
+                if ( request.magic != SERVER_MAGIC
+                     || request.version != SERVER_VERSION
+                     || payload > SERVER_MAX_PAYLOAD ) {
+                    // Answer, then hang up once the answer is out
+                    send_error(c, "Malformed request.");
+                    stats.errors += 1;
+                    c.closing = true;
+                    c.buffer.clear();
+                    break;
+                }
+                if ( c.buffer.size() < sizeof(request) + payload ) {
+                    break;
+                }
+                const char* body = c.buffer.data() + sizeof(request);
+                std::string name(body, request.name_length);
+                if ( request.type == REQUEST_PREDICT ) {
+                    std::map<std::string, int>::iterator m;
+                    m = model_index.find(name);
+                    if ( m == model_index.end() ) {
+                        send_error(c, "Unknown model " + name + ".");
+                        stats.errors += 1;
+                    }
+                    else if ( int(request.n_cols) != model_dims[m->second] ) {
+                        send_error(c, "Wrong number of input columns.");
+                        stats.errors += 1;
+                    }
+                    else {
+                        pending_request p;
+                        p.fd = c.fd;
+                        p.model = m->second;
+                        p.n_rows = request.n_rows;
+                        p.x.resize(n_values);
+                        if ( n_values > 0 ) {
+                            std::memcpy(&p.x[0], body + request.name_length,
+                                        8 * n_values);
+                        }
+                        p.received = server_clock::now();
+                        pending_rows += p.n_rows;
+                        pending.push_back(p);
+                    }
+                }
+                else if ( request.type == REQUEST_STATS ) {
+                    std::vector<double> table = stats_table(stats);
+                    send_values(c, &table[0], SERVER_HISTOGRAM_BUCKETS, 3);
+                }
+                else if ( request.type == REQUEST_SHUTDOWN ) {
+                    send_values(c, 0, 0, 0);
+                    shutting_down = true;
+                }
+                else {
+                    send_error(c, "Unknown request type.");
+                    stats.errors += 1;
+                }
+                c.buffer.erase(0, sizeof(request) + payload);
+            }
+            if ( closed ) {
+                drop_connection(connections, i, pending, pending_rows);
+            }
+        }
+        // Run the batch if it's big enough or the oldest request is due
+        bool due = !pending.empty() && (
+            pending_rows >= options.max_batch || shutting_down
+            || elapsed_ms(pending[0].received) >= options.max_wait_ms
+        );
+        if ( due ) {
+            std::map<int, std::vector<size_t> > by_model;
+            for ( size_t j = 0; j < pending.size(); ++j ) {
+                by_model[pending[j].model].push_back(j);
+            }
+            std::map<int, std::vector<size_t> >::iterator it;
+            for ( it = by_model.begin(); it != by_model.end(); ++it ) {
+                int d = model_dims[it->first];
+                std::vector<size_t>& members = it->second;
+                int n = 0;
+                for ( size_t k = 0; k < members.size(); ++k ) {
+                    n += pending[members[k]].n_rows;
+                }
+                // Stack the requests' rows into one column-major matrix
+                std::vector<double> xs(static_cast<size_t>(n) * d);
+                int row = 0;
+                for ( size_t k = 0; k < members.size(); ++k ) {
+                    pending_request& p = pending[members[k]];
+                    for ( int r = 0; r < p.n_rows; ++r, ++row ) {
+                        for ( int j = 0; j < d; ++j ) {
+                            size_t at = static_cast<size_t>(j) * n + row;
+                            xs[at] = p.x[r * d + j];
+                        }
+                    }
+                }
+                std::vector<double> out;
+                std::string message = predict(it->first, xs, n, d, out);
+                stats.batches += 1;
+                stats.rows += n;
+                stats.record(stats.batch_rows, n);
+                // And split the results back up
+                row = 0;
+                for ( size_t k = 0; k < members.size(); ++k ) {
+                    pending_request& p = pending[members[k]];
+                    connection* c = find_connection(connections, p.fd);
+                    if ( message.empty() ) {
+                        std::vector<double> mine(4 * p.n_rows);
+                        for ( int j = 0; j < 4; ++j ) {
+                            for ( int r = 0; r < p.n_rows; ++r ) {
+                                mine[j * p.n_rows + r]
+                                    = out[static_cast<size_t>(j) * n + row + r];
+                            }
+                        }
+                        send_values(*c, mine.empty() ? 0 : &mine[0],
+                                    p.n_rows, 4);
+                    }
+                    else {
+                        send_error(*c, message);
+                        stats.errors += 1;
+                    }
+                    row += p.n_rows;
+                    stats.requests += 1;
+                    stats.record(stats.latency,
+                                 1000.0 * elapsed_ms(p.received));
+                }
+            }
+            pending.clear();
+            pending_rows = 0;
+        }
+        // Send what the sockets take now; the rest waits for POLLOUT
+        for ( size_t i = connections.size(); i-- > 0; ) {
+            connection& c = connections[i];
+            if ( !flush(c) || (c.closing && c.output.empty()) ) {
+                drop_connection(connections, i, pending, pending_rows);
+            }
+        }
+        if ( shutting_down && pending.empty() ) {
+            break;
+        }
+    }
+    // Give the last responses, the shutdown's among them, a moment to go
+    // out
+    server_clock::time_point stopped = server_clock::now();
+    while ( elapsed_ms(stopped) < 1000.0 ) {
+        std::vector<pollfd> fds;
+        for ( size_t i = 0; i < connections.size(); ++i ) {
+            if ( flush(connections[i]) && !connections[i].output.empty() ) {
+                pollfd f;
+                f.fd = connections[i].fd;
+                f.events = POLLOUT;
+                f.revents = 0;
+                fds.push_back(f);
+            }
+        }
+        if ( fds.empty() ) {
+            break;
+        }
+        poll(&fds[0], fds.size(), 100);
+    }
+    for ( size_t i = 0; i < connections.size(); ++i ) {
+        close(connections[i].fd);
+    }
+    close(listener);
+    unlink(options.path.c_str());
+    return result;
+}
@@ -0,0 +1,54 @@
+#ifndef GPMLR_SERVER_H
+#define GPMLR_SERVER_H
+
+// The event loop behind gp_serve(). It only deals with sockets, framing,
+// batching, and bookkeeping; the actual predictions are made by a callback,
+// which is always invoked on the thread that called run_server() (so it may
+// safely call into Octave).
+
+#include <gpmlr/server-protocol.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+struct server_options {
+    std::string path;     // where to create the Unix domain socket
+    int max_batch;        // run a batch once this many rows are waiting
+    double max_wait_ms;   // or once the oldest request has waited this long
+};
+
+// Latencies (from a request being fully read until its response is queued)
+// are counted in buckets of powers of two microseconds: bucket b holds
+// latencies below 2^(b + 1) microseconds (and at least 2^b, for b > 0)
+const int SERVER_HISTOGRAM_BUCKETS = 32;
+
+struct server_stats {
+    double requests;
+    double errors;
+    double batches;
+    double rows;
+    std::vector<double> latency;     // counts per bucket, as above
+    std::vector<double> batch_rows;  // batch sizes, in the same buckets
+    server_stats() : requests(0), errors(0), batches(0), rows(0),
+                     latency(SERVER_HISTOGRAM_BUCKETS, 0.0),
+                     batch_rows(SERVER_HISTOGRAM_BUCKETS, 0.0) {}
+    void record(std::vector<double>& histogram, double value);
+};
+
+// Predicts at the n x d inputs xs (column-major) for model index model,
+// filling out with the n x 4 matrix [ymu ys2 fmu fs2]. Returns "" on
+// success or an error message, which is sent to every request in the batch.
+typedef std::function<std::string(int model, const std::vector<double>& xs,
+                                  int n, int d, std::vector<double>& out)>
+    batch_predictor;
+
+// Serves until a shutdown request arrives (returns true) or interrupted()
+// says to stop or the socket can't be set up (returns false; error says why)
+bool run_server(const server_options& options,
+                const std::vector<std::string>& model_names,
+                const std::vector<int>& model_dims,
+                const batch_predictor& predict,
+                const std::function<bool()>& interrupted,
+                server_stats& stats, std::string& error);
+
+#endif
@@ -1,21 +1,49 @@
 #include "gpmlr.h"
 
+namespace {
+
+// Sets the memory limit of GPML's sq_dist_cache() (see util/sq_dist_cache.m)
+// for as long as it is in scope, so the training inputs' squared distances
+// are kept across minimize()'s calls to gp() and released afterwards, even
+// if minimize() fails
+struct distance_cache_scope {
+    explicit distance_cache_scope(double bytes) {
+        set_limit(bytes);
+    }
+    ~distance_cache_scope() {
+        try {
+            set_limit(0.0);
+        } catch ( ... ) {
+            // Octave may already be in an error state
+        }
+    }
+    static void set_limit(double bytes) {
+        octave_value_list in;
+        in(0) = octave_value("limit");
+        in(1) = octave_value(bytes);
+        OCT("sq_dist_cache", in, 0);
+    }
+};
+
+}
+
 // [[Rcpp::export(.set_hyperparameters)]]
 Rcpp::List set_hyperparameters(Rcpp::List hyp,
                                Rcpp::List inf,
                                Rcpp::List mean,
                                Rcpp::List cov,
                                Rcpp::List lik,
-                               Rcpp::NumericVector x,
+                               SEXP x,
                                Rcpp::NumericVector y,
-                               int n_evals) {
+                               int n_evals,
+                               double cache_bytes) {
     // Convert the arguments to values Octave can understand
     octave_map octave_hyperparameters = list_to_map(hyp);
     Cell inf_func = list_to_cell(inf);
     Cell mean_func = list_to_cell(mean);
     Cell lik_func = list_to_cell(lik);
     Cell cov_func = list_to_cell(cov);
-    Matrix octave_x = rcppmat_to_octmat(x);
+    octave_value octave_x = rcpp_to_octval(x);
     Matrix octave_y = rcppmat_to_octmat(y);
     // Create the list of arguments going into the Octave function
     octave_value_list in;
@@ -26,9 +54,11 @@ Rcpp::List set_hyperparameters(Rcpp::List hyp,
     in(4) = octave_value(mean_func);
     in(5) = octave_value(cov_func);
     in(6) = octave_value(lik_func);
-    in(7) = octave_value(octave_x);
+    in(7) = octave_x;
     in(8) = octave_value(octave_y);
-    // Call GPML's Octave function minimize() (quietly)
+    // Call GPML's Octave function minimize() (quietly), with the distances
+    // between the training inputs cached across its iterations
+    distance_cache_scope cache(cache_bytes);
     std::cout.setstate(std::ios_base::failbit);
     octave_value_list octave_result = OCT("minimize", in, 1);
     std::cout.clear();
@@ -0,0 +1,129 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s state-space inference (approx = "statespace"): infExact() for
+// likGauss on 1-D inputs by Kalman filtering and smoothing (see
+// native-statespace.cpp), in O(n) time and memory without Octave.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// [[Rcpp::export(.gp_state_space)]]
+Rcpp::List gp_state_space(Rcpp::List hyp,
+                          Rcpp::List mean,
+                          Rcpp::List cov,
+                          Rcpp::List lik,
+                          Rcpp::NumericVector x,
+                          Rcpp::NumericVector y,
+                          Rcpp::NumericVector xs,
+                          Rcpp::NumericVector ys,
+                          bool derivatives,
+                          bool posterior) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( dim != 1 ) {
+        Rcpp::stop("State-space inference needs one-dimensional inputs.\n");
+    }
+    if ( x.size() != n ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int ns = xs.size();
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    state_space_model model;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    if ( !parse_state_space_model(inf, mean, cov, lik, model) ) {
+        Rcpp::stop("State-space inference needs likGauss, meanZero or "
+                   "meanConst, and covMaterniso (d = 1, 3, or 5), covCos, "
+                   "covPeriodic, covPeriodicNoDC, or covSum and covProd of "
+                   "those.\n");
+    }
+    // hyp, as native_state_space() orders it
+    Rcpp::NumericVector hyp_mean = hyp["mean"];
+    Rcpp::NumericVector hyp_cov = hyp["cov"];
+    Rcpp::NumericVector hyp_lik = hyp["lik"];
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    if ( hyp_mean.size() != n_mean || hyp_cov.size() != n_cov
+         || hyp_lik.size() != 1 ) {
+        Rcpp::stop("The hyperparameters do not match the model.\n");
+    }
+    std::vector<double> h(hyp_mean.begin(), hyp_mean.end());
+    h.insert(h.end(), hyp_cov.begin(), hyp_cov.end());
+    h.push_back(hyp_lik[0]);
+    if ( state_space_order(model, &h[0]) == 0 ) {
+        Rcpp::stop("The state-space form would need too many states; a "
+                   "periodic length scale may be too short.\n");
+    }
+    double sn2 = std::exp(2.0 * h[n_mean + n_cov]);
+    // POST: K is never formed, so there is no L to give
+    Rcpp::NumericMatrix alpha(n, 1);
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), 1.0 / std::sqrt(sn2));
+    Rcpp::NumericMatrix L(0, 0);
+    if ( ns == 0 ) {
+        Rcpp::NumericMatrix nlz(1, 1);
+        std::vector<double> dnlz(model.n_hyp());
+        if ( !native_state_space(model, &h[0], x.begin(), y.begin(), n,
+                                 &nlz[0], derivatives ? &dnlz[0] : 0,
+                                 posterior ? alpha.begin() : 0) ) {
+            Rcpp::stop("The Kalman filter broke down.\n");
+        }
+        Rcpp::List result = Rcpp::List::create(Rcpp::_["NLZ"] = nlz);
+        if ( derivatives ) {
+            Rcpp::NumericMatrix d_mean(n_mean, 1);
+            Rcpp::NumericMatrix d_cov(n_cov, 1);
+            Rcpp::NumericMatrix d_lik(1, 1);
+            std::copy(dnlz.begin(), dnlz.begin() + n_mean, d_mean.begin());
+            std::copy(dnlz.begin() + n_mean, dnlz.begin() + n_mean + n_cov,
+                      d_cov.begin());
+            d_lik[0] = dnlz[n_mean + n_cov];
+            result.push_back(Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                                Rcpp::_["cov"] = d_cov,
+                                                Rcpp::_["lik"] = d_lik),
+                             "DNLZ");
+        }
+        if ( posterior ) {
+            result.push_back(Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                                Rcpp::_["sW"] = sW,
+                                                Rcpp::_["L"] = L),
+                             "POST");
+        }
+        return result;
+    }
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    if ( !native_state_space_predict(model, &h[0], x.begin(), y.begin(), n,
+                                     xs.begin(), ns, fmu.begin(),
+                                     fs2.begin(), alpha.begin()) ) {
+        Rcpp::stop("The Kalman filter broke down.\n");
+    }
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    Rcpp::NumericMatrix ymu = Rcpp::clone(fmu);
+    Rcpp::NumericMatrix ys2(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        ys2[i] = fs2[i] + sn2;
+    }
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2,
+                                  Rcpp::_["POST"] = post);
+    }
+    // likGauss' log predictive probabilities
+    Rcpp::NumericMatrix lp(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        double r = ys[i] - ymu[i];
+        lp[i] = -r * r / (2.0 * ys2[i]) - 0.5 * (LOG_2PI + std::log(ys2[i]));
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp,
+                              Rcpp::_["POST"] = post);
+}
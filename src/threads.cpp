@@ -0,0 +1,121 @@
+#include "gpmlr.h"
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+// gp_threads(): the thread budget shared by the BLAS the embedded Octave
+// calls and gpmlr's own parallel code (see native-threads.cpp). The BLAS is
+// found by the thread-control functions it exports, since the library
+// loaded at run time (e.g. through the alternatives system) need not be the
+// one configure saw; those without any are taken to be single threaded
+// reference BLAS.
+
+namespace {
+
+#if defined(GPMLR_BLAS_OPENBLAS)
+const char* CONFIGURED_BLAS = "OpenBLAS";
+#elif defined(GPMLR_BLAS_MKL)
+const char* CONFIGURED_BLAS = "MKL";
+#elif defined(GPMLR_BLAS_REFERENCE)
+const char* CONFIGURED_BLAS = "reference";
+#else
+const char* CONFIGURED_BLAS = "unknown";
+#endif
+
+typedef void (*set_threads_function)(int);
+typedef int (*get_threads_function)();
+typedef char* (*get_config_function)();
+
+struct blas_library {
+    std::string name;
+    set_threads_function set_threads;
+    get_threads_function get_threads;
+    std::string config;
+};
+
+void* find_symbol(const char* name) {
+#ifdef _WIN32
+    return 0;
+#else
+    void* symbol = dlsym(RTLD_DEFAULT, name);
+    if ( symbol ) {
+        return symbol;
+    }
+    // R loads packages' libraries locally, so the BLAS may only be visible
+    // from this library's own dependencies
+    Dl_info info;
+    if ( dladdr(reinterpret_cast<void*>(&find_symbol), &info)
+         && info.dli_fname ) {
+        void* self = dlopen(info.dli_fname, RTLD_LAZY | RTLD_NOLOAD);
+        if ( self ) {
+            symbol = dlsym(self, name);
+            dlclose(self);
+        }
+    }
+    return symbol;
+#endif
+}
+
+const blas_library& loaded_blas() {
+    static blas_library blas;
+    static bool detected = false;
+    if ( detected ) {
+        return blas;
+    }
+    detected = true;
+    blas.set_threads = 0;
+    blas.get_threads = 0;
+    if ( find_symbol("openblas_set_num_threads") ) {
+        blas.name = "OpenBLAS";
+        blas.set_threads = reinterpret_cast<set_threads_function>(
+            find_symbol("openblas_set_num_threads"));
+        blas.get_threads = reinterpret_cast<get_threads_function>(
+            find_symbol("openblas_get_num_threads"));
+        get_config_function config = reinterpret_cast<get_config_function>(
+            find_symbol("openblas_get_config"));
+        if ( config ) {
+            blas.config = config();
+        }
+    } else if ( find_symbol("MKL_Set_Num_Threads") ) {
+        blas.name = "MKL";
+        blas.set_threads = reinterpret_cast<set_threads_function>(
+            find_symbol("MKL_Set_Num_Threads"));
+        blas.get_threads = reinterpret_cast<get_threads_function>(
+            find_symbol("MKL_Get_Max_Threads"));
+    } else if ( find_symbol("dgemm_") ) {
+        blas.name = "reference";
+    } else {
+        blas.name = "unknown";
+    }
+    return blas;
+}
+
+}
+
+// blas is the number of BLAS threads, or zero to leave them alone
+// [[Rcpp::export(.gp_set_threads)]]
+void gp_set_threads(int total, int blas) {
+    set_thread_budget(total);
+    const blas_library& library = loaded_blas();
+    if ( blas > 0 && library.set_threads ) {
+        library.set_threads(blas);
+    }
+}
+
+// [[Rcpp::export(.gp_threads_info)]]
+Rcpp::List gp_threads_info() {
+    const blas_library& library = loaded_blas();
+    int blas_threads = NA_INTEGER;
+    if ( library.get_threads ) {
+        blas_threads = library.get_threads();
+    } else if ( library.name == "reference" ) {
+        blas_threads = 1;
+    }
+    return Rcpp::List::create(
+        Rcpp::_["blas"] = library.name,
+        Rcpp::_["blas_configured"] = std::string(CONFIGURED_BLAS),
+        Rcpp::_["blas_config"] = library.config,
+        Rcpp::_["blas_threads"] = blas_threads,
+        Rcpp::_["gpmlr_threads"] = resolve_threads(0),
+        Rcpp::_["cores"] = available_cores());
+}
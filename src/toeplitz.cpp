@@ -0,0 +1,155 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s exact inference for training inputs on a regular 1-D grid, where
+// K is Toeplitz (see native-toeplitz.cpp). Neither training nor prediction
+// goes through Octave, and nothing n x n is formed.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// Checks the model and the grid, putting hyp in native_model's order
+static bool parse_toeplitz(const Rcpp::List& hyp, const Rcpp::List& mean,
+                           const Rcpp::List& cov, const Rcpp::List& lik,
+                           const Rcpp::NumericVector& x, native_model& model,
+                           std::vector<double>& h, std::vector<int>& order,
+                           double& step) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    std::vector<int> offsets;
+    if ( dim != 1 || !parse_native_model(inf, mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets) ) {
+        return false;
+    }
+    if ( !regular_grid(x.begin(), x.size(), order, step) ) {
+        return false;
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    h.resize(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+    return true;
+}
+
+// Whether x is a regular 1-D grid and the model one .gp_toeplitz() handles
+// [[Rcpp::export(.gp_toeplitz_grid)]]
+bool gp_toeplitz_grid(Rcpp::List hyp,
+                      Rcpp::List mean,
+                      Rcpp::List cov,
+                      Rcpp::List lik,
+                      Rcpp::NumericVector x) {
+    native_model model;
+    std::vector<double> h;
+    std::vector<int> order;
+    double step = 0.0;
+    return parse_toeplitz(hyp, mean, cov, lik, x, model, h, order, step);
+}
+
+// [[Rcpp::export(.gp_toeplitz)]]
+Rcpp::List gp_toeplitz(Rcpp::List hyp,
+                       Rcpp::List mean,
+                       Rcpp::List cov,
+                       Rcpp::List lik,
+                       Rcpp::NumericVector x,
+                       Rcpp::NumericVector y,
+                       Rcpp::NumericVector xs,
+                       Rcpp::NumericVector ys,
+                       bool derivatives,
+                       int threads) {
+    int n = y.size();
+    if ( x.size() != n ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int ns = xs.size();
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    native_model model;
+    std::vector<double> h;
+    std::vector<int> order;
+    double step = 0.0;
+    if ( !parse_toeplitz(hyp, mean, cov, lik, x, model, h, order, step) ) {
+        Rcpp::stop("Toeplitz inference needs equally spaced 1-D inputs, "
+                   "likGauss, meanZero or meanConst, and a covariance "
+                   "function the compiled code supports.\n");
+    }
+    std::vector<double> y_grid(n);
+    for ( int k = 0; k < n; ++k ) {
+        y_grid[k] = y[order[k]];
+    }
+    toeplitz_result result;
+    if ( !native_toeplitz(model, &h[0], step, &y_grid[0], n,
+                          derivatives && ns == 0, result) ) {
+        Rcpp::stop("The covariance matrix is not positive definite.\n");
+    }
+    // POST: K is never formed, so there is no L to give
+    double sn2 = std::exp(2.0 * h[model.n_mean() + model.cov.n_hyp()]);
+    Rcpp::NumericMatrix alpha(n, 1);
+    for ( int k = 0; k < n; ++k ) {
+        alpha[order[k]] = result.alpha[k];
+    }
+    Rcpp::NumericMatrix sW(n, 1);
+    std::fill(sW.begin(), sW.end(), 1.0 / std::sqrt(sn2));
+    Rcpp::NumericMatrix L(0, 0);
+    Rcpp::List post = Rcpp::List::create(Rcpp::_["alpha"] = alpha,
+                                         Rcpp::_["sW"] = sW,
+                                         Rcpp::_["L"] = L);
+    if ( ns == 0 ) {
+        Rcpp::NumericMatrix nlz(1, 1);
+        nlz[0] = result.nlz;
+        if ( !derivatives ) {
+            return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                      Rcpp::_["POST"] = post);
+        }
+        int n_mean = model.n_mean();
+        int n_cov = model.cov.n_hyp();
+        Rcpp::NumericMatrix d_mean(n_mean, 1);
+        Rcpp::NumericMatrix d_cov(n_cov, 1);
+        Rcpp::NumericMatrix d_lik(1, 1);
+        std::copy(result.dnlz.begin(), result.dnlz.begin() + n_mean,
+                  d_mean.begin());
+        std::copy(result.dnlz.begin() + n_mean,
+                  result.dnlz.begin() + n_mean + n_cov, d_cov.begin());
+        d_lik[0] = result.dnlz[n_mean + n_cov];
+        Rcpp::List dnlz = Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                             Rcpp::_["cov"] = d_cov,
+                                             Rcpp::_["lik"] = d_lik);
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                                  Rcpp::_["DNLZ"] = dnlz,
+                                  Rcpp::_["POST"] = post);
+    }
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    native_toeplitz_predict(model, &h[0], x[order[0]], step, n, result,
+                            xs.begin(), ns, fmu.begin(), fs2.begin(),
+                            threads);
+    Rcpp::NumericMatrix ymu = Rcpp::clone(fmu);
+    Rcpp::NumericMatrix ys2(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        ys2[i] = fs2[i] + sn2;
+    }
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2,
+                                  Rcpp::_["POST"] = post);
+    }
+    // likGauss' log predictive probabilities
+    Rcpp::NumericMatrix lp(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        double r = ys[i] - ymu[i];
+        lp[i] = -r * r / (2.0 * ys2[i]) - 0.5 * (LOG_2PI + std::log(ys2[i]));
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp,
+                              Rcpp::_["POST"] = post);
+}
@@ -1,6 +1,14 @@
 #include "gpmlr.h"
 #include <ov-cell.h>
 #include <ov-fcn-handle.h>
+#include <ov-re-mat.h>
+#include <ov-scalar.h>
+#include <ov-float.h>
+#include <ov-flt-re-mat.h>
+#include <ov-re-sparse.h>
+#include <ov-bool.h>
+#include <ov-bool-mat.h>
+#include <ov-bool-sparse.h>
 
 // String conversions
 string_vector to_string_vector(const Rcpp::CharacterVector& x) {
@@ -52,13 +60,166 @@ Matrix rcppmat_to_octmat(const Rcpp::NumericVector& x) {
     return result;
 }
 
+// CONVERSIONS BETWEEN SPARSE MATRICES
+
+// The Matrix package's dgCMatrix and Octave's SparseMatrix are both
+// compressed sparse column, so the conversions copy the arrays as they are.
+bool is_dgcmatrix(SEXP x) {
+    return Rf_isS4(x) && Rf_inherits(x, "dgCMatrix");
+}
+
+SparseMatrix rcppsparse_to_octsparse(const Rcpp::S4& x) {
+    Rcpp::IntegerVector dims = x.slot("Dim");
+    Rcpp::IntegerVector i = x.slot("i");
+    Rcpp::IntegerVector p = x.slot("p");
+    Rcpp::NumericVector values = x.slot("x");
+    int n = dims[0];
+    int m = dims[1];
+    int nnz = p[m];
+    SparseMatrix result(n, m, nnz);
+    for ( int j = 0; j <= m; ++j ) {
+        result.xcidx(j) = p[j];
+    }
+    for ( int k = 0; k < nnz; ++k ) {
+        result.xridx(k) = i[k];
+        result.xdata(k) = values[k];
+    }
+    return result;
+}
+
+// Without the Matrix package, the result is dense instead
+Rcpp::RObject octsparse_to_rcppsparse(const SparseMatrix& x) {
+    int n = x.rows();
+    int m = x.cols();
+    int nnz = x.cidx(m);
+    try {
+        Rcpp::Environment::namespace_env("Matrix");
+    } catch ( ... ) {
+        return octmat_to_rcppmat(x.matrix_value());
+    }
+    Rcpp::S4 result("dgCMatrix");
+    Rcpp::IntegerVector i(nnz);
+    Rcpp::IntegerVector p(m + 1);
+    Rcpp::NumericVector values(nnz);
+    for ( int j = 0; j <= m; ++j ) {
+        p[j] = x.cidx(j);
+    }
+    for ( int k = 0; k < nnz; ++k ) {
+        i[k] = x.ridx(k);
+        values[k] = x.data(k);
+    }
+    result.slot("Dim") = Rcpp::IntegerVector::create(n, m);
+    result.slot("i") = i;
+    result.slot("p") = p;
+    result.slot("x") = values;
+    return result;
+}
+
+// CONVERSIONS OF SINGLE VALUES
+
+// Numeric vectors and matrices become Matrix, and dgCMatrix SparseMatrix
+octave_value rcpp_to_octval(SEXP x) {
+    if ( is_dgcmatrix(x) ) {
+        return octave_value(rcppsparse_to_octsparse(Rcpp::S4(x)));
+    }
+    return octave_value(rcppmat_to_octmat(Rcpp::NumericVector(x)));
+}
+
+// The conversion is chosen by the value's type ID; real numeric values of
+// other types (ranges, integers) become numeric matrices too, and anything
+// else (e.g. complex values) becomes NULL
+SEXP octval_to_rcpp(const octave_value& x) {
+    int type = x.type_id();
+    if ( type == octave_matrix::static_type_id()
+         || type == octave_scalar::static_type_id()
+         || type == octave_float_matrix::static_type_id()
+         || type == octave_float_scalar::static_type_id() ) {
+        return octmat_to_rcppmat(x.matrix_value());
+    }
+    if ( type == octave_sparse_matrix::static_type_id()
+         || type == octave_sparse_bool_matrix::static_type_id() ) {
+        return octsparse_to_rcppsparse(x.sparse_matrix_value());
+    }
+    if ( type == octave_bool::static_type_id()
+         || type == octave_bool_matrix::static_type_id() ) {
+        boolMatrix values = x.bool_matrix_value();
+        int n = values.rows();
+        int m = values.cols();
+        Rcpp::LogicalMatrix result(n, m);
+        for ( int j = 0; j < m; ++j ) {
+            for ( int i = 0; i < n; ++i ) {
+                result(i, j) = values(i, j);
+            }
+        }
+        return result;
+    }
+    if ( type == octave_scalar_struct::static_type_id() ) {
+        return map_to_list(x.scalar_map_value());
+    }
+    if ( type == octave_struct::static_type_id() ) {
+        // A struct array becomes a list of lists, one per element
+        octave_map values = x.map_value();
+        if ( values.numel() == 1 ) {
+            return map_to_list(values.checkelem(0));
+        }
+        Rcpp::List result(values.numel());
+        for ( int k = 0; k < values.numel(); ++k ) {
+            result[k] = map_to_list(values.checkelem(k));
+        }
+        return result;
+    }
+    if ( type == octave_cell::static_type_id() ) {
+        Cell values = x.cell_value();
+        Rcpp::List result(values.numel());
+        for ( int k = 0; k < values.numel(); ++k ) {
+            result[k] = octval_to_rcpp(values(k));
+        }
+        return result;
+    }
+    if ( type == octave_fcn_handle::static_type_id() ) {
+        // It won't have a name, but we can get its string representation
+        octave_fcn_handle* handle = x.fcn_handle_value();
+        std::ostringstream os;
+        handle->print(os);
+        std::string returned_fcn = os.str();
+        // The only issue is it usually (always?) has a trailling newline
+        returned_fcn.erase(returned_fcn.find_last_not_of("\n") + 1);
+        return Rcpp::wrap(returned_fcn);
+    }
+    if ( x.is_string() ) {
+        string_vector rows = x.string_vector_value();
+        #ifdef OCTAVE_4_2_OR_HIGHER
+            int n = rows.numel();
+        #else
+            int n = rows.length();
+        #endif
+        Rcpp::CharacterVector result(n);
+        for ( int i = 0; i < n; ++i ) {
+            result[i] = rows(i);
+        }
+        return result;
+    }
+    #ifdef OCTAVE_4_4_OR_HIGHER
+        bool real_numeric = x.isnumeric() && x.isreal();
+    #else
+        bool real_numeric = x.is_numeric_type() && x.is_real_type();
+    #endif
+    if ( real_numeric && x.ndims() == 2 ) {
+        return octmat_to_rcppmat(x.matrix_value());
+    }
+    return R_NilValue;
+}
+
 // CONVERSIONS TO AND FROM LISTS
 
 octave_map list_to_map(const Rcpp::List& x) {
-    // TODO: For now, this just deals with lists of numeric vectors/matrices.
-    //       That is all I think we need for dealing with hyperparameters,
-    //       but if we need something more general this could be fixed up
-    //       easily enough along the same lines as list_to_cell.
+    // TODO: For now, this just deals with lists whose elements
+    //       rcpp_to_octval() handles: numeric vectors and matrices (which
+    //       keep their shape, e.g. FITC's hyp.xu) and dgCMatrix objects
+    //       (which stay sparse, e.g. a posterior's L). That is all I think
+    //       we need for hyperparameters and posteriors, but if we need
+    //       something more general this could be fixed up easily enough
+    //       along the same lines as list_to_cell.
     //       I do not yet implement that in case a user could trip up Octave
     //       by taking advantage of such generality.
     // GPML's gp() needs the field names
@@ -69,10 +230,9 @@ octave_map list_to_map(const Rcpp::List& x) {
     for ( int i = 0; i < x.size(); ++i ) {
         // Get this element's name
         std::string tmp_name = xnames[i];
-        // Get the NumericVector
-        Rcpp::NumericVector tmp_vec = Rcpp::as<Rcpp::NumericVector>(x(i));
-        // Convert it to a value Octave understands
-        octave_value octave_tmp_value = rcppmat_to_octmat(tmp_vec);
+        // Convert it to a value Octave understands (sparse matrices, such
+        // as a posterior's L, stay sparse)
+        octave_value octave_tmp_value = rcpp_to_octval(x[i]);
         // Then we use the element name, octave_value, and octave_map member
         // function assign() to put the value in the map with the fieldname
         result.assign(tmp_name, octave_tmp_value);
@@ -98,28 +258,10 @@ Rcpp::List map_to_list(const octave_scalar_map& x) {
         // Get this element and its field name
         std::string this_field_name = octave_xnames(i);
         octave_value octave_tmp_val = x.getfield(this_field_name);
-        // It should usually be a matrix/column vector, but some inference
-        // methods return a function, so we have to deal with that.
-        // Get the value type
-        std::string tmp_val_type = octave_tmp_val.type_name();
-        if ( tmp_val_type == "matrix" || tmp_val_type == "scalar" ) {
-            // If it's a Matrix, convert it to a NumericVector & put in result
-            Matrix oct_mat_tmp = octave_tmp_val.matrix_value();
-            Rcpp::NumericVector rcpp_tmp = octmat_to_rcppmat(oct_mat_tmp);
-            result(i) = rcpp_tmp;
-        }
-        // Otherwise it should be a function handle
-        else if ( tmp_val_type == "function handle" ) {
-            // It won't have a name, but we can get its string representation
-            octave_fcn_handle* octave_tmp = octave_tmp_val.fcn_handle_value();
-            std::ostringstream os;
-            octave_tmp->print(os);
-            std::string returned_fcn = os.str();
-            // The only issue is it usually (always?) has a trailling newline
-            returned_fcn.erase(returned_fcn.find_last_not_of("\n") + 1);
-            result(i) = returned_fcn;
-        }
-        // If neither of those occur, this element will simply be a named NULL
+        // Usually a matrix or column vector, but some inference methods
+        // return functions, sparse matrices, or nested structs; values of
+        // types we don't know of become a named NULL
+        result(i) = octval_to_rcpp(octave_tmp_val);
         rcpp_names(i) = this_field_name;
     }
     result.names() = rcpp_names;
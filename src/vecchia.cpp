@@ -0,0 +1,183 @@
+#include "gpmlr.h"
+#include <cmath>
+
+// gp()'s nearest neighbour approximation (approx = "vecchia"; see
+// native-vecchia.cpp). The index (the maxmin ordering and each point's
+// conditioning set) is built once by .gp_vecchia_index() and passed back in
+// with every set of hyperparameters, so minimizing the NLZ doesn't repeat
+// the neighbour searches.
+
+static const double LOG_2PI = 1.8378770664093454836;
+
+// Returns list(order, neighbours), both 1-based: neighbours is m x n, with
+// column i giving training point i's neighbours (0 where there are fewer
+// than m)
+// [[Rcpp::export(.gp_vecchia_index)]]
+Rcpp::List gp_vecchia_index(Rcpp::NumericVector x, int m, int threads) {
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    int n = x.size() / dim;
+    if ( m < 1 ) {
+        Rcpp::stop("The number of neighbours must be positive.\n");
+    }
+    std::vector<int> order;
+    std::vector<int> neighbours;
+    vecchia_index(x.begin(), n, dim, m, threads, order, neighbours);
+    Rcpp::IntegerVector order_r(n);
+    for ( int r = 0; r < n; ++r ) {
+        order_r[r] = order[r] + 1;
+    }
+    Rcpp::IntegerMatrix neighbours_r(m, n);
+    for ( long k = 0; k < static_cast<long>(n) * m; ++k ) {
+        neighbours_r[k] = neighbours[k] + 1;
+    }
+    return Rcpp::List::create(Rcpp::_["order"] = order_r,
+                              Rcpp::_["neighbours"] = neighbours_r);
+}
+
+// Checks the model and puts hyp in native_model's order
+static void parse_vecchia_model(const Rcpp::List& hyp, const Rcpp::List& mean,
+                                const Rcpp::List& cov, const Rcpp::List& lik,
+                                int dim, native_model& model,
+                                std::vector<double>& h) {
+    Rcpp::List inf = Rcpp::List::create("infExact");
+    std::vector<int> offsets;
+    if ( !parse_native_model(inf, mean, cov, lik, dim, model)
+         || !native_hyp_offsets(hyp, model, offsets) ) {
+        Rcpp::stop("The Vecchia approximation needs likGauss, meanZero or "
+                   "meanConst, and a covariance function the compiled code "
+                   "supports.\n");
+    }
+    std::vector<double> flat_hyp;
+    for ( int i = 0; i < hyp.size(); ++i ) {
+        Rcpp::NumericVector element = hyp[i];
+        flat_hyp.insert(flat_hyp.end(), element.begin(), element.end());
+    }
+    h.resize(offsets.size());
+    for ( size_t k = 0; k < offsets.size(); ++k ) {
+        h[k] = flat_hyp[offsets[k]];
+    }
+}
+
+// NLZ (and DNLZ) given the neighbours .gp_vecchia_index() found
+// [[Rcpp::export(.gp_vecchia)]]
+Rcpp::List gp_vecchia(Rcpp::List hyp,
+                      Rcpp::List mean,
+                      Rcpp::List cov,
+                      Rcpp::List lik,
+                      Rcpp::NumericVector x,
+                      Rcpp::NumericVector y,
+                      Rcpp::IntegerMatrix neighbours,
+                      bool derivatives,
+                      int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    if ( neighbours.ncol() != n ) {
+        Rcpp::stop("The neighbours must have one column per training "
+                   "point.\n");
+    }
+    int m = neighbours.nrow();
+    native_model model;
+    std::vector<double> h;
+    parse_vecchia_model(hyp, mean, cov, lik, dim, model, h);
+    std::vector<int> nb(neighbours.size());
+    for ( size_t k = 0; k < nb.size(); ++k ) {
+        nb[k] = neighbours[k] - 1;
+        if ( nb[k] >= n ) {
+            Rcpp::stop("The neighbours must index the training points.\n");
+        }
+    }
+    Rcpp::NumericMatrix nlz(1, 1);
+    std::vector<double> dnlz(model.n_hyp());
+    if ( !native_vecchia(model, &h[0], x.begin(), y.begin(), n, &nb[0], m,
+                         &nlz[0], derivatives ? &dnlz[0] : 0, threads) ) {
+        Rcpp::stop("A conditional variance was not positive.\n");
+    }
+    if ( !derivatives ) {
+        return Rcpp::List::create(Rcpp::_["NLZ"] = nlz);
+    }
+    int n_mean = model.n_mean();
+    int n_cov = model.cov.n_hyp();
+    Rcpp::NumericMatrix d_mean(n_mean, 1);
+    Rcpp::NumericMatrix d_cov(n_cov, 1);
+    Rcpp::NumericMatrix d_lik(1, 1);
+    std::copy(dnlz.begin(), dnlz.begin() + n_mean, d_mean.begin());
+    std::copy(dnlz.begin() + n_mean, dnlz.begin() + n_mean + n_cov,
+              d_cov.begin());
+    d_lik[0] = dnlz[n_mean + n_cov];
+    Rcpp::List dnlz_r = Rcpp::List::create(Rcpp::_["mean"] = d_mean,
+                                           Rcpp::_["cov"] = d_cov,
+                                           Rcpp::_["lik"] = d_lik);
+    return Rcpp::List::create(Rcpp::_["NLZ"] = nlz,
+                              Rcpp::_["DNLZ"] = dnlz_r);
+}
+
+// Predictions, each test point being conditioned on its m nearest training
+// points
+// [[Rcpp::export(.gp_vecchia_predict)]]
+Rcpp::List gp_vecchia_predict(Rcpp::List hyp,
+                              Rcpp::List mean,
+                              Rcpp::List cov,
+                              Rcpp::List lik,
+                              Rcpp::NumericVector x,
+                              Rcpp::NumericVector y,
+                              int m,
+                              Rcpp::NumericVector xs,
+                              Rcpp::NumericVector ys,
+                              int threads) {
+    int n = y.size();
+    int dim = x.hasAttribute("dim") ? Rcpp::as<Rcpp::NumericMatrix>(x).ncol()
+                                    : 1;
+    if ( x.size() != static_cast<R_xlen_t>(n) * dim ) {
+        Rcpp::stop("x and y have incompatible dimensions.\n");
+    }
+    int ns = xs.size() / dim;
+    if ( xs.size() != static_cast<R_xlen_t>(ns) * dim ) {
+        Rcpp::stop("xs must have as many columns as x.\n");
+    }
+    if ( ys.size() > 0 && ys.size() != ns ) {
+        Rcpp::stop("xs and ys have incompatible dimensions.\n");
+    }
+    if ( m < 1 ) {
+        Rcpp::stop("The number of neighbours must be positive.\n");
+    }
+    native_model model;
+    std::vector<double> h;
+    parse_vecchia_model(hyp, mean, cov, lik, dim, model, h);
+    double sn2 = std::exp(2.0 * h[model.n_mean() + model.cov.n_hyp()]);
+    kd_tree tree;
+    build_kd_tree(x.begin(), n, dim, tree);
+    Rcpp::NumericMatrix fmu(ns, 1);
+    Rcpp::NumericMatrix fs2(ns, 1);
+    if ( !native_vecchia_predict(model, &h[0], x.begin(), y.begin(), n, tree,
+                                 m, xs.begin(), ns, fmu.begin(), fs2.begin(),
+                                 threads) ) {
+        Rcpp::stop("A conditional variance was not positive.\n");
+    }
+    Rcpp::NumericMatrix ys2(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        ys2[i] = fs2[i] + sn2;
+    }
+    Rcpp::NumericMatrix ymu = Rcpp::clone(fmu);
+    if ( ys.size() == 0 ) {
+        return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                                  Rcpp::_["YS2"] = ys2,
+                                  Rcpp::_["FMU"] = fmu,
+                                  Rcpp::_["FS2"] = fs2);
+    }
+    // likGauss' log predictive probabilities
+    Rcpp::NumericMatrix lp(ns, 1);
+    for ( int i = 0; i < ns; ++i ) {
+        double r = ys[i] - ymu[i];
+        lp[i] = -r * r / (2.0 * ys2[i]) - 0.5 * (LOG_2PI + std::log(ys2[i]));
+    }
+    return Rcpp::List::create(Rcpp::_["YMU"] = ymu,
+                              Rcpp::_["YS2"] = ys2,
+                              Rcpp::_["FMU"] = fmu,
+                              Rcpp::_["FS2"] = fs2,
+                              Rcpp::_["LP"] = lp);
+}